@@ -0,0 +1,288 @@
+/* Block filters for ADC samples - see adc_filter.h
+
+   Each kernel copies the stage state into locals, runs the block and
+   writes the state back, so the loops touch only registers and the block.
+   A stage writes output n after reading input n and never reads behind
+   it, which is what makes in place safe, decimation included.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "soc/cpu.h"
+#include "adc_filter.h"
+
+static const char * const pcTypeNames[] = { "boxcar", "iir", "median", "decimate" };
+
+/**************************************************************************/
+
+BaseType_t xAdcFilterBoxcarInit( AdcFilterStage_t *pxStage, uint16_t usWindow )
+{
+	if( usWindow == 0 || usWindow > ADC_FILTER_MAX_BOXCAR || ( usWindow & ( usWindow - 1 ) ) != 0 )
+	{
+		return pdFAIL;
+	}
+
+	memset( pxStage, 0, sizeof( AdcFilterStage_t ) );
+	pxStage->eType = eAdcFilterBoxcar;
+	pxStage->u.xBoxcar.usWindow = usWindow;
+	pxStage->u.xBoxcar.usShift = __builtin_ctz( usWindow );
+	return pdPASS;
+}
+
+BaseType_t xAdcFilterIirInit( AdcFilterStage_t *pxStage, uint16_t usShift )
+{
+	if( usShift == 0 || usShift > ADC_FILTER_MAX_IIR_SHIFT )
+	{
+		return pdFAIL;
+	}
+
+	memset( pxStage, 0, sizeof( AdcFilterStage_t ) );
+	pxStage->eType = eAdcFilterIir;
+	pxStage->u.xIir.usShift = usShift;
+	return pdPASS;
+}
+
+BaseType_t xAdcFilterMedianInit( AdcFilterStage_t *pxStage, uint16_t usWindow )
+{
+	if( usWindow > ADC_FILTER_MAX_MEDIAN || ( usWindow & 1 ) == 0 )
+	{
+		return pdFAIL;
+	}
+
+	memset( pxStage, 0, sizeof( AdcFilterStage_t ) );
+	pxStage->eType = eAdcFilterMedian;
+	pxStage->u.xMedian.usWindow = usWindow;
+	return pdPASS;
+}
+
+BaseType_t xAdcFilterDecimateInit( AdcFilterStage_t *pxStage, uint16_t usFactor )
+{
+	if( usFactor == 0 || usFactor > ADC_FILTER_MAX_DECIMATE )
+	{
+		return pdFAIL;
+	}
+
+	memset( pxStage, 0, sizeof( AdcFilterStage_t ) );
+	pxStage->eType = eAdcFilterDecimate;
+	pxStage->u.xDecimate.usFactor = usFactor;
+	return pdPASS;
+}
+
+/**************************************************************************/
+
+/* Until the window has filled, the average is over the samples so far. */
+static size_t prvBoxcar( AdcFilterStage_t *pxStage, uint16_t *pusSamples, size_t uxSamples )
+{
+	uint32_t ulSum = pxStage->u.xBoxcar.ulSum;
+	uint16_t usCount = pxStage->u.xBoxcar.usCount;
+	uint16_t usNext = pxStage->u.xBoxcar.usNext;
+	const uint16_t usWindow = pxStage->u.xBoxcar.usWindow;
+	const uint16_t usShift = pxStage->u.xBoxcar.usShift;
+	uint16_t * const pusHistory = pxStage->u.xBoxcar.usHistory;
+	size_t i = 0;
+
+	for( ; i < uxSamples && usCount < usWindow; i++ )
+	{
+		pusHistory[ usNext ] = pusSamples[ i ];
+		usNext = ( usNext + 1 ) & ( usWindow - 1 );
+		ulSum += pusSamples[ i ];
+		usCount++;
+		pusSamples[ i ] = ulSum / usCount;
+	}
+
+	for( ; i < uxSamples; i++ )
+	{
+		ulSum += pusSamples[ i ] - pusHistory[ usNext ];
+		pusHistory[ usNext ] = pusSamples[ i ];
+		usNext = ( usNext + 1 ) & ( usWindow - 1 );
+		pusSamples[ i ] = ulSum >> usShift;
+	}
+
+	pxStage->u.xBoxcar.ulSum = ulSum;
+	pxStage->u.xBoxcar.usCount = usCount;
+	pxStage->u.xBoxcar.usNext = usNext;
+	return uxSamples;
+}
+
+/* The first sample seeds the state, so the output doesn't ramp up from 0. */
+static size_t prvIir( AdcFilterStage_t *pxStage, uint16_t *pusSamples, size_t uxSamples )
+{
+	int32_t lState = pxStage->u.xIir.lState;
+	const uint16_t usShift = pxStage->u.xIir.usShift;
+
+	if( uxSamples == 0 )
+	{
+		return 0;
+	}
+	if( pxStage->u.xIir.usStarted == 0 )
+	{
+		lState = ( int32_t ) pusSamples[ 0 ] << 16;
+		pxStage->u.xIir.usStarted = 1;
+	}
+
+	for( size_t i = 0; i < uxSamples; i++ )
+	{
+		lState += ( ( ( int32_t ) pusSamples[ i ] << 16 ) - lState ) >> usShift;
+		pusSamples[ i ] = ( uint16_t ) ( ( lState + 0x8000 ) >> 16 );
+	}
+
+	pxStage->u.xIir.lState = lState;
+	return uxSamples;
+}
+
+/* The sorted copy of the window is kept up to date by moving the samples
+   between the outgoing one's place and the incoming one's by one. */
+static size_t prvMedian( AdcFilterStage_t *pxStage, uint16_t *pusSamples, size_t uxSamples )
+{
+	uint16_t usCount = pxStage->u.xMedian.usCount;
+	uint16_t usNext = pxStage->u.xMedian.usNext;
+	const uint16_t usWindow = pxStage->u.xMedian.usWindow;
+	uint16_t * const pusHistory = pxStage->u.xMedian.usHistory;
+	uint16_t * const pusSorted = pxStage->u.xMedian.usSorted;
+
+	for( size_t i = 0; i < uxSamples; i++ )
+	{
+		uint16_t usIn = pusSamples[ i ];
+		int lAt;
+
+		if( usCount < usWindow )
+		{
+			lAt = usCount++;
+		}
+		else
+		{
+			uint16_t usOut = pusHistory[ usNext ];
+
+			for( lAt = 0; pusSorted[ lAt ] != usOut; lAt++ )
+			{
+			}
+		}
+
+		/* Slide the hole at lAt to where usIn belongs. */
+		while( lAt > 0 && pusSorted[ lAt - 1 ] > usIn )
+		{
+			pusSorted[ lAt ] = pusSorted[ lAt - 1 ];
+			lAt--;
+		}
+		while( lAt < usCount - 1 && pusSorted[ lAt + 1 ] < usIn )
+		{
+			pusSorted[ lAt ] = pusSorted[ lAt + 1 ];
+			lAt++;
+		}
+		pusSorted[ lAt ] = usIn;
+
+		pusHistory[ usNext ] = usIn;
+		usNext = ( usNext + 1 == usWindow ) ? 0 : usNext + 1;
+		pusSamples[ i ] = pusSorted[ usCount / 2 ];
+	}
+
+	pxStage->u.xMedian.usCount = usCount;
+	pxStage->u.xMedian.usNext = usNext;
+	return uxSamples;
+}
+
+static size_t prvDecimate( AdcFilterStage_t *pxStage, uint16_t *pusSamples, size_t uxSamples )
+{
+	const uint16_t usFactor = pxStage->u.xDecimate.usFactor;
+	size_t i = pxStage->u.xDecimate.usPhase;
+	size_t uxOut = 0;
+
+	for( ; i < uxSamples; i += usFactor )
+	{
+		pusSamples[ uxOut++ ] = pusSamples[ i ];
+	}
+
+	pxStage->u.xDecimate.usPhase = i - uxSamples;
+	return uxOut;
+}
+
+/**************************************************************************/
+
+size_t uxAdcFilterStageProcess( AdcFilterStage_t *pxStage, uint16_t *pusSamples, size_t uxSamples )
+{
+	static size_t ( * const pxKernels[] )( AdcFilterStage_t *, uint16_t *, size_t ) =
+	{
+		prvBoxcar, prvIir, prvMedian, prvDecimate
+	};
+	uint32_t ulStart = esp_cpu_get_ccount();
+	size_t uxOut = pxKernels[ pxStage->eType ]( pxStage, pusSamples, uxSamples );
+
+	pxStage->ullCycles += esp_cpu_get_ccount() - ulStart;
+	pxStage->ulSamples += uxSamples;
+	return uxOut;
+}
+
+void vAdcFilterChainInit( AdcFilterChain_t *pxChain )
+{
+	pxChain->pxFirst = NULL;
+	pxChain->pxLast = NULL;
+}
+
+void vAdcFilterChainAppend( AdcFilterChain_t *pxChain, AdcFilterStage_t *pxStage )
+{
+	pxStage->pxNext = NULL;
+	if( pxChain->pxLast == NULL )
+	{
+		pxChain->pxFirst = pxStage;
+	}
+	else
+	{
+		pxChain->pxLast->pxNext = pxStage;
+	}
+	pxChain->pxLast = pxStage;
+}
+
+size_t uxAdcFilterChainProcess( AdcFilterChain_t *pxChain, uint16_t *pusSamples, size_t uxSamples )
+{
+	for( AdcFilterStage_t *pxStage = pxChain->pxFirst; pxStage != NULL; pxStage = pxStage->pxNext )
+	{
+		uxSamples = uxAdcFilterStageProcess( pxStage, pusSamples, uxSamples );
+	}
+	return uxSamples;
+}
+
+/* No dependency between iterations but the sum itself, which the compiler
+   may split into vector lanes. */
+uint32_t ulAdcFilterSum( const uint16_t * restrict pusSamples, size_t uxSamples )
+{
+	uint32_t ulSum = 0;
+
+	for( size_t i = 0; i < uxSamples; i++ )
+	{
+		ulSum += pusSamples[ i ];
+	}
+	return ulSum;
+}
+
+/**************************************************************************/
+
+static uint32_t prvParameter( const AdcFilterStage_t *pxStage )
+{
+	switch( pxStage->eType )
+	{
+		case eAdcFilterBoxcar:   return pxStage->u.xBoxcar.usWindow;
+		case eAdcFilterIir:      return pxStage->u.xIir.usShift;
+		case eAdcFilterMedian:   return pxStage->u.xMedian.usWindow;
+		case eAdcFilterDecimate: return pxStage->u.xDecimate.usFactor;
+		default:                 return 0;
+	}
+}
+
+void vAdcFilterChainPrint( const AdcFilterChain_t *pxChain, const char *pcName )
+{
+	for( const AdcFilterStage_t *pxStage = pxChain->pxFirst; pxStage != NULL; pxStage = pxStage->pxNext )
+	{
+		printf("%s: %-8s %4u %10u samples %8.1f cycles/sample\r\n", pcName, pcTypeNames[ pxStage->eType ],
+		       prvParameter( pxStage ), pxStage->ulSamples, fAdcFilterCyclesPerSample( pxStage ));
+	}
+}
+
+void vAdcFilterChainResetStats( AdcFilterChain_t *pxChain )
+{
+	for( AdcFilterStage_t *pxStage = pxChain->pxFirst; pxStage != NULL; pxStage = pxStage->pxNext )
+	{
+		pxStage->ulSamples = 0;
+		pxStage->ullCycles = 0;
+	}
+}
@@ -0,0 +1,137 @@
+/* Block filters for ADC samples
+
+   A plain average lets one spike move the result by spike / samples, which
+   can be enough to cross a threshold. Here filter stages are chained and
+   run over each block of samples, in place, in the order they were added:
+
+   eAdcFilterBoxcar     moving average over a power of two window
+   eAdcFilterIir        single-pole low-pass, y += ( x - y ) / 2^shift
+   eAdcFilterMedian     running median over an odd window: a spike shorter
+                        than half the window never reaches the output
+   eAdcFilterDecimate   keeps one sample in every factor; the block gets
+                        shorter, so it goes after the smoothing stages
+
+   static AdcFilterStage_t xMedian, xBoxcar, xDecimate;
+   static AdcFilterChain_t xChain;
+
+   vAdcFilterChainInit( &xChain );
+   xAdcFilterMedianInit( &xMedian, 5 );
+   xAdcFilterBoxcarInit( &xBoxcar, 16 );
+   xAdcFilterDecimateInit( &xDecimate, 10 );
+   vAdcFilterChainAppend( &xChain, &xMedian );
+   vAdcFilterChainAppend( &xChain, &xBoxcar );
+   vAdcFilterChainAppend( &xChain, &xDecimate );
+
+   uxSamples = uxAdcFilterChainProcess( &xChain, xBlock.pusSamples, xBlock.uxSamples );
+
+   Stages keep their state between blocks, so a signal split into blocks
+   comes out the same as in one piece. All state lives in the caller's
+   stage structures: nothing is allocated. A stage belongs to one chain,
+   and a chain to one task.
+
+   Every stage counts the CPU cycles it spends per input sample, printed by
+   vAdcFilterChainPrint(). The stages are recurrences, one sample after the
+   other; ulAdcFilterSum(), for averaging the output, has no dependency
+   between samples and is written so the compiler can vectorise it where
+   the target has vector units.
+*/
+#ifndef ADC_FILTER_H
+#define ADC_FILTER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "freertos/FreeRTOS.h"
+
+#define ADC_FILTER_MAX_BOXCAR       64
+#define ADC_FILTER_MAX_MEDIAN       15
+#define ADC_FILTER_MAX_IIR_SHIFT    15
+#define ADC_FILTER_MAX_DECIMATE     256
+
+typedef enum
+{
+	eAdcFilterBoxcar = 0,
+	eAdcFilterIir,
+	eAdcFilterMedian,
+	eAdcFilterDecimate
+} AdcFilterType_t;
+
+typedef struct AdcFilterStage
+{
+	AdcFilterType_t eType;
+	union
+	{
+		struct
+		{
+			uint32_t ulSum;
+			uint16_t usWindow;
+			uint16_t usShift;
+			uint16_t usCount;       /* samples in the window, up to usWindow */
+			uint16_t usNext;        /* oldest sample, replaced next */
+			uint16_t usHistory[ ADC_FILTER_MAX_BOXCAR ];
+		} xBoxcar;
+		struct
+		{
+			int32_t  lState;        /* output, 16 fractional bits */
+			uint16_t usShift;
+			uint16_t usStarted;
+		} xIir;
+		struct
+		{
+			uint16_t usWindow;
+			uint16_t usCount;
+			uint16_t usNext;
+			uint16_t usHistory[ ADC_FILTER_MAX_MEDIAN ];    /* in arrival order */
+			uint16_t usSorted[ ADC_FILTER_MAX_MEDIAN ];     /* the same samples, ascending */
+		} xMedian;
+		struct
+		{
+			uint16_t usFactor;
+			uint16_t usPhase;       /* input samples to skip before the next one kept */
+		} xDecimate;
+	} u;
+
+	uint32_t ulSamples;             /* input samples processed */
+	uint64_t ullCycles;             /* cycles spent on them */
+	struct AdcFilterStage *pxNext;
+} AdcFilterStage_t;
+
+typedef struct
+{
+	AdcFilterStage_t *pxFirst;
+	AdcFilterStage_t *pxLast;
+} AdcFilterChain_t;
+
+/* These return pdFAIL, leaving the stage alone, if the parameter is out of
+   range: usWindow a power of two up to ADC_FILTER_MAX_BOXCAR, usShift 1 to
+   ADC_FILTER_MAX_IIR_SHIFT, usWindow odd up to ADC_FILTER_MAX_MEDIAN,
+   usFactor 1 to ADC_FILTER_MAX_DECIMATE. */
+BaseType_t xAdcFilterBoxcarInit( AdcFilterStage_t *pxStage, uint16_t usWindow );
+BaseType_t xAdcFilterIirInit( AdcFilterStage_t *pxStage, uint16_t usShift );
+BaseType_t xAdcFilterMedianInit( AdcFilterStage_t *pxStage, uint16_t usWindow );
+BaseType_t xAdcFilterDecimateInit( AdcFilterStage_t *pxStage, uint16_t usFactor );
+
+void vAdcFilterChainInit( AdcFilterChain_t *pxChain );
+void vAdcFilterChainAppend( AdcFilterChain_t *pxChain, AdcFilterStage_t *pxStage );
+
+/* Runs the block through every stage in place. Returns the number of
+   samples left at the start of pusSamples. */
+size_t uxAdcFilterChainProcess( AdcFilterChain_t *pxChain, uint16_t *pusSamples, size_t uxSamples );
+
+/* Runs the block through one stage only. */
+size_t uxAdcFilterStageProcess( AdcFilterStage_t *pxStage, uint16_t *pusSamples, size_t uxSamples );
+
+/* Sum of uxSamples 12-bit samples; exact for up to 2^20 of them. */
+uint32_t ulAdcFilterSum( const uint16_t *pusSamples, size_t uxSamples );
+
+static inline float fAdcFilterCyclesPerSample( const AdcFilterStage_t *pxStage )
+{
+	return pxStage->ulSamples ? ( float ) pxStage->ullCycles / pxStage->ulSamples : 0.0f;
+}
+
+/* One line per stage: type, parameter, samples in and cycles per sample,
+   prefixed by pcName. */
+void vAdcFilterChainPrint( const AdcFilterChain_t *pxChain, const char *pcName );
+
+void vAdcFilterChainResetStats( AdcFilterChain_t *pxChain );
+
+#endif /* ADC_FILTER_H */
@@ -0,0 +1,203 @@
+/* Multi-channel ADC1 scans - see adc_scan.h
+
+   The rows are one allocation, channel after channel, so the scan is
+   structure-of-arrays in memory and not just in its pointers.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/adc.h"
+#include "esp_timer.h"
+#include "soc/cpu.h"
+#include "adc_stream.h"
+#include "adc_scan.h"
+
+#define ADC_SCAN_NO_ROW     0xFF
+
+struct AdcScanner
+{
+	AdcScanMode_t      eMode;
+	AdcScan_t          xScan;
+	size_t             uxRowLength;         /* samples per channel */
+	uint16_t          *pusRows;
+	uint8_t            ucRowOf[ 16 ];       /* row of each channel tag, or ADC_SCAN_NO_ROW */
+
+	AdcStreamHandle_t  xStream;             /* eAdcScanDma */
+	TickType_t         xPeriod;             /* eAdcScanPolled */
+	TickType_t         xLastWake;
+
+	AdcScanStats_t     xStats;
+};
+
+/**************************************************************************/
+
+AdcScannerHandle_t xAdcScanCreate( AdcScanMode_t eMode, const adc1_channel_t *pxChannels, size_t uxChannels,
+                                   adc_atten_t xAtten, uint32_t ulScanRateHz, size_t uxSamplesPerChannel )
+{
+	struct AdcScanner *pxScanner;
+
+	if( uxChannels == 0 || uxChannels > ADC_SCAN_MAX_CHANNELS || uxSamplesPerChannel == 0 || ulScanRateHz == 0 ||
+	    ( eMode == eAdcScanDma && uxChannels * uxSamplesPerChannel > ADC_STREAM_MAX_BLOCK ) )
+	{
+		return NULL;
+	}
+
+	pxScanner = pvPortMalloc( sizeof( struct AdcScanner ) );
+	if( pxScanner == NULL )
+	{
+		return NULL;
+	}
+	memset( pxScanner, 0, sizeof( struct AdcScanner ) );
+	memset( pxScanner->ucRowOf, ADC_SCAN_NO_ROW, sizeof( pxScanner->ucRowOf ) );
+
+	for( size_t c = 0; c < uxChannels; c++ )
+	{
+		if( pxChannels[ c ] >= ADC1_CHANNEL_MAX || pxScanner->ucRowOf[ pxChannels[ c ] ] != ADC_SCAN_NO_ROW )
+		{
+			vPortFree( pxScanner );
+			return NULL;
+		}
+		pxScanner->ucRowOf[ pxChannels[ c ] ] = c;
+		pxScanner->xScan.xChannels[ c ] = pxChannels[ c ];
+	}
+
+	pxScanner->pusRows = pvPortMalloc( uxChannels * uxSamplesPerChannel * sizeof( uint16_t ) );
+	if( pxScanner->pusRows == NULL )
+	{
+		vPortFree( pxScanner );
+		return NULL;
+	}
+
+	pxScanner->eMode = eMode;
+	pxScanner->uxRowLength = uxSamplesPerChannel;
+	pxScanner->xScan.uxChannels = uxChannels;
+	for( size_t c = 0; c < uxChannels; c++ )
+	{
+		pxScanner->xScan.pusSamples[ c ] = &pxScanner->pusRows[ c * uxSamplesPerChannel ];
+	}
+
+	if( eMode == eAdcScanDma )
+	{
+		pxScanner->xStream = xAdcStreamCreateScan( pxChannels, uxChannels, xAtten,
+		                                           ulScanRateHz * uxChannels * uxSamplesPerChannel,
+		                                           uxChannels * uxSamplesPerChannel );
+		if( pxScanner->xStream == NULL )
+		{
+			vPortFree( pxScanner->pusRows );
+			vPortFree( pxScanner );
+			return NULL;
+		}
+	}
+	else
+	{
+		adc1_config_width( ADC_WIDTH_BIT_12 );
+		for( size_t c = 0; c < uxChannels; c++ )
+		{
+			adc1_config_channel_atten( pxChannels[ c ], xAtten );
+		}
+		pxScanner->xPeriod = ( configTICK_RATE_HZ / ulScanRateHz ) ? ( configTICK_RATE_HZ / ulScanRateHz ) : 1;
+		pxScanner->xLastWake = xTaskGetTickCount();
+	}
+
+	return pxScanner;
+}
+
+void vAdcScanDelete( AdcScannerHandle_t xScanner )
+{
+	if( xScanner->xStream != NULL )
+	{
+		vAdcStreamDelete( xScanner->xStream );
+	}
+	vPortFree( xScanner->pusRows );
+	vPortFree( xScanner );
+}
+
+/**************************************************************************/
+
+/* Round-robin, so every channel's samples are spread over the same time. */
+static void prvScanPolled( struct AdcScanner *pxScanner )
+{
+	AdcScan_t *pxScan = &pxScanner->xScan;
+
+	for( size_t i = 0; i < pxScanner->uxRowLength; i++ )
+	{
+		for( size_t c = 0; c < pxScan->uxChannels; c++ )
+		{
+			pxScan->pusSamples[ c ][ i ] = adc1_get_raw( pxScan->xChannels[ c ] );
+		}
+	}
+	pxScan->uxSamples = pxScanner->uxRowLength;
+	pxScan->ulSequence = pxScanner->xStats.ulScans;
+}
+
+/* By tag rather than by position: the ESP32 swaps samples in pairs, and a
+   pattern that slips still lands each sample in its own row. A scan is as
+   long as its shortest row. */
+static void prvSortBlock( struct AdcScanner *pxScanner, const AdcStreamBlock_t *pxBlock )
+{
+	AdcScan_t *pxScan = &pxScanner->xScan;
+	size_t uxFill[ ADC_SCAN_MAX_CHANNELS ] = { 0 };
+	size_t uxShortest = pxScanner->uxRowLength;
+	uint32_t ulStray = 0;
+
+	for( size_t i = 0; i < pxBlock->uxSamples; i++ )
+	{
+		uint16_t usSample = pxBlock->pusSamples[ i ];
+		uint8_t ucRow = pxScanner->ucRowOf[ ADC_STREAM_CHANNEL( usSample ) ];
+
+		if( ucRow == ADC_SCAN_NO_ROW || uxFill[ ucRow ] == pxScanner->uxRowLength )
+		{
+			ulStray++;
+			continue;
+		}
+		pxScan->pusSamples[ ucRow ][ uxFill[ ucRow ]++ ] = ADC_STREAM_CODE( usSample );
+	}
+
+	for( size_t c = 0; c < pxScan->uxChannels; c++ )
+	{
+		if( uxFill[ c ] < uxShortest )
+		{
+			uxShortest = uxFill[ c ];
+		}
+	}
+
+	pxScan->uxSamples = uxShortest;
+	pxScan->ulSequence = pxBlock->ulSequence;
+	pxScanner->xStats.ulLostScans += pxBlock->ulLostBefore;
+	pxScanner->xStats.ulStray += ulStray;
+}
+
+BaseType_t xAdcScanNext( AdcScannerHandle_t xScanner, AdcScan_t **ppxScan, TickType_t xTicksToWait )
+{
+	AdcStreamBlock_t xBlock;
+	uint32_t ulStart;
+
+	if( xScanner->eMode == eAdcScanDma )
+	{
+		if( xAdcStreamReceive( xScanner->xStream, &xBlock, xTicksToWait ) != pdTRUE )
+		{
+			return pdFALSE;
+		}
+		ulStart = esp_cpu_get_ccount();
+		prvSortBlock( xScanner, &xBlock );
+	}
+	else
+	{
+		vTaskDelayUntil( &xScanner->xLastWake, xScanner->xPeriod );
+		ulStart = esp_cpu_get_ccount();
+		prvScanPolled( xScanner );
+	}
+
+	xScanner->xStats.ullCycles += esp_cpu_get_ccount() - ulStart;
+	xScanner->xStats.ulScans++;
+	xScanner->xScan.llTimestamp = esp_timer_get_time();
+	*ppxScan = &xScanner->xScan;
+	return pdTRUE;
+}
+
+void vAdcScanGetStats( AdcScannerHandle_t xScanner, AdcScanStats_t *pxStats )
+{
+	*pxStats = xScanner->xStats;
+}
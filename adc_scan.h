@@ -0,0 +1,90 @@
+/* Multi-channel ADC1 scans
+
+   Reading another sensor used to mean another copy of vReadSensor. A scan
+   engine samples a set of ADC1 channels together instead, and hands the
+   task one scan at a time: uxSamples samples of every channel, stored
+   channel-major - one contiguous row per channel - so a row can go
+   straight through the block filters (adc_filter.h) and ulAdcFilterSum():
+
+   static const adc1_channel_t xChannels[] = { ADC1_CHANNEL_6, ADC1_CHANNEL_7 };
+
+   xScanner = xAdcScanCreate( eAdcScanDma, xChannels, 2, ADC_ATTEN_DB_0, 10, 50 );
+
+   for(;;)
+   {
+       xAdcScanNext( xScanner, &pxScan, portMAX_DELAY );
+       for( size_t c = 0; c < pxScan->uxChannels; c++ )
+       {
+           ulMean[ c ] = ulAdcFilterSum( pxScan->pusSamples[ c ], pxScan->uxSamples ) / pxScan->uxSamples;
+       }
+       ... one queue message with every channel ...
+   }
+
+   Two ways to sample:
+
+   eAdcScanPolled   xAdcScanNext() waits for the next scan period, then the
+                    calling task converts the channels round-robin with
+                    adc1_get_raw(), uxSamples rounds of one conversion each
+   eAdcScanDma      an ADC stream (adc_stream.h) converts the channels in
+                    turn through the ADC1 pattern table, one DMA block per
+                    scan; xAdcScanNext() sorts the block into the rows by
+                    the channel tag of each sample. The task costs a pass
+                    over the block per scan, however many channels there are
+
+   The scan is valid until the next call. Only one DMA scanner can run at a
+   time, and it owns ADC1 like any ADC stream.
+*/
+#ifndef ADC_SCAN_H
+#define ADC_SCAN_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "freertos/FreeRTOS.h"
+#include "driver/adc.h"
+
+#define ADC_SCAN_MAX_CHANNELS       ADC1_CHANNEL_MAX
+
+typedef enum
+{
+	eAdcScanPolled = 0,
+	eAdcScanDma
+} AdcScanMode_t;
+
+typedef struct
+{
+	size_t          uxChannels;
+	adc1_channel_t  xChannels[ ADC_SCAN_MAX_CHANNELS ];
+	size_t          uxSamples;                                  /* in every row */
+	uint16_t       *pusSamples[ ADC_SCAN_MAX_CHANNELS ];        /* row c holds xChannels[ c ], oldest first */
+	uint32_t        ulSequence;                                 /* scans since the start, lost ones included */
+	int64_t         llTimestamp;                                /* esp_timer_get_time() at the end of the scan */
+} AdcScan_t;
+
+typedef struct
+{
+	uint32_t ulScans;           /* scans returned */
+	uint32_t ulLostScans;       /* DMA blocks the driver dropped */
+	uint32_t ulStray;           /* DMA samples that didn't fit their row or had an unknown channel */
+	uint64_t ullCycles;         /* CPU cycles spent filling the rows */
+} AdcScanStats_t;
+
+typedef struct AdcScanner * AdcScannerHandle_t;
+
+/* Scans uxChannels distinct channels ulScanRateHz times a second, at 12
+   bits with xAtten, uxSamplesPerChannel samples each. A DMA scan is one
+   block, so uxChannels * uxSamplesPerChannel must fit ADC_STREAM_MAX_BLOCK;
+   a polled scan period is rounded to whole ticks. Returns NULL on bad
+   parameters, if the stream can't start or there is not enough heap. */
+AdcScannerHandle_t xAdcScanCreate( AdcScanMode_t eMode, const adc1_channel_t *pxChannels, size_t uxChannels,
+                                   adc_atten_t xAtten, uint32_t ulScanRateHz, size_t uxSamplesPerChannel );
+
+void vAdcScanDelete( AdcScannerHandle_t xScanner );
+
+/* Waits for the next scan and points *ppxScan at it. A DMA scanner gives up
+   after xTicksToWait and returns pdFALSE; a polled one always waits for its
+   period. */
+BaseType_t xAdcScanNext( AdcScannerHandle_t xScanner, AdcScan_t **ppxScan, TickType_t xTicksToWait );
+
+void vAdcScanGetStats( AdcScannerHandle_t xScanner, AdcScanStats_t *pxStats );
+
+#endif /* ADC_SCAN_H */
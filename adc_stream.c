@@ -0,0 +1,200 @@
+/* Continuous ADC1 sampling by DMA - see adc_stream.h
+
+   The DMA buffers are the I2S driver's: dma_buf_len is the block size, so
+   one i2s_read() of a block takes exactly one completed buffer off the
+   driver's queue. The driver reports each completed buffer, and each one it
+   drops because the queue was full, on its event queue; the stream drains
+   that after every block to count the drops.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "driver/adc.h"
+#include "driver/i2s.h"
+#include "esp_timer.h"
+#include "adc_stream.h"
+
+#define ADC_STREAM_PORT     I2S_NUM_0
+
+struct AdcStream
+{
+	size_t           uxBlockSamples;
+	uint16_t         usMask;            /* ADC_STREAM_CODE_MASK, or all bits for scans,
+	                                       one-channel scans included */
+	uint16_t        *pusBlock;
+	QueueHandle_t    xEvents;
+	int64_t          llStartTime;
+	int64_t          llLastTime;
+	AdcStreamStats_t xStats;
+};
+
+static BaseType_t xStreamRunning = pdFALSE;
+
+/**************************************************************************/
+
+AdcStreamHandle_t xAdcStreamCreate( adc1_channel_t xChannel, adc_atten_t xAtten, uint32_t ulSampleRateHz,
+                                    size_t uxBlockSamples )
+{
+	AdcStreamHandle_t xStream = xAdcStreamCreateScan( &xChannel, 1, xAtten, ulSampleRateHz, uxBlockSamples );
+
+	/* Only the plain stream strips the channel tag. Nothing is read before
+	   this returns, so no block has been masked with the scan's mask yet. */
+	if( xStream != NULL )
+	{
+		xStream->usMask = ADC_STREAM_CODE_MASK;
+	}
+	return xStream;
+}
+
+/* The driver only knows one channel: i2s_adc_enable() loads it as a
+   one-entry pattern, so the full pattern is configured after that. */
+static esp_err_t prvConfigPattern( const adc1_channel_t *pxChannels, size_t uxChannels, adc_atten_t xAtten )
+{
+	adc_digi_pattern_table_t xPattern[ ADC_STREAM_MAX_CHANNELS ];
+	adc_digi_config_t xConfig =
+	{
+		.conv_limit_en = true,
+		.conv_limit_num = 255,
+		.adc1_pattern_len = uxChannels,
+		.adc2_pattern_len = 0,
+		.adc1_pattern = xPattern,
+		.adc2_pattern = NULL,
+		.conv_mode = ADC_CONV_SINGLE_UNIT_1,
+		.format = ADC_DIGI_FORMAT_12BIT,
+	};
+
+	for( size_t i = 0; i < uxChannels; i++ )
+	{
+		xPattern[ i ].val = 0;
+		xPattern[ i ].atten = xAtten;
+		xPattern[ i ].bit_width = ADC_WIDTH_BIT_12;
+		xPattern[ i ].channel = pxChannels[ i ];
+	}
+	return adc_digi_controller_config( &xConfig );
+}
+
+AdcStreamHandle_t xAdcStreamCreateScan( const adc1_channel_t *pxChannels, size_t uxChannels, adc_atten_t xAtten,
+                                        uint32_t ulSampleRateHz, size_t uxBlockSamples )
+{
+	struct AdcStream *pxStream;
+	i2s_config_t xConfig =
+	{
+		.mode = I2S_MODE_MASTER | I2S_MODE_RX | I2S_MODE_ADC_BUILT_IN,
+		.sample_rate = ulSampleRateHz,
+		.bits_per_sample = I2S_BITS_PER_SAMPLE_16BIT,
+		.channel_format = I2S_CHANNEL_FMT_ONLY_LEFT,
+		.communication_format = I2S_COMM_FORMAT_I2S_MSB,
+		.intr_alloc_flags = 0,
+		.dma_buf_count = ADC_STREAM_DMA_BUFFERS,
+		.dma_buf_len = uxBlockSamples,
+		.use_apll = false,
+	};
+
+	if( xStreamRunning || uxBlockSamples == 0 || uxBlockSamples > ADC_STREAM_MAX_BLOCK || ulSampleRateHz == 0 ||
+	    uxChannels == 0 || uxChannels > ADC_STREAM_MAX_CHANNELS )
+	{
+		return NULL;
+	}
+
+	pxStream = pvPortMalloc( sizeof( struct AdcStream ) );
+	if( pxStream == NULL )
+	{
+		return NULL;
+	}
+	memset( pxStream, 0, sizeof( struct AdcStream ) );
+	pxStream->uxBlockSamples = uxBlockSamples;
+	pxStream->usMask = 0xFFFF;
+	pxStream->pusBlock = pvPortMalloc( uxBlockSamples * sizeof( uint16_t ) );
+	if( pxStream->pusBlock == NULL )
+	{
+		vPortFree( pxStream );
+		return NULL;
+	}
+
+	adc1_config_width( ADC_WIDTH_BIT_12 );
+	for( size_t i = 0; i < uxChannels; i++ )
+	{
+		adc1_config_channel_atten( pxChannels[ i ], xAtten );
+	}
+	if( i2s_driver_install( ADC_STREAM_PORT, &xConfig, ADC_STREAM_EVENT_QUEUE, &pxStream->xEvents ) != ESP_OK )
+	{
+		vPortFree( pxStream->pusBlock );
+		vPortFree( pxStream );
+		return NULL;
+	}
+	if( i2s_set_adc_mode( ADC_UNIT_1, pxChannels[ 0 ] ) != ESP_OK || i2s_adc_enable( ADC_STREAM_PORT ) != ESP_OK ||
+	    ( uxChannels > 1 && prvConfigPattern( pxChannels, uxChannels, xAtten ) != ESP_OK ) )
+	{
+		i2s_adc_disable( ADC_STREAM_PORT );
+		i2s_driver_uninstall( ADC_STREAM_PORT );
+		vPortFree( pxStream->pusBlock );
+		vPortFree( pxStream );
+		return NULL;
+	}
+
+	pxStream->llStartTime = esp_timer_get_time();
+	pxStream->llLastTime = pxStream->llStartTime;
+	xStreamRunning = pdTRUE;
+	return pxStream;
+}
+
+void vAdcStreamDelete( AdcStreamHandle_t xStream )
+{
+	i2s_adc_disable( ADC_STREAM_PORT );
+	i2s_driver_uninstall( ADC_STREAM_PORT );
+	vPortFree( xStream->pusBlock );
+	vPortFree( xStream );
+	xStreamRunning = pdFALSE;
+}
+
+/**************************************************************************/
+
+BaseType_t xAdcStreamReceive( AdcStreamHandle_t xStream, AdcStreamBlock_t *pxBlock, TickType_t xTicksToWait )
+{
+	size_t uxBytes = xStream->uxBlockSamples * sizeof( uint16_t );
+	size_t uxRead = 0;
+	uint32_t ulLost = 0;
+	i2s_event_t xEvent;
+
+	/* Whole buffers only, so a read either takes one or none. */
+	i2s_read( ADC_STREAM_PORT, xStream->pusBlock, uxBytes, &uxRead, xTicksToWait );
+	if( uxRead != uxBytes )
+	{
+		return pdFALSE;
+	}
+
+	while( xQueueReceive( xStream->xEvents, &xEvent, 0 ) == pdTRUE )
+	{
+		if( xEvent.type == I2S_EVENT_RX_Q_OVF )
+		{
+			ulLost++;
+		}
+	}
+
+	for( size_t i = 0; i < xStream->uxBlockSamples; i++ )
+	{
+		xStream->pusBlock[ i ] &= xStream->usMask;
+	}
+
+	xStream->llLastTime = esp_timer_get_time();
+	xStream->xStats.ulLostBlocks += ulLost;
+	xStream->xStats.ulBlocks++;
+
+	pxBlock->pusSamples = xStream->pusBlock;
+	pxBlock->uxSamples = xStream->uxBlockSamples;
+	pxBlock->ulSequence = xStream->xStats.ulBlocks + xStream->xStats.ulLostBlocks - 1;
+	pxBlock->ulLostBefore = ulLost;
+	return pdTRUE;
+}
+
+void vAdcStreamGetStats( AdcStreamHandle_t xStream, AdcStreamStats_t *pxStats )
+{
+	int64_t llElapsed = xStream->llLastTime - xStream->llStartTime;
+	uint64_t ullSamples = ( uint64_t ) ( xStream->xStats.ulBlocks + xStream->xStats.ulLostBlocks ) *
+	                      xStream->uxBlockSamples;
+
+	*pxStats = xStream->xStats;
+	pxStats->ulMeasuredRateHz = ( llElapsed > 0 ) ? ( uint32_t ) ( ullSamples * 1000000ULL / llElapsed ) : 0;
+}
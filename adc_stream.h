@@ -0,0 +1,98 @@
+/* Continuous ADC1 sampling by DMA
+
+   Polling adc1_get_raw() in a loop keeps the task busy for the whole burst
+   and caps the sample rate at whatever the loop manages. Here the I2S
+   peripheral clocks ADC1 in its built-in ADC mode and its DMA writes the
+   samples into ADC_STREAM_DMA_BUFFERS buffers of one block each, in turn:
+   while the DMA fills one, the task has the other. The task sleeps until a
+   whole block is ready and gets it in one call:
+
+   xStream = xAdcStreamCreate( ADC1_CHANNEL_6, ADC_ATTEN_DB_11, 20000, 1000 );
+
+   for(;;)
+   {
+       xAdcStreamReceive( xStream, &xBlock, portMAX_DELAY );
+       for( size_t i = 0; i < xBlock.uxSamples; i++ )
+       {
+           ... xBlock.pusSamples[ i ] ...
+       }
+   }
+
+   A block must be taken before the DMA completes the next one, or the
+   driver drops it; ulLostBefore of the next block received says how many
+   were dropped. Processing longer than one block period therefore loses
+   data: raise ADC_STREAM_DMA_BUFFERS to ride out longer gaps.
+
+   xAdcStreamCreateScan() converts several channels in turn instead, through
+   the ADC1 pattern table of the digital controller. Its samples keep the
+   channel they came from in the top bits: ADC_STREAM_CHANNEL() and
+   ADC_STREAM_CODE() take them apart (adc_scan.h sorts them by channel).
+
+   The stream owns I2S0 and ADC1, so there is at most one at a time, and
+   nothing else may read ADC1 while it runs. On the ESP32 the I2S ADC mode
+   returns the samples of each pair swapped; for averaging and thresholds
+   that makes no difference, and scans go by the channel bits.
+*/
+#ifndef ADC_STREAM_H
+#define ADC_STREAM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "freertos/FreeRTOS.h"
+#include "driver/adc.h"
+
+/* Ping-pong: one buffer being filled, one being read. */
+#define ADC_STREAM_DMA_BUFFERS      2
+/* RX_DONE and overflow events kept between two reads. Lost blocks are only
+   counted exactly while the reader falls behind by fewer blocks. */
+#define ADC_STREAM_EVENT_QUEUE      16
+/* Largest block the I2S DMA supports. */
+#define ADC_STREAM_MAX_BLOCK        1024
+/* Entries in the ADC1 pattern table. */
+#define ADC_STREAM_MAX_CHANNELS     16
+
+#define ADC_STREAM_CODE_MASK        0x0FFF
+#define ADC_STREAM_CHANNEL( s )     ( ( s ) >> 12 )
+#define ADC_STREAM_CODE( s )        ( ( s ) & ADC_STREAM_CODE_MASK )
+
+typedef struct
+{
+	uint16_t       *pusSamples;     /* 12-bit codes, tagged for scans, oldest first; may be
+	                                   filtered in place, valid until the next receive */
+	size_t          uxSamples;
+	uint32_t        ulSequence;     /* index of the block since the start, lost ones included */
+	uint32_t        ulLostBefore;   /* blocks dropped since the previous receive */
+} AdcStreamBlock_t;
+
+typedef struct
+{
+	uint32_t ulBlocks;              /* blocks received */
+	uint32_t ulLostBlocks;          /* blocks the driver dropped */
+	uint32_t ulMeasuredRateHz;      /* samples completed per second, lost ones included */
+} AdcStreamStats_t;
+
+typedef struct AdcStream * AdcStreamHandle_t;
+
+/* Configures xChannel with xAtten at 12 bits and starts sampling it at
+   ulSampleRateHz in blocks of uxBlockSamples, up to ADC_STREAM_MAX_BLOCK.
+   Returns NULL if a stream is running already, the driver rejects the
+   configuration or there is not enough heap. */
+AdcStreamHandle_t xAdcStreamCreate( adc1_channel_t xChannel, adc_atten_t xAtten, uint32_t ulSampleRateHz,
+                                    size_t uxBlockSamples );
+
+/* Converts uxChannels channels, up to ADC_STREAM_MAX_CHANNELS, in turn;
+   ulSampleRateHz counts the conversions of all of them. A block holds
+   uxBlockSamples of those, each tagged with its channel, also when
+   uxChannels is 1. */
+AdcStreamHandle_t xAdcStreamCreateScan( const adc1_channel_t *pxChannels, size_t uxChannels, adc_atten_t xAtten,
+                                        uint32_t ulSampleRateHz, size_t uxBlockSamples );
+
+/* Stops sampling and releases I2S0. */
+void vAdcStreamDelete( AdcStreamHandle_t xStream );
+
+/* Waits up to xTicksToWait for the next block. Returns pdFALSE on timeout. */
+BaseType_t xAdcStreamReceive( AdcStreamHandle_t xStream, AdcStreamBlock_t *pxBlock, TickType_t xTicksToWait );
+
+void vAdcStreamGetStats( AdcStreamHandle_t xStream, AdcStreamStats_t *pxStats );
+
+#endif /* ADC_STREAM_H */
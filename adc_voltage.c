@@ -0,0 +1,18 @@
+/* Calibrated ADC voltages without floating point - see adc_voltage.h */
+
+#include <stdint.h>
+#include "esp_adc_cal.h"
+#include "adc_voltage.h"
+
+/**************************************************************************/
+
+void vAdcVoltageLutInit( AdcVoltageLut_t *pxLut, const esp_adc_cal_characteristics_t *pxChars )
+{
+	/* ADC_WIDTH_BIT_9 is 0, so the width is 9 + bit_width bits. */
+	pxLut->ulMaxRaw = ( 1UL << ( 9 + pxChars->bit_width ) ) - 1;
+
+	for( uint32_t ulRaw = 0; ulRaw <= pxLut->ulMaxRaw; ulRaw++ )
+	{
+		pxLut->usMillivolts[ ulRaw ] = ( Millivolts_t ) esp_adc_cal_raw_to_voltage( ulRaw, pxChars );
+	}
+}
@@ -0,0 +1,78 @@
+/* Calibrated ADC voltages without floating point
+
+   esp_adc_cal_raw_to_voltage() is exact but too slow to call per sample,
+   and 3.3/4096.0 * raw * 1000 is both uncalibrated and double precision
+   arithmetic, which the ESP32 does in software. Here the calibration is
+   run once per raw code, when the ADC is configured, into a table of whole
+   millivolts; converting a sample is then one table read:
+
+   static AdcVoltageLut_t xLut;
+
+   esp_adc_cal_characterize( unit, atten, ADC_WIDTH_BIT_12, DEFAULT_VREF, adc_chars );
+   vAdcVoltageLutInit( &xLut, adc_chars );
+
+   usMillivolts = usAdcVoltageFromRaw( &xLut, raw );
+   xAverage = xAdcVoltageFromSumQ8( &xLut, ulSum, ulCount );
+
+   The average of many samples falls between two codes, so it is converted
+   by interpolating between their table entries into MillivoltsQ8_t: an
+   integer holding millivolts in units of 1/256 mV. That is the type to
+   queue and compare; ADC_MV_Q8() turns a millivolt constant into one, and
+   printf("%u.%02umV", ADC_Q8_MV( x ), ADC_Q8_HUNDREDTHS( x )) prints one.
+*/
+#ifndef ADC_VOLTAGE_H
+#define ADC_VOLTAGE_H
+
+#include <stdint.h>
+#include "esp_adc_cal.h"
+
+/* One entry per code at 12 bits; narrower widths use the first 2^bits. */
+#define ADC_VOLTAGE_LUT_MAX         4096
+
+typedef uint16_t Millivolts_t;              /* whole millivolts */
+typedef uint32_t MillivoltsQ8_t;            /* millivolts * 256 */
+
+#define ADC_Q8_SHIFT                8
+#define ADC_MV_Q8( mv )             ( ( MillivoltsQ8_t ) ( ( mv ) * ( 1 << ADC_Q8_SHIFT ) ) )
+#define ADC_Q8_MV( q8 )             ( ( uint32_t ) ( q8 ) >> ADC_Q8_SHIFT )
+#define ADC_Q8_HUNDREDTHS( q8 )     ( ( ( ( uint32_t ) ( q8 ) & 0xFF ) * 100 ) >> ADC_Q8_SHIFT )
+
+typedef struct
+{
+	uint32_t     ulMaxRaw;                  /* highest code at the characterised width */
+	Millivolts_t usMillivolts[ ADC_VOLTAGE_LUT_MAX ];
+} AdcVoltageLut_t;
+
+/* Fills the table from a characterisation (esp_adc_cal_characterize()). */
+void vAdcVoltageLutInit( AdcVoltageLut_t *pxLut, const esp_adc_cal_characteristics_t *pxChars );
+
+/* Codes above the characterised width read as the highest one. */
+static inline Millivolts_t usAdcVoltageFromRaw( const AdcVoltageLut_t *pxLut, uint32_t ulRaw )
+{
+	return pxLut->usMillivolts[ ( ulRaw > pxLut->ulMaxRaw ) ? pxLut->ulMaxRaw : ulRaw ];
+}
+
+/* The voltage of the average of ulCount codes that add up to ulSum.
+   32-bit arithmetic only, so ulCount must stay below 2^24. */
+static inline MillivoltsQ8_t xAdcVoltageFromSumQ8( const AdcVoltageLut_t *pxLut, uint32_t ulSum, uint32_t ulCount )
+{
+	uint32_t ulRaw, ulFraction;
+	int32_t lStep;
+
+	if( ulCount == 0 )
+	{
+		return 0;
+	}
+
+	ulRaw = ulSum / ulCount;
+	if( ulRaw >= pxLut->ulMaxRaw )
+	{
+		return ADC_MV_Q8( pxLut->usMillivolts[ pxLut->ulMaxRaw ] );
+	}
+
+	ulFraction = ( ( ulSum % ulCount ) << ADC_Q8_SHIFT ) / ulCount;
+	lStep = ( int32_t ) pxLut->usMillivolts[ ulRaw + 1 ] - ( int32_t ) pxLut->usMillivolts[ ulRaw ];
+	return ( MillivoltsQ8_t ) ( ( int32_t ) ADC_MV_Q8( pxLut->usMillivolts[ ulRaw ] ) + lStep * ( int32_t ) ulFraction );
+}
+
+#endif /* ADC_VOLTAGE_H */
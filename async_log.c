@@ -0,0 +1,467 @@
+/* Deferred (asynchronous) logging - see async_log.h
+
+   The ring buffer is a bounded multi-producer/single-consumer queue in which
+   every slot carries a sequence number. A producer claims a slot by advancing
+   ulEnqueuePos with compare-and-swap, fills it, then publishes it by storing
+   the slot's sequence number. The drain task is the only consumer, so it
+   simply waits for the slot at ulDequeuePos to be published. No critical
+   section is ever taken on the logging path.
+
+   All formatting or encoding happens in the drain task, so the cost of
+   ASYNC_LOG() is the same in text and binary mode.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "async_log.h"
+
+#if ( ASYNC_LOG_QUEUE_LENGTH & ( ASYNC_LOG_QUEUE_LENGTH - 1 ) ) != 0
+	#error ASYNC_LOG_QUEUE_LENGTH must be a power of two
+#endif
+
+#define LOG_LINE_MAX        160
+
+/* Worst case binary frame: id + every argument as a full varint or string,
+   plus COBS overhead. */
+#define LOG_FRAME_MAX       ( 16 + ASYNC_LOG_MAX_ARGS * ( 10 + ASYNC_LOG_MAX_STRING ) )
+
+typedef struct
+{
+	volatile uint32_t ulSequence;
+	const char       *pcFormat;
+	uint32_t          ulArgCount;
+	AsyncLogArg_t     xArgs[ ASYNC_LOG_MAX_ARGS ];
+} LogSlot_t;
+
+static LogSlot_t          xSlots[ ASYNC_LOG_QUEUE_LENGTH ];
+static volatile uint32_t  ulEnqueuePos = 0;
+static uint32_t           ulDequeuePos = 0;
+static AsyncLogStats_t    xStats;
+static TaskHandle_t       xDrainTask = NULL;
+static AsyncLogSink_t     pxLogSink = NULL;
+
+#if ASYNC_LOG_BINARY
+static const char        *pcSites[ ASYNC_LOG_MAX_SITES ];   /* index + 1 is the site id */
+#endif
+
+/**************************************************************************/
+
+void vAsyncLogWrite( const char *pcFormat, const AsyncLogArg_t *pxArgs, UBaseType_t uxArgCount )
+{
+	LogSlot_t *pxSlot;
+	uint32_t ulPos, ulWaiting, ulHighWater;
+	int32_t lDiff;
+
+	ulPos = __atomic_load_n( &ulEnqueuePos, __ATOMIC_RELAXED );
+
+	for(;;)
+	{
+		pxSlot = &xSlots[ ulPos & ( ASYNC_LOG_QUEUE_LENGTH - 1 ) ];
+		lDiff = ( int32_t ) ( __atomic_load_n( &pxSlot->ulSequence, __ATOMIC_ACQUIRE ) - ulPos );
+
+		if( lDiff == 0 )
+		{
+			/* The slot is free; try to claim it. On failure ulPos is reloaded
+			   with the position another producer moved it to. */
+			if( __atomic_compare_exchange_n( &ulEnqueuePos, &ulPos, ulPos + 1, pdFALSE,
+			                                 __ATOMIC_RELAXED, __ATOMIC_RELAXED ) )
+			{
+				break;
+			}
+		}
+		else if( lDiff < 0 )
+		{
+			/* The slot still holds a record the drain task hasn't printed:
+			   the buffer is full. */
+			__atomic_fetch_add( &xStats.ulDropped, 1, __ATOMIC_RELAXED );
+			return;
+		}
+		else
+		{
+			ulPos = __atomic_load_n( &ulEnqueuePos, __ATOMIC_RELAXED );
+		}
+	}
+
+	if( uxArgCount > ASYNC_LOG_MAX_ARGS )
+	{
+		uxArgCount = ASYNC_LOG_MAX_ARGS;
+	}
+
+	pxSlot->pcFormat = pcFormat;
+	pxSlot->ulArgCount = ( uint32_t ) uxArgCount;
+	memcpy( pxSlot->xArgs, pxArgs, uxArgCount * sizeof( AsyncLogArg_t ) );
+
+	__atomic_store_n( &pxSlot->ulSequence, ulPos + 1, __ATOMIC_RELEASE );
+	__atomic_fetch_add( &xStats.ulWritten, 1, __ATOMIC_RELAXED );
+
+	/* Best effort: a racing producer may overwrite a slightly larger value,
+	   which only makes the high-water mark a little conservative. */
+	ulWaiting = ulPos + 1 - ulDequeuePos;
+	ulHighWater = xStats.ulHighWater;
+	if( ulWaiting > ulHighWater && ulWaiting <= ASYNC_LOG_QUEUE_LENGTH )
+	{
+		xStats.ulHighWater = ulWaiting;
+	}
+}
+
+/**************************************************************************/
+
+#if ASYNC_LOG_BINARY
+
+static size_t prvPutVarint( uint8_t *pucOut, uint64_t ullValue )
+{
+	size_t xLen = 0;
+
+	while( ullValue >= 0x80 )
+	{
+		pucOut[ xLen++ ] = ( uint8_t ) ( ullValue | 0x80 );
+		ullValue >>= 7;
+	}
+	pucOut[ xLen++ ] = ( uint8_t ) ullValue;
+	return xLen;
+}
+
+/* Appends the arguments of a record to pucOut as described in
+   async_log_format.h. The format string is walked exactly as the decoder
+   will walk it. */
+static size_t prvEncodeArgs( const LogSlot_t *pxSlot, uint8_t *pucOut )
+{
+	static char cScratch[ 2 ];
+	const char *pcFmt = pxSlot->pcFormat;
+	const AsyncLogArg_t *pxArg;
+	size_t xLen = 0, xScratch, xStrLen;
+	uint32_t ulArg = 0;
+	LogSpec_t xSpec;
+	double dScaled;
+	float fValue;
+
+	for(;;)
+	{
+		xScratch = 0;
+		pcFmt = pcAsyncLogScan( pcFmt, cScratch, sizeof( cScratch ), &xScratch, &xSpec );
+		if( xSpec.eConv == eLogConvNone || ulArg >= pxSlot->ulArgCount )
+		{
+			break;
+		}
+
+		pxArg = &pxSlot->xArgs[ ulArg++ ];
+
+		switch( xSpec.eConv )
+		{
+			case eLogConvSigned:
+				xLen += prvPutVarint( &pucOut[ xLen ], ullAsyncLogZigzag( llAsyncLogNarrow( &xSpec, pxArg->llValue ) ) );
+				break;
+
+			case eLogConvUnsigned:
+			case eLogConvChar:
+				xLen += prvPutVarint( &pucOut[ xLen ], ( uint64_t ) llAsyncLogNarrow( &xSpec, pxArg->llValue ) );
+				break;
+
+			case eLogConvFixed:
+				/* The text would only ever show p decimals, so sending the
+				   value scaled by 10^p loses nothing. */
+				if( xSpec.lPrecision < 0 ) xSpec.lPrecision = 6;
+				dScaled = pxArg->dValue * ( double ) llAsyncLogPow10( xSpec.lPrecision );
+				if( xSpec.lPrecision <= ASYNC_LOG_MAX_FIXED_DIGITS && dScaled > -1e17 && dScaled < 1e17 )
+				{
+					int64_t llScaled = ( int64_t ) ( dScaled < 0 ? dScaled - 0.5 : dScaled + 0.5 );
+					xLen += prvPutVarint( &pucOut[ xLen ], ullAsyncLogZigzag( llScaled ) << 1 );
+					break;
+				}
+				/* Out of range or NaN: send the raw form. */
+				/* fall through */
+
+			case eLogConvFloat:
+				fValue = ( float ) pxArg->dValue;
+				pucOut[ xLen++ ] = ASYNC_LOG_FLOAT_RAW;
+				memcpy( &pucOut[ xLen ], &fValue, sizeof( fValue ) );
+				xLen += sizeof( fValue );
+				break;
+
+			case eLogConvString:
+				xStrLen = ( pxArg->pvValue != NULL ) ? strnlen( pxArg->pvValue, ASYNC_LOG_MAX_STRING ) : 0;
+				xLen += prvPutVarint( &pucOut[ xLen ], xStrLen );
+				memcpy( &pucOut[ xLen ], pxArg->pvValue, xStrLen );
+				xLen += xStrLen;
+				break;
+
+			case eLogConvPointer:
+				xLen += prvPutVarint( &pucOut[ xLen ], ( uintptr_t ) pxArg->pvValue );
+				break;
+
+			default:
+				/* Nothing is sent; the decoder prints a placeholder. */
+				break;
+		}
+	}
+
+	return xLen;
+}
+
+/* COBS-encodes ucPayload and sends it, followed by the 0x00 delimiter. */
+static void prvSendFrame( const uint8_t *pucPayload, size_t xLength )
+{
+	static uint8_t ucFrame[ LOG_FRAME_MAX + LOG_FRAME_MAX / 254 + 2 ];
+	size_t xOut = 1, xCode = 0;
+
+	for( size_t i = 0; i < xLength; i++ )
+	{
+		if( pucPayload[ i ] == 0 )
+		{
+			ucFrame[ xCode ] = ( uint8_t ) ( xOut - xCode );
+			xCode = xOut++;
+		}
+		else
+		{
+			ucFrame[ xOut++ ] = pucPayload[ i ];
+			if( xOut - xCode == 0xFF )
+			{
+				ucFrame[ xCode ] = 0xFF;
+				xCode = xOut++;
+			}
+		}
+	}
+	ucFrame[ xCode ] = ( uint8_t ) ( xOut - xCode );
+	ucFrame[ xOut++ ] = 0x00;
+
+	pxLogSink( ucFrame, xOut );
+	xStats.ulBytesOut += xOut;
+}
+
+static void prvSendControl( uint8_t ucKind, uint64_t ullFirst, uint64_t ullSecond, BaseType_t xHasSecond )
+{
+	uint8_t ucPayload[ 24 ];
+	size_t xLen = 0;
+
+	ucPayload[ xLen++ ] = 0;
+	ucPayload[ xLen++ ] = ucKind;
+	xLen += prvPutVarint( &ucPayload[ xLen ], ullFirst );
+	if( xHasSecond )
+	{
+		xLen += prvPutVarint( &ucPayload[ xLen ], ullSecond );
+	}
+	prvSendFrame( ucPayload, xLen );
+}
+
+/* Returns the site id of pcFormat, binding a new one (and telling the decoder
+   about it) on first use, or 0 once the table is full. */
+static uint32_t prvSiteId( const char *pcFormat )
+{
+	uint32_t ulHash = ( uint32_t ) ( ( uintptr_t ) pcFormat >> 2 ) * 2654435761UL;
+	uint32_t ulIndex, ulProbe;
+
+	for( ulProbe = 0; ulProbe < ASYNC_LOG_MAX_SITES; ulProbe++ )
+	{
+		ulIndex = ( ulHash + ulProbe ) % ASYNC_LOG_MAX_SITES;
+
+		if( pcSites[ ulIndex ] == pcFormat )
+		{
+			return ulIndex + 1;
+		}
+
+		if( pcSites[ ulIndex ] == NULL )
+		{
+			pcSites[ ulIndex ] = pcFormat;
+			prvSendControl( ASYNC_LOG_CTRL_DEFINE, ulIndex + 1, ( uintptr_t ) pcFormat, pdTRUE );
+			return ulIndex + 1;
+		}
+	}
+
+	return 0;
+}
+
+static void prvOutputRecord( const LogSlot_t *pxSlot )
+{
+	static uint8_t ucPayload[ LOG_FRAME_MAX ];
+	uint32_t ulSite = prvSiteId( pxSlot->pcFormat );
+	size_t xLen = 0;
+
+	if( ulSite != 0 )
+	{
+		xLen += prvPutVarint( &ucPayload[ xLen ], ulSite );
+	}
+	else
+	{
+		ucPayload[ xLen++ ] = 0;
+		ucPayload[ xLen++ ] = ASYNC_LOG_CTRL_BY_ADDRESS;
+		xLen += prvPutVarint( &ucPayload[ xLen ], ( uintptr_t ) pxSlot->pcFormat );
+	}
+
+	xLen += prvEncodeArgs( pxSlot, &ucPayload[ xLen ] );
+	prvSendFrame( ucPayload, xLen );
+}
+
+static void prvOutputDrops( uint32_t ulDropped )
+{
+	prvSendControl( ASYNC_LOG_CTRL_DROPS, ulDropped, 0, pdFALSE );
+}
+
+#else /* ASYNC_LOG_BINARY */
+
+/* Formats one record as text. Each conversion in the format string is handed
+   to snprintf() on its own, with the stored argument cast to the type that
+   conversion expects. */
+static size_t prvFormatRecord( const LogSlot_t *pxSlot, char *pcOut, size_t xOutSize )
+{
+	const char *pcFmt = pxSlot->pcFormat;
+	size_t xLen = 0;
+	uint32_t ulArg = 0;
+	LogSpec_t xSpec;
+
+	for(;;)
+	{
+		pcFmt = pcAsyncLogScan( pcFmt, pcOut, xOutSize, &xLen, &xSpec );
+		if( xSpec.eConv == eLogConvNone )
+		{
+			break;
+		}
+
+		if( ulArg < pxSlot->ulArgCount )
+		{
+			vAsyncLogEmit( &xSpec, &pxSlot->xArgs[ ulArg++ ], pcOut, xOutSize, &xLen );
+		}
+		else if( xLen + 4 < xOutSize )
+		{
+			/* More conversions than arguments. */
+			memcpy( &pcOut[ xLen ], "<?>", 4 );
+			xLen += 3;
+		}
+	}
+
+	return xLen;
+}
+
+static void prvOutputRecord( const LogSlot_t *pxSlot )
+{
+	static char cLine[ LOG_LINE_MAX ];
+	size_t xLen = prvFormatRecord( pxSlot, cLine, sizeof( cLine ) );
+
+	pxLogSink( cLine, xLen );
+	xStats.ulBytesOut += xLen;
+}
+
+static void prvOutputDrops( uint32_t ulDropped )
+{
+	static char cLine[ 48 ];
+	int lLen = snprintf( cLine, sizeof( cLine ), "[async_log] %u messages dropped\r\n", ( unsigned ) ulDropped );
+
+	pxLogSink( cLine, ( size_t ) lLen );
+	xStats.ulBytesOut += ( uint32_t ) lLen;
+}
+
+#endif /* ASYNC_LOG_BINARY */
+
+/**************************************************************************/
+
+static void prvStdoutSink( const void *pvData, size_t xLength )
+{
+	fwrite( pvData, 1, xLength, stdout );
+}
+
+/**************************************************************************/
+
+static void prvAsyncLogDrainTask( void *pvParameters )
+{
+	static LogSlot_t xRecord;
+	uint32_t ulReportedDrops = 0, ulDropped;
+	int64_t llStart;
+	BaseType_t xWorked;
+	LogSlot_t *pxSlot;
+
+#if ASYNC_LOG_BINARY
+	prvSendControl( ASYNC_LOG_CTRL_ANCHOR, ( uintptr_t ) vAsyncLogWrite, 0, pdFALSE );
+#endif
+
+	for(;;)
+	{
+		llStart = esp_timer_get_time();
+		xWorked = pdFALSE;
+
+		/* Output every published record. A slot that was claimed but isn't
+		   published yet stops the loop until the next period. */
+		for(;;)
+		{
+			pxSlot = &xSlots[ ulDequeuePos & ( ASYNC_LOG_QUEUE_LENGTH - 1 ) ];
+			if( __atomic_load_n( &pxSlot->ulSequence, __ATOMIC_ACQUIRE ) != ulDequeuePos + 1 )
+			{
+				break;
+			}
+
+			/* Copy the record out and hand the slot back before the (slow)
+			   output so producers can reuse it meanwhile. */
+			xRecord = *pxSlot;
+			__atomic_store_n( &pxSlot->ulSequence, ulDequeuePos + ASYNC_LOG_QUEUE_LENGTH, __ATOMIC_RELEASE );
+			ulDequeuePos++;
+
+			prvOutputRecord( &xRecord );
+			xStats.ulPrinted++;
+			xWorked = pdTRUE;
+		}
+
+		ulDropped = __atomic_load_n( &xStats.ulDropped, __ATOMIC_RELAXED );
+		if( ulDropped != ulReportedDrops )
+		{
+			prvOutputDrops( ulDropped - ulReportedDrops );
+			ulReportedDrops = ulDropped;
+			xWorked = pdTRUE;
+		}
+
+		fflush( stdout );
+
+		/* Only passes that had something to do count towards the cost. */
+		if( xWorked )
+		{
+			xStats.ullDrainUs += esp_timer_get_time() - llStart;
+		}
+		vTaskDelay( pdMS_TO_TICKS( ASYNC_LOG_DRAIN_PERIOD_MS ) );
+	}
+}
+
+/**************************************************************************/
+
+void vAsyncLogSetSink( AsyncLogSink_t pxSink )
+{
+	pxLogSink = pxSink;
+}
+
+BaseType_t xAsyncLogInit( UBaseType_t uxDrainPriority )
+{
+	uint32_t i;
+
+	if( xDrainTask != NULL )
+	{
+		return pdPASS;
+	}
+
+	if( pxLogSink == NULL )
+	{
+		pxLogSink = prvStdoutSink;
+	}
+
+	for( i = 0; i < ASYNC_LOG_QUEUE_LENGTH; i++ )
+	{
+		xSlots[ i ].ulSequence = i;
+	}
+
+	return xTaskCreate( prvAsyncLogDrainTask,
+	                    "async_log",
+	                    ASYNC_LOG_STACK_SIZE,
+	                    NULL,
+	                    uxDrainPriority,
+	                    &xDrainTask );
+}
+
+/**************************************************************************/
+
+void vAsyncLogGetStats( AsyncLogStats_t *pxStats )
+{
+	pxStats->ulWritten = __atomic_load_n( &xStats.ulWritten, __ATOMIC_RELAXED );
+	pxStats->ulDropped = __atomic_load_n( &xStats.ulDropped, __ATOMIC_RELAXED );
+	pxStats->ulPrinted = xStats.ulPrinted;
+	pxStats->ulHighWater = xStats.ulHighWater;
+	pxStats->ulBytesOut = xStats.ulBytesOut;
+	pxStats->ullDrainUs = xStats.ullDrainUs;
+}
@@ -0,0 +1,145 @@
+/* Deferred (asynchronous) logging
+
+   printf() formats the string and pushes it out of the UART in the context of
+   the calling task, so every log line costs the caller the time it takes to
+   transmit it. ASYNC_LOG() instead copies the format pointer and the raw
+   argument values into a lock-free ring buffer and returns. A low priority
+   drain task formats and prints the records later, when nothing more
+   important wants the CPU.
+
+   ASYNC_LOG( "Raw: %d\tVoltage: %.2fmV\r\n", adc_reading, voltage );
+
+   Rules for the arguments:
+
+   - At most ASYNC_LOG_MAX_ARGS arguments per call.
+   - Integers, floating point values and pointers are supported. Every integer
+     is widened to 64 bits and every floating point value to double, then cast
+     back to whatever the conversion in the format string asks for.
+   - The format string and any %s argument are stored by pointer, so they must
+     outlive the record: string literals and other static strings only.
+
+   ASYNC_LOG() never blocks and may be used from tasks and ISRs. When the ring
+   buffer is full the record is dropped and counted; the drain task reports
+   how many records were lost the next time it runs.
+*/
+#ifndef ASYNC_LOG_H
+#define ASYNC_LOG_H
+
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "async_log_format.h"
+
+/* Number of records the ring buffer holds. Must be a power of two. */
+#ifndef ASYNC_LOG_QUEUE_LENGTH
+#define ASYNC_LOG_QUEUE_LENGTH      64
+#endif
+
+#ifndef ASYNC_LOG_MAX_ARGS
+#define ASYNC_LOG_MAX_ARGS          6
+#endif
+
+/* How often the drain task looks for new records. */
+#ifndef ASYNC_LOG_DRAIN_PERIOD_MS
+#define ASYNC_LOG_DRAIN_PERIOD_MS   20
+#endif
+
+/* 0: the drain task prints formatted text.
+   1: the drain task sends compact binary frames instead (see
+      async_log_format.h) and tools/log_decode.c turns them back into text on
+      the host, using the firmware ELF to recover the format strings. */
+#ifndef ASYNC_LOG_BINARY
+#define ASYNC_LOG_BINARY            0
+#endif
+
+/* Distinct log sites that get a short id in binary mode; further sites are
+   sent with their full address. */
+#ifndef ASYNC_LOG_MAX_SITES
+#define ASYNC_LOG_MAX_SITES         128
+#endif
+
+#define ASYNC_LOG_STACK_SIZE        3072
+
+/* Where the drain task writes its output. Defaults to stdout. */
+typedef void ( *AsyncLogSink_t )( const void *pvData, size_t xLength );
+
+typedef struct
+{
+	uint32_t ulWritten;     /* records accepted into the ring buffer */
+	uint32_t ulDropped;     /* records lost because the ring buffer was full */
+	uint32_t ulPrinted;     /* records formatted and printed by the drain task */
+	uint32_t ulHighWater;   /* most records ever waiting at once */
+	uint32_t ulBytesOut;    /* bytes handed to the sink */
+	uint64_t ullDrainUs;    /* time the drain task spent formatting and
+	                           printing, preemptions included */
+} AsyncLogStats_t;
+
+/* Creates the drain task. Call once, before the first ASYNC_LOG(). */
+BaseType_t xAsyncLogInit( UBaseType_t uxDrainPriority );
+
+/* Backend of ASYNC_LOG(); pxArgs holds uxArgCount packed arguments. */
+void vAsyncLogWrite( const char *pcFormat, const AsyncLogArg_t *pxArgs, UBaseType_t uxArgCount );
+
+void vAsyncLogGetStats( AsyncLogStats_t *pxStats );
+
+/* Replaces the output sink; call before xAsyncLogInit(). */
+void vAsyncLogSetSink( AsyncLogSink_t pxSink );
+
+/* Argument packing. _Generic picks the widening for each argument's type. */
+static inline AsyncLogArg_t xAsyncLogArgInt( long long llValue )
+{
+	AsyncLogArg_t xArg;
+	xArg.llValue = llValue;
+	return xArg;
+}
+
+static inline AsyncLogArg_t xAsyncLogArgDouble( double dValue )
+{
+	AsyncLogArg_t xArg;
+	xArg.dValue = dValue;
+	return xArg;
+}
+
+static inline AsyncLogArg_t xAsyncLogArgPtr( const void *pvValue )
+{
+	AsyncLogArg_t xArg;
+	xArg.pvValue = pvValue;
+	return xArg;
+}
+
+#define xAsyncLogArg( x ) _Generic( ( x ),                   \
+	float:              xAsyncLogArgDouble,                      \
+	double:             xAsyncLogArgDouble,                      \
+	long double:        xAsyncLogArgDouble,                      \
+	char *:             xAsyncLogArgPtr,                         \
+	const char *:       xAsyncLogArgPtr,                         \
+	void *:             xAsyncLogArgPtr,                         \
+	const void *:       xAsyncLogArgPtr,                         \
+	default:            xAsyncLogArgInt )( x )
+
+#define prvLOG_NARGS( ... )     prvLOG_NARGS_( _, ##__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0 )
+#define prvLOG_NARGS_( _, a1, a2, a3, a4, a5, a6, a7, a8, N, ... ) N
+#define prvLOG_CAT( a, b )      prvLOG_CAT_( a, b )
+#define prvLOG_CAT_( a, b )     a##b
+#define prvLOG_MAP( ... )       prvLOG_CAT( prvLOG_MAP_, prvLOG_NARGS( __VA_ARGS__ ) )( __VA_ARGS__ )
+#define prvLOG_MAP_0()
+#define prvLOG_MAP_1( a )       , xAsyncLogArg( a )
+#define prvLOG_MAP_2( a, ... )  , xAsyncLogArg( a ) prvLOG_MAP_1( __VA_ARGS__ )
+#define prvLOG_MAP_3( a, ... )  , xAsyncLogArg( a ) prvLOG_MAP_2( __VA_ARGS__ )
+#define prvLOG_MAP_4( a, ... )  , xAsyncLogArg( a ) prvLOG_MAP_3( __VA_ARGS__ )
+#define prvLOG_MAP_5( a, ... )  , xAsyncLogArg( a ) prvLOG_MAP_4( __VA_ARGS__ )
+#define prvLOG_MAP_6( a, ... )  , xAsyncLogArg( a ) prvLOG_MAP_5( __VA_ARGS__ )
+#define prvLOG_MAP_7( a, ... )  , xAsyncLogArg( a ) prvLOG_MAP_6( __VA_ARGS__ )
+#define prvLOG_MAP_8( a, ... )  , xAsyncLogArg( a ) prvLOG_MAP_7( __VA_ARGS__ )
+
+#define ASYNC_LOG( pcFormat, ... )                                                         \
+	do                                                                                     \
+	{                                                                                      \
+		const AsyncLogArg_t xLogArgs_[] = { { 0 } prvLOG_MAP( __VA_ARGS__ ) };            \
+		_Static_assert( sizeof( xLogArgs_ ) / sizeof( xLogArgs_[ 0 ] ) - 1 <= ASYNC_LOG_MAX_ARGS, \
+		                "too many ASYNC_LOG arguments" );                                  \
+		vAsyncLogWrite( ( pcFormat ), &xLogArgs_[ 1 ],                                     \
+		                sizeof( xLogArgs_ ) / sizeof( xLogArgs_[ 0 ] ) - 1 );              \
+	} while( 0 )
+
+#endif /* ASYNC_LOG_H */
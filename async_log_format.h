@@ -0,0 +1,290 @@
+/* Format string handling shared by the deferred logger (async_log.c) and the
+   host-side decoder (tools/log_decode.c)
+
+   Both sides walk a printf format string one conversion at a time and need to
+   agree exactly on what each conversion consumes, so the walker lives here as
+   plain C with no FreeRTOS dependency.
+
+   BINARY WIRE FORMAT (ASYNC_LOG_BINARY = 1)
+
+   The stream is a sequence of frames. Each frame is COBS encoded and ends with
+   a 0x00 byte, so a decoder can join the stream at any point and resynchronise
+   on the next zero. Inside a frame, integers are unsigned LEB128 varints;
+   signed values are zigzag encoded first.
+
+   frame   := site_id args                 site_id >= 1, see DEFINE
+            | 0 DEFINE site_id address     binds a site id to the address of
+                                           its format string
+            | 0 DROPS count                records lost since the last DROPS
+            | 0 ANCHOR address             run-time address of vAsyncLogWrite,
+                                           lets the decoder relocate PIE images
+            | 0 BY_ADDRESS address args    record whose site has no id
+
+   Log sites are identified by the link-time address of their format string,
+   which the decoder looks up in the firmware ELF, so no text ever goes on the
+   wire. The first time a site is seen the drain task binds it to a small id
+   with a DEFINE frame and uses the id from then on.
+
+   args are encoded in format string order, one per conversion:
+
+   %d %i           zigzag varint of the value cast to the conversion's type
+   %u %o %x %X %c  varint of the value cast to the conversion's type
+   %f %F           precision p <= 6: (zigzag( round( value * 10^p ) ) << 1)
+                   otherwise, and for %e %g %a: 0x01 then IEEE float32 LE
+   %s              varint length (at most ASYNC_LOG_MAX_STRING) then the bytes
+   %p              varint of the pointer value
+*/
+#ifndef ASYNC_LOG_FORMAT_H
+#define ASYNC_LOG_FORMAT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#define ASYNC_LOG_SPEC_MAX          24
+#define ASYNC_LOG_MAX_STRING        64
+#define ASYNC_LOG_MAX_FIXED_DIGITS  6
+
+#define ASYNC_LOG_CTRL_DEFINE       1
+#define ASYNC_LOG_CTRL_DROPS        2
+#define ASYNC_LOG_CTRL_ANCHOR       3
+#define ASYNC_LOG_CTRL_BY_ADDRESS   4
+
+/* Floating point arguments that don't fit the fixed-point form. */
+#define ASYNC_LOG_FLOAT_RAW         0x01
+
+typedef union
+{
+	int64_t     llValue;
+	double      dValue;
+	const void *pvValue;
+} AsyncLogArg_t;
+
+typedef enum
+{
+	eLogConvNone = 0,       /* end of the format string */
+	eLogConvSigned,
+	eLogConvUnsigned,
+	eLogConvChar,
+	eLogConvFixed,          /* %f / %F: sent as a scaled integer */
+	eLogConvFloat,          /* %e %g %a: sent as float32 */
+	eLogConvString,
+	eLogConvPointer,
+	eLogConvUnsupported,
+} LogConv_t;
+
+typedef struct
+{
+	LogConv_t eConv;
+	char      cConv;
+	int       lLongs;       /* number of 'l' length modifiers */
+	int       lPrecision;   /* -1 when the format doesn't give one */
+	char      cSpec[ ASYNC_LOG_SPEC_MAX ];  /* snprintf spec for the widened value */
+} LogSpec_t;
+
+/**************************************************************************/
+
+/* Appends literal text from pcFmt to pcOut (collapsing "%%") up to the next
+   conversion, and describes that conversion in pxSpec. Returns the position
+   just after the conversion; pxSpec->eConv is eLogConvNone at the end. */
+static inline const char *pcAsyncLogScan( const char *pcFmt, char *pcOut, size_t xOutSize,
+                                          size_t *pxLen, LogSpec_t *pxSpec )
+{
+	size_t xSpecLen = 0;
+
+	pxSpec->eConv = eLogConvNone;
+	pxSpec->lLongs = 0;
+	pxSpec->lPrecision = -1;
+	pxSpec->cConv = '\0';
+
+	while( *pcFmt != '\0' )
+	{
+		if( pcFmt[ 0 ] == '%' && pcFmt[ 1 ] == '%' )
+		{
+			pcFmt += 2;
+			if( *pxLen + 1 < xOutSize ) pcOut[ ( *pxLen )++ ] = '%';
+		}
+		else if( pcFmt[ 0 ] == '%' )
+		{
+			break;
+		}
+		else
+		{
+			if( *pxLen + 1 < xOutSize ) pcOut[ ( *pxLen )++ ] = *pcFmt;
+			pcFmt++;
+		}
+	}
+	pcOut[ *pxLen < xOutSize ? *pxLen : xOutSize - 1 ] = '\0';
+
+	if( *pcFmt == '\0' )
+	{
+		return pcFmt;
+	}
+
+	/* "%[flags][width][.precision]" is kept; length modifiers are counted
+	   and replaced by whatever suits the widened argument. */
+	pxSpec->cSpec[ xSpecLen++ ] = *pcFmt++;
+	while( *pcFmt != '\0' && strchr( "-+ #0123456789", *pcFmt ) != NULL && xSpecLen < ASYNC_LOG_SPEC_MAX - 4 )
+	{
+		pxSpec->cSpec[ xSpecLen++ ] = *pcFmt++;
+	}
+	if( *pcFmt == '.' )
+	{
+		pxSpec->lPrecision = 0;
+		pxSpec->cSpec[ xSpecLen++ ] = *pcFmt++;
+		while( *pcFmt >= '0' && *pcFmt <= '9' )
+		{
+			pxSpec->lPrecision = pxSpec->lPrecision * 10 + ( *pcFmt - '0' );
+			if( xSpecLen < ASYNC_LOG_SPEC_MAX - 4 ) pxSpec->cSpec[ xSpecLen++ ] = *pcFmt;
+			pcFmt++;
+		}
+	}
+	while( *pcFmt != '\0' && strchr( "hlLqjzt", *pcFmt ) != NULL )
+	{
+		if( *pcFmt == 'l' || *pcFmt == 'L' || *pcFmt == 'q' || *pcFmt == 'j' )
+		{
+			pxSpec->lLongs++;
+		}
+		pcFmt++;
+	}
+
+	pxSpec->cConv = *pcFmt;
+	if( *pcFmt == '\0' )
+	{
+		pxSpec->eConv = eLogConvNone;
+		return pcFmt;
+	}
+	pcFmt++;
+
+	switch( pxSpec->cConv )
+	{
+		case 'd': case 'i':
+			pxSpec->eConv = eLogConvSigned;
+			pxSpec->cSpec[ xSpecLen++ ] = 'l';
+			pxSpec->cSpec[ xSpecLen++ ] = 'l';
+			break;
+
+		case 'u': case 'o': case 'x': case 'X':
+			pxSpec->eConv = eLogConvUnsigned;
+			pxSpec->cSpec[ xSpecLen++ ] = 'l';
+			pxSpec->cSpec[ xSpecLen++ ] = 'l';
+			break;
+
+		case 'c':
+			pxSpec->eConv = eLogConvChar;
+			break;
+
+		case 'f': case 'F':
+			pxSpec->eConv = eLogConvFixed;
+			break;
+
+		case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+			pxSpec->eConv = eLogConvFloat;
+			break;
+
+		case 's':
+			pxSpec->eConv = eLogConvString;
+			break;
+
+		case 'p':
+			pxSpec->eConv = eLogConvPointer;
+			break;
+
+		default:
+			pxSpec->eConv = eLogConvUnsupported;
+			break;
+	}
+
+	pxSpec->cSpec[ xSpecLen++ ] = pxSpec->cConv;
+	pxSpec->cSpec[ xSpecLen ] = '\0';
+	return pcFmt;
+}
+
+/**************************************************************************/
+
+/* Narrows a widened integer argument to the type its conversion names, so
+   sign and wrap-around match what printf() would have shown. */
+static inline int64_t llAsyncLogNarrow( const LogSpec_t *pxSpec, int64_t llValue )
+{
+	if( pxSpec->eConv == eLogConvSigned )
+	{
+		if( pxSpec->lLongs == 0 ) return ( int64_t ) ( int ) llValue;
+		if( pxSpec->lLongs == 1 ) return ( int64_t ) ( long ) llValue;
+	}
+	else if( pxSpec->eConv == eLogConvUnsigned || pxSpec->eConv == eLogConvChar )
+	{
+		if( pxSpec->lLongs == 0 ) return ( int64_t ) ( unsigned int ) llValue;
+		if( pxSpec->lLongs == 1 ) return ( int64_t ) ( unsigned long ) llValue;
+	}
+	return llValue;
+}
+
+/* Appends one converted argument to pcOut. */
+static inline void vAsyncLogEmit( const LogSpec_t *pxSpec, const AsyncLogArg_t *pxArg,
+                                  char *pcOut, size_t xOutSize, size_t *pxLen )
+{
+	int lWritten;
+	const void *pvValue;
+
+	if( *pxLen + 1 >= xOutSize )
+	{
+		return;
+	}
+
+	switch( pxSpec->eConv )
+	{
+		case eLogConvSigned:
+		case eLogConvUnsigned:
+			lWritten = snprintf( &pcOut[ *pxLen ], xOutSize - *pxLen, pxSpec->cSpec,
+			                     ( long long ) llAsyncLogNarrow( pxSpec, pxArg->llValue ) );
+			break;
+
+		case eLogConvChar:
+			lWritten = snprintf( &pcOut[ *pxLen ], xOutSize - *pxLen, pxSpec->cSpec, ( int ) pxArg->llValue );
+			break;
+
+		case eLogConvFixed:
+		case eLogConvFloat:
+			lWritten = snprintf( &pcOut[ *pxLen ], xOutSize - *pxLen, pxSpec->cSpec, pxArg->dValue );
+			break;
+
+		case eLogConvString:
+		case eLogConvPointer:
+			pvValue = pxArg->pvValue;
+			if( pxSpec->eConv == eLogConvString && pvValue == NULL ) pvValue = "(null)";
+			lWritten = snprintf( &pcOut[ *pxLen ], xOutSize - *pxLen, pxSpec->cSpec, pvValue );
+			break;
+
+		default:
+			lWritten = snprintf( &pcOut[ *pxLen ], xOutSize - *pxLen, "<%%%c?>", pxSpec->cConv );
+			break;
+	}
+
+	if( lWritten > 0 )
+	{
+		*pxLen += ( size_t ) lWritten;
+		if( *pxLen >= xOutSize ) *pxLen = xOutSize - 1;
+	}
+}
+
+/**************************************************************************/
+
+static inline uint64_t ullAsyncLogZigzag( int64_t llValue )
+{
+	return ( ( uint64_t ) llValue << 1 ) ^ ( uint64_t ) ( llValue >> 63 );
+}
+
+static inline int64_t llAsyncLogUnzigzag( uint64_t ullValue )
+{
+	return ( int64_t ) ( ullValue >> 1 ) ^ -( int64_t ) ( ullValue & 1 );
+}
+
+static inline int64_t llAsyncLogPow10( int lExponent )
+{
+	int64_t llResult = 1;
+	while( lExponent-- > 0 ) llResult *= 10;
+	return llResult;
+}
+
+#endif /* ASYNC_LOG_FORMAT_H */
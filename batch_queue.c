@@ -0,0 +1,340 @@
+/* Batched queue - see batch_queue.h
+
+   The items live in a plain ring buffer guarded by a spinlock critical
+   section, which is held only for the index update and the memcpy of one
+   batch. Blocking is left to two semaphores:
+
+   - xDataAvailable (binary) wakes the receiver. A receiver that finds the
+     queue empty sets xReceiverWaiting in the same critical section, and the
+     first sender to add items after that clears the flag and gives.
+   - xSpaceAvailable (counting) wakes senders. A sender that could not place
+     everything counts itself in uxSendersWaiting, and the receiver gives one
+     token per waiting sender after it has made room.
+
+   Because a waiter registers while it still holds the lock in which it saw
+   the queue empty (or full), the peer can't miss it. A waiter that times out
+   leaves its registration behind; the token it causes later only makes some
+   task look at the queue once more for nothing.
+*/
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "batch_queue.h"
+
+/* Tokens for waiting senders must never be refused, or a sender whose
+registration was consumed could be left blocked with nobody to wake it. */
+#define prvUNLIMITED_TOKENS     ( ( UBaseType_t ) 0x7FFFFFFF )
+
+struct BatchQueue
+{
+	uint8_t          *pucStorage;
+	UBaseType_t       uxItemSize;
+	UBaseType_t       uxLength;
+	UBaseType_t       uxHead;               /* oldest item */
+	UBaseType_t       uxCount;
+	portMUX_TYPE      xLock;
+	SemaphoreHandle_t xDataAvailable;
+	SemaphoreHandle_t xSpaceAvailable;
+	BaseType_t        xReceiverWaiting;
+	UBaseType_t       uxSendersWaiting;
+	QueueMonitor_t    xMonitor;
+};
+
+/**************************************************************************/
+
+/* Appends uxCount items; the caller holds the lock and has checked for room. */
+static void prvCopyIn( struct BatchQueue *pxQueue, const uint8_t *pucItems, UBaseType_t uxCount )
+{
+	UBaseType_t uxTail = pxQueue->uxHead + pxQueue->uxCount;
+	UBaseType_t uxFirst;
+
+	if( uxTail >= pxQueue->uxLength )
+	{
+		uxTail -= pxQueue->uxLength;
+	}
+
+	/* At most two pieces: up to the end of the storage, then from the start. */
+	uxFirst = pxQueue->uxLength - uxTail;
+	if( uxFirst > uxCount )
+	{
+		uxFirst = uxCount;
+	}
+
+	memcpy( &pxQueue->pucStorage[ uxTail * pxQueue->uxItemSize ], pucItems, uxFirst * pxQueue->uxItemSize );
+	memcpy( pxQueue->pucStorage, &pucItems[ uxFirst * pxQueue->uxItemSize ], ( uxCount - uxFirst ) * pxQueue->uxItemSize );
+	pxQueue->uxCount += uxCount;
+}
+
+/* Removes the uxCount oldest items; the caller holds the lock. */
+static void prvCopyOut( struct BatchQueue *pxQueue, uint8_t *pucBuffer, UBaseType_t uxCount )
+{
+	UBaseType_t uxFirst = pxQueue->uxLength - pxQueue->uxHead;
+
+	if( uxFirst > uxCount )
+	{
+		uxFirst = uxCount;
+	}
+
+	memcpy( pucBuffer, &pxQueue->pucStorage[ pxQueue->uxHead * pxQueue->uxItemSize ], uxFirst * pxQueue->uxItemSize );
+	memcpy( &pucBuffer[ uxFirst * pxQueue->uxItemSize ], pxQueue->pucStorage, ( uxCount - uxFirst ) * pxQueue->uxItemSize );
+
+	pxQueue->uxHead += uxCount;
+	if( pxQueue->uxHead >= pxQueue->uxLength )
+	{
+		pxQueue->uxHead -= pxQueue->uxLength;
+	}
+	pxQueue->uxCount -= uxCount;
+}
+
+/**************************************************************************/
+
+BatchQueueHandle_t xBatchQueueCreate( UBaseType_t uxLength, UBaseType_t uxItemSize, const char *pcName )
+{
+	struct BatchQueue *pxQueue;
+	const portMUX_TYPE xUnlocked = portMUX_INITIALIZER_UNLOCKED;
+
+	if( uxLength == 0 || uxItemSize == 0 )
+	{
+		return NULL;
+	}
+
+	pxQueue = pvPortMalloc( sizeof( struct BatchQueue ) );
+	if( pxQueue == NULL )
+	{
+		return NULL;
+	}
+	memset( pxQueue, 0, sizeof( struct BatchQueue ) );
+
+	pxQueue->pucStorage = pvPortMalloc( uxLength * uxItemSize );
+	pxQueue->xDataAvailable = xSemaphoreCreateBinary();
+	pxQueue->xSpaceAvailable = xSemaphoreCreateCounting( prvUNLIMITED_TOKENS, 0 );
+
+	if( pxQueue->pucStorage == NULL || pxQueue->xDataAvailable == NULL || pxQueue->xSpaceAvailable == NULL )
+	{
+		vBatchQueueDelete( pxQueue );
+		return NULL;
+	}
+
+	pxQueue->uxItemSize = uxItemSize;
+	pxQueue->uxLength = uxLength;
+	pxQueue->xLock = xUnlocked;
+	pxQueue->xMonitor.uxLength = uxLength;
+
+	if( pcName != NULL )
+	{
+		vQueueMonitorRegister( &pxQueue->xMonitor, pcName, uxLength );
+	}
+	return pxQueue;
+}
+
+void vBatchQueueDelete( BatchQueueHandle_t xQueue )
+{
+	if( xQueue->xMonitor.pcName != NULL )
+	{
+		vQueueMonitorUnregister( &xQueue->xMonitor );
+	}
+	if( xQueue->xDataAvailable != NULL )
+	{
+		vSemaphoreDelete( xQueue->xDataAvailable );
+	}
+	if( xQueue->xSpaceAvailable != NULL )
+	{
+		vSemaphoreDelete( xQueue->xSpaceAvailable );
+	}
+	vPortFree( xQueue->pucStorage );
+	vPortFree( xQueue );
+}
+
+/**************************************************************************/
+
+UBaseType_t uxBatchQueueSendBatch( BatchQueueHandle_t xQueue, const void *pvItems, UBaseType_t uxCount, TickType_t xTicksToWait )
+{
+	const uint8_t *pucItems = pvItems;
+	UBaseType_t uxSent = 0;
+	UBaseType_t uxNow;
+	BaseType_t xWakeReceiver;
+	TimeOut_t xTimeOut;
+	TickType_t xBlockStart;
+
+	vTaskSetTimeOutState( &xTimeOut );
+
+	for(;;)
+	{
+		taskENTER_CRITICAL( &xQueue->xLock );
+		{
+			uxNow = xQueue->uxLength - xQueue->uxCount;
+			if( uxNow > uxCount - uxSent )
+			{
+				uxNow = uxCount - uxSent;
+			}
+			prvCopyIn( xQueue, &pucItems[ uxSent * xQueue->uxItemSize ], uxNow );
+			if( uxNow > 0 )
+			{
+				vQueueMonitorSent( &xQueue->xMonitor, uxNow, xQueue->uxCount );
+			}
+
+			xWakeReceiver = ( uxNow > 0 ) && xQueue->xReceiverWaiting;
+			if( xWakeReceiver )
+			{
+				xQueue->xReceiverWaiting = pdFALSE;
+			}
+
+			if( uxSent + uxNow < uxCount && xTicksToWait != 0 )
+			{
+				xQueue->uxSendersWaiting++;
+			}
+		}
+		taskEXIT_CRITICAL( &xQueue->xLock );
+
+		uxSent += uxNow;
+		if( xWakeReceiver )
+		{
+			xSemaphoreGive( xQueue->xDataAvailable );
+		}
+
+		if( uxSent == uxCount )
+		{
+			return uxSent;
+		}
+		if( xTicksToWait == 0 || xTaskCheckForTimeOut( &xTimeOut, &xTicksToWait ) != pdFALSE )
+		{
+			vQueueMonitorFull( &xQueue->xMonitor );
+			return uxSent;
+		}
+
+		xBlockStart = xTaskGetTickCount();
+		xSemaphoreTake( xQueue->xSpaceAvailable, xTicksToWait );
+		vQueueMonitorBlocked( &xQueue->xMonitor, pdTRUE, xTaskGetTickCount() - xBlockStart );
+	}
+}
+
+UBaseType_t uxBatchQueueSendBatchFromISR( BatchQueueHandle_t xQueue, const void *pvItems, UBaseType_t uxCount, BaseType_t *pxHigherPriorityTaskWoken )
+{
+	UBaseType_t uxNow;
+	BaseType_t xWakeReceiver;
+
+	taskENTER_CRITICAL_ISR( &xQueue->xLock );
+	{
+		uxNow = xQueue->uxLength - xQueue->uxCount;
+		if( uxNow > uxCount )
+		{
+			uxNow = uxCount;
+		}
+		prvCopyIn( xQueue, pvItems, uxNow );
+		if( uxNow > 0 )
+		{
+			vQueueMonitorSent( &xQueue->xMonitor, uxNow, xQueue->uxCount );
+		}
+		if( uxNow < uxCount )
+		{
+			vQueueMonitorFull( &xQueue->xMonitor );
+		}
+
+		xWakeReceiver = ( uxNow > 0 ) && xQueue->xReceiverWaiting;
+		if( xWakeReceiver )
+		{
+			xQueue->xReceiverWaiting = pdFALSE;
+		}
+	}
+	taskEXIT_CRITICAL_ISR( &xQueue->xLock );
+
+	if( xWakeReceiver )
+	{
+		xSemaphoreGiveFromISR( xQueue->xDataAvailable, pxHigherPriorityTaskWoken );
+	}
+	return uxNow;
+}
+
+/**************************************************************************/
+
+UBaseType_t uxBatchQueueReceiveBatch( BatchQueueHandle_t xQueue, void *pvBuffer, UBaseType_t uxMaxItems, TickType_t xTicksToWait )
+{
+	UBaseType_t uxNow;
+	UBaseType_t uxWakeSenders;
+	TimeOut_t xTimeOut;
+	TickType_t xBlockStart;
+
+	vTaskSetTimeOutState( &xTimeOut );
+
+	for(;;)
+	{
+		uxWakeSenders = 0;
+
+		taskENTER_CRITICAL( &xQueue->xLock );
+		{
+			uxNow = ( xQueue->uxCount < uxMaxItems ) ? xQueue->uxCount : uxMaxItems;
+			prvCopyOut( xQueue, pvBuffer, uxNow );
+
+			if( uxNow > 0 )
+			{
+				vQueueMonitorReceived( &xQueue->xMonitor, uxNow );
+				uxWakeSenders = xQueue->uxSendersWaiting;
+				xQueue->uxSendersWaiting = 0;
+			}
+			else if( xTicksToWait != 0 )
+			{
+				xQueue->xReceiverWaiting = pdTRUE;
+			}
+		}
+		taskEXIT_CRITICAL( &xQueue->xLock );
+
+		while( uxWakeSenders-- > 0 )
+		{
+			xSemaphoreGive( xQueue->xSpaceAvailable );
+		}
+
+		if( uxNow > 0 )
+		{
+			return uxNow;
+		}
+		if( xTicksToWait == 0 || xTaskCheckForTimeOut( &xTimeOut, &xTicksToWait ) != pdFALSE )
+		{
+			vQueueMonitorEmpty( &xQueue->xMonitor );
+			return 0;
+		}
+
+		xBlockStart = xTaskGetTickCount();
+		xSemaphoreTake( xQueue->xDataAvailable, xTicksToWait );
+		vQueueMonitorBlocked( &xQueue->xMonitor, pdFALSE, xTaskGetTickCount() - xBlockStart );
+	}
+}
+
+UBaseType_t uxBatchQueueReceiveAll( BatchQueueHandle_t xQueue, void *pvBuffer, TickType_t xTicksToWait )
+{
+	return uxBatchQueueReceiveBatch( xQueue, pvBuffer, xQueue->uxLength, xTicksToWait );
+}
+
+/**************************************************************************/
+
+BaseType_t xBatchQueueSend( BatchQueueHandle_t xQueue, const void *pvItem, TickType_t xTicksToWait )
+{
+	return ( uxBatchQueueSendBatch( xQueue, pvItem, 1, xTicksToWait ) == 1 ) ? pdPASS : errQUEUE_FULL;
+}
+
+BaseType_t xBatchQueueReceive( BatchQueueHandle_t xQueue, void *pvBuffer, TickType_t xTicksToWait )
+{
+	return ( uxBatchQueueReceiveBatch( xQueue, pvBuffer, 1, xTicksToWait ) == 1 ) ? pdPASS : errQUEUE_EMPTY;
+}
+
+UBaseType_t uxBatchQueueMessagesWaiting( BatchQueueHandle_t xQueue )
+{
+	UBaseType_t uxCount;
+
+	taskENTER_CRITICAL( &xQueue->xLock );
+	uxCount = xQueue->uxCount;
+	taskEXIT_CRITICAL( &xQueue->xLock );
+
+	return uxCount;
+}
+
+UBaseType_t uxBatchQueueSpacesAvailable( BatchQueueHandle_t xQueue )
+{
+	return xQueue->uxLength - uxBatchQueueMessagesWaiting( xQueue );
+}
+
+void vBatchQueueGetStats( BatchQueueHandle_t xQueue, QueueStats_t *pxStats )
+{
+	vQueueMonitorGetStats( &xQueue->xMonitor, pxStats );
+}
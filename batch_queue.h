@@ -0,0 +1,66 @@
+/* Queue that moves many items per kernel entry
+
+   Every xQueueSendToBack()/xQueueReceive() takes the queue's critical section
+   and may switch context, once per item. When items arrive at thousands per
+   second that per-item overhead, not the work done on the items, is what
+   limits the receiver. A batch queue moves up to N items under one critical
+   section and wakes a blocked peer at most once per call:
+
+   xQueue = xBatchQueueCreate( 64, sizeof( int32_t ) );
+
+   uxSent = uxBatchQueueSendBatch( xQueue, lValues, 16, xTicksToWait );
+   uxReceived = uxBatchQueueReceiveBatch( xQueue, lBuffer, 16, xTicksToWait );
+
+   uxBatchQueueReceiveAll() is the drain mode: one wakeup empties everything
+   that is waiting into the caller's buffer, however many senders put it
+   there.
+
+   Any number of tasks may send. Only one task may receive, which is the
+   usual ingest arrangement (example4 and example5) and lets a waiting
+   receiver be woken with a single give.
+
+   Every batch queue keeps the counters described in queue_monitor.h; one
+   created with a name is also listed by the queue monitor.
+*/
+#ifndef BATCH_QUEUE_H
+#define BATCH_QUEUE_H
+
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "queue_monitor.h"
+
+typedef struct BatchQueue * BatchQueueHandle_t;
+
+/* Returns NULL if there is not enough heap for the queue. pcName may be NULL
+   to keep the queue out of the queue monitor's list. */
+BatchQueueHandle_t xBatchQueueCreate( UBaseType_t uxLength, UBaseType_t uxItemSize, const char *pcName );
+void vBatchQueueDelete( BatchQueueHandle_t xQueue );
+
+/* Copies uxCount items from pvItems into the queue, as many per critical
+   section as there is room for, waiting up to xTicksToWait in total for room
+   for the rest. Returns the number of items sent, which is less than uxCount
+   only if the wait expired. */
+UBaseType_t uxBatchQueueSendBatch( BatchQueueHandle_t xQueue, const void *pvItems, UBaseType_t uxCount, TickType_t xTicksToWait );
+
+/* Never blocks: sends what fits and returns how many that was. */
+UBaseType_t uxBatchQueueSendBatchFromISR( BatchQueueHandle_t xQueue, const void *pvItems, UBaseType_t uxCount, BaseType_t *pxHigherPriorityTaskWoken );
+
+/* Waits up to xTicksToWait for at least one item, then copies up to
+   uxMaxItems of what is waiting into pvBuffer. Returns the number of items
+   received, 0 if the wait expired. */
+UBaseType_t uxBatchQueueReceiveBatch( BatchQueueHandle_t xQueue, void *pvBuffer, UBaseType_t uxMaxItems, TickType_t xTicksToWait );
+
+/* Drain mode: pvBuffer must hold the queue length in items. */
+UBaseType_t uxBatchQueueReceiveAll( BatchQueueHandle_t xQueue, void *pvBuffer, TickType_t xTicksToWait );
+
+/* Single-item forms with xQueueSendToBack()/xQueueReceive() return values. */
+BaseType_t xBatchQueueSend( BatchQueueHandle_t xQueue, const void *pvItem, TickType_t xTicksToWait );
+BaseType_t xBatchQueueReceive( BatchQueueHandle_t xQueue, void *pvBuffer, TickType_t xTicksToWait );
+
+UBaseType_t uxBatchQueueMessagesWaiting( BatchQueueHandle_t xQueue );
+UBaseType_t uxBatchQueueSpacesAvailable( BatchQueueHandle_t xQueue );
+
+void vBatchQueueGetStats( BatchQueueHandle_t xQueue, QueueStats_t *pxStats );
+
+#endif /* BATCH_QUEUE_H */
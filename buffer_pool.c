@@ -0,0 +1,204 @@
+/* Fixed-block buffer pool - see buffer_pool.h
+
+   Every block starts with a small header that points back at its size class,
+   so vBufferPoolFree() needs nothing but the payload pointer. The header is
+   padded to the strictest alignment so the payload can hold any type.
+*/
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "buffer_pool.h"
+
+struct BufferClass
+{
+	QueueHandle_t     xFree;            /* pointers to the free blocks */
+	uint8_t          *pucStorage;
+	BufferPoolStats_t xStats;
+};
+
+typedef union
+{
+	struct BufferClass *pxClass;
+	long double         xAlign;
+	uint64_t            ullAlign;
+} BlockHeader_t;
+
+struct BufferPool
+{
+	UBaseType_t        uxClassCount;
+	struct BufferClass xClasses[ BUFFER_POOL_MAX_CLASSES ];
+};
+
+/**************************************************************************/
+
+static inline BlockHeader_t *prvHeader( const void *pvBlock )
+{
+	return ( BlockHeader_t * ) pvBlock - 1;
+}
+
+static void prvCountAlloc( struct BufferClass *pxClass )
+{
+	uint32_t ulInUse = __atomic_add_fetch( &pxClass->xStats.ulInUse, 1, __ATOMIC_RELAXED );
+	uint32_t ulHigh = __atomic_load_n( &pxClass->xStats.ulHighWater, __ATOMIC_RELAXED );
+
+	while( ulInUse > ulHigh &&
+	       !__atomic_compare_exchange_n( &pxClass->xStats.ulHighWater, &ulHigh, ulInUse,
+	                                     pdTRUE, __ATOMIC_RELAXED, __ATOMIC_RELAXED ) )
+	{
+	}
+	__atomic_add_fetch( &pxClass->xStats.ulAllocs, 1, __ATOMIC_RELAXED );
+}
+
+static void prvDeleteClasses( struct BufferPool *pxPool )
+{
+	for( UBaseType_t i = 0; i < pxPool->uxClassCount; i++ )
+	{
+		if( pxPool->xClasses[ i ].xFree != NULL )
+		{
+			vQueueDelete( pxPool->xClasses[ i ].xFree );
+		}
+		vPortFree( pxPool->xClasses[ i ].pucStorage );
+	}
+	vPortFree( pxPool );
+}
+
+/**************************************************************************/
+
+BufferPoolHandle_t xBufferPoolCreate( const BufferPoolClass_t *pxClasses, UBaseType_t uxClassCount )
+{
+	struct BufferPool *pxPool;
+	struct BufferClass *pxClass;
+	BlockHeader_t *pxHeader;
+	size_t xStride;
+
+	if( uxClassCount == 0 || uxClassCount > BUFFER_POOL_MAX_CLASSES )
+	{
+		return NULL;
+	}
+
+	pxPool = pvPortMalloc( sizeof( struct BufferPool ) );
+	if( pxPool == NULL )
+	{
+		return NULL;
+	}
+	memset( pxPool, 0, sizeof( struct BufferPool ) );
+	pxPool->uxClassCount = uxClassCount;
+
+	for( UBaseType_t i = 0; i < uxClassCount; i++ )
+	{
+		pxClass = &pxPool->xClasses[ i ];
+
+		/* Round the block up so every header stays aligned. */
+		xStride = sizeof( BlockHeader_t ) + pxClasses[ i ].uxBlockSize;
+		xStride = ( xStride + sizeof( BlockHeader_t ) - 1 ) / sizeof( BlockHeader_t ) * sizeof( BlockHeader_t );
+
+		pxClass->xStats.ulBlockSize = xStride - sizeof( BlockHeader_t );
+		pxClass->xStats.ulBlocks = pxClasses[ i ].uxBlocks;
+		pxClass->xFree = xQueueCreate( pxClasses[ i ].uxBlocks, sizeof( void * ) );
+		pxClass->pucStorage = pvPortMalloc( xStride * pxClasses[ i ].uxBlocks );
+
+		if( pxClass->xFree == NULL || pxClass->pucStorage == NULL )
+		{
+			prvDeleteClasses( pxPool );
+			return NULL;
+		}
+
+		for( UBaseType_t j = 0; j < pxClasses[ i ].uxBlocks; j++ )
+		{
+			pxHeader = ( BlockHeader_t * ) &pxClass->pucStorage[ j * xStride ];
+			pxHeader->pxClass = pxClass;
+			pxHeader++;
+			xQueueSendToBack( pxClass->xFree, &pxHeader, 0 );
+		}
+	}
+
+	return pxPool;
+}
+
+/**************************************************************************/
+
+void *pvBufferPoolAlloc( BufferPoolHandle_t xPool, size_t xSize, TickType_t xTicksToWait )
+{
+	struct BufferClass *pxFirstFit = NULL;
+	void *pvBlock;
+
+	/* Without waiting, take the smallest class that has a block left. */
+	for( UBaseType_t i = 0; i < xPool->uxClassCount; i++ )
+	{
+		struct BufferClass *pxClass = &xPool->xClasses[ i ];
+
+		if( pxClass->xStats.ulBlockSize < xSize )
+		{
+			continue;
+		}
+		if( pxFirstFit == NULL )
+		{
+			pxFirstFit = pxClass;
+		}
+
+		if( xQueueReceive( pxClass->xFree, &pvBlock, 0 ) == pdPASS )
+		{
+			prvCountAlloc( pxClass );
+			return pvBlock;
+		}
+		__atomic_add_fetch( &pxClass->xStats.ulExhausted, 1, __ATOMIC_RELAXED );
+	}
+
+	if( pxFirstFit == NULL )
+	{
+		return NULL;
+	}
+
+	/* Everything that fits is in use: wait for the best-fitting class. */
+	if( xTicksToWait != 0 && xQueueReceive( pxFirstFit->xFree, &pvBlock, xTicksToWait ) == pdPASS )
+	{
+		prvCountAlloc( pxFirstFit );
+		return pvBlock;
+	}
+
+	__atomic_add_fetch( &pxFirstFit->xStats.ulFailed, 1, __ATOMIC_RELAXED );
+	return NULL;
+}
+
+void vBufferPoolFree( void *pvBlock )
+{
+	struct BufferClass *pxClass = prvHeader( pvBlock )->pxClass;
+
+	__atomic_sub_fetch( &pxClass->xStats.ulInUse, 1, __ATOMIC_RELAXED );
+	xQueueSendToBack( pxClass->xFree, &pvBlock, 0 );
+}
+
+void vBufferPoolFreeFromISR( void *pvBlock, BaseType_t *pxHigherPriorityTaskWoken )
+{
+	struct BufferClass *pxClass = prvHeader( pvBlock )->pxClass;
+
+	__atomic_sub_fetch( &pxClass->xStats.ulInUse, 1, __ATOMIC_RELAXED );
+	xQueueSendToBackFromISR( pxClass->xFree, &pvBlock, pxHigherPriorityTaskWoken );
+}
+
+size_t xBufferPoolBlockSize( const void *pvBlock )
+{
+	return prvHeader( pvBlock )->pxClass->xStats.ulBlockSize;
+}
+
+/**************************************************************************/
+
+UBaseType_t uxBufferPoolGetStats( BufferPoolHandle_t xPool, BufferPoolStats_t *pxStats, UBaseType_t uxMaxClasses )
+{
+	UBaseType_t uxCount = ( xPool->uxClassCount < uxMaxClasses ) ? xPool->uxClassCount : uxMaxClasses;
+
+	for( UBaseType_t i = 0; i < uxCount; i++ )
+	{
+		const BufferPoolStats_t *pxSrc = &xPool->xClasses[ i ].xStats;
+
+		pxStats[ i ].ulBlockSize = pxSrc->ulBlockSize;
+		pxStats[ i ].ulBlocks = pxSrc->ulBlocks;
+		pxStats[ i ].ulInUse = __atomic_load_n( &pxSrc->ulInUse, __ATOMIC_RELAXED );
+		pxStats[ i ].ulHighWater = __atomic_load_n( &pxSrc->ulHighWater, __ATOMIC_RELAXED );
+		pxStats[ i ].ulAllocs = __atomic_load_n( &pxSrc->ulAllocs, __ATOMIC_RELAXED );
+		pxStats[ i ].ulExhausted = __atomic_load_n( &pxSrc->ulExhausted, __ATOMIC_RELAXED );
+		pxStats[ i ].ulFailed = __atomic_load_n( &pxSrc->ulFailed, __ATOMIC_RELAXED );
+	}
+	return uxCount;
+}
@@ -0,0 +1,100 @@
+/* Fixed-block buffer pool for passing large messages by reference
+
+   xQueueSendToBack() copies the whole item into the queue and xQueueReceive()
+   copies it out again, which is fine for a Data_t of a few bytes but not for
+   messages of hundreds of bytes. With a buffer pool the sender takes a block,
+   fills it in place and queues only the pointer; the receiver owns the block
+   from then on and gives it back when it is done with it:
+
+   pxMsg = pvBufferPoolAlloc( xPool, sizeof( Data_t ), xTicksToWait );
+   pxMsg->ucValue = 100;
+   xBufferQueueSend( xQueue, pxMsg, xTicksToWait );      sender no longer owns pxMsg
+
+   xBufferQueueReceive( xQueue, &pxMsg, portMAX_DELAY );  receiver owns pxMsg
+   ...
+   vBufferPoolFree( pxMsg );
+
+   A pool has up to BUFFER_POOL_MAX_CLASSES size classes, each with a fixed
+   number of blocks of one size. A request is served from the smallest class
+   the payload fits in, falling back to larger classes when that one is empty.
+   All blocks are allocated once, in xBufferPoolCreate(), so nothing is taken
+   from the heap while the application runs.
+
+   The free blocks of each class are kept in a FreeRTOS queue of pointers, so
+   an empty pool blocks the caller exactly like a full queue does, and
+   vBufferPoolFreeFromISR() lets an interrupt return a block.
+*/
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+#ifndef BUFFER_POOL_MAX_CLASSES
+#define BUFFER_POOL_MAX_CLASSES     4
+#endif
+
+typedef struct BufferPool * BufferPoolHandle_t;
+
+/* One size class: uxBlocks blocks that can each hold uxBlockSize bytes. */
+typedef struct
+{
+	UBaseType_t uxBlockSize;
+	UBaseType_t uxBlocks;
+} BufferPoolClass_t;
+
+typedef struct
+{
+	uint32_t ulBlockSize;
+	uint32_t ulBlocks;
+	uint32_t ulInUse;       /* blocks currently handed out */
+	uint32_t ulHighWater;   /* most blocks ever handed out at once */
+	uint32_t ulAllocs;      /* blocks handed out from this class */
+	uint32_t ulExhausted;   /* requests that found this class empty */
+	uint32_t ulFailed;      /* requests for this class that got no block at all */
+} BufferPoolStats_t;
+
+/* pxClasses must be sorted by increasing uxBlockSize. Returns NULL if there
+   is not enough heap for the blocks. */
+BufferPoolHandle_t xBufferPoolCreate( const BufferPoolClass_t *pxClasses, UBaseType_t uxClassCount );
+
+/* Returns a block of at least xSize bytes, or NULL if no class is big enough
+   or every suitable class stayed empty for xTicksToWait. */
+void *pvBufferPoolAlloc( BufferPoolHandle_t xPool, size_t xSize, TickType_t xTicksToWait );
+
+/* Returns a block to the pool it came from. */
+void vBufferPoolFree( void *pvBlock );
+void vBufferPoolFreeFromISR( void *pvBlock, BaseType_t *pxHigherPriorityTaskWoken );
+
+/* Usable size of a block, which may be larger than what was asked for. */
+size_t xBufferPoolBlockSize( const void *pvBlock );
+
+/* Fills pxStats[ 0 .. uxClassCount - 1 ] and returns the number of classes. */
+UBaseType_t uxBufferPoolGetStats( BufferPoolHandle_t xPool, BufferPoolStats_t *pxStats, UBaseType_t uxMaxClasses );
+
+/* A buffer queue is a FreeRTOS queue of block pointers. Sending a block
+   hands it over to whoever receives it. */
+static inline QueueHandle_t xBufferQueueCreate( UBaseType_t uxLength )
+{
+	return xQueueCreate( uxLength, sizeof( void * ) );
+}
+
+static inline BaseType_t xBufferQueueSend( QueueHandle_t xQueue, void *pvBlock, TickType_t xTicksToWait )
+{
+	return xQueueSendToBack( xQueue, &pvBlock, xTicksToWait );
+}
+
+static inline BaseType_t xBufferQueueSendFromISR( QueueHandle_t xQueue, void *pvBlock, BaseType_t *pxHigherPriorityTaskWoken )
+{
+	return xQueueSendToBackFromISR( xQueue, &pvBlock, pxHigherPriorityTaskWoken );
+}
+
+/* ppvBlock takes the address of the receiver's pointer variable. */
+static inline BaseType_t xBufferQueueReceive( QueueHandle_t xQueue, void *ppvBlock, TickType_t xTicksToWait )
+{
+	return xQueueReceive( xQueue, ppvBlock, xTicksToWait );
+}
+
+#endif /* BUFFER_POOL_H */
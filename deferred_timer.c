@@ -0,0 +1,264 @@
+/* Deferred software timer callbacks - see deferred_timer.h
+
+   Each deferred timer owns a record, kept in the FreeRTOS timer's ID. The
+   daemon callback of every deferred timer is prvDispatch(), which marks
+   the record pending and queues a pointer to it; workers take records off
+   the queue and run the user callback.
+
+   The flags are guarded by xWorkersLock. xDeferredTimerDelete() only stops
+   the timer and marks the record deleted; a worker that finds the mark
+   skips the callback. The FreeRTOS timer is deleted, and the record freed,
+   once the daemon has processed the stop and no callback is queued or
+   running, by whichever of prvStopped() and the worker sees that last. So
+   a callback never gets a freed handle, and a deleted timer's callback
+   doesn't start at all.
+*/
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/timers.h"
+#include "freertos/queue.h"
+#include "esp_timer.h"
+#include "deferred_timer.h"
+#include "timer_lateness.h"
+
+#define deferredPENDING     0x01        /* queued for a worker or running */
+#define deferredDELETED     0x02        /* xDeferredTimerDelete() was called */
+#define deferredSTOPPED     0x04        /* the daemon has processed the stop */
+#define deferredRELEASABLE  ( deferredDELETED | deferredSTOPPED )
+
+struct DeferredTimer
+{
+	TimerHandle_t            xTimer;
+	TimerCallbackFunction_t  pxCallback;
+	void                    *pvTimerID;
+	UBaseType_t              uxAutoReload;
+	TickType_t               xScheduled;
+	int64_t                  llQueuedAt;
+	uint8_t                  ucFlags;
+};
+
+static QueueHandle_t xWorkQueue;
+static portMUX_TYPE xWorkersLock = portMUX_INITIALIZER_UNLOCKED;
+static TimerWorkerStats_t xStats;
+
+/**************************************************************************/
+
+static void prvStoreMax( uint32_t *pulMax, uint32_t ulValue )
+{
+	uint32_t ulHigh = __atomic_load_n( pulMax, __ATOMIC_RELAXED );
+
+	while( ulValue > ulHigh &&
+	       !__atomic_compare_exchange_n( pulMax, &ulHigh, ulValue, pdTRUE, __ATOMIC_RELAXED, __ATOMIC_RELAXED ) )
+	{
+	}
+}
+
+/* The daemon callback of every deferred timer. */
+static void prvDispatch( TimerHandle_t xTimer )
+{
+	struct DeferredTimer *pxRecord = pvTimerGetTimerID( xTimer );
+	BaseType_t xQueue;
+
+	taskENTER_CRITICAL( &xWorkersLock );
+	xQueue = ( pxRecord->ucFlags == 0 );
+	if( xQueue )
+	{
+		pxRecord->ucFlags = deferredPENDING;
+		pxRecord->llQueuedAt = esp_timer_get_time();
+		pxRecord->xScheduled = xTimerScheduledExpiry( xTimer, pxRecord->uxAutoReload );
+	}
+	taskEXIT_CRITICAL( &xWorkersLock );
+
+	if( !xQueue )
+	{
+		__atomic_add_fetch( &xStats.ulCoalesced, 1, __ATOMIC_RELAXED );
+		return;
+	}
+
+	/* Never wait here: that would hold up every other timer. */
+	if( xQueueSendToBack( xWorkQueue, &pxRecord, 0 ) == pdPASS )
+	{
+		__atomic_add_fetch( &xStats.ulQueued, 1, __ATOMIC_RELAXED );
+	}
+	else
+	{
+		taskENTER_CRITICAL( &xWorkersLock );
+		pxRecord->ucFlags &= ~deferredPENDING;
+		taskEXIT_CRITICAL( &xWorkersLock );
+		__atomic_add_fetch( &xStats.ulDropped, 1, __ATOMIC_RELAXED );
+	}
+}
+
+static void prvFree( void *pvRecord, uint32_t ulUnused )
+{
+	vPortFree( pvRecord );
+}
+
+/* Deletes the timer and frees the record. The free is queued behind the
+   delete, so the daemon can't dispatch to the record once it is freed. If
+   either cannot be queued the timer leaks, which is the lesser evil next to
+   freeing it under a dispatch still to come. */
+static void prvRelease( struct DeferredTimer *pxRecord, TickType_t xTicksToWait )
+{
+	if( xTimerDelete( pxRecord->xTimer, xTicksToWait ) == pdPASS )
+	{
+		xTimerPendFunctionCall( prvFree, pxRecord, 0, xTicksToWait );
+	}
+}
+
+static void prvWorkerTask( void *pvParameters )
+{
+	struct DeferredTimer *pxRecord;
+	int64_t llStart;
+	BaseType_t xRun, xRelease;
+
+	for(;;)
+	{
+		xQueueReceive( xWorkQueue, &pxRecord, portMAX_DELAY );
+
+		taskENTER_CRITICAL( &xWorkersLock );
+		xRun = ( ( pxRecord->ucFlags & deferredDELETED ) == 0 );
+		taskEXIT_CRITICAL( &xWorkersLock );
+
+		if( xRun )
+		{
+			llStart = esp_timer_get_time();
+			prvStoreMax( &xStats.ulMaxWaitUs, ( uint32_t ) ( llStart - pxRecord->llQueuedAt ) );
+
+			pxRecord->pxCallback( pxRecord->xTimer );
+
+			prvStoreMax( &xStats.ulMaxRunUs, ( uint32_t ) ( esp_timer_get_time() - llStart ) );
+			__atomic_add_fetch( &xStats.ulRun, 1, __ATOMIC_RELAXED );
+		}
+
+		taskENTER_CRITICAL( &xWorkersLock );
+		pxRecord->ucFlags &= ~deferredPENDING;
+		xRelease = ( pxRecord->ucFlags == deferredRELEASABLE );
+		taskEXIT_CRITICAL( &xWorkersLock );
+
+		if( xRelease )
+		{
+			prvRelease( pxRecord, portMAX_DELAY );
+		}
+	}
+}
+
+BaseType_t xTimerWorkersStart( UBaseType_t uxPriority, UBaseType_t uxWorkers )
+{
+	if( uxWorkers == 0 || uxWorkers > TIMER_WORKERS_MAX )
+	{
+		return pdFAIL;
+	}
+
+	xWorkQueue = xQueueCreate( TIMER_WORKERS_QUEUE_LENGTH, sizeof( struct DeferredTimer * ) );
+	if( xWorkQueue == NULL )
+	{
+		return pdFAIL;
+	}
+
+	for( UBaseType_t i = 0; i < uxWorkers; i++ )
+	{
+		if( xTaskCreatePinnedToCore( prvWorkerTask, "TimerWorker", TIMER_WORKERS_STACK_SIZE, NULL,
+		                             uxPriority, NULL, i % portNUM_PROCESSORS ) != pdPASS )
+		{
+			return pdFAIL;
+		}
+	}
+	return pdPASS;
+}
+
+/**************************************************************************/
+
+TimerHandle_t xDeferredTimerCreate( const char * const pcTimerName, TickType_t xTimerPeriodInTicks,
+                                    UBaseType_t uxAutoReload, void * const pvTimerID,
+                                    TimerCallbackFunction_t pxCallbackFunction )
+{
+	struct DeferredTimer *pxRecord = pvPortMalloc( sizeof( struct DeferredTimer ) );
+
+	if( pxRecord == NULL )
+	{
+		return NULL;
+	}
+
+	memset( pxRecord, 0, sizeof( struct DeferredTimer ) );
+	pxRecord->pxCallback = pxCallbackFunction;
+	pxRecord->pvTimerID = pvTimerID;
+	pxRecord->uxAutoReload = uxAutoReload;
+
+	pxRecord->xTimer = xTimerCreate( pcTimerName, xTimerPeriodInTicks, uxAutoReload, pxRecord, prvDispatch );
+	if( pxRecord->xTimer == NULL )
+	{
+		vPortFree( pxRecord );
+		return NULL;
+	}
+	return pxRecord->xTimer;
+}
+
+/* Runs in the daemon, after the stop command queued before it. The daemon
+   can't wait on its own queue, hence no block time. */
+static void prvStopped( void *pvRecord, uint32_t ulUnused )
+{
+	struct DeferredTimer *pxRecord = pvRecord;
+	BaseType_t xRelease;
+
+	taskENTER_CRITICAL( &xWorkersLock );
+	pxRecord->ucFlags |= deferredSTOPPED;
+	xRelease = ( pxRecord->ucFlags == deferredRELEASABLE );
+	taskEXIT_CRITICAL( &xWorkersLock );
+
+	if( xRelease )
+	{
+		prvRelease( pxRecord, 0 );
+	}
+}
+
+BaseType_t xDeferredTimerDelete( TimerHandle_t xTimer, TickType_t xTicksToWait )
+{
+	struct DeferredTimer *pxRecord = pvTimerGetTimerID( xTimer );
+
+	if( xTimerStop( xTimer, xTicksToWait ) != pdPASS )
+	{
+		return pdFAIL;
+	}
+
+	/* From here on a queued callback is skipped. */
+	taskENTER_CRITICAL( &xWorkersLock );
+	pxRecord->ucFlags |= deferredDELETED;
+	taskEXIT_CRITICAL( &xWorkersLock );
+
+	/* If this cannot be queued the timer and record leak, see prvRelease(). */
+	return xTimerPendFunctionCall( prvStopped, pxRecord, 0, xTicksToWait );
+}
+
+void *pvDeferredTimerGetTimerID( const TimerHandle_t xTimer )
+{
+	struct DeferredTimer *pxRecord = pvTimerGetTimerID( xTimer );
+
+	return pxRecord->pvTimerID;
+}
+
+void vDeferredTimerSetTimerID( TimerHandle_t xTimer, void *pvNewID )
+{
+	struct DeferredTimer *pxRecord = pvTimerGetTimerID( xTimer );
+
+	pxRecord->pvTimerID = pvNewID;
+}
+
+TickType_t xDeferredTimerGetScheduledExpiry( TimerHandle_t xTimer )
+{
+	struct DeferredTimer *pxRecord = pvTimerGetTimerID( xTimer );
+
+	return pxRecord->xScheduled;
+}
+
+void vTimerWorkersGetStats( TimerWorkerStats_t *pxStats )
+{
+	pxStats->ulQueued = __atomic_load_n( &xStats.ulQueued, __ATOMIC_RELAXED );
+	pxStats->ulRun = __atomic_load_n( &xStats.ulRun, __ATOMIC_RELAXED );
+	pxStats->ulCoalesced = __atomic_load_n( &xStats.ulCoalesced, __ATOMIC_RELAXED );
+	pxStats->ulDropped = __atomic_load_n( &xStats.ulDropped, __ATOMIC_RELAXED );
+	pxStats->ulMaxWaitUs = __atomic_load_n( &xStats.ulMaxWaitUs, __ATOMIC_RELAXED );
+	pxStats->ulMaxRunUs = __atomic_load_n( &xStats.ulMaxRunUs, __ATOMIC_RELAXED );
+}
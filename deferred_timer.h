@@ -0,0 +1,84 @@
+/* Deferred software timer callbacks
+
+   All software timer callbacks run in the one timer daemon task, one after
+   the other, so a callback that takes long - a printf to a slow console, a
+   flash write - delays the expiry of every other timer by as much.
+
+   A deferred timer is an ordinary FreeRTOS timer whose callback is not run
+   by the daemon: on expiry the daemon only queues the timer to a small pool
+   of worker tasks, a few microseconds of work, and a worker runs the
+   callback. Timers that are not deferred keep their expiry latency no
+   matter how long the deferred callbacks take.
+
+   xTimerWorkersStart( tskIDLE_PRIORITY, portNUM_PROCESSORS );
+   xTimer = xDeferredTimerCreate( "AutoReload", pdMS_TO_TICKS( 500 ), pdTRUE, 0, prvAutoReloadTimerCallback );
+   xTimerStart( xTimer, 0 );
+
+   The handle is a plain TimerHandle_t, so it is started, stopped, reset and
+   queried with the xTimer calls, except for:
+
+   - the timer ID, which holds the deferral record: use
+     pvDeferredTimerGetTimerID() and vDeferredTimerSetTimerID().
+   - deletion: use xDeferredTimerDelete().
+
+   While a timer's callback is still queued or running, further expiries of
+   the same timer are coalesced into that one run and counted, so one slow
+   callback can neither fill the queue nor run in parallel with itself.
+   Callbacks of different timers run in parallel, one per worker. They run
+   in a task of their own, so unlike daemon callbacks they may block.
+
+   Workers should run at a lower priority than the daemon
+   (configTIMER_TASK_PRIORITY), or on the other core, so that a running
+   callback never keeps the daemon from its bookkeeping.
+*/
+#ifndef DEFERRED_TIMER_H
+#define DEFERRED_TIMER_H
+
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/timers.h"
+
+#define TIMER_WORKERS_MAX           4
+#define TIMER_WORKERS_STACK_SIZE    3072
+
+/* Deferred callbacks waiting for a worker. Expiries that find it full are
+   dropped and counted. */
+#define TIMER_WORKERS_QUEUE_LENGTH  16
+
+typedef struct
+{
+	uint32_t ulQueued;       /* expiries handed to the workers */
+	uint32_t ulRun;          /* callbacks run */
+	uint32_t ulCoalesced;    /* expiries folded into a run still pending */
+	uint32_t ulDropped;      /* expiries lost to a full queue */
+	uint32_t ulMaxWaitUs;    /* longest time from expiry to callback start */
+	uint32_t ulMaxRunUs;     /* longest callback */
+} TimerWorkerStats_t;
+
+/* Creates uxWorkers worker tasks (at most TIMER_WORKERS_MAX), spread over
+   the cores: worker n is pinned to core n % portNUM_PROCESSORS. Call once,
+   before the first deferred timer expires. */
+BaseType_t xTimerWorkersStart( UBaseType_t uxPriority, UBaseType_t uxWorkers );
+
+/* Same arguments as xTimerCreate(). Returns NULL if there is not enough heap. */
+TimerHandle_t xDeferredTimerCreate( const char * const pcTimerName, TickType_t xTimerPeriodInTicks,
+                                    UBaseType_t uxAutoReload, void * const pvTimerID,
+                                    TimerCallbackFunction_t pxCallbackFunction );
+
+/* Deletes the timer like xTimerDelete(). A callback still queued for it is
+   not run; one already running keeps a valid handle, because the timer is
+   only deleted, and its deferral record freed, once that callback has
+   returned. Safe to call from the timer's own callback. */
+BaseType_t xDeferredTimerDelete( TimerHandle_t xTimer, TickType_t xTicksToWait );
+
+void *pvDeferredTimerGetTimerID( const TimerHandle_t xTimer );
+void vDeferredTimerSetTimerID( TimerHandle_t xTimer, void *pvNewID );
+
+/* From the timer's callback: the tick the expiry being handled was due at,
+   e.g. for vTimerLatenessRecord(). */
+TickType_t xDeferredTimerGetScheduledExpiry( TimerHandle_t xTimer );
+
+void vTimerWorkersGetStats( TimerWorkerStats_t *pxStats );
+
+#endif /* DEFERRED_TIMER_H */
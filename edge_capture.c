@@ -0,0 +1,237 @@
+/* GPIO edge capture with debouncing - see edge_capture.h
+
+   The ring is single producer (the ISR writes ulHead) and single consumer
+   (the receiving task writes ulTail), so neither side takes a lock; the
+   free-running indices are masked on use.
+
+   The debouncer walks the ring one edge at a time. An edge's level has
+   held long enough once the next edge is at least ulDebounceUs later, or,
+   for the newest edge, once that long has passed since it. While the
+   newest edge is still too recent the task waits for the debounce timer.
+
+   An edge that finds the ring full is added to the newest record instead:
+   ulLost counts such edges and ulLostUs keeps the first of them. With the
+   ring full the task is 63 records behind, so it is never reading the
+   record the ISR updates. ulLastEdgeUs is stamped for every edge, lost
+   ones included, and is what the newest record's quiet time is measured
+   against; if edges were lost after it, its level is read back from the
+   pin, which by then has been quiet for the debounce interval.
+*/
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/gpio.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "hrtimer.h"
+#include "isr_signal.h"
+#include "edge_capture.h"
+
+#define edgeMASK        ( EDGE_CAPTURE_RING_LENGTH - 1 )
+
+typedef struct
+{
+	uint32_t ulTimeUs;
+	uint32_t ulLevel;
+	uint32_t ulLost;            /* edges after this one that found the ring full */
+	uint32_t ulLostUs;          /* when the first of them came */
+} EdgeRecord_t;
+
+struct EdgeCapture
+{
+	gpio_num_t          xPin;
+	uint32_t            ulActiveLevel;
+	uint32_t            ulDebounceUs;
+	HrTimerHandle_t     xDebounceTimer;
+	IsrSignalHandle_t   xSettled;
+
+	uint32_t            ulHead;         /* written by the ISR */
+	uint32_t            ulTail;         /* written by the receiving task */
+	uint32_t            ulLastEdgeUs;   /* written by the ISR, lost edges included */
+	EdgeRecord_t        xRing[ EDGE_CAPTURE_RING_LENGTH ];
+
+	/* Debouncer state, receiving task only. */
+	uint32_t            ulStableLevel;
+	uint32_t            ulStableSinceUs;
+	uint32_t            ulBurstStartUs;
+	uint32_t            ulBurstEdges;
+
+	EdgeCaptureStats_t  xStats;
+};
+
+/**************************************************************************/
+
+static void IRAM_ATTR prvEdgeIsr( void *pvParameters )
+{
+	struct EdgeCapture *pxCapture = pvParameters;
+	uint32_t ulHead = pxCapture->ulHead;
+	uint32_t ulNow = ( uint32_t ) esp_timer_get_time();
+	EdgeRecord_t *pxRecord;
+
+	pxCapture->xStats.ulEdges++;
+
+	if( ulHead - __atomic_load_n( &pxCapture->ulTail, __ATOMIC_ACQUIRE ) < EDGE_CAPTURE_RING_LENGTH )
+	{
+		pxRecord = &pxCapture->xRing[ ulHead & edgeMASK ];
+		pxRecord->ulTimeUs = ulNow;
+		pxRecord->ulLevel = gpio_get_level( pxCapture->xPin );
+		pxRecord->ulLost = 0;
+		__atomic_store_n( &pxCapture->ulHead, ulHead + 1, __ATOMIC_RELEASE );
+	}
+	else
+	{
+		pxRecord = &pxCapture->xRing[ ( ulHead - 1 ) & edgeMASK ];
+		if( pxRecord->ulLost++ == 0 )
+		{
+			pxRecord->ulLostUs = ulNow;
+		}
+		pxCapture->xStats.ulOverruns++;
+	}
+	__atomic_store_n( &pxCapture->ulLastEdgeUs, ulNow, __ATOMIC_RELEASE );
+
+	/* Every edge pushes the wakeup back: the task runs once the pin has
+	   been quiet for the debounce interval. */
+	xHrTimerStartOnce( pxCapture->xDebounceTimer, pxCapture->ulDebounceUs );
+}
+
+static void IRAM_ATTR prvSettledCallback( HrTimerHandle_t xTimer, BaseType_t *pxHigherPriorityTaskWoken )
+{
+	struct EdgeCapture *pxCapture = pvHrTimerGetContext( xTimer );
+
+	/* Sets *pxHigherPriorityTaskWoken to pdTRUE if this unblocks the
+	   receiving task and it has a higher priority than the task that was
+	   interrupted. The hrtimer alarm interrupt then ends with
+	   portYIELD_FROM_ISR(), so it returns straight to that task. */
+	xIsrSignalGiveFromISR( pxCapture->xSettled, pxHigherPriorityTaskWoken );
+}
+
+/**************************************************************************/
+
+EdgeCaptureHandle_t xEdgeCaptureCreate( gpio_num_t xPin, uint32_t ulActiveLevel, uint32_t ulDebounceUs )
+{
+	struct EdgeCapture *pxCapture = pvPortMalloc( sizeof( struct EdgeCapture ) );
+
+	if( pxCapture == NULL )
+	{
+		return NULL;
+	}
+
+	memset( pxCapture, 0, sizeof( struct EdgeCapture ) );
+	pxCapture->xPin = xPin;
+	pxCapture->ulActiveLevel = ulActiveLevel;
+	pxCapture->ulDebounceUs = ulDebounceUs;
+	pxCapture->ulStableLevel = gpio_get_level( xPin );
+	pxCapture->ulStableSinceUs = ( uint32_t ) esp_timer_get_time();
+
+	pxCapture->xSettled = xIsrSignalCreateBinary();
+	pxCapture->xDebounceTimer = xHrTimerCreate( "debounce", prvSettledCallback, pxCapture );
+	if( pxCapture->xSettled == NULL || pxCapture->xDebounceTimer == NULL )
+	{
+		/* Neither can be deleted; a failed create is not retried. */
+		vPortFree( pxCapture );
+		return NULL;
+	}
+
+	gpio_set_intr_type( xPin, GPIO_INTR_ANYEDGE );
+	gpio_isr_handler_add( xPin, prvEdgeIsr, pxCapture );
+	return pxCapture;
+}
+
+/* Runs the debouncer over the recorded edges. Returns pdTRUE with an event,
+   pdFALSE once the ring is empty or its newest edge has not settled yet. */
+static BaseType_t prvDebounce( struct EdgeCapture *pxCapture, EdgeCaptureEvent_t *pxEvent )
+{
+	uint32_t ulHead = __atomic_load_n( &pxCapture->ulHead, __ATOMIC_ACQUIRE );
+	const EdgeRecord_t *pxEdge;
+	uint32_t ulQuietUntil, ulLevel;
+	BaseType_t xEmitted = pdFALSE;
+
+	while( pxCapture->ulTail != ulHead )
+	{
+		pxEdge = &pxCapture->xRing[ pxCapture->ulTail & edgeMASK ];
+		ulLevel = pxEdge->ulLevel;
+
+		if( pxCapture->ulTail + 1 != ulHead )
+		{
+			/* Held until the next edge, recorded or lost. */
+			ulQuietUntil = ( pxEdge->ulLost != 0 ) ? pxEdge->ulLostUs :
+			               pxCapture->xRing[ ( pxCapture->ulTail + 1 ) & edgeMASK ].ulTimeUs;
+		}
+		else
+		{
+			ulQuietUntil = ( uint32_t ) esp_timer_get_time();
+			if( ulQuietUntil - __atomic_load_n( &pxCapture->ulLastEdgeUs, __ATOMIC_ACQUIRE ) < pxCapture->ulDebounceUs )
+			{
+				return pdFALSE;
+			}
+			if( pxEdge->ulLost != 0 )
+			{
+				ulLevel = gpio_get_level( pxCapture->xPin );
+			}
+		}
+
+		if( pxCapture->ulBurstEdges == 0 )
+		{
+			pxCapture->ulBurstStartUs = pxEdge->ulTimeUs;
+		}
+		pxCapture->ulBurstEdges += 1 + pxEdge->ulLost;
+
+		if( ulQuietUntil - pxEdge->ulTimeUs >= pxCapture->ulDebounceUs )
+		{
+			/* The burst is over: this edge's level held. */
+			xEmitted = ( ulLevel != pxCapture->ulStableLevel );
+			if( xEmitted )
+			{
+				pxEvent->eType = ( ulLevel == pxCapture->ulActiveLevel ) ? eEdgeCapturePressed : eEdgeCaptureReleased;
+				pxEvent->ulTimeUs = pxCapture->ulBurstStartUs;
+				pxEvent->ulDurationUs = pxCapture->ulBurstStartUs - pxCapture->ulStableSinceUs;
+				pxEvent->ulEdges = pxCapture->ulBurstEdges;
+
+				pxCapture->ulStableLevel = ulLevel;
+				pxCapture->ulStableSinceUs = pxCapture->ulBurstStartUs;
+				pxCapture->xStats.ulEvents++;
+			}
+			else
+			{
+				pxCapture->xStats.ulGlitches++;
+			}
+			pxCapture->ulBurstEdges = 0;
+		}
+
+		__atomic_store_n( &pxCapture->ulTail, pxCapture->ulTail + 1, __ATOMIC_RELEASE );
+		if( xEmitted )
+		{
+			return pdTRUE;
+		}
+	}
+	return pdFALSE;
+}
+
+BaseType_t xEdgeCaptureReceive( EdgeCaptureHandle_t xCapture, EdgeCaptureEvent_t *pxEvent, TickType_t xTicksToWait )
+{
+	TimeOut_t xTimeOut;
+
+	vTaskSetTimeOutState( &xTimeOut );
+
+	for(;;)
+	{
+		if( prvDebounce( xCapture, pxEvent ) )
+		{
+			return pdPASS;
+		}
+		if( xTaskCheckForTimeOut( &xTimeOut, &xTicksToWait ) != pdFALSE ||
+		    xIsrSignalTake( xCapture->xSettled, xTicksToWait ) != pdTRUE )
+		{
+			return pdFAIL;
+		}
+	}
+}
+
+void vEdgeCaptureGetStats( EdgeCaptureHandle_t xCapture, EdgeCaptureStats_t *pxStats )
+{
+	pxStats->ulEdges = __atomic_load_n( &xCapture->xStats.ulEdges, __ATOMIC_RELAXED );
+	pxStats->ulOverruns = __atomic_load_n( &xCapture->xStats.ulOverruns, __ATOMIC_RELAXED );
+	pxStats->ulEvents = xCapture->xStats.ulEvents;
+	pxStats->ulGlitches = xCapture->xStats.ulGlitches;
+}
@@ -0,0 +1,80 @@
+/* GPIO edge capture with debouncing
+
+   A semaphore given per edge, as in example08, collapses a bouncing press
+   into however many wakes the task happens to see, and keeps neither the
+   count nor the times. Here the pin interrupts on both edges and the ISR
+   only appends a (time, level) record to a ring and pushes back a one-shot
+   hrtimer (hrtimer.h) by the debounce interval. The task is woken when that
+   timer fires, i.e. once the pin has been quiet for the debounce interval,
+   and turns the recorded edges into press and release events:
+
+   xHrTimerInit();
+   gpio_install_isr_service( ESP_INTR_FLAG_DEFAULT );
+   xButton = xEdgeCaptureCreate( TOGGLE, 0, 20000 );
+
+   for(;;)
+   {
+       xEdgeCaptureReceive( xButton, &xEvent, portMAX_DELAY );
+       if( xEvent.eType == eEdgeCaptureReleased ) printf("held %u us\r\n", xEvent.ulDurationUs);
+   }
+
+   A level counts once it has held for the debounce interval; the event is
+   stamped with the first edge of the bounce burst that led to it, so
+   durations are measured from the contacts first moving. A burst that
+   settles back at the level it started from is counted as a glitch and
+   produces no event.
+
+   The ring holds EDGE_CAPTURE_RING_LENGTH edges. Edges that find it full
+   are counted as overruns and folded into the burst of the newest recorded
+   edge. The settled level is then read back from the pin once it has been
+   quiet for the debounce interval, so it still produces the right event. The receiving task must not use
+   its direct-to-task notification for anything else (see isr_signal.h).
+*/
+#ifndef EDGE_CAPTURE_H
+#define EDGE_CAPTURE_H
+
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "driver/gpio.h"
+
+/* Power of two. */
+#define EDGE_CAPTURE_RING_LENGTH    64
+
+typedef enum
+{
+	eEdgeCapturePressed = 0,
+	eEdgeCaptureReleased
+} EdgeCaptureEventType_t;
+
+typedef struct
+{
+	EdgeCaptureEventType_t eType;
+	uint32_t ulTimeUs;          /* esp_timer_get_time() of the first edge of the burst */
+	uint32_t ulDurationUs;      /* since the previous event: how long the button was
+	                               released before a press, held before a release */
+	uint32_t ulEdges;           /* edges in the burst, lost ones included, 1 for a clean contact */
+} EdgeCaptureEvent_t;
+
+typedef struct
+{
+	uint32_t ulEdges;           /* edges recorded by the ISR */
+	uint32_t ulOverruns;        /* edges lost to a full ring */
+	uint32_t ulEvents;          /* press and release events produced */
+	uint32_t ulGlitches;        /* bursts that settled back where they started */
+} EdgeCaptureStats_t;
+
+typedef struct EdgeCapture * EdgeCaptureHandle_t;
+
+/* Sets the pin to interrupt on both edges and adds the handler;
+   gpio_install_isr_service() and xHrTimerInit() must have been called.
+   ulActiveLevel is the level while pressed. Returns NULL if there is not
+   enough heap or no hrtimer is left. */
+EdgeCaptureHandle_t xEdgeCaptureCreate( gpio_num_t xPin, uint32_t ulActiveLevel, uint32_t ulDebounceUs );
+
+/* Waits up to xTicksToWait for the next press or release. Returns pdPASS
+   with the event, or pdFAIL on timeout. Only one task may receive. */
+BaseType_t xEdgeCaptureReceive( EdgeCaptureHandle_t xCapture, EdgeCaptureEvent_t *pxEvent, TickType_t xTicksToWait );
+
+void vEdgeCaptureGetStats( EdgeCaptureHandle_t xCapture, EdgeCaptureStats_t *pxStats );
+
+#endif /* EDGE_CAPTURE_H */
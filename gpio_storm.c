@@ -0,0 +1,192 @@
+/* GPIO interrupt storm protection - see gpio_storm.h
+
+   The ISR and the poll timer never run at the same time for one pin: the
+   ISR starts the timer only after masking the interrupt, and the timer
+   unmasks it only after it has stopped sampling. So the state below has
+   one writer at a time and needs no lock.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/timers.h"
+#include "driver/gpio.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "gpio_storm.h"
+
+struct GpioStorm
+{
+	gpio_num_t          xPin;
+	gpio_int_type_t     xIntrType;
+	uint32_t            ulWindowLimit;  /* interrupts allowed per window */
+	uint32_t            ulQuietPolls;   /* polls without a level change before unmasking */
+	GpioStormHandler_t  pxHandler;
+	void               *pvContext;
+	TimerHandle_t       xPollTimer;
+
+	int64_t             llWindowStart;
+	uint32_t            ulWindowCount;
+	uint32_t            ulLastLevel;
+	uint32_t            ulQuiet;
+
+	GpioStormStats_t    xStats;
+};
+
+/**************************************************************************/
+
+static BaseType_t prvMatches( gpio_int_type_t xIntrType, uint32_t ulFrom, uint32_t ulTo )
+{
+	switch( xIntrType )
+	{
+		case GPIO_INTR_POSEDGE: return ulFrom == 0 && ulTo == 1;
+		case GPIO_INTR_NEGEDGE: return ulFrom == 1 && ulTo == 0;
+		case GPIO_INTR_ANYEDGE: return ulFrom != ulTo;
+		default:                return pdFALSE;
+	}
+}
+
+static void IRAM_ATTR prvStormIsr( void *pvParameters )
+{
+	struct GpioStorm *pxStorm = pvParameters;
+	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+	int64_t llNow = esp_timer_get_time();
+
+	pxStorm->xStats.ulInterrupts++;
+
+	if( llNow - pxStorm->llWindowStart >= GPIO_STORM_WINDOW_US )
+	{
+		pxStorm->llWindowStart = llNow;
+		pxStorm->ulWindowCount = 0;
+	}
+
+	if( ++pxStorm->ulWindowCount > pxStorm->ulWindowLimit )
+	{
+		pxStorm->ulLastLevel = gpio_get_level( pxStorm->xPin );
+		pxStorm->ulQuiet = 0;
+
+		/* Without the timer nothing would unmask the pin again, so a storm
+		   that can't start it stays on interrupts. */
+		if( xTimerStartFromISR( pxStorm->xPollTimer, &xHigherPriorityTaskWoken ) == pdPASS )
+		{
+			gpio_intr_disable( pxStorm->xPin );
+			pxStorm->xStats.ulStorms++;
+			__atomic_store_n( &pxStorm->xStats.ulPolling, 1, __ATOMIC_RELAXED );
+		}
+		else
+		{
+			pxStorm->xStats.ulStartFailed++;
+		}
+	}
+
+	pxStorm->pxHandler( pxStorm->pvContext, &xHigherPriorityTaskWoken );
+
+	if( xHigherPriorityTaskWoken ) portYIELD_FROM_ISR();
+}
+
+static void prvPoll( TimerHandle_t xTimer )
+{
+	struct GpioStorm *pxStorm = pvTimerGetTimerID( xTimer );
+	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+	uint32_t ulLevel;
+
+	/* A stop that didn't make it into the timer queue last time. */
+	if( __atomic_load_n( &pxStorm->xStats.ulPolling, __ATOMIC_RELAXED ) == 0 )
+	{
+		xTimerStop( xTimer, 0 );
+		return;
+	}
+
+	ulLevel = gpio_get_level( pxStorm->xPin );
+	pxStorm->xStats.ulPolls++;
+
+	if( ulLevel != pxStorm->ulLastLevel )
+	{
+		if( prvMatches( pxStorm->xIntrType, pxStorm->ulLastLevel, ulLevel ) )
+		{
+			pxStorm->xStats.ulPolledEdges++;
+			pxStorm->pxHandler( pxStorm->pvContext, &xHigherPriorityTaskWoken );
+		}
+		pxStorm->ulLastLevel = ulLevel;
+		pxStorm->ulQuiet = 0;
+	}
+	else if( ++pxStorm->ulQuiet >= pxStorm->ulQuietPolls )
+	{
+		xTimerStop( xTimer, 0 );
+
+		/* The calm period starts a fresh window. */
+		pxStorm->llWindowStart = esp_timer_get_time();
+		pxStorm->ulWindowCount = 0;
+		__atomic_store_n( &pxStorm->xStats.ulPolling, 0, __ATOMIC_RELAXED );
+		gpio_intr_enable( pxStorm->xPin );
+	}
+
+	if( xHigherPriorityTaskWoken ) taskYIELD();
+}
+
+/**************************************************************************/
+
+GpioStormHandle_t xGpioStormCreate( gpio_num_t xPin, gpio_int_type_t xIntrType, uint32_t ulMaxRateHz,
+                                    uint32_t ulPollMs, uint32_t ulQuietMs,
+                                    GpioStormHandler_t pxHandler, void *pvContext )
+{
+	struct GpioStorm *pxStorm = pvPortMalloc( sizeof( struct GpioStorm ) );
+	TickType_t xPollTicks = pdMS_TO_TICKS( ulPollMs );
+
+	if( pxStorm == NULL )
+	{
+		return NULL;
+	}
+
+	memset( pxStorm, 0, sizeof( struct GpioStorm ) );
+	pxStorm->xPin = xPin;
+	pxStorm->xIntrType = xIntrType;
+	pxStorm->ulWindowLimit = ( uint32_t ) ( ( uint64_t ) ulMaxRateHz * GPIO_STORM_WINDOW_US / 1000000 );
+	pxStorm->ulQuietPolls = ( ulPollMs != 0 ) ? ulQuietMs / ulPollMs : ulQuietMs;
+	pxStorm->pxHandler = pxHandler;
+	pxStorm->pvContext = pvContext;
+
+	if( pxStorm->ulWindowLimit == 0 )
+	{
+		pxStorm->ulWindowLimit = 1;
+	}
+	if( pxStorm->ulQuietPolls == 0 )
+	{
+		pxStorm->ulQuietPolls = 1;
+	}
+
+	pxStorm->xPollTimer = xTimerCreate( "GpioStorm", ( xPollTicks != 0 ) ? xPollTicks : 1, pdTRUE,
+	                                    pxStorm, prvPoll );
+	if( pxStorm->xPollTimer == NULL )
+	{
+		vPortFree( pxStorm );
+		return NULL;
+	}
+
+	gpio_set_intr_type( xPin, xIntrType );
+	gpio_isr_handler_add( xPin, prvStormIsr, pxStorm );
+	return pxStorm;
+}
+
+void vGpioStormGetStats( GpioStormHandle_t xStorm, GpioStormStats_t *pxStats )
+{
+	const GpioStormStats_t *pxSrc = &xStorm->xStats;
+
+	pxStats->ulInterrupts = __atomic_load_n( &pxSrc->ulInterrupts, __ATOMIC_RELAXED );
+	pxStats->ulStorms = __atomic_load_n( &pxSrc->ulStorms, __ATOMIC_RELAXED );
+	pxStats->ulPolls = __atomic_load_n( &pxSrc->ulPolls, __ATOMIC_RELAXED );
+	pxStats->ulPolledEdges = __atomic_load_n( &pxSrc->ulPolledEdges, __ATOMIC_RELAXED );
+	pxStats->ulStartFailed = __atomic_load_n( &pxSrc->ulStartFailed, __ATOMIC_RELAXED );
+	pxStats->ulPolling = __atomic_load_n( &pxSrc->ulPolling, __ATOMIC_RELAXED );
+}
+
+void vGpioStormPrint( GpioStormHandle_t xStorm, const char *pcName )
+{
+	GpioStormStats_t xStats;
+
+	vGpioStormGetStats( xStorm, &xStats );
+	printf("%s: %u interrupts, %u storms, %u polls, %u polled edges, %u start failures, %s\r\n",
+	       pcName, xStats.ulInterrupts, xStats.ulStorms, xStats.ulPolls, xStats.ulPolledEdges,
+	       xStats.ulStartFailed, xStats.ulPolling ? "polling" : "on interrupts");
+}
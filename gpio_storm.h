@@ -0,0 +1,70 @@
+/* GPIO interrupt storm protection
+
+   A noisy or floating line can interrupt thousands of times a second; each
+   interrupt runs the handler and wakes a task, and the core spends its time
+   there instead of in the tasks that matter. Like a network driver that
+   switches from interrupts to polling under load, the pin's ISR here counts
+   interrupts per GPIO_STORM_WINDOW_US. Once a window holds more than the
+   allowed rate, it masks the pin's interrupt and starts a software timer
+   that samples the pin every ulPollMs instead. Each matching edge the
+   sampling sees is passed to the same handler, so the work per second is
+   bounded by the poll rate. Once the level has held for ulQuietMs, the timer
+   stops and the interrupt is unmasked again.
+
+   gpio_install_isr_service( ESP_INTR_FLAG_DEFAULT );
+   xButtonStorm = xGpioStormCreate( BUTTON, GPIO_INTR_NEGEDGE, 200, 10, 500,
+                                    vButtonHandler, NULL );
+
+   static void vButtonHandler( void *pvContext, BaseType_t *pxHigherPriorityTaskWoken )
+   {
+       xIsrSignalGiveFromISR( xSignal, pxHigherPriorityTaskWoken );
+   }
+
+   The handler runs in the ISR while interrupts are on and in the timer
+   daemon while polling, so it must only use calls that are safe in both:
+   the FromISR ones, reporting wakes through pxHigherPriorityTaskWoken. The
+   module yields for it where that is allowed.
+
+   Polling only sees levels that last longer than a poll period, and sees
+   at most one edge per poll; edges shorter than that are lost while a storm
+   lasts, which is the point.
+*/
+#ifndef GPIO_STORM_H
+#define GPIO_STORM_H
+
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "driver/gpio.h"
+
+/* Rate measurement window. */
+#define GPIO_STORM_WINDOW_US        100000
+
+typedef void ( *GpioStormHandler_t )( void *pvContext, BaseType_t *pxHigherPriorityTaskWoken );
+
+typedef struct
+{
+	uint32_t ulInterrupts;      /* ISR runs */
+	uint32_t ulStorms;          /* times the interrupt was masked */
+	uint32_t ulPolls;           /* samples taken while masked */
+	uint32_t ulPolledEdges;     /* edges the samples found, handler calls included */
+	uint32_t ulStartFailed;     /* storms left unmasked: the timer queue was full */
+	uint32_t ulPolling;         /* 1 while masked */
+} GpioStormStats_t;
+
+typedef struct GpioStorm * GpioStormHandle_t;
+
+/* Sets the pin's interrupt type and adds the protecting ISR;
+   gpio_install_isr_service() must have been called. xIntrType must be an
+   edge type. Above ulMaxRateHz interrupts per second, averaged over
+   GPIO_STORM_WINDOW_US, the pin is polled every ulPollMs until its level
+   has held for ulQuietMs. Returns NULL if there is not enough heap. */
+GpioStormHandle_t xGpioStormCreate( gpio_num_t xPin, gpio_int_type_t xIntrType, uint32_t ulMaxRateHz,
+                                    uint32_t ulPollMs, uint32_t ulQuietMs,
+                                    GpioStormHandler_t pxHandler, void *pvContext );
+
+void vGpioStormGetStats( GpioStormHandle_t xStorm, GpioStormStats_t *pxStats );
+
+/* One line with the counters, prefixed by pcName. */
+void vGpioStormPrint( GpioStormHandle_t xStorm, const char *pcName );
+
+#endif /* GPIO_STORM_H */
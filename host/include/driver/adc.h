@@ -0,0 +1,109 @@
+/* Host stand-in for ESP-IDF's driver/adc.h.
+
+   Conversions return samples from the per-channel signal generator in
+   host/sim_adc.c, which defaults to a slow triangle sweep over the whole
+   input range and can be replaced with vSimAdcSetSignal() (see host/sim.h).
+   The digital controller's ADC1 pattern table is modelled by the I2S ADC
+   mode in host/sim_i2s.c, which converts the pattern's channels in turn.
+*/
+#ifndef DRIVER_ADC_H
+#define DRIVER_ADC_H
+
+#include "esp_types.h"
+
+typedef enum {
+    ADC_UNIT_1 = 1,
+    ADC_UNIT_2 = 2,
+    ADC_UNIT_BOTH = 3,
+    ADC_UNIT_ALTER = 7,
+    ADC_UNIT_MAX,
+} adc_unit_t;
+
+typedef enum {
+    ADC_CHANNEL_0 = 0, ADC_CHANNEL_1, ADC_CHANNEL_2, ADC_CHANNEL_3, ADC_CHANNEL_4,
+    ADC_CHANNEL_5, ADC_CHANNEL_6, ADC_CHANNEL_7, ADC_CHANNEL_8, ADC_CHANNEL_9,
+    ADC_CHANNEL_MAX,
+} adc_channel_t;
+
+typedef enum {
+    ADC_ATTEN_DB_0   = 0,
+    ADC_ATTEN_DB_2_5 = 1,
+    ADC_ATTEN_DB_6   = 2,
+    ADC_ATTEN_DB_11  = 3,
+    ADC_ATTEN_MAX,
+} adc_atten_t;
+
+typedef enum {
+    ADC_WIDTH_BIT_9  = 0,
+    ADC_WIDTH_BIT_10 = 1,
+    ADC_WIDTH_BIT_11 = 2,
+    ADC_WIDTH_BIT_12 = 3,
+    ADC_WIDTH_MAX,
+} adc_bits_width_t;
+
+typedef enum {
+    ADC1_CHANNEL_0 = 0, /*!< ADC1 channel 0 is GPIO36 */
+    ADC1_CHANNEL_1,     /*!< ADC1 channel 1 is GPIO37 */
+    ADC1_CHANNEL_2,     /*!< ADC1 channel 2 is GPIO38 */
+    ADC1_CHANNEL_3,     /*!< ADC1 channel 3 is GPIO39 */
+    ADC1_CHANNEL_4,     /*!< ADC1 channel 4 is GPIO32 */
+    ADC1_CHANNEL_5,     /*!< ADC1 channel 5 is GPIO33 */
+    ADC1_CHANNEL_6,     /*!< ADC1 channel 6 is GPIO34 */
+    ADC1_CHANNEL_7,     /*!< ADC1 channel 7 is GPIO35 */
+    ADC1_CHANNEL_MAX,
+} adc1_channel_t;
+
+typedef enum {
+    ADC2_CHANNEL_0 = 0, ADC2_CHANNEL_1, ADC2_CHANNEL_2, ADC2_CHANNEL_3, ADC2_CHANNEL_4,
+    ADC2_CHANNEL_5, ADC2_CHANNEL_6, ADC2_CHANNEL_7, ADC2_CHANNEL_8, ADC2_CHANNEL_9,
+    ADC2_CHANNEL_MAX,
+} adc2_channel_t;
+
+esp_err_t adc1_config_width(adc_bits_width_t width_bit);
+esp_err_t adc1_config_channel_atten(adc1_channel_t channel, adc_atten_t atten);
+int adc1_get_raw(adc1_channel_t channel);
+esp_err_t adc2_config_channel_atten(adc2_channel_t channel, adc_atten_t atten);
+esp_err_t adc2_get_raw(adc2_channel_t channel, adc_bits_width_t width_bit, int *raw_out);
+
+/* Digital controller (DMA through I2S0), ESP32 flavour. */
+typedef struct {
+    union {
+        struct {
+            uint8_t atten:     2;
+            uint8_t bit_width: 2;
+            uint8_t channel:   4;
+        };
+        uint8_t val;
+    };
+} adc_digi_pattern_table_t;
+
+typedef enum {
+    ADC_DIGI_FORMAT_12BIT,      /* channel in bits 15..12, data below */
+    ADC_DIGI_FORMAT_11BIT,
+    ADC_DIGI_FORMAT_MAX,
+} adc_digi_output_format_t;
+
+typedef enum {
+    ADC_CONV_SINGLE_UNIT_1 = 1,
+    ADC_CONV_SINGLE_UNIT_2 = 2,
+    ADC_CONV_BOTH_UNIT     = 3,
+    ADC_CONV_ALTER_UNIT    = 7,
+    ADC_CONV_UNIT_MAX,
+} adc_digi_convert_mode_t;
+
+typedef struct {
+    bool conv_limit_en;
+    uint32_t conv_limit_num;
+    uint32_t adc1_pattern_len;          /* up to 16 */
+    uint32_t adc2_pattern_len;
+    adc_digi_pattern_table_t *adc1_pattern;
+    adc_digi_pattern_table_t *adc2_pattern;
+    adc_digi_convert_mode_t conv_mode;
+    adc_digi_output_format_t format;
+} adc_digi_config_t;
+
+esp_err_t adc_digi_init(void);
+esp_err_t adc_digi_deinit(void);
+esp_err_t adc_digi_controller_config(const adc_digi_config_t *config);
+
+#endif /* DRIVER_ADC_H */
@@ -0,0 +1,99 @@
+/* Host stand-in for ESP-IDF's driver/i2s.h.
+
+   Only the receive path of the built-in ADC mode is modelled: once
+   i2s_adc_enable() is called, the simulated DMA engine in host/sim_i2s.c
+   fills dma_buf_count buffers of dma_buf_len 16-bit samples in turn at
+   sample_rate, from the ADC1 signal generator (see host/sim.h). Like the
+   driver, a completed buffer is queued for i2s_read() and, when the queue
+   (dma_buf_count - 1 deep) is full, the oldest one is dropped and
+   I2S_EVENT_RX_Q_OVF posted. Each 16-bit sample holds the channel in bits
+   15..12 and the 12-bit code below, as the I2S ADC mode delivers it.
+   Samples follow the ADC1 pattern table: i2s_set_adc_mode() and
+   i2s_adc_enable() set it to the one channel, as the driver does, and
+   adc_digi_controller_config() afterwards replaces it (driver/adc.h). Only
+   I2S_NUM_0, 16-bit samples and a single channel format are modelled.
+   Buffers are completed by the interrupt dispatcher (host/sim_main.c), at
+   least once per tick.
+*/
+#ifndef DRIVER_I2S_H
+#define DRIVER_I2S_H
+
+#include "esp_types.h"
+#include "driver/adc.h"
+
+typedef enum {
+    I2S_NUM_0 = 0,
+    I2S_NUM_1 = 1,
+    I2S_NUM_MAX,
+} i2s_port_t;
+
+typedef enum {
+    I2S_BITS_PER_SAMPLE_8BIT  = 8,
+    I2S_BITS_PER_SAMPLE_16BIT = 16,
+    I2S_BITS_PER_SAMPLE_24BIT = 24,
+    I2S_BITS_PER_SAMPLE_32BIT = 32,
+} i2s_bits_per_sample_t;
+
+typedef enum {
+    I2S_CHANNEL_FMT_RIGHT_LEFT = 0x00,
+    I2S_CHANNEL_FMT_ALL_RIGHT,
+    I2S_CHANNEL_FMT_ALL_LEFT,
+    I2S_CHANNEL_FMT_ONLY_RIGHT,
+    I2S_CHANNEL_FMT_ONLY_LEFT,
+} i2s_channel_fmt_t;
+
+typedef enum {
+    I2S_COMM_FORMAT_I2S       = 0x01,
+    I2S_COMM_FORMAT_I2S_MSB   = 0x02,
+    I2S_COMM_FORMAT_I2S_LSB   = 0x04,
+    I2S_COMM_FORMAT_PCM       = 0x08,
+} i2s_comm_format_t;
+
+typedef enum {
+    I2S_MODE_MASTER       = 1,
+    I2S_MODE_SLAVE        = 2,
+    I2S_MODE_TX           = 4,
+    I2S_MODE_RX           = 8,
+    I2S_MODE_DAC_BUILT_IN = 16,
+    I2S_MODE_ADC_BUILT_IN = 32,
+    I2S_MODE_PDM          = 64,
+} i2s_mode_t;
+
+typedef struct {
+    i2s_mode_t            mode;
+    int                   sample_rate;
+    i2s_bits_per_sample_t bits_per_sample;
+    i2s_channel_fmt_t     channel_format;
+    i2s_comm_format_t     communication_format;
+    int                   intr_alloc_flags;
+    int                   dma_buf_count;
+    int                   dma_buf_len;
+    bool                  use_apll;
+    bool                  tx_desc_auto_clear;
+    int                   fixed_mclk;
+} i2s_config_t;
+
+typedef enum {
+    I2S_EVENT_DMA_ERROR = 0,
+    I2S_EVENT_TX_DONE,
+    I2S_EVENT_RX_DONE,
+    I2S_EVENT_TX_Q_OVF,
+    I2S_EVENT_RX_Q_OVF,
+    I2S_EVENT_MAX,
+} i2s_event_type_t;
+
+typedef struct {
+    i2s_event_type_t type;
+    size_t           size;
+} i2s_event_t;
+
+/* i2s_queue is a QueueHandle_t *; a queue of queue_size i2s_event_t is
+   created in it when both are non-zero. */
+esp_err_t i2s_driver_install(i2s_port_t i2s_num, const i2s_config_t *i2s_config, int queue_size, void *i2s_queue);
+esp_err_t i2s_driver_uninstall(i2s_port_t i2s_num);
+esp_err_t i2s_set_adc_mode(adc_unit_t adc_unit, adc1_channel_t adc_channel);
+esp_err_t i2s_adc_enable(i2s_port_t i2s_num);
+esp_err_t i2s_adc_disable(i2s_port_t i2s_num);
+esp_err_t i2s_read(i2s_port_t i2s_num, void *dest, size_t size, size_t *bytes_read, TickType_t ticks_to_wait);
+
+#endif /* DRIVER_I2S_H */
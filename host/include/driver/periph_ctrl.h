@@ -0,0 +1,8 @@
+/* Host stand-in for driver/periph_ctrl.h: peripheral clocks are always on
+   in the simulation. */
+#ifndef DRIVER_PERIPH_CTRL_H
+#define DRIVER_PERIPH_CTRL_H
+
+#include "esp_types.h"
+
+#endif
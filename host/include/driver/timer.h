@@ -0,0 +1,94 @@
+/* Host stand-in for ESP-IDF's driver/timer.h (timer group API).
+
+   Counters are derived from the host monotonic clock scaled by
+   TIMER_BASE_CLK / divider, so counter values and alarm periods match the
+   board. Alarms are checked by the simulated interrupt dispatcher, which
+   calls the handler registered with timer_isr_register() when they fire.
+*/
+#ifndef DRIVER_TIMER_H
+#define DRIVER_TIMER_H
+
+#include "esp_types.h"
+
+#define APB_CLK_FREQ        ( 80 * 1000000 )
+#define TIMER_BASE_CLK      ( APB_CLK_FREQ )
+
+typedef enum {
+    TIMER_GROUP_0 = 0,
+    TIMER_GROUP_1 = 1,
+    TIMER_GROUP_MAX,
+} timer_group_t;
+
+typedef enum {
+    TIMER_0 = 0,
+    TIMER_1 = 1,
+    TIMER_MAX,
+} timer_idx_t;
+
+typedef enum {
+    TIMER_COUNT_DOWN = 0,
+    TIMER_COUNT_UP = 1,
+    TIMER_COUNT_MAX
+} timer_count_dir_t;
+
+typedef enum {
+    TIMER_PAUSE = 0,
+    TIMER_START = 1,
+} timer_start_t;
+
+typedef enum {
+    TIMER_INTR_T0 = ( 1 << 0 ),
+    TIMER_INTR_T1 = ( 1 << 1 ),
+    TIMER_INTR_WDT = ( 1 << 2 ),
+} timer_intr_t;
+
+typedef enum {
+    TIMER_ALARM_DIS = 0,
+    TIMER_ALARM_EN = 1,
+    TIMER_ALARM_MAX
+} timer_alarm_t;
+
+typedef enum {
+    TIMER_INTR_LEVEL = 0,
+    TIMER_INTR_MAX
+} timer_intr_mode_t;
+
+typedef enum {
+    TIMER_AUTORELOAD_DIS = 0,
+    TIMER_AUTORELOAD_EN = 1,
+    TIMER_AUTORELOAD_MAX,
+} timer_autoreload_t;
+
+typedef struct {
+    timer_alarm_t alarm_en;
+    timer_start_t counter_en;
+    timer_intr_mode_t intr_type;
+    timer_count_dir_t counter_dir;
+    timer_autoreload_t auto_reload;
+    uint32_t divider;
+} timer_config_t;
+
+typedef void *timer_isr_handle_t;
+
+esp_err_t timer_init(timer_group_t group_num, timer_idx_t timer_num, const timer_config_t *config);
+esp_err_t timer_get_counter_value(timer_group_t group_num, timer_idx_t timer_num, uint64_t *timer_val);
+esp_err_t timer_get_counter_time_sec(timer_group_t group_num, timer_idx_t timer_num, double *time);
+esp_err_t timer_set_counter_value(timer_group_t group_num, timer_idx_t timer_num, uint64_t load_val);
+esp_err_t timer_start(timer_group_t group_num, timer_idx_t timer_num);
+esp_err_t timer_pause(timer_group_t group_num, timer_idx_t timer_num);
+esp_err_t timer_set_alarm_value(timer_group_t group_num, timer_idx_t timer_num, uint64_t alarm_value);
+esp_err_t timer_get_alarm_value(timer_group_t group_num, timer_idx_t timer_num, uint64_t *alarm_value);
+esp_err_t timer_set_alarm(timer_group_t group_num, timer_idx_t timer_num, timer_alarm_t alarm_en);
+esp_err_t timer_set_auto_reload(timer_group_t group_num, timer_idx_t timer_num, timer_autoreload_t reload);
+esp_err_t timer_enable_intr(timer_group_t group_num, timer_idx_t timer_num);
+esp_err_t timer_disable_intr(timer_group_t group_num, timer_idx_t timer_num);
+esp_err_t timer_isr_register(timer_group_t group_num, timer_idx_t timer_num, void (*fn)(void *),
+                             void *arg, int intr_alloc_flags, timer_isr_handle_t *handle);
+
+timer_intr_t timer_group_intr_get_in_isr(timer_group_t group_num);
+void timer_group_intr_clr_in_isr(timer_group_t group_num, timer_idx_t timer_num);
+void timer_group_enable_alarm_in_isr(timer_group_t group_num, timer_idx_t timer_num);
+uint64_t timer_group_get_counter_value_in_isr(timer_group_t group_num, timer_idx_t timer_num);
+void timer_group_set_alarm_value_in_isr(timer_group_t group_num, timer_idx_t timer_num, uint64_t alarm_val);
+
+#endif /* DRIVER_TIMER_H */
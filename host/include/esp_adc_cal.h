@@ -0,0 +1,38 @@
+/* Host stand-in for ESP-IDF's esp_adc_cal.h.
+
+   The simulated ADC is ideal, so characterization yields a straight line
+   through the origin scaled to the attenuation's full-scale voltage. The
+   conversion uses the same fixed-point formula as the real library.
+*/
+#ifndef ESP_ADC_CAL_H
+#define ESP_ADC_CAL_H
+
+#include "esp_types.h"
+#include "driver/adc.h"
+
+typedef enum {
+    ESP_ADC_CAL_VAL_EFUSE_VREF = 0,
+    ESP_ADC_CAL_VAL_EFUSE_TP = 1,
+    ESP_ADC_CAL_VAL_DEFAULT_VREF = 2,
+    ESP_ADC_CAL_VAL_MAX,
+} esp_adc_cal_value_t;
+
+typedef struct {
+    adc_unit_t adc_num;
+    adc_atten_t atten;
+    adc_bits_width_t bit_width;
+    uint32_t coeff_a;
+    uint32_t coeff_b;
+    uint32_t vref;
+    const uint32_t *low_curve;
+    const uint32_t *high_curve;
+} esp_adc_cal_characteristics_t;
+
+esp_adc_cal_value_t esp_adc_cal_characterize(adc_unit_t adc_num, adc_atten_t atten,
+                                             adc_bits_width_t bit_width, uint32_t default_vref,
+                                             esp_adc_cal_characteristics_t *chars);
+uint32_t esp_adc_cal_raw_to_voltage(uint32_t adc_reading, const esp_adc_cal_characteristics_t *chars);
+esp_err_t esp_adc_cal_get_voltage(adc_channel_t channel, const esp_adc_cal_characteristics_t *chars,
+                                  uint32_t *voltage);
+
+#endif /* ESP_ADC_CAL_H */
@@ -0,0 +1,10 @@
+/* Host stand-in for esp_attr.h: memory placement attributes have no meaning
+   in a Linux process. */
+#ifndef ESP_ATTR_H
+#define ESP_ATTR_H
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define RTC_DATA_ATTR
+
+#endif
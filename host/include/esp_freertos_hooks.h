@@ -0,0 +1,14 @@
+/* Host stand-in for ESP-IDF's esp_freertos_hooks.h. Only tick hooks are
+   provided; they are called from the kernel tick hook, see host/sim_main.c. */
+#ifndef ESP_FREERTOS_HOOKS_H
+#define ESP_FREERTOS_HOOKS_H
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+typedef void ( *esp_freertos_tick_cb_t )( void );
+
+esp_err_t esp_register_freertos_tick_hook_for_cpu( esp_freertos_tick_cb_t new_tick_cb, UBaseType_t cpuid );
+esp_err_t esp_register_freertos_tick_hook( esp_freertos_tick_cb_t new_tick_cb );
+
+#endif
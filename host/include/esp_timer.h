@@ -0,0 +1,10 @@
+/* Host stand-in for ESP-IDF's esp_timer.h. Only the microsecond time base is
+   provided; it reads the same clock that drives the simulated peripherals. */
+#ifndef ESP_TIMER_H
+#define ESP_TIMER_H
+
+#include "esp_types.h"
+
+int64_t esp_timer_get_time(void);
+
+#endif
@@ -0,0 +1,12 @@
+/* Host stand-in for esp_types.h */
+#ifndef ESP_TYPES_H
+#define ESP_TYPES_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include "esp_err.h"
+#include "esp_attr.h"
+
+#endif
@@ -0,0 +1,42 @@
+/* Host stand-in for ESP-IDF's freertos/FreeRTOS.h.
+
+   ESP-IDF ships FreeRTOS under a "freertos/" include prefix and extends the
+   port layer with spinlock-taking critical sections, core affinity and a
+   zero-argument portYIELD_FROM_ISR(). This header pulls in the upstream
+   kernel built with the POSIX port and maps those extensions onto it, so the
+   examples compile unchanged. Simulated ISRs run to completion inside the
+   interrupt dispatcher task (see host/sim_main.c), which is why the ISR
+   variants of the critical section macros can simply nest the task ones.
+*/
+#ifndef HOST_FREERTOS_FREERTOS_H
+#define HOST_FREERTOS_FREERTOS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "esp_attr.h"
+#include "esp_err.h"
+#include <FreeRTOS.h>
+
+typedef int portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED    0
+#define portNUM_PROCESSORS              1
+
+#undef portENTER_CRITICAL
+#undef portEXIT_CRITICAL
+/* One core, so the spinlock itself is not needed; it is still evaluated so
+   the locks don't look unused. */
+#define portENTER_CRITICAL( pxMux )     do { ( void ) ( pxMux ); vPortEnterCritical(); } while( 0 )
+#define portEXIT_CRITICAL( pxMux )      do { ( void ) ( pxMux ); vPortExitCritical(); } while( 0 )
+#define portENTER_CRITICAL_ISR( pxMux ) do { ( void ) ( pxMux ); vPortEnterCritical(); } while( 0 )
+#define portEXIT_CRITICAL_ISR( pxMux )  do { ( void ) ( pxMux ); vPortExitCritical(); } while( 0 )
+
+#undef portYIELD_FROM_ISR
+#define portYIELD_FROM_ISR( ... )       vPortYield()
+
+#define xPortGetCoreID()                ( ( BaseType_t ) 0 )
+#define xPortInIsrContext()             xSimInIsrContext()
+
+BaseType_t xSimInIsrContext( void );
+
+#endif /* HOST_FREERTOS_FREERTOS_H */
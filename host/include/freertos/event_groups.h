@@ -0,0 +1,8 @@
+/* Host stand-in for ESP-IDF's freertos/event_groups.h. See freertos/FreeRTOS.h. */
+#ifndef HOST_FREERTOS_EVENT_GROUPS_H
+#define HOST_FREERTOS_EVENT_GROUPS_H
+
+#include "freertos/task.h"
+#include <event_groups.h>
+
+#endif
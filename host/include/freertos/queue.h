@@ -0,0 +1,8 @@
+/* Host stand-in for ESP-IDF's freertos/queue.h. See freertos/FreeRTOS.h. */
+#ifndef HOST_FREERTOS_QUEUE_H
+#define HOST_FREERTOS_QUEUE_H
+
+#include "freertos/task.h"
+#include <queue.h>
+
+#endif
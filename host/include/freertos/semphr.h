@@ -0,0 +1,8 @@
+/* Host stand-in for ESP-IDF's freertos/semphr.h. See freertos/FreeRTOS.h. */
+#ifndef HOST_FREERTOS_SEMPHR_H
+#define HOST_FREERTOS_SEMPHR_H
+
+#include "freertos/task.h"
+#include <semphr.h>
+
+#endif
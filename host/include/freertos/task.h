@@ -0,0 +1,30 @@
+/* Host stand-in for ESP-IDF's freertos/task.h. See freertos/FreeRTOS.h. */
+#ifndef HOST_FREERTOS_TASK_H
+#define HOST_FREERTOS_TASK_H
+
+#include "freertos/FreeRTOS.h"
+#include <task.h>
+
+/* ESP-IDF critical sections take the spinlock to hold. */
+#undef taskENTER_CRITICAL
+#undef taskEXIT_CRITICAL
+#define taskENTER_CRITICAL( pxMux )     portENTER_CRITICAL( pxMux )
+#define taskEXIT_CRITICAL( pxMux )      portEXIT_CRITICAL( pxMux )
+#define taskENTER_CRITICAL_ISR( pxMux ) portENTER_CRITICAL_ISR( pxMux )
+#define taskEXIT_CRITICAL_ISR( pxMux )  portEXIT_CRITICAL_ISR( pxMux )
+
+/* ESP-IDF stack depths are given in bytes while the POSIX port counts
+   StackType_t words backing a pthread stack, which also has to clear
+   PTHREAD_STACK_MIN. Pad every request so the examples' sizes work as-is. */
+#define SIM_STACK_EXTRA_WORDS           ( configMINIMAL_STACK_SIZE )
+
+#define xTaskCreate( pxTaskCode, pcName, usStackDepth, pvParameters, uxPriority, pxCreatedTask ) \
+	xTaskCreate( ( pxTaskCode ), ( pcName ), ( usStackDepth ) + SIM_STACK_EXTRA_WORDS,        \
+	             ( pvParameters ), ( uxPriority ), ( pxCreatedTask ) )
+
+#define xTaskCreatePinnedToCore( pxTaskCode, pcName, usStackDepth, pvParameters, uxPriority, pxCreatedTask, xCoreID ) \
+	xTaskCreate( ( pxTaskCode ), ( pcName ), ( usStackDepth ), ( pvParameters ), ( uxPriority ), ( pxCreatedTask ) )
+
+#define tskNO_AFFINITY                  ( 0x7FFFFFFF )
+
+#endif /* HOST_FREERTOS_TASK_H */
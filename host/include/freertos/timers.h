@@ -0,0 +1,8 @@
+/* Host stand-in for ESP-IDF's freertos/timers.h. See freertos/FreeRTOS.h. */
+#ifndef HOST_FREERTOS_TIMERS_H
+#define HOST_FREERTOS_TIMERS_H
+
+#include "freertos/task.h"
+#include <timers.h>
+
+#endif
@@ -0,0 +1,10 @@
+/* Host stand-in for the sdkconfig.h generated by menuconfig.
+   Only the options the examples depend on are defined. */
+#ifndef SDKCONFIG_H
+#define SDKCONFIG_H
+
+#define CONFIG_FREERTOS_HZ            100
+#define CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ 240
+#define CONFIG_FREERTOS_UNICORE       1
+
+#endif
@@ -0,0 +1,20 @@
+/* Host stand-in for ESP-IDF's soc/cpu.h. Only the cycle counter is
+   provided: the host monotonic clock scaled to the configured CPU
+   frequency, wrapping at 32 bits like CCOUNT. */
+#ifndef SOC_CPU_H
+#define SOC_CPU_H
+
+#include <stdint.h>
+#include <time.h>
+#include "sdkconfig.h"
+
+static inline uint32_t esp_cpu_get_ccount( void )
+{
+	struct timespec xNow;
+
+	clock_gettime( CLOCK_MONOTONIC, &xNow );
+	return ( uint32_t ) ( ( ( uint64_t ) xNow.tv_sec * 1000000000ULL + xNow.tv_nsec ) *
+	                      CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ / 1000 );
+}
+
+#endif
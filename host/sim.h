@@ -0,0 +1,53 @@
+/* Control interface of the host simulation.
+
+   The simulation replaces the ESP32 peripherals the examples use (GPIO, ADC1/2
+   with calibration, the I2S built-in ADC mode, timer group 0/1) with models driven by the Linux
+   monotonic clock, and runs their interrupt handlers from a dispatcher task
+   at the highest FreeRTOS priority. A handler therefore runs to completion
+   before any task, exactly like an ISR, and tasks it wakes run as soon as it
+   returns.
+
+   Environment variables read at start-up:
+
+   SIM_RUN_SECONDS    - exit(0) after this many seconds (default: run forever)
+   SIM_GPIO_STIMULUS  - "pin:period_ms[,pin:period_ms...]", pulls each listed
+                        input low for half of every period, like a button
+                        being pressed periodically
+*/
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "driver/gpio.h"
+#include "driver/adc.h"
+
+/* Signal generator for one ADC channel. Returns the 12-bit code the channel
+   reads at time ullMicros. */
+typedef uint32_t ( *SimAdcSignal_t )( adc_unit_t xUnit, int lChannel, uint64_t ullMicros, void *pvContext );
+
+uint64_t ullSimMicros( void );
+
+/* Drives an input pin from task context (test code, load generators). The
+   matching edge interrupt, if any, is delivered before this returns to the
+   caller's next blocking call. */
+void vSimGpioDrive( gpio_num_t xPin, uint32_t ulLevel );
+
+void vSimAdcSetSignal( adc_unit_t xUnit, int lChannel, SimAdcSignal_t pxSignal, void *pvContext );
+
+/* The 12-bit code the channel reads at time ullMicros. */
+uint32_t ulSimAdcSample( adc_unit_t xUnit, int lChannel, uint64_t ullMicros );
+
+/* Wakes the interrupt dispatcher so pending simulated interrupts are serviced
+   immediately instead of on the next tick. */
+void vSimRaiseInterrupt( void );
+
+/* Used by the peripheral models. */
+void vSimGpioInit( void );
+void vSimGpioService( uint64_t ullNow );
+void vSimTimerService( uint64_t ullNow );
+void vSimI2sService( uint64_t ullNow );
+void vSimEnterIsr( void );
+void vSimExitIsr( void );
+
+#endif /* SIM_H */
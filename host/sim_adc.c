@@ -0,0 +1,152 @@
+/* ADC model and calibration library for the host simulation (see sim.h) */
+
+#include <stdio.h>
+#include "freertos/FreeRTOS.h"
+#include "driver/adc.h"
+#include "esp_adc_cal.h"
+#include "sim.h"
+
+#define SIM_ADC_MAX_CODE       4095
+#define SIM_ADC_SWEEP_US       ( 20ULL * 1000000ULL )
+#define SIM_ADC_NOISE_CODES    8
+
+typedef struct {
+    SimAdcSignal_t signal;
+    void          *context;
+} SimAdcChannel_t;
+
+static SimAdcChannel_t   xAdc1[ ADC1_CHANNEL_MAX ];
+static SimAdcChannel_t   xAdc2[ ADC2_CHANNEL_MAX ];
+static adc_bits_width_t  xAdc1Width = ADC_WIDTH_BIT_12;
+static uint32_t          ulNoiseState = 0x12345678;
+
+/* Full-scale input voltage (mV) for each attenuation at the nominal 1100mV
+   reference, as documented for the ESP32. */
+static const uint32_t ulFullScaleMv[ ADC_ATTEN_MAX ] = { 1100, 1500, 2200, 3900 };
+
+/**************************************************************************/
+
+/* Triangle sweep across the full range, offset per channel, with a little
+   noise so averaging and filtering have something to do. */
+static uint32_t prvDefaultSignal( adc_unit_t xUnit, int lChannel, uint64_t ullMicros, void *pvContext )
+{
+    uint64_t ullPhase = ( ullMicros + ( uint64_t ) lChannel * SIM_ADC_SWEEP_US / 8 ) % SIM_ADC_SWEEP_US;
+    int32_t lCode;
+
+    if( ullPhase < SIM_ADC_SWEEP_US / 2 ) {
+        lCode = ( int32_t ) ( ullPhase * 2 * SIM_ADC_MAX_CODE / SIM_ADC_SWEEP_US );
+    } else {
+        lCode = ( int32_t ) ( ( SIM_ADC_SWEEP_US - ullPhase ) * 2 * SIM_ADC_MAX_CODE / SIM_ADC_SWEEP_US );
+    }
+
+    ulNoiseState = ulNoiseState * 1664525UL + 1013904223UL;
+    lCode += ( int32_t ) ( ulNoiseState >> 24 ) % ( 2 * SIM_ADC_NOISE_CODES + 1 ) - SIM_ADC_NOISE_CODES;
+
+    if( lCode < 0 ) lCode = 0;
+    if( lCode > SIM_ADC_MAX_CODE ) lCode = SIM_ADC_MAX_CODE;
+    return ( uint32_t ) lCode;
+}
+
+uint32_t ulSimAdcSample( adc_unit_t xUnit, int lChannel, uint64_t ullMicros )
+{
+    SimAdcChannel_t *pxChannel = ( xUnit == ADC_UNIT_1 ) ? &xAdc1[ lChannel ] : &xAdc2[ lChannel ];
+    SimAdcSignal_t pxSignal = ( pxChannel->signal != NULL ) ? pxChannel->signal : prvDefaultSignal;
+    uint32_t ulCode = pxSignal( xUnit, lChannel, ullMicros, pxChannel->context );
+
+    return ( ulCode > SIM_ADC_MAX_CODE ) ? SIM_ADC_MAX_CODE : ulCode;
+}
+
+static int prvSample( adc_unit_t xUnit, int lChannel, adc_bits_width_t xWidth )
+{
+    /* The generator works in 12-bit codes; narrower widths drop LSBs. */
+    return ( int ) ( ulSimAdcSample( xUnit, lChannel, ullSimMicros() ) >> ( ADC_WIDTH_BIT_12 - xWidth ) );
+}
+
+/**************************************************************************/
+
+void vSimAdcSetSignal( adc_unit_t xUnit, int lChannel, SimAdcSignal_t pxSignal, void *pvContext )
+{
+    if( xUnit == ADC_UNIT_1 && lChannel >= 0 && lChannel < ADC1_CHANNEL_MAX ) {
+        xAdc1[ lChannel ].signal = pxSignal;
+        xAdc1[ lChannel ].context = pvContext;
+    } else if( xUnit == ADC_UNIT_2 && lChannel >= 0 && lChannel < ADC2_CHANNEL_MAX ) {
+        xAdc2[ lChannel ].signal = pxSignal;
+        xAdc2[ lChannel ].context = pvContext;
+    }
+}
+
+/**************************************************************************/
+
+esp_err_t adc1_config_width(adc_bits_width_t width_bit)
+{
+    if (width_bit >= ADC_WIDTH_MAX) return ESP_ERR_INVALID_ARG;
+    xAdc1Width = width_bit;
+    return ESP_OK;
+}
+
+esp_err_t adc1_config_channel_atten(adc1_channel_t channel, adc_atten_t atten)
+{
+    if (channel >= ADC1_CHANNEL_MAX || atten >= ADC_ATTEN_MAX) return ESP_ERR_INVALID_ARG;
+    return ESP_OK;
+}
+
+int adc1_get_raw(adc1_channel_t channel)
+{
+    if (channel >= ADC1_CHANNEL_MAX) return -1;
+    return prvSample(ADC_UNIT_1, channel, xAdc1Width);
+}
+
+esp_err_t adc2_config_channel_atten(adc2_channel_t channel, adc_atten_t atten)
+{
+    if (channel >= ADC2_CHANNEL_MAX || atten >= ADC_ATTEN_MAX) return ESP_ERR_INVALID_ARG;
+    return ESP_OK;
+}
+
+esp_err_t adc2_get_raw(adc2_channel_t channel, adc_bits_width_t width_bit, int *raw_out)
+{
+    if (channel >= ADC2_CHANNEL_MAX || width_bit >= ADC_WIDTH_MAX) return ESP_ERR_INVALID_ARG;
+    *raw_out = prvSample(ADC_UNIT_2, channel, width_bit);
+    return ESP_OK;
+}
+
+/**************************************************************************/
+
+esp_adc_cal_value_t esp_adc_cal_characterize(adc_unit_t adc_num, adc_atten_t atten,
+                                             adc_bits_width_t bit_width, uint32_t default_vref,
+                                             esp_adc_cal_characteristics_t *chars)
+{
+    uint32_t full_scale = ulFullScaleMv[atten] * default_vref / 1100;
+    uint32_t max_code = (1U << (9 + bit_width)) - 1;
+
+    chars->adc_num = adc_num;
+    chars->atten = atten;
+    chars->bit_width = bit_width;
+    chars->vref = default_vref;
+    chars->coeff_a = (uint32_t) (((uint64_t) full_scale << 16) / max_code);
+    chars->coeff_b = 0;
+    chars->low_curve = NULL;
+    chars->high_curve = NULL;
+
+    return ESP_ADC_CAL_VAL_DEFAULT_VREF;
+}
+
+uint32_t esp_adc_cal_raw_to_voltage(uint32_t adc_reading, const esp_adc_cal_characteristics_t *chars)
+{
+    /* Same rounding as the ESP-IDF implementation. */
+    return (((chars->coeff_a * adc_reading) + (1 << 15)) >> 16) + chars->coeff_b;
+}
+
+esp_err_t esp_adc_cal_get_voltage(adc_channel_t channel, const esp_adc_cal_characteristics_t *chars,
+                                  uint32_t *voltage)
+{
+    int raw;
+
+    if (chars->adc_num == ADC_UNIT_1) {
+        raw = adc1_get_raw((adc1_channel_t) channel);
+    } else if (adc2_get_raw((adc2_channel_t) channel, chars->bit_width, &raw) != ESP_OK) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    *voltage = esp_adc_cal_raw_to_voltage((uint32_t) raw, chars);
+    return ESP_OK;
+}
@@ -0,0 +1,235 @@
+/* GPIO model for the host simulation (see sim.h) */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/gpio.h"
+#include "sim.h"
+
+#define SIM_GPIO_MAX_STIMULI   8
+
+typedef struct {
+    gpio_mode_t     mode;
+    gpio_int_type_t intr_type;
+    bool            intr_enabled;
+    uint32_t        level;
+    gpio_isr_t      handler;
+    void           *args;
+} SimGpioPin_t;
+
+typedef struct {
+    gpio_num_t pin;
+    uint64_t   half_period_us;
+    uint64_t   next_toggle_us;
+} SimGpioStimulus_t;
+
+static SimGpioPin_t      xPins[ GPIO_PIN_COUNT ];
+static SimGpioStimulus_t xStimuli[ SIM_GPIO_MAX_STIMULI ];
+static int               lStimulusCount = 0;
+static bool              isrServiceInstalled = false;
+static uint64_t          ullPendingMask = 0;
+
+/**************************************************************************/
+
+static bool prvValidPin(gpio_num_t gpio_num)
+{
+    return (gpio_num >= 0) && (gpio_num < GPIO_PIN_COUNT);
+}
+
+/* Latches a new input level and records the interrupt it would raise. */
+static void prvSetInputLevel(gpio_num_t gpio_num, uint32_t level)
+{
+    SimGpioPin_t *pin = &xPins[gpio_num];
+    uint32_t old_level = pin->level;
+    bool edge = false;
+
+    pin->level = level ? 1 : 0;
+
+    switch (pin->intr_type) {
+        case GPIO_INTR_POSEDGE:  edge = (old_level == 0) && (pin->level == 1); break;
+        case GPIO_INTR_NEGEDGE:  edge = (old_level == 1) && (pin->level == 0); break;
+        case GPIO_INTR_ANYEDGE:  edge = (old_level != pin->level);             break;
+        default:                 break;
+    }
+
+    if (edge) {
+        __atomic_fetch_or(&ullPendingMask, 1ULL << gpio_num, __ATOMIC_RELEASE);
+    }
+}
+
+/**************************************************************************/
+
+void vSimGpioInit(void)
+{
+    const char *spec = getenv("SIM_GPIO_STIMULUS");
+
+    for (int i = 0; i < GPIO_PIN_COUNT; i++) {
+        xPins[i].mode = GPIO_MODE_DISABLE;
+        xPins[i].intr_type = GPIO_INTR_DISABLE;
+        xPins[i].intr_enabled = true;
+        xPins[i].level = 1;     /* inputs idle high, as with the buttons' pull-ups */
+        xPins[i].handler = NULL;
+        xPins[i].args = NULL;
+    }
+
+    while (spec != NULL && *spec != '\0' && lStimulusCount < SIM_GPIO_MAX_STIMULI) {
+        int pin;
+        unsigned period_ms;
+
+        if (sscanf(spec, "%d:%u", &pin, &period_ms) == 2 && prvValidPin(pin) && period_ms > 1) {
+            xStimuli[lStimulusCount].pin = pin;
+            xStimuli[lStimulusCount].half_period_us = (uint64_t) period_ms * 500ULL;
+            xStimuli[lStimulusCount].next_toggle_us = (uint64_t) period_ms * 500ULL;
+            lStimulusCount++;
+        }
+
+        spec = strchr(spec, ',');
+        if (spec != NULL) spec++;
+    }
+}
+
+void vSimGpioService(uint64_t ullNow)
+{
+    uint64_t pending;
+
+    for (int i = 0; i < lStimulusCount; i++) {
+        while (ullNow >= xStimuli[i].next_toggle_us) {
+            prvSetInputLevel(xStimuli[i].pin, !xPins[xStimuli[i].pin].level);
+            xStimuli[i].next_toggle_us += xStimuli[i].half_period_us;
+        }
+    }
+
+    pending = __atomic_exchange_n(&ullPendingMask, 0, __ATOMIC_ACQUIRE);
+
+    /* Level interrupts keep firing for as long as the level is held. */
+    for (int i = 0; i < GPIO_PIN_COUNT; i++) {
+        if ((xPins[i].intr_type == GPIO_INTR_LOW_LEVEL && xPins[i].level == 0) ||
+            (xPins[i].intr_type == GPIO_INTR_HIGH_LEVEL && xPins[i].level == 1)) {
+            pending |= 1ULL << i;
+        }
+    }
+
+    while (pending != 0) {
+        int i = __builtin_ctzll(pending);
+        pending &= pending - 1;
+
+        if (isrServiceInstalled && xPins[i].intr_enabled && xPins[i].handler != NULL) {
+            vSimEnterIsr();
+            xPins[i].handler(xPins[i].args);
+            vSimExitIsr();
+        }
+    }
+}
+
+void vSimGpioDrive(gpio_num_t xPin, uint32_t ulLevel)
+{
+    if (!prvValidPin(xPin)) return;
+
+    prvSetInputLevel(xPin, ulLevel);
+    vSimRaiseInterrupt();
+}
+
+/**************************************************************************/
+
+void gpio_pad_select_gpio(uint8_t gpio_num)
+{
+}
+
+esp_err_t gpio_config(const gpio_config_t *pGPIOConfig)
+{
+    for (int i = 0; i < GPIO_PIN_COUNT; i++) {
+        if (pGPIOConfig->pin_bit_mask & (1ULL << i)) {
+            gpio_set_direction(i, pGPIOConfig->mode);
+            gpio_set_intr_type(i, pGPIOConfig->intr_type);
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_direction(gpio_num_t gpio_num, gpio_mode_t mode)
+{
+    if (!prvValidPin(gpio_num)) return ESP_ERR_INVALID_ARG;
+    xPins[gpio_num].mode = mode;
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level)
+{
+    gpio_mode_t mode;
+
+    if (!prvValidPin(gpio_num)) return ESP_ERR_INVALID_ARG;
+
+    /* A pin that is both input and output reads back its own pad, so
+       writing it raises its edge interrupt, as on the chip. */
+    mode = xPins[gpio_num].mode;
+    if ((mode & GPIO_MODE_INPUT) && (mode & GPIO_MODE_OUTPUT)) {
+        vSimGpioDrive(gpio_num, level);
+    } else {
+        xPins[gpio_num].level = level ? 1 : 0;
+    }
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio_num)
+{
+    if (!prvValidPin(gpio_num)) return 0;
+    return (int) xPins[gpio_num].level;
+}
+
+esp_err_t gpio_set_pull_mode(gpio_num_t gpio_num, gpio_pull_mode_t pull)
+{
+    if (!prvValidPin(gpio_num)) return ESP_ERR_INVALID_ARG;
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_intr_type(gpio_num_t gpio_num, gpio_int_type_t intr_type)
+{
+    if (!prvValidPin(gpio_num)) return ESP_ERR_INVALID_ARG;
+    xPins[gpio_num].intr_type = intr_type;
+    return ESP_OK;
+}
+
+esp_err_t gpio_intr_enable(gpio_num_t gpio_num)
+{
+    if (!prvValidPin(gpio_num)) return ESP_ERR_INVALID_ARG;
+    xPins[gpio_num].intr_enabled = true;
+    return ESP_OK;
+}
+
+esp_err_t gpio_intr_disable(gpio_num_t gpio_num)
+{
+    if (!prvValidPin(gpio_num)) return ESP_ERR_INVALID_ARG;
+    xPins[gpio_num].intr_enabled = false;
+    return ESP_OK;
+}
+
+esp_err_t gpio_install_isr_service(int intr_alloc_flags)
+{
+    if (isrServiceInstalled) return ESP_ERR_INVALID_STATE;
+    isrServiceInstalled = true;
+    return ESP_OK;
+}
+
+void gpio_uninstall_isr_service(void)
+{
+    isrServiceInstalled = false;
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t gpio_num, gpio_isr_t isr_handler, void *args)
+{
+    if (!prvValidPin(gpio_num)) return ESP_ERR_INVALID_ARG;
+    if (!isrServiceInstalled) return ESP_ERR_INVALID_STATE;
+    xPins[gpio_num].handler = isr_handler;
+    xPins[gpio_num].args = args;
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_remove(gpio_num_t gpio_num)
+{
+    if (!prvValidPin(gpio_num)) return ESP_ERR_INVALID_ARG;
+    xPins[gpio_num].handler = NULL;
+    xPins[gpio_num].args = NULL;
+    return ESP_OK;
+}
@@ -0,0 +1,273 @@
+/* I2S built-in ADC model for the host simulation (see sim.h) */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "driver/i2s.h"
+#include "sim.h"
+
+#define SIM_I2S_MIN_BUF_COUNT    2
+#define SIM_I2S_MAX_BUF_COUNT    128
+#define SIM_I2S_MIN_BUF_LEN      8
+#define SIM_I2S_MAX_BUF_LEN      1024
+#define SIM_ADC_MAX_PATTERN      16
+
+typedef struct {
+    bool           installed;
+    volatile bool  adc_enabled;
+    uint32_t       rate;
+    int            buf_count;
+    int            buf_len;          /* samples per DMA buffer */
+    uint16_t     **bufs;
+    int            fill;             /* buffer the DMA writes next */
+    uint64_t       start_us;
+    uint64_t       done;             /* samples written since i2s_adc_enable() */
+    QueueHandle_t  rx_queue;         /* completed buffers */
+    QueueHandle_t  event_queue;      /* optional, i2s_event_t */
+    uint16_t      *curr_ptr;         /* buffer i2s_read() copies from */
+    size_t         rw_pos;           /* bytes of it already copied */
+} SimI2s_t;
+
+static SimI2s_t        xI2s[ I2S_NUM_MAX ];
+
+/* ADC1 pattern table of the digital controller, shared by the ports like
+   the hardware's. i2s_set_adc_mode() remembers its channel, which
+   i2s_adc_enable() loads as a one-entry pattern. */
+static adc1_channel_t  xAdcModeChannel = ADC1_CHANNEL_0;
+static uint8_t         ucPattern[ SIM_ADC_MAX_PATTERN ] = { ADC1_CHANNEL_0 };
+static uint32_t        ulPatternLen = 1;
+static uint32_t        ulPatternPos;
+
+/**************************************************************************/
+
+/* Sends to a queue from the simulated ISR, dropping the oldest item if it
+   is full, as the driver's ISR does. */
+static void prvSendDropOldest(QueueHandle_t q, const void *item)
+{
+    union { uint16_t *buf; i2s_event_t event; } dummy;
+
+    if (xQueueIsQueueFullFromISR(q)) {
+        xQueueReceiveFromISR(q, &dummy, NULL);
+    }
+    xQueueSendFromISR(q, item, NULL);
+}
+
+static void prvPostEvent(SimI2s_t *s, i2s_event_type_t type)
+{
+    i2s_event_t event = { type, s->buf_len * sizeof(uint16_t) };
+
+    if (s->event_queue != NULL) {
+        prvSendDropOldest(s->event_queue, &event);
+    }
+}
+
+/* Fills every buffer whose last sample is due by ullNow. Sample n is taken
+   at n / rate after i2s_adc_enable(), however late the dispatcher runs. */
+void vSimI2sService(uint64_t ullNow)
+{
+    for (int p = 0; p < I2S_NUM_MAX; p++) {
+        SimI2s_t *s = &xI2s[p];
+        uint64_t due;
+
+        if (!s->adc_enabled) continue;
+
+        due = (ullNow - s->start_us) * s->rate / 1000000ULL;
+        while (due - s->done >= (uint64_t) s->buf_len) {
+            uint16_t *buf = s->bufs[s->fill];
+
+            for (int i = 0; i < s->buf_len; i++) {
+                uint64_t at = s->start_us + (s->done + i) * 1000000ULL / s->rate;
+                uint8_t channel = ucPattern[ulPatternPos];
+
+                ulPatternPos = (ulPatternPos + 1 == ulPatternLen) ? 0 : ulPatternPos + 1;
+                buf[i] = (uint16_t) ((channel << 12) | ulSimAdcSample(ADC_UNIT_1, channel, at));
+            }
+            s->done += s->buf_len;
+            s->fill = (s->fill + 1) % s->buf_count;
+
+            vSimEnterIsr();
+            if (xQueueIsQueueFullFromISR(s->rx_queue)) {
+                prvPostEvent(s, I2S_EVENT_RX_Q_OVF);
+            }
+            prvSendDropOldest(s->rx_queue, &buf);
+            prvPostEvent(s, I2S_EVENT_RX_DONE);
+            vSimExitIsr();
+        }
+    }
+}
+
+/**************************************************************************/
+
+esp_err_t i2s_driver_install(i2s_port_t i2s_num, const i2s_config_t *i2s_config, int queue_size, void *i2s_queue)
+{
+    SimI2s_t *s;
+
+    if (i2s_num >= I2S_NUM_MAX || i2s_config == NULL) return ESP_ERR_INVALID_ARG;
+    if (xI2s[i2s_num].installed) return ESP_ERR_INVALID_STATE;
+
+    /* Only what the built-in ADC mode can do on the ESP32. */
+    if (i2s_num != I2S_NUM_0 ||
+        (i2s_config->mode & (I2S_MODE_MASTER | I2S_MODE_RX | I2S_MODE_ADC_BUILT_IN)) !=
+            (I2S_MODE_MASTER | I2S_MODE_RX | I2S_MODE_ADC_BUILT_IN) ||
+        i2s_config->bits_per_sample != I2S_BITS_PER_SAMPLE_16BIT ||
+        i2s_config->sample_rate <= 0 ||
+        i2s_config->dma_buf_count < SIM_I2S_MIN_BUF_COUNT || i2s_config->dma_buf_count > SIM_I2S_MAX_BUF_COUNT ||
+        i2s_config->dma_buf_len < SIM_I2S_MIN_BUF_LEN || i2s_config->dma_buf_len > SIM_I2S_MAX_BUF_LEN) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    s = &xI2s[i2s_num];
+    memset(s, 0, sizeof(*s));
+    s->rate = (uint32_t) i2s_config->sample_rate;
+    s->buf_count = i2s_config->dma_buf_count;
+    s->buf_len = i2s_config->dma_buf_len;
+
+    s->bufs = calloc(s->buf_count, sizeof(uint16_t *));
+    if (s->bufs == NULL) return ESP_ERR_NO_MEM;
+    for (int i = 0; i < s->buf_count; i++) {
+        s->bufs[i] = calloc(s->buf_len, sizeof(uint16_t));
+        if (s->bufs[i] == NULL) goto no_mem;
+    }
+
+    /* One buffer is always being filled. */
+    s->rx_queue = xQueueCreate(s->buf_count - 1, sizeof(uint16_t *));
+    if (s->rx_queue == NULL) goto no_mem;
+
+    if (queue_size > 0 && i2s_queue != NULL) {
+        s->event_queue = xQueueCreate(queue_size, sizeof(i2s_event_t));
+        if (s->event_queue == NULL) goto no_mem;
+        *(QueueHandle_t *) i2s_queue = s->event_queue;
+    }
+
+    s->installed = true;
+    return ESP_OK;
+
+no_mem:
+    if (s->rx_queue != NULL) vQueueDelete(s->rx_queue);
+    for (int i = 0; i < s->buf_count; i++) free(s->bufs[i]);
+    free(s->bufs);
+    memset(s, 0, sizeof(*s));
+    return ESP_ERR_NO_MEM;
+}
+
+esp_err_t i2s_driver_uninstall(i2s_port_t i2s_num)
+{
+    SimI2s_t *s;
+
+    if (i2s_num >= I2S_NUM_MAX || !xI2s[i2s_num].installed) return ESP_ERR_INVALID_ARG;
+
+    s = &xI2s[i2s_num];
+    s->adc_enabled = false;
+    vQueueDelete(s->rx_queue);
+    if (s->event_queue != NULL) vQueueDelete(s->event_queue);
+    for (int i = 0; i < s->buf_count; i++) free(s->bufs[i]);
+    free(s->bufs);
+    memset(s, 0, sizeof(*s));
+    return ESP_OK;
+}
+
+esp_err_t i2s_set_adc_mode(adc_unit_t adc_unit, adc1_channel_t adc_channel)
+{
+    if (adc_unit != ADC_UNIT_1 || adc_channel >= ADC1_CHANNEL_MAX) return ESP_ERR_INVALID_ARG;
+    xAdcModeChannel = adc_channel;
+    return ESP_OK;
+}
+
+esp_err_t adc_digi_init(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t adc_digi_deinit(void)
+{
+    return ESP_OK;
+}
+
+/* Takes effect from the next conversion; the running stream is not
+   restarted. */
+esp_err_t adc_digi_controller_config(const adc_digi_config_t *config)
+{
+    uint8_t pattern[SIM_ADC_MAX_PATTERN];
+
+    if (config == NULL || config->conv_mode != ADC_CONV_SINGLE_UNIT_1 ||
+        config->format != ADC_DIGI_FORMAT_12BIT ||
+        config->adc1_pattern_len == 0 || config->adc1_pattern_len > SIM_ADC_MAX_PATTERN) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    for (uint32_t i = 0; i < config->adc1_pattern_len; i++) {
+        if (config->adc1_pattern[i].channel >= ADC1_CHANNEL_MAX) return ESP_ERR_INVALID_ARG;
+        pattern[i] = config->adc1_pattern[i].channel;
+    }
+
+    /* The dispatcher may be converting; park it on entry 0 first. */
+    ulPatternPos = 0;
+    ulPatternLen = 1;
+    memcpy(ucPattern, pattern, config->adc1_pattern_len);
+    ulPatternLen = config->adc1_pattern_len;
+    return ESP_OK;
+}
+
+/* The dispatcher preempts the caller, so the stream state is set up before
+   it is enabled and the stream disabled before it is touched. */
+esp_err_t i2s_adc_enable(i2s_port_t i2s_num)
+{
+    SimI2s_t *s;
+
+    if (i2s_num >= I2S_NUM_MAX || !xI2s[i2s_num].installed) return ESP_ERR_INVALID_STATE;
+
+    s = &xI2s[i2s_num];
+    s->adc_enabled = false;
+    xQueueReset(s->rx_queue);
+    s->curr_ptr = NULL;
+    s->rw_pos = 0;
+    s->fill = 0;
+    s->done = 0;
+    ucPattern[0] = xAdcModeChannel;
+    ulPatternLen = 1;
+    ulPatternPos = 0;
+    s->start_us = ullSimMicros();
+    s->adc_enabled = true;
+    return ESP_OK;
+}
+
+esp_err_t i2s_adc_disable(i2s_port_t i2s_num)
+{
+    if (i2s_num >= I2S_NUM_MAX || !xI2s[i2s_num].installed) return ESP_ERR_INVALID_STATE;
+
+    xI2s[i2s_num].adc_enabled = false;
+    return ESP_OK;
+}
+
+/* Same algorithm as the driver: copies from the current buffer, taking the
+   next one from the queue when it is used up. A timeout returns ESP_OK
+   with fewer bytes read. */
+esp_err_t i2s_read(i2s_port_t i2s_num, void *dest, size_t size, size_t *bytes_read, TickType_t ticks_to_wait)
+{
+    SimI2s_t *s;
+    char *out = dest;
+    size_t buf_size, n;
+
+    *bytes_read = 0;
+    if (i2s_num >= I2S_NUM_MAX || !xI2s[i2s_num].installed) return ESP_ERR_INVALID_ARG;
+
+    s = &xI2s[i2s_num];
+    buf_size = s->buf_len * sizeof(uint16_t);
+    while (size > 0) {
+        if (s->curr_ptr == NULL || s->rw_pos == buf_size) {
+            if (xQueueReceive(s->rx_queue, &s->curr_ptr, ticks_to_wait) == pdFALSE) break;
+            s->rw_pos = 0;
+        }
+
+        n = buf_size - s->rw_pos;
+        if (n > size) n = size;
+        memcpy(out, (const char *) s->curr_ptr + s->rw_pos, n);
+        s->rw_pos += n;
+        out += n;
+        size -= n;
+        *bytes_read += n;
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,189 @@
+/* Host simulation entry point
+
+   Runs any test_bench_main_*.c file as a Linux process on top of the
+   FreeRTOS POSIX port, with the ESP-IDF drivers it uses replaced by the
+   models in this directory (see sim.h).
+
+   The top-level CMakeLists.txt builds one binary per test_bench_main file
+   (FREERTOS_KERNEL points at a FreeRTOS-Kernel checkout; without it the
+   kernel is fetched):
+
+     cmake -S . -B build -DFREERTOS_KERNEL=$FREERTOS_KERNEL
+     cmake --build build -j
+     ctest --test-dir build -L smoke
+
+   Run one, e.g. with a button press on GPIO18 every 300 ms for 10 s:
+
+     SIM_GPIO_STIMULUS=18:300 SIM_RUN_SECONDS=10 build/example12
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "esp_freertos_hooks.h"
+#include "sim.h"
+
+/* ESP-IDF creates the main task at priority 1 with a 3.5KB stack. */
+#define SIM_MAIN_TASK_PRIORITY    1
+#define SIM_MAIN_TASK_STACK       3584
+#define SIM_INTR_TASK_STACK       4096
+
+/* ESP-IDF allows this many tick hooks per core. */
+#define SIM_MAX_TICK_HOOKS        8
+
+void app_main(void);
+
+static TaskHandle_t       xSimIntrTask = NULL;
+static volatile BaseType_t xSimInIsr   = pdFALSE;
+static uint64_t           ullSimStartMicros;
+static uint64_t           ullSimRunMicros = 0;
+static esp_freertos_tick_cb_t pxSimTickHooks[ SIM_MAX_TICK_HOOKS ];
+
+/**************************************************************************/
+
+uint64_t ullSimMicros( void )
+{
+	struct timespec xNow;
+
+	clock_gettime( CLOCK_MONOTONIC, &xNow );
+	return ( uint64_t ) xNow.tv_sec * 1000000ULL + ( uint64_t ) xNow.tv_nsec / 1000ULL - ullSimStartMicros;
+}
+
+int64_t esp_timer_get_time( void )
+{
+	return ( int64_t ) ullSimMicros();
+}
+
+/**************************************************************************/
+
+BaseType_t xSimInIsrContext( void )
+{
+	return xSimInIsr;
+}
+
+void vSimEnterIsr( void )
+{
+	xSimInIsr = pdTRUE;
+}
+
+void vSimExitIsr( void )
+{
+	xSimInIsr = pdFALSE;
+}
+
+void vSimRaiseInterrupt( void )
+{
+	/* The dispatcher services everything pending on each pass, so a raise from
+	   inside a simulated ISR needs no wakeup. */
+	if( ( xSimIntrTask != NULL ) && ( xSimInIsr == pdFALSE ) )
+	{
+		xTaskNotifyGive( xSimIntrTask );
+	}
+}
+
+/**************************************************************************/
+
+/* There is one core, so hooks for any core run on it. */
+esp_err_t esp_register_freertos_tick_hook_for_cpu( esp_freertos_tick_cb_t new_tick_cb, UBaseType_t cpuid )
+{
+	for( int i = 0; i < SIM_MAX_TICK_HOOKS; i++ )
+	{
+		if( pxSimTickHooks[ i ] == NULL )
+		{
+			pxSimTickHooks[ i ] = new_tick_cb;
+			return ESP_OK;
+		}
+	}
+	return ESP_ERR_NO_MEM;
+}
+
+esp_err_t esp_register_freertos_tick_hook( esp_freertos_tick_cb_t new_tick_cb )
+{
+	return esp_register_freertos_tick_hook_for_cpu( new_tick_cb, 0 );
+}
+
+void vApplicationTickHook( void )
+{
+	for( int i = 0; i < SIM_MAX_TICK_HOOKS && pxSimTickHooks[ i ] != NULL; i++ )
+	{
+		pxSimTickHooks[ i ]();
+	}
+}
+
+/**************************************************************************/
+
+static void prvSimInterruptTask( void *pvParameters )
+{
+	uint64_t ullNow;
+
+	for(;;)
+	{
+		ullNow = ullSimMicros();
+
+		if( ( ullSimRunMicros != 0 ) && ( ullNow >= ullSimRunMicros ) )
+		{
+			fflush( stdout );
+			exit( EXIT_SUCCESS );
+		}
+
+		vSimGpioService( ullNow );
+		vSimTimerService( ullNow );
+		vSimI2sService( ullNow );
+
+		/* Peripheral alarms are checked at least once per tick; driven GPIO
+		   edges wake the dispatcher straight away. */
+		ulTaskNotifyTake( pdTRUE, 1 );
+	}
+}
+
+/**************************************************************************/
+
+static void prvMainTask( void *pvParameters )
+{
+	app_main();
+	vTaskDelete( NULL );
+}
+
+/**************************************************************************/
+
+int main( void )
+{
+	const char *pcRunSeconds;
+
+	ullSimStartMicros = 0;
+	ullSimStartMicros = ullSimMicros();
+
+	pcRunSeconds = getenv( "SIM_RUN_SECONDS" );
+	if( pcRunSeconds != NULL )
+	{
+		ullSimRunMicros = ( uint64_t ) ( atof( pcRunSeconds ) * 1000000.0 );
+	}
+
+	/* printf output is interleaved with other tasks; don't let stdio hold it. */
+	setvbuf( stdout, NULL, _IOLBF, 0 );
+
+	vSimGpioInit();
+
+	xTaskCreate( prvSimInterruptTask,
+	             "sim_intr",
+	             SIM_INTR_TASK_STACK,
+	             NULL,
+	             configMAX_PRIORITIES - 1,
+	             &xSimIntrTask );
+
+	xTaskCreate( prvMainTask,
+	             "main",
+	             SIM_MAIN_TASK_STACK,
+	             NULL,
+	             SIM_MAIN_TASK_PRIORITY,
+	             NULL );
+
+	vTaskStartScheduler();
+
+	/* Only reached if the scheduler could not start. */
+	printf("Scheduler could not be started\r\n");
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,236 @@
+/* Timer group model for the host simulation (see sim.h) */
+
+#include <stdio.h>
+#include "freertos/FreeRTOS.h"
+#include "driver/timer.h"
+#include "sim.h"
+
+typedef struct {
+    bool               initialized;
+    bool               running;
+    bool               alarm_en;
+    bool               intr_en;
+    bool               auto_reload;
+    timer_count_dir_t  dir;
+    uint32_t           divider;
+    uint64_t           load_value;
+    uint64_t           alarm_value;
+    uint64_t           base_count;    /* counter value at base_us */
+    uint64_t           base_us;
+    void             (*isr)(void *);
+    void              *isr_arg;
+} SimTimer_t;
+
+static SimTimer_t   xTimers[ TIMER_GROUP_MAX ][ TIMER_MAX ];
+static uint32_t     ulIntrStatus[ TIMER_GROUP_MAX ];
+
+/**************************************************************************/
+
+static bool prvValid(timer_group_t group_num, timer_idx_t timer_num)
+{
+    return group_num < TIMER_GROUP_MAX && timer_num < TIMER_MAX;
+}
+
+static uint64_t prvCounterAt(const SimTimer_t *t, uint64_t now)
+{
+    uint64_t elapsed;
+
+    if (!t->running) return t->base_count;
+
+    elapsed = (now - t->base_us) * (TIMER_BASE_CLK / 1000000) / t->divider;
+    return (t->dir == TIMER_COUNT_UP) ? t->base_count + elapsed : t->base_count - elapsed;
+}
+
+static void prvSetCounter(SimTimer_t *t, uint64_t value, uint64_t now)
+{
+    t->base_count = value;
+    t->base_us = now;
+}
+
+/**************************************************************************/
+
+void vSimTimerService(uint64_t ullNow)
+{
+    for (int g = 0; g < TIMER_GROUP_MAX; g++) {
+        for (int i = 0; i < TIMER_MAX; i++) {
+            SimTimer_t *t = &xTimers[g][i];
+            uint64_t count;
+            bool expired;
+
+            if (!t->initialized || !t->running || !t->alarm_en) continue;
+
+            count = prvCounterAt(t, ullNow);
+            expired = (t->dir == TIMER_COUNT_UP) ? count >= t->alarm_value : count <= t->alarm_value;
+            if (!expired) continue;
+
+            /* Like the hardware, the alarm disarms itself and must be
+               re-enabled from the ISR; auto-reload restarts the count from
+               the load value at the alarm point, not at the (late) service
+               time, so periods don't drift. */
+            t->alarm_en = false;
+            if (t->auto_reload) {
+                uint64_t ticks_per_s = TIMER_BASE_CLK / t->divider;
+                uint64_t overshoot = (t->dir == TIMER_COUNT_UP) ? count - t->alarm_value : t->alarm_value - count;
+                uint64_t overshoot_us = overshoot * 1000000ULL / ticks_per_s;
+
+                prvSetCounter(t, t->load_value, ullNow - overshoot_us);
+            }
+
+            ulIntrStatus[g] |= 1U << i;
+
+            if (t->intr_en && t->isr != NULL) {
+                vSimEnterIsr();
+                t->isr(t->isr_arg);
+                vSimExitIsr();
+            }
+        }
+    }
+}
+
+/**************************************************************************/
+
+esp_err_t timer_init(timer_group_t group_num, timer_idx_t timer_num, const timer_config_t *config)
+{
+    SimTimer_t *t;
+
+    if (!prvValid(group_num, timer_num) || config->divider < 2) return ESP_ERR_INVALID_ARG;
+
+    t = &xTimers[group_num][timer_num];
+    t->initialized = true;
+    t->divider = config->divider;
+    t->dir = config->counter_dir;
+    t->alarm_en = config->alarm_en == TIMER_ALARM_EN;
+    t->auto_reload = config->auto_reload == TIMER_AUTORELOAD_EN;
+    t->intr_en = false;
+    prvSetCounter(t, t->base_count, ullSimMicros());
+    t->running = config->counter_en == TIMER_START;
+    return ESP_OK;
+}
+
+esp_err_t timer_get_counter_value(timer_group_t group_num, timer_idx_t timer_num, uint64_t *timer_val)
+{
+    if (!prvValid(group_num, timer_num)) return ESP_ERR_INVALID_ARG;
+    *timer_val = prvCounterAt(&xTimers[group_num][timer_num], ullSimMicros());
+    return ESP_OK;
+}
+
+esp_err_t timer_get_counter_time_sec(timer_group_t group_num, timer_idx_t timer_num, double *time)
+{
+    uint64_t count;
+
+    if (timer_get_counter_value(group_num, timer_num, &count) != ESP_OK) return ESP_ERR_INVALID_ARG;
+    *time = (double) count / (TIMER_BASE_CLK / xTimers[group_num][timer_num].divider);
+    return ESP_OK;
+}
+
+esp_err_t timer_set_counter_value(timer_group_t group_num, timer_idx_t timer_num, uint64_t load_val)
+{
+    if (!prvValid(group_num, timer_num)) return ESP_ERR_INVALID_ARG;
+    xTimers[group_num][timer_num].load_value = load_val;
+    prvSetCounter(&xTimers[group_num][timer_num], load_val, ullSimMicros());
+    return ESP_OK;
+}
+
+esp_err_t timer_start(timer_group_t group_num, timer_idx_t timer_num)
+{
+    SimTimer_t *t;
+
+    if (!prvValid(group_num, timer_num)) return ESP_ERR_INVALID_ARG;
+    t = &xTimers[group_num][timer_num];
+    if (!t->running) {
+        prvSetCounter(t, t->base_count, ullSimMicros());
+        t->running = true;
+    }
+    return ESP_OK;
+}
+
+esp_err_t timer_pause(timer_group_t group_num, timer_idx_t timer_num)
+{
+    SimTimer_t *t;
+
+    if (!prvValid(group_num, timer_num)) return ESP_ERR_INVALID_ARG;
+    t = &xTimers[group_num][timer_num];
+    t->base_count = prvCounterAt(t, ullSimMicros());
+    t->running = false;
+    return ESP_OK;
+}
+
+esp_err_t timer_set_alarm_value(timer_group_t group_num, timer_idx_t timer_num, uint64_t alarm_value)
+{
+    if (!prvValid(group_num, timer_num)) return ESP_ERR_INVALID_ARG;
+    xTimers[group_num][timer_num].alarm_value = alarm_value;
+    return ESP_OK;
+}
+
+esp_err_t timer_get_alarm_value(timer_group_t group_num, timer_idx_t timer_num, uint64_t *alarm_value)
+{
+    if (!prvValid(group_num, timer_num)) return ESP_ERR_INVALID_ARG;
+    *alarm_value = xTimers[group_num][timer_num].alarm_value;
+    return ESP_OK;
+}
+
+esp_err_t timer_set_alarm(timer_group_t group_num, timer_idx_t timer_num, timer_alarm_t alarm_en)
+{
+    if (!prvValid(group_num, timer_num)) return ESP_ERR_INVALID_ARG;
+    xTimers[group_num][timer_num].alarm_en = alarm_en == TIMER_ALARM_EN;
+    vSimRaiseInterrupt();
+    return ESP_OK;
+}
+
+esp_err_t timer_set_auto_reload(timer_group_t group_num, timer_idx_t timer_num, timer_autoreload_t reload)
+{
+    if (!prvValid(group_num, timer_num)) return ESP_ERR_INVALID_ARG;
+    xTimers[group_num][timer_num].auto_reload = reload == TIMER_AUTORELOAD_EN;
+    return ESP_OK;
+}
+
+esp_err_t timer_enable_intr(timer_group_t group_num, timer_idx_t timer_num)
+{
+    if (!prvValid(group_num, timer_num)) return ESP_ERR_INVALID_ARG;
+    xTimers[group_num][timer_num].intr_en = true;
+    return ESP_OK;
+}
+
+esp_err_t timer_disable_intr(timer_group_t group_num, timer_idx_t timer_num)
+{
+    if (!prvValid(group_num, timer_num)) return ESP_ERR_INVALID_ARG;
+    xTimers[group_num][timer_num].intr_en = false;
+    return ESP_OK;
+}
+
+esp_err_t timer_isr_register(timer_group_t group_num, timer_idx_t timer_num, void (*fn)(void *),
+                             void *arg, int intr_alloc_flags, timer_isr_handle_t *handle)
+{
+    if (!prvValid(group_num, timer_num) || fn == NULL) return ESP_ERR_INVALID_ARG;
+    xTimers[group_num][timer_num].isr = fn;
+    xTimers[group_num][timer_num].isr_arg = arg;
+    if (handle != NULL) *handle = &xTimers[group_num][timer_num];
+    return ESP_OK;
+}
+
+/**************************************************************************/
+
+timer_intr_t timer_group_intr_get_in_isr(timer_group_t group_num)
+{
+    return (timer_intr_t) ulIntrStatus[group_num];
+}
+
+void timer_group_intr_clr_in_isr(timer_group_t group_num, timer_idx_t timer_num)
+{
+    ulIntrStatus[group_num] &= ~(1U << timer_num);
+}
+
+void timer_group_enable_alarm_in_isr(timer_group_t group_num, timer_idx_t timer_num)
+{
+    xTimers[group_num][timer_num].alarm_en = true;
+}
+
+uint64_t timer_group_get_counter_value_in_isr(timer_group_t group_num, timer_idx_t timer_num)
+{
+    return prvCounterAt(&xTimers[group_num][timer_num], ullSimMicros());
+}
+
+void timer_group_set_alarm_value_in_isr(timer_group_t group_num, timer_idx_t timer_num, uint64_t alarm_val)
+{
+    xTimers[group_num][timer_num].alarm_value = alarm_val;
+}
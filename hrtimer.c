@@ -0,0 +1,351 @@
+/* High-resolution timers on one hardware timer - see hrtimer.h
+
+   The heap is an array of active timers ordered by ullLatest, the deadline
+   plus the slack, each timer knowing its own position (uxIndex) so it can
+   be removed from the middle. pxHeap[ 0 ] is the timer that must fire
+   first and the alarm is set to its ullLatest. When the alarm fires, any
+   other timer whose ullDeadline has passed is run along with it; with at
+   most HRTIMER_MAX_TIMERS in the heap a linear scan for them is cheapest.
+
+   Everything is guarded by xHrTimerLock, taken with the _ISR critical
+   section macros in the interrupt. Callbacks run with the lock dropped so
+   they can start and stop timers, their own included.
+*/
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/timer.h"
+#include "esp_attr.h"
+#include "hrtimer.h"
+
+/* 80 MHz APB clock / 80: one count per microsecond. */
+#define hrtimerDIVIDER          ( TIMER_BASE_CLK / 1000000 )
+
+/* An alarm set to a count the counter has already passed would not fire,
+   so alarms are never set closer than this to the current count. */
+#define hrtimerMIN_LEAD_US      5
+
+#define hrtimerINACTIVE         ( ( UBaseType_t ) -1 )
+
+/* Callbacks run per interrupt at most. After a long stall, periodic timers
+   catching up on their grid would otherwise keep the interrupt busy; the
+   rest run from the next alarm, hrtimerMIN_LEAD_US later. */
+#define hrtimerMAX_RUNS         ( 2 * HRTIMER_MAX_TIMERS )
+
+struct HrTimer
+{
+	uint64_t                   ullDeadline;
+	uint64_t                   ullLatest;      /* ullDeadline + ulSlackUs */
+	uint32_t                   ulPeriodUs;     /* 0 for a one-shot */
+	uint32_t                   ulSlackUs;
+	UBaseType_t                uxIndex;        /* position in pxHeap, or hrtimerINACTIVE */
+	HrTimerCallbackFunction_t  pxCallback;
+	void                      *pvContext;
+	const char                *pcName;
+};
+
+static struct HrTimer *pxHeap[ HRTIMER_MAX_TIMERS ];
+static UBaseType_t uxHeapSize;
+static UBaseType_t uxCreated;
+static portMUX_TYPE xHrTimerLock = portMUX_INITIALIZER_UNLOCKED;
+static HrTimerStats_t xStats;
+
+/**************************************************************************/
+
+static void IRAM_ATTR prvPlace( struct HrTimer *pxTimer, UBaseType_t uxIndex )
+{
+	pxHeap[ uxIndex ] = pxTimer;
+	pxTimer->uxIndex = uxIndex;
+}
+
+static void IRAM_ATTR prvSiftUp( UBaseType_t uxIndex )
+{
+	struct HrTimer *pxTimer = pxHeap[ uxIndex ];
+	UBaseType_t uxParent;
+
+	while( uxIndex > 0 )
+	{
+		uxParent = ( uxIndex - 1 ) / 2;
+		if( pxHeap[ uxParent ]->ullLatest <= pxTimer->ullLatest )
+		{
+			break;
+		}
+		prvPlace( pxHeap[ uxParent ], uxIndex );
+		uxIndex = uxParent;
+	}
+	prvPlace( pxTimer, uxIndex );
+}
+
+static void IRAM_ATTR prvSiftDown( UBaseType_t uxIndex )
+{
+	struct HrTimer *pxTimer = pxHeap[ uxIndex ];
+	UBaseType_t uxChild;
+
+	while( ( uxChild = 2 * uxIndex + 1 ) < uxHeapSize )
+	{
+		if( uxChild + 1 < uxHeapSize && pxHeap[ uxChild + 1 ]->ullLatest < pxHeap[ uxChild ]->ullLatest )
+		{
+			uxChild++;
+		}
+		if( pxTimer->ullLatest <= pxHeap[ uxChild ]->ullLatest )
+		{
+			break;
+		}
+		prvPlace( pxHeap[ uxChild ], uxIndex );
+		uxIndex = uxChild;
+	}
+	prvPlace( pxTimer, uxIndex );
+}
+
+static void IRAM_ATTR prvInsert( struct HrTimer *pxTimer )
+{
+	prvPlace( pxTimer, uxHeapSize++ );
+	prvSiftUp( pxTimer->uxIndex );
+}
+
+static void IRAM_ATTR prvRemove( struct HrTimer *pxTimer )
+{
+	UBaseType_t uxIndex = pxTimer->uxIndex;
+	struct HrTimer *pxLast = pxHeap[ --uxHeapSize ];
+
+	pxTimer->uxIndex = hrtimerINACTIVE;
+	if( pxLast == pxTimer )
+	{
+		return;
+	}
+
+	/* The last timer fills the hole and moves whichever way it has to. */
+	prvPlace( pxLast, uxIndex );
+	prvSiftUp( uxIndex );
+	prvSiftDown( pxLast->uxIndex );
+}
+
+/* Points the alarm at the earliest deadline plus slack. */
+static void IRAM_ATTR prvProgramAlarm( void )
+{
+	uint64_t ullEarliest;
+
+	if( uxHeapSize == 0 )
+	{
+		return;
+	}
+
+	ullEarliest = timer_group_get_counter_value_in_isr( HRTIMER_GROUP, HRTIMER_INDEX ) + hrtimerMIN_LEAD_US;
+	if( pxHeap[ 0 ]->ullLatest > ullEarliest )
+	{
+		ullEarliest = pxHeap[ 0 ]->ullLatest;
+	}
+	timer_group_set_alarm_value_in_isr( HRTIMER_GROUP, HRTIMER_INDEX, ullEarliest );
+	timer_group_enable_alarm_in_isr( HRTIMER_GROUP, HRTIMER_INDEX );
+}
+
+/* The timer to run next at ullNow: the first one that is out of slack, or
+   failing that any whose deadline has come. */
+static struct HrTimer * IRAM_ATTR prvNextDue( uint64_t ullNow )
+{
+	if( uxHeapSize == 0 )
+	{
+		return NULL;
+	}
+	if( pxHeap[ 0 ]->ullLatest <= ullNow )
+	{
+		return pxHeap[ 0 ];
+	}
+
+	for( UBaseType_t i = 0; i < uxHeapSize; i++ )
+	{
+		if( pxHeap[ i ]->ullDeadline <= ullNow )
+		{
+			xStats.ulCoalesced++;
+			return pxHeap[ i ];
+		}
+	}
+	return NULL;
+}
+
+/**************************************************************************/
+
+static void IRAM_ATTR prvAlarmIsr( void *pvParameters )
+{
+	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+	struct HrTimer *pxTimer;
+	UBaseType_t uxRuns = 0;
+
+	timer_group_intr_clr_in_isr( HRTIMER_GROUP, HRTIMER_INDEX );
+
+	taskENTER_CRITICAL_ISR( &xHrTimerLock );
+	xStats.ulWakeups++;
+	while( uxRuns++ < hrtimerMAX_RUNS &&
+	       ( pxTimer = prvNextDue( timer_group_get_counter_value_in_isr( HRTIMER_GROUP, HRTIMER_INDEX ) ) ) != NULL )
+	{
+		xStats.ulExpiries++;
+		prvRemove( pxTimer );
+
+		if( pxTimer->ulPeriodUs != 0 )
+		{
+			/* Next deadline on the grid, reinserted before the callback so
+			   the callback sees the timer still active and can stop it. The
+			   callback reads the one it runs for with ullHrTimerGetDeadline(). */
+			pxTimer->ullDeadline += pxTimer->ulPeriodUs;
+			pxTimer->ullLatest = pxTimer->ullDeadline + pxTimer->ulSlackUs;
+			prvInsert( pxTimer );
+		}
+
+		taskEXIT_CRITICAL_ISR( &xHrTimerLock );
+		pxTimer->pxCallback( pxTimer, &xHigherPriorityTaskWoken );
+		taskENTER_CRITICAL_ISR( &xHrTimerLock );
+	}
+	prvProgramAlarm();
+	taskEXIT_CRITICAL_ISR( &xHrTimerLock );
+
+	if( xHigherPriorityTaskWoken ) portYIELD_FROM_ISR();
+}
+
+/* Same set-up as example_tg0_timer_init() in example11, at 1 MHz and with
+   the alarm left off until a timer is started. */
+BaseType_t xHrTimerInit( void )
+{
+	timer_config_t config;
+
+	config.divider = hrtimerDIVIDER;
+	config.counter_dir = TIMER_COUNT_UP;
+	config.counter_en = TIMER_PAUSE;
+	config.alarm_en = TIMER_ALARM_DIS;
+	config.intr_type = TIMER_INTR_LEVEL;
+	config.auto_reload = TIMER_AUTORELOAD_DIS;
+
+	if( timer_init( HRTIMER_GROUP, HRTIMER_INDEX, &config ) != ESP_OK )
+	{
+		return pdFAIL;
+	}
+
+	timer_set_counter_value( HRTIMER_GROUP, HRTIMER_INDEX, 0x00000000ULL );
+	timer_enable_intr( HRTIMER_GROUP, HRTIMER_INDEX );
+	if( timer_isr_register( HRTIMER_GROUP, HRTIMER_INDEX, prvAlarmIsr, NULL, ESP_INTR_FLAG_IRAM, NULL ) != ESP_OK )
+	{
+		return pdFAIL;
+	}
+
+	return ( timer_start( HRTIMER_GROUP, HRTIMER_INDEX ) == ESP_OK ) ? pdPASS : pdFAIL;
+}
+
+uint64_t IRAM_ATTR ullHrTimerNow( void )
+{
+	return timer_group_get_counter_value_in_isr( HRTIMER_GROUP, HRTIMER_INDEX );
+}
+
+/**************************************************************************/
+
+HrTimerHandle_t xHrTimerCreate( const char *pcName, HrTimerCallbackFunction_t pxCallback, void *pvContext )
+{
+	struct HrTimer *pxTimer;
+	BaseType_t xRoom;
+
+	taskENTER_CRITICAL( &xHrTimerLock );
+	xRoom = ( uxCreated < HRTIMER_MAX_TIMERS );
+	if( xRoom )
+	{
+		uxCreated++;
+	}
+	taskEXIT_CRITICAL( &xHrTimerLock );
+
+	pxTimer = xRoom ? pvPortMalloc( sizeof( struct HrTimer ) ) : NULL;
+	if( pxTimer == NULL )
+	{
+		if( xRoom )
+		{
+			taskENTER_CRITICAL( &xHrTimerLock );
+			uxCreated--;
+			taskEXIT_CRITICAL( &xHrTimerLock );
+		}
+		return NULL;
+	}
+
+	memset( pxTimer, 0, sizeof( struct HrTimer ) );
+	pxTimer->uxIndex = hrtimerINACTIVE;
+	pxTimer->pxCallback = pxCallback;
+	pxTimer->pvContext = pvContext;
+	pxTimer->pcName = pcName;
+	return pxTimer;
+}
+
+static BaseType_t IRAM_ATTR prvArm( struct HrTimer *pxTimer, uint32_t ulDelayUs, uint32_t ulPeriodUs )
+{
+	taskENTER_CRITICAL_ISR( &xHrTimerLock );
+	if( pxTimer->uxIndex != hrtimerINACTIVE )
+	{
+		prvRemove( pxTimer );
+	}
+	pxTimer->ulPeriodUs = ulPeriodUs;
+	pxTimer->ullDeadline = ullHrTimerNow() + ulDelayUs;
+	pxTimer->ullLatest = pxTimer->ullDeadline + pxTimer->ulSlackUs;
+	prvInsert( pxTimer );
+
+	/* Only a new earliest deadline moves the alarm. */
+	if( pxHeap[ 0 ] == pxTimer )
+	{
+		prvProgramAlarm();
+	}
+	taskEXIT_CRITICAL_ISR( &xHrTimerLock );
+	return pdPASS;
+}
+
+BaseType_t IRAM_ATTR xHrTimerStartOnce( HrTimerHandle_t xTimer, uint32_t ulDelayUs )
+{
+	return prvArm( xTimer, ulDelayUs, 0 );
+}
+
+BaseType_t IRAM_ATTR xHrTimerStartPeriodic( HrTimerHandle_t xTimer, uint32_t ulPeriodUs )
+{
+	if( ulPeriodUs < HRTIMER_MIN_PERIOD_US )
+	{
+		return pdFAIL;
+	}
+	return prvArm( xTimer, ulPeriodUs, ulPeriodUs );
+}
+
+/* A stopped earliest timer leaves the alarm where it was: it fires once
+   for nothing and is then set to the next deadline. */
+BaseType_t IRAM_ATTR xHrTimerStop( HrTimerHandle_t xTimer )
+{
+	taskENTER_CRITICAL_ISR( &xHrTimerLock );
+	if( xTimer->uxIndex != hrtimerINACTIVE )
+	{
+		prvRemove( xTimer );
+	}
+	taskEXIT_CRITICAL_ISR( &xHrTimerLock );
+	return pdPASS;
+}
+
+void vHrTimerSetSlack( HrTimerHandle_t xTimer, uint32_t ulSlackUs )
+{
+	xTimer->ulSlackUs = ulSlackUs;
+}
+
+BaseType_t IRAM_ATTR xHrTimerIsActive( HrTimerHandle_t xTimer )
+{
+	return xTimer->uxIndex != hrtimerINACTIVE;
+}
+
+void *pvHrTimerGetContext( HrTimerHandle_t xTimer )
+{
+	return xTimer->pvContext;
+}
+
+const char *pcHrTimerGetName( HrTimerHandle_t xTimer )
+{
+	return xTimer->pcName;
+}
+
+uint64_t IRAM_ATTR ullHrTimerGetDeadline( HrTimerHandle_t xTimer )
+{
+	return xTimer->ullDeadline - xTimer->ulPeriodUs;
+}
+
+void vHrTimerGetStats( HrTimerStats_t *pxStats )
+{
+	taskENTER_CRITICAL( &xHrTimerLock );
+	*pxStats = xStats;
+	taskEXIT_CRITICAL( &xHrTimerLock );
+}
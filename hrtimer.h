@@ -0,0 +1,111 @@
+/* High-resolution timers on one hardware timer
+
+   Software timers run on the tick: pdMS_TO_TICKS( 3333 ) at 100 Hz becomes
+   333 ticks and the callback runs up to a tick late, so nothing below 10 ms
+   can be timed with them. These timers run off a timer group counter
+   ticking at 1 MHz instead. All active timers share it: their deadlines are
+   kept in a binary min-heap and the counter's alarm is always set to the
+   earliest one, so the alarm interrupt only fires when a timer is due.
+
+   xHrTimerInit();
+   xControlTimer = xHrTimerCreate( "control", prvControlCallback, NULL );
+   xHrTimerStartPeriodic( xControlTimer, 250 );
+
+   static void IRAM_ATTR prvControlCallback( HrTimerHandle_t xTimer,
+                                             BaseType_t *pxHigherPriorityTaskWoken )
+   {
+       vTaskNotifyGiveFromISR( xControlTask, pxHigherPriorityTaskWoken );
+   }
+
+   Callbacks run in the alarm interrupt, so they must be short and may only
+   use FromISR calls; like timer_group0_isr in example11, they usually just
+   wake a task. The interrupt is registered with ESP_INTR_FLAG_IRAM, so
+   callbacks and everything they call must be IRAM_ATTR too. A periodic
+   timer's deadlines are kept on a fixed grid (previous deadline + period),
+   so lateness of one callback does not accumulate.
+
+   A timer can be given slack: it may then fire anywhere from its deadline
+   to its deadline plus the slack. The alarm is set for the earliest
+   deadline-plus-slack, and each alarm runs every timer whose deadline has
+   come, so timers with nearby deadlines share one interrupt instead of
+   waking the CPU one after the other. vHrTimerGetStats() counts the
+   wakeups this saved.
+
+   Starting, restarting and stopping are O(log n) in the number of active
+   timers and may be called from tasks, ISRs and callbacks.
+
+   In the host simulation the counter is modelled by host/sim_timer.c, whose
+   alarms are serviced on every pass of the interrupt dispatcher (at least
+   once a tick), so there the ordering and bookkeeping are exact but the
+   timing is not sub-tick.
+*/
+#ifndef HRTIMER_H
+#define HRTIMER_H
+
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "driver/timer.h"
+
+/* The timer used. Example11 and example12 use both timers of group 0. */
+#ifndef HRTIMER_GROUP
+#define HRTIMER_GROUP           TIMER_GROUP_1
+#endif
+#ifndef HRTIMER_INDEX
+#define HRTIMER_INDEX           TIMER_0
+#endif
+
+#define HRTIMER_MAX_TIMERS      16
+
+/* The shortest period xHrTimerStartPeriodic() accepts. Below this the
+   alarm interrupt would have no time left for anything else. */
+#ifndef HRTIMER_MIN_PERIOD_US
+#define HRTIMER_MIN_PERIOD_US   50
+#endif
+
+typedef struct HrTimer * HrTimerHandle_t;
+
+typedef struct
+{
+	uint32_t ulWakeups;      /* alarm interrupts */
+	uint32_t ulExpiries;     /* callbacks run */
+	uint32_t ulCoalesced;    /* callbacks run early within their slack, by an
+	                            alarm set for another timer: wakeups saved */
+} HrTimerStats_t;
+
+typedef void ( *HrTimerCallbackFunction_t )( HrTimerHandle_t xTimer,
+                                             BaseType_t *pxHigherPriorityTaskWoken );
+
+/* Sets the counter up and installs the alarm interrupt. Call once. */
+BaseType_t xHrTimerInit( void );
+
+/* Microseconds since xHrTimerInit(), read from the counter. */
+uint64_t ullHrTimerNow( void );
+
+/* Returns NULL when HRTIMER_MAX_TIMERS already exist or there is not enough
+   heap. The timer is created stopped. */
+HrTimerHandle_t xHrTimerCreate( const char *pcName, HrTimerCallbackFunction_t pxCallback,
+                                void *pvContext );
+
+/* (Re)arms the timer to fire once, ulDelayUs from now. */
+BaseType_t xHrTimerStartOnce( HrTimerHandle_t xTimer, uint32_t ulDelayUs );
+
+/* (Re)arms the timer to fire every ulPeriodUs, the first time one period
+   from now. Returns pdFAIL for a period under HRTIMER_MIN_PERIOD_US. */
+BaseType_t xHrTimerStartPeriodic( HrTimerHandle_t xTimer, uint32_t ulPeriodUs );
+
+BaseType_t xHrTimerStop( HrTimerHandle_t xTimer );
+
+/* How late the timer may fire to share a wakeup, 0 (the default) for
+   exactly on time. Takes effect from the next start. */
+void vHrTimerSetSlack( HrTimerHandle_t xTimer, uint32_t ulSlackUs );
+BaseType_t xHrTimerIsActive( HrTimerHandle_t xTimer );
+
+void *pvHrTimerGetContext( HrTimerHandle_t xTimer );
+const char *pcHrTimerGetName( HrTimerHandle_t xTimer );
+
+/* From the callback: the deadline it was due at, in ullHrTimerNow() time. */
+uint64_t ullHrTimerGetDeadline( HrTimerHandle_t xTimer );
+
+void vHrTimerGetStats( HrTimerStats_t *pxStats );
+
+#endif /* HRTIMER_H */
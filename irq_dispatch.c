@@ -0,0 +1,257 @@
+/* Table-driven interrupt dispatcher - see irq_dispatch.h
+
+   A worker source owns one bit of its worker's pending set: its slot, the
+   order it was added in. The worker's table lists the sources from the
+   highest priority down; the worker copies it under the lock after every
+   wakeup, so sources can be added while others are firing.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/gpio.h"
+#include "driver/timer.h"
+#include "esp_attr.h"
+#include "isr_pending.h"
+#include "isr_latency.h"
+#include "irq_dispatch.h"
+
+typedef struct IrqWorker
+{
+	IsrPendingHandle_t  xPending;
+	UBaseType_t         uxSources;
+	struct IrqSource   *pxSources[ IRQ_DISPATCH_MAX_SOURCES ];     /* highest priority first */
+} IrqWorker_t;
+
+struct IrqSource
+{
+	const char         *pcName;
+	IrqContext_t        eContext;
+	UBaseType_t         uxPriority;
+	IrqHandler_t        pxHandler;
+	void               *pvContext;
+	IrqWorker_t        *pxWorker;       /* NULL for inline sources */
+	UBaseType_t         uxSlot;
+
+	timer_group_t       xGroup;         /* timer sources only */
+	timer_idx_t         xTimer;
+
+	uint32_t            ulRaised;
+	uint32_t            ulCalls;
+	IsrLatency_t        xLatency;
+	struct IrqSource   *pxNext;
+};
+
+/* Indexed by context: [ eIrqContextHigh ] and [ eIrqContextBackground ]. */
+static IrqWorker_t xWorkers[ eIrqContextBackground + 1 ];
+static struct IrqSource *pxSourceList;
+static portMUX_TYPE xDispatchLock = portMUX_INITIALIZER_UNLOCKED;
+
+static const char * const pcContextNames[] = { "inline", "high", "background" };
+
+/**************************************************************************/
+
+static void prvWorkerTask( void *pvParameters )
+{
+	IrqWorker_t *pxWorker = pvParameters;
+	struct IrqSource *pxOrder[ IRQ_DISPATCH_MAX_SOURCES ];
+	struct IrqSource *pxSource;
+	uint32_t ulCounts[ ISR_PENDING_MAX_SOURCES ];
+	uint32_t ulSources, ulBit;
+	UBaseType_t uxSources;
+
+	for(;;)
+	{
+		ulSources = ulIsrPendingWait( pxWorker->xPending, ulCounts, portMAX_DELAY );
+
+		taskENTER_CRITICAL( &xDispatchLock );
+		uxSources = pxWorker->uxSources;
+		memcpy( pxOrder, pxWorker->pxSources, uxSources * sizeof( pxOrder[ 0 ] ) );
+		taskEXIT_CRITICAL( &xDispatchLock );
+
+		for( UBaseType_t i = 0; i < uxSources && ulSources != 0; i++ )
+		{
+			pxSource = pxOrder[ i ];
+			ulBit = 1UL << pxSource->uxSlot;
+			if( ( ulSources & ulBit ) == 0 )
+			{
+				continue;
+			}
+			ulSources &= ~ulBit;
+
+			vIsrLatencyResume( &pxSource->xLatency );
+			pxSource->pxHandler( pxSource->pvContext, ulCounts[ pxSource->uxSlot ], NULL );
+			__atomic_add_fetch( &pxSource->ulCalls, 1, __ATOMIC_RELAXED );
+		}
+	}
+}
+
+BaseType_t xIrqDispatchStart( UBaseType_t uxHighPriority, UBaseType_t uxBackgroundPriority, BaseType_t xCoreID )
+{
+	static const char * const pcTaskNames[] = { NULL, "IrqHigh", "IrqBackground" };
+	UBaseType_t uxPriorities[] = { 0, uxHighPriority, uxBackgroundPriority };
+
+	for( UBaseType_t i = eIrqContextHigh; i <= eIrqContextBackground; i++ )
+	{
+		xWorkers[ i ].xPending = xIsrPendingCreate();
+		if( xWorkers[ i ].xPending == NULL ||
+		    xTaskCreatePinnedToCore( prvWorkerTask, pcTaskNames[ i ], IRQ_DISPATCH_STACK_SIZE, &xWorkers[ i ],
+		                             uxPriorities[ i ], NULL, xCoreID ) != pdPASS )
+		{
+			return pdFAIL;
+		}
+	}
+	return pdPASS;
+}
+
+/**************************************************************************/
+
+void IRAM_ATTR vIrqDispatchRaiseFromISR( IrqSourceHandle_t xSource, BaseType_t *pxHigherPriorityTaskWoken )
+{
+	__atomic_add_fetch( &xSource->ulRaised, 1, __ATOMIC_RELAXED );
+
+	if( xSource->pxWorker == NULL )
+	{
+		xSource->pxHandler( xSource->pvContext, 1, pxHigherPriorityTaskWoken );
+		__atomic_add_fetch( &xSource->ulCalls, 1, __ATOMIC_RELAXED );
+		return;
+	}
+
+	vIsrLatencyStamp( &xSource->xLatency );
+	vIsrPendingSetFromISR( xSource->pxWorker->xPending, xSource->uxSlot, pxHigherPriorityTaskWoken );
+}
+
+/* Acknowledges and re-arms the alarm, as example11's timer ISR does. */
+static void IRAM_ATTR prvTimerIsr( void *pvParameters )
+{
+	struct IrqSource *pxSource = pvParameters;
+	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+	if( timer_group_intr_get_in_isr( pxSource->xGroup ) & ( 1 << pxSource->xTimer ) )
+	{
+		timer_group_intr_clr_in_isr( pxSource->xGroup, pxSource->xTimer );
+		timer_group_enable_alarm_in_isr( pxSource->xGroup, pxSource->xTimer );
+		vIrqDispatchRaiseFromISR( pxSource, &xHigherPriorityTaskWoken );
+	}
+
+	if( xHigherPriorityTaskWoken ) portYIELD_FROM_ISR();
+}
+
+static void IRAM_ATTR prvGpioIsr( void *pvParameters )
+{
+	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+	vIrqDispatchRaiseFromISR( pvParameters, &xHigherPriorityTaskWoken );
+
+	if( xHigherPriorityTaskWoken ) portYIELD_FROM_ISR();
+}
+
+/**************************************************************************/
+
+IrqSourceHandle_t xIrqDispatchAddSource( const char *pcName, IrqContext_t eContext, UBaseType_t uxPriority,
+                                         IrqHandler_t pxHandler, void *pvContext )
+{
+	struct IrqSource *pxSource = pvPortMalloc( sizeof( struct IrqSource ) );
+	IrqWorker_t *pxWorker = ( eContext == eIrqContextInline ) ? NULL : &xWorkers[ eContext ];
+	UBaseType_t uxAt;
+
+	if( pxSource == NULL )
+	{
+		return NULL;
+	}
+
+	memset( pxSource, 0, sizeof( struct IrqSource ) );
+	pxSource->pcName = pcName;
+	pxSource->eContext = eContext;
+	pxSource->uxPriority = uxPriority;
+	pxSource->pxHandler = pxHandler;
+	pxSource->pvContext = pvContext;
+	pxSource->pxWorker = pxWorker;
+
+	taskENTER_CRITICAL( &xDispatchLock );
+	if( pxWorker != NULL )
+	{
+		if( pxWorker->xPending == NULL || pxWorker->uxSources == IRQ_DISPATCH_MAX_SOURCES )
+		{
+			taskEXIT_CRITICAL( &xDispatchLock );
+			vPortFree( pxSource );
+			return NULL;
+		}
+
+		/* After the sources of the same priority, so they keep the order
+		   they were added in. */
+		pxSource->uxSlot = pxWorker->uxSources;
+		for( uxAt = pxWorker->uxSources; uxAt > 0 && pxWorker->pxSources[ uxAt - 1 ]->uxPriority < uxPriority; uxAt-- )
+		{
+			pxWorker->pxSources[ uxAt ] = pxWorker->pxSources[ uxAt - 1 ];
+		}
+		pxWorker->pxSources[ uxAt ] = pxSource;
+		pxWorker->uxSources++;
+	}
+	pxSource->pxNext = pxSourceList;
+	pxSourceList = pxSource;
+	taskEXIT_CRITICAL( &xDispatchLock );
+
+	/* Nothing can raise the source before it is returned. */
+	if( pxWorker != NULL )
+	{
+		vIsrLatencyRegister( &pxSource->xLatency, pcName );
+	}
+	return pxSource;
+}
+
+IrqSourceHandle_t xIrqDispatchAddTimer( timer_group_t xGroup, timer_idx_t xTimer, const char *pcName,
+                                        IrqContext_t eContext, UBaseType_t uxPriority,
+                                        IrqHandler_t pxHandler, void *pvContext )
+{
+	struct IrqSource *pxSource = xIrqDispatchAddSource( pcName, eContext, uxPriority, pxHandler, pvContext );
+
+	if( pxSource == NULL )
+	{
+		return NULL;
+	}
+
+	pxSource->xGroup = xGroup;
+	pxSource->xTimer = xTimer;
+	timer_enable_intr( xGroup, xTimer );
+	timer_isr_register( xGroup, xTimer, prvTimerIsr, pxSource, ESP_INTR_FLAG_IRAM, NULL );
+	return pxSource;
+}
+
+IrqSourceHandle_t xIrqDispatchAddGpio( gpio_num_t xPin, gpio_int_type_t xIntrType, const char *pcName,
+                                       IrqContext_t eContext, UBaseType_t uxPriority,
+                                       IrqHandler_t pxHandler, void *pvContext )
+{
+	struct IrqSource *pxSource = xIrqDispatchAddSource( pcName, eContext, uxPriority, pxHandler, pvContext );
+
+	if( pxSource == NULL )
+	{
+		return NULL;
+	}
+
+	gpio_set_intr_type( xPin, xIntrType );
+	gpio_isr_handler_add( xPin, prvGpioIsr, pxSource );
+	return pxSource;
+}
+
+/**************************************************************************/
+
+void vIrqDispatchPrintAll( void )
+{
+	const struct IrqSource *pxSource;
+
+	printf("%-10s %-10s %4s %10s %10s\r\n", "source", "context", "prio", "raised", "calls");
+
+	taskENTER_CRITICAL( &xDispatchLock );
+	pxSource = pxSourceList;
+	taskEXIT_CRITICAL( &xDispatchLock );
+
+	/* Sources are never removed, so the list can be walked unlocked. */
+	for( ; pxSource != NULL; pxSource = pxSource->pxNext )
+	{
+		printf("%-10s %-10s %4u %10u %10u\r\n", pxSource->pcName, pcContextNames[ pxSource->eContext ],
+		       ( unsigned ) pxSource->uxPriority, __atomic_load_n( &pxSource->ulRaised, __ATOMIC_RELAXED ),
+		       __atomic_load_n( &pxSource->ulCalls, __ATOMIC_RELAXED ));
+	}
+}
@@ -0,0 +1,99 @@
+/* Table-driven interrupt dispatcher
+
+   Instead of one task that wakes for every interrupt and finds out what to
+   do in a switch, each interrupt source is registered once with its own
+   handler, a priority and the context the handler runs in:
+
+   eIrqContextInline       in the ISR itself: for the few lines that must
+                           not wait for any task (re-arming, latching a
+                           timestamp). The handler must be in IRAM and only
+                           use FromISR calls.
+   eIrqContextHigh         in the high priority worker task
+   eIrqContextBackground   in the background worker task, for slow work:
+                           printing, logging, anything that may block
+
+   Each worker drains every pending source of its own in one wakeup (see
+   isr_pending.h) and calls their handlers from the highest priority down,
+   each once with the number of interrupts it raised since its last call.
+   The high worker preempts the background worker, so an urgent source
+   never queues behind a slow one. Sources come and go without touching
+   any central code:
+
+   xIrqDispatchStart( 6, 4, 0 );
+
+   example_tg0_timer_init( TIMER_0, TEST_WITH_RELOAD, TIMER_INTERVAL0_SEC );
+   xIrqDispatchAddTimer( TIMER_GROUP_0, TIMER_0, "TIMER_0", eIrqContextBackground, 1, vTimer0Handler, NULL );
+   timer_start( TIMER_GROUP_0, TIMER_0 );
+
+   static void vTimer0Handler( void *pvContext, uint32_t ulCount, BaseType_t *pxHigherPriorityTaskWoken )
+   {
+       printf("INTERRUPTION FROM TIMER 0 (x%u)\r\n", ulCount);
+   }
+
+   Timer sources get an ISR that acknowledges and re-arms the alarm; GPIO
+   sources are added to the GPIO ISR service. Any other interrupt - or a
+   GPIO pin behind gpio_storm.h - is a plain source its own ISR raises with
+   vIrqDispatchRaiseFromISR().
+
+   Handlers of worker sources are called with pxHigherPriorityTaskWoken
+   NULL and may use any call a task may. The interrupt-to-handler latency of
+   every worker source is recorded under its name (isr_latency.h), so the
+   workers should run on the core the interrupts are allocated on.
+*/
+#ifndef IRQ_DISPATCH_H
+#define IRQ_DISPATCH_H
+
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/gpio.h"
+#include "driver/timer.h"
+
+/* Sources per worker; inline sources don't count. */
+#define IRQ_DISPATCH_MAX_SOURCES    16
+#define IRQ_DISPATCH_STACK_SIZE     3072
+
+typedef enum
+{
+	eIrqContextInline = 0,
+	eIrqContextHigh,
+	eIrqContextBackground
+} IrqContext_t;
+
+/* ulCount is the number of interrupts since the last call: always 1 for
+   inline sources. pxHigherPriorityTaskWoken is NULL outside the ISR. */
+typedef void ( *IrqHandler_t )( void *pvContext, uint32_t ulCount, BaseType_t *pxHigherPriorityTaskWoken );
+
+typedef struct IrqSource * IrqSourceHandle_t;
+
+/* Creates the two workers, pinned to xCoreID. Call once, before adding
+   sources. */
+BaseType_t xIrqDispatchStart( UBaseType_t uxHighPriority, UBaseType_t uxBackgroundPriority, BaseType_t xCoreID );
+
+/* Within a worker, higher uxPriority handlers are called first. pcName must
+   stay valid. These return NULL if there is not enough heap or the
+   worker's table is full. */
+IrqSourceHandle_t xIrqDispatchAddSource( const char *pcName, IrqContext_t eContext, UBaseType_t uxPriority,
+                                         IrqHandler_t pxHandler, void *pvContext );
+
+/* Registers the timer's ISR and enables its interrupt. Call after
+   timer_init() and before timer_start(). */
+IrqSourceHandle_t xIrqDispatchAddTimer( timer_group_t xGroup, timer_idx_t xTimer, const char *pcName,
+                                        IrqContext_t eContext, UBaseType_t uxPriority,
+                                        IrqHandler_t pxHandler, void *pvContext );
+
+/* Sets the pin's interrupt type and adds it to the GPIO ISR service;
+   gpio_install_isr_service() must have been called. */
+IrqSourceHandle_t xIrqDispatchAddGpio( gpio_num_t xPin, gpio_int_type_t xIntrType, const char *pcName,
+                                       IrqContext_t eContext, UBaseType_t uxPriority,
+                                       IrqHandler_t pxHandler, void *pvContext );
+
+/* Records one interrupt from xSource: runs an inline handler, or marks the
+   source pending in its worker. */
+void vIrqDispatchRaiseFromISR( IrqSourceHandle_t xSource, BaseType_t *pxHigherPriorityTaskWoken );
+
+/* One line per source: context, priority, interrupts raised and handler
+   calls. The latencies are printed by vIsrLatencyPrintAll(). */
+void vIrqDispatchPrintAll( void );
+
+#endif /* IRQ_DISPATCH_H */
@@ -0,0 +1,132 @@
+/* Interrupt-to-task latency histograms - see isr_latency.h */
+
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "isr_latency.h"
+
+static IsrLatency_t *pxLatencyList;
+static portMUX_TYPE xLatencyLock = portMUX_INITIALIZER_UNLOCKED;
+
+/**************************************************************************/
+
+static UBaseType_t prvBucket( uint32_t ulCycles )
+{
+	UBaseType_t uxLog;
+
+	if( ulCycles < 4 )
+	{
+		return ulCycles;
+	}
+	uxLog = 31 - __builtin_clz( ulCycles );
+	return 4 * ( uxLog - 1 ) + ( ( ulCycles >> ( uxLog - 2 ) ) & 3 );
+}
+
+/* Largest value that lands in uxBucket. */
+static uint32_t prvBucketTop( UBaseType_t uxBucket )
+{
+	UBaseType_t uxLog = uxBucket / 4 + 1;
+
+	if( uxBucket < 4 )
+	{
+		return uxBucket;
+	}
+	return ( uint32_t ) ( ( ( uint64_t ) ( 5 + uxBucket % 4 ) << ( uxLog - 2 ) ) - 1 );
+}
+
+/**************************************************************************/
+
+void vIsrLatencyRegister( IsrLatency_t *pxLatency, const char *pcName )
+{
+	memset( pxLatency, 0, sizeof( IsrLatency_t ) );
+	pxLatency->pcName = pcName;
+
+	taskENTER_CRITICAL( &xLatencyLock );
+	pxLatency->pxNext = pxLatencyList;
+	__atomic_store_n( &pxLatencyList, pxLatency, __ATOMIC_RELEASE );
+	taskEXIT_CRITICAL( &xLatencyLock );
+}
+
+void vIsrLatencyReset( IsrLatency_t *pxLatency )
+{
+	pxLatency->ulPending = 0;
+	pxLatency->ulSamples = 0;
+	pxLatency->ulCoalesced = 0;
+	pxLatency->ulCrossCore = 0;
+	pxLatency->ulMaxCycles = 0;
+	memset( pxLatency->ulBuckets, 0, sizeof( pxLatency->ulBuckets ) );
+}
+
+void vIsrLatencyRecord( IsrLatency_t *pxLatency, uint32_t ulCycles )
+{
+	uint32_t ulMax = __atomic_load_n( &pxLatency->ulMaxCycles, __ATOMIC_RELAXED );
+
+	__atomic_add_fetch( &pxLatency->ulBuckets[ prvBucket( ulCycles ) ], 1, __ATOMIC_RELAXED );
+	__atomic_add_fetch( &pxLatency->ulSamples, 1, __ATOMIC_RELAXED );
+	while( ulCycles > ulMax &&
+	       !__atomic_compare_exchange_n( &pxLatency->ulMaxCycles, &ulMax, ulCycles,
+	                                     pdTRUE, __ATOMIC_RELAXED, __ATOMIC_RELAXED ) )
+	{
+	}
+}
+
+/**************************************************************************/
+
+void vIsrLatencyGetSummary( const IsrLatency_t *pxLatency, IsrLatencySummary_t *pxSummary )
+{
+	static const uint32_t ulPerMille[ 4 ] = { 500, 900, 990, 999 };
+	uint32_t *pulOut[ 4 ] = { &pxSummary->ulP50, &pxSummary->ulP90, &pxSummary->ulP99, &pxSummary->ulP999 };
+	uint32_t ulBuckets[ ISR_LATENCY_BUCKETS ];
+	uint32_t ulTotal = 0, ulSeen = 0;
+	UBaseType_t uxBucket = 0;
+
+	/* The buckets are summed from the copy, so the percentiles agree with
+	   each other even while samples keep arriving. */
+	for( UBaseType_t i = 0; i < ISR_LATENCY_BUCKETS; i++ )
+	{
+		ulBuckets[ i ] = __atomic_load_n( &pxLatency->ulBuckets[ i ], __ATOMIC_RELAXED );
+		ulTotal += ulBuckets[ i ];
+	}
+
+	pxSummary->ulSamples = ulTotal;
+	pxSummary->ulCoalesced = __atomic_load_n( &pxLatency->ulCoalesced, __ATOMIC_RELAXED );
+	pxSummary->ulCrossCore = __atomic_load_n( &pxLatency->ulCrossCore, __ATOMIC_RELAXED );
+	pxSummary->ulMax = __atomic_load_n( &pxLatency->ulMaxCycles, __ATOMIC_RELAXED );
+
+	for( UBaseType_t p = 0; p < 4; p++ )
+	{
+		/* The rank of the sample the percentile falls on, counted from 1. */
+		uint32_t ulRank = ( uint32_t ) ( ( ( uint64_t ) ulTotal * ulPerMille[ p ] + 999 ) / 1000 );
+
+		while( ulTotal != 0 && ulSeen + ulBuckets[ uxBucket ] < ulRank )
+		{
+			ulSeen += ulBuckets[ uxBucket++ ];
+		}
+		*pulOut[ p ] = ( ulTotal == 0 ) ? 0 : prvBucketTop( uxBucket );
+
+		/* The top of the bucket may be above anything actually seen. */
+		if( *pulOut[ p ] > pxSummary->ulMax )
+		{
+			*pulOut[ p ] = pxSummary->ulMax;
+		}
+	}
+}
+
+void vIsrLatencyPrintAll( void )
+{
+	const IsrLatency_t *pxLatency = __atomic_load_n( &pxLatencyList, __ATOMIC_ACQUIRE );
+	IsrLatencySummary_t xSummary;
+
+	printf("%-10s %8s %8s %6s %9s %9s %9s %9s %9s %9s %9s\r\n", "source", "samples", "coalesc", "xcore",
+	       "p50_cyc", "p90_cyc", "p99_cyc", "p999_cyc", "max_cyc", "p99_us", "max_us");
+
+	for( ; pxLatency != NULL; pxLatency = pxLatency->pxNext )
+	{
+		vIsrLatencyGetSummary( pxLatency, &xSummary );
+		printf("%-10s %8u %8u %6u %9u %9u %9u %9u %9u %9.1f %9.1f\r\n", pxLatency->pcName,
+		       xSummary.ulSamples, xSummary.ulCoalesced, xSummary.ulCrossCore,
+		       xSummary.ulP50, xSummary.ulP90, xSummary.ulP99, xSummary.ulP999, xSummary.ulMax,
+		       fIsrLatencyCyclesToUs( xSummary.ulP99 ), fIsrLatencyCyclesToUs( xSummary.ulMax ));
+	}
+}
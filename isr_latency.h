@@ -0,0 +1,139 @@
+/* Interrupt-to-task latency histograms
+
+   How long after an interrupt does the task that handles it actually run?
+   The ISR stamps the CPU cycle counter into the source's histogram, and the
+   task, once it resumes, takes the difference:
+
+   static IsrLatency_t xTimer0Latency;
+
+   vIsrLatencyRegister( &xTimer0Latency, "TIMER_0" );
+
+   static void IRAM_ATTR timer_group0_isr( void *para )
+   {
+       vIsrLatencyStamp( &xTimer0Latency );
+       ...
+   }
+
+   static void example_evt_task( void *pvParameters )
+   {
+       ...
+       xIsrSignalTake( xSignal, portMAX_DELAY );
+       vIsrLatencyResume( &xTimer0Latency );
+       ...
+   }
+
+   vIsrLatencyPrintAll();    (whenever the numbers are wanted)
+
+   A stamp stays pending until the task resumes; a second interrupt from
+   the same source before then keeps the first stamp, since that is the
+   event that has waited longest, and is counted as coalesced. A resume with
+   nothing pending records nothing, so a task that handles several sources
+   can simply resume all of them after every wake.
+
+   Cycle counters are per core. A resume on another core than the stamp's
+   is counted and dropped, so pin the task to the core the interrupt is
+   allocated on (the core that registered it).
+
+   Samples land in log-linear buckets, four per power of two, so a
+   percentile read back from the histogram is within 25% of the true value;
+   the maximum is kept exactly. Stamping is a cycle counter read and two
+   stores, resuming a subtraction, a count-leading-zeros and a few relaxed
+   atomic adds, so the instrumentation can stay in the code it measures.
+*/
+#ifndef ISR_LATENCY_H
+#define ISR_LATENCY_H
+
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "soc/cpu.h"
+#include "sdkconfig.h"
+
+/* Buckets 0-3 hold 0-3 cycles exactly; from there on each power of two is
+   split in four, up to 2^32 cycles. */
+#define ISR_LATENCY_BUCKETS         124
+
+typedef struct
+{
+	uint32_t ulSamples;
+	uint32_t ulCoalesced;   /* interrupts that found a stamp still pending */
+	uint32_t ulCrossCore;   /* resumes dropped for running on another core */
+	uint32_t ulP50;         /* cycles, from the histogram */
+	uint32_t ulP90;
+	uint32_t ulP99;
+	uint32_t ulP999;
+	uint32_t ulMax;         /* cycles, exact */
+} IsrLatencySummary_t;
+
+typedef struct IsrLatency
+{
+	const char        *pcName;
+	volatile uint32_t  ulStamp;
+	volatile uint32_t  ulStampCore;
+	uint32_t           ulPending;
+	uint32_t           ulSamples;
+	uint32_t           ulCoalesced;
+	uint32_t           ulCrossCore;
+	uint32_t           ulMaxCycles;
+	uint32_t           ulBuckets[ ISR_LATENCY_BUCKETS ];
+	struct IsrLatency *pxNext;
+} IsrLatency_t;
+
+/* Clears the histogram and links it into the list vIsrLatencyPrintAll()
+   prints. pcName must stay valid for as long as the histogram is linked. */
+void vIsrLatencyRegister( IsrLatency_t *pxLatency, const char *pcName );
+
+/* Clears the counters of a registered histogram, e.g. between runs. Don't
+   call it while the source can interrupt. */
+void vIsrLatencyReset( IsrLatency_t *pxLatency );
+
+void vIsrLatencyRecord( IsrLatency_t *pxLatency, uint32_t ulCycles );
+
+void vIsrLatencyGetSummary( const IsrLatency_t *pxLatency, IsrLatencySummary_t *pxSummary );
+
+/* Prints samples, coalesced and cross-core counts and the percentiles of
+   every histogram, in cycles and microseconds. */
+void vIsrLatencyPrintAll( void );
+
+/* Call first thing in the ISR. */
+static inline void vIsrLatencyStamp( IsrLatency_t *pxLatency )
+{
+	uint32_t ulNow = esp_cpu_get_ccount();
+
+	if( __atomic_load_n( &pxLatency->ulPending, __ATOMIC_RELAXED ) != 0 )
+	{
+		__atomic_add_fetch( &pxLatency->ulCoalesced, 1, __ATOMIC_RELAXED );
+		return;
+	}
+	pxLatency->ulStamp = ulNow;
+	pxLatency->ulStampCore = ( uint32_t ) xPortGetCoreID();
+	__atomic_store_n( &pxLatency->ulPending, 1, __ATOMIC_RELEASE );
+}
+
+/* Call first thing after the task wakes. */
+static inline void vIsrLatencyResume( IsrLatency_t *pxLatency )
+{
+	uint32_t ulNow = esp_cpu_get_ccount();
+
+	if( __atomic_load_n( &pxLatency->ulPending, __ATOMIC_ACQUIRE ) == 0 )
+	{
+		return;
+	}
+
+	if( pxLatency->ulStampCore != ( uint32_t ) xPortGetCoreID() )
+	{
+		__atomic_add_fetch( &pxLatency->ulCrossCore, 1, __ATOMIC_RELAXED );
+	}
+	else
+	{
+		vIsrLatencyRecord( pxLatency, ulNow - pxLatency->ulStamp );
+	}
+	__atomic_store_n( &pxLatency->ulPending, 0, __ATOMIC_RELEASE );
+}
+
+static inline float fIsrLatencyCyclesToUs( uint32_t ulCycles )
+{
+	return ( float ) ulCycles / CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ;
+}
+
+#endif /* ISR_LATENCY_H */
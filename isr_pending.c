@@ -0,0 +1,128 @@
+/* Per-source pending interrupt counts - see isr_pending.h
+
+   The ISR adds to the source's counter before setting its bit, and the
+   task clears the mask before taking the counters. An interrupt that lands
+   between the two is either taken with this drain, leaving a bit behind
+   whose counter reads 0 on the next one (skipped), or sets its bit after
+   the mask was cleared and wakes the task again. Either way no interrupt
+   is lost or counted twice.
+*/
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_attr.h"
+#include "isr_signal.h"
+#include "isr_pending.h"
+
+struct IsrPending
+{
+	uint32_t          ulMask;
+	uint32_t          ulCounts[ ISR_PENDING_MAX_SOURCES ];
+	IsrSignalHandle_t xWake;
+	IsrPendingStats_t xStats;
+};
+
+/**************************************************************************/
+
+IsrPendingHandle_t xIsrPendingCreate( void )
+{
+	struct IsrPending *pxPending = pvPortMalloc( sizeof( struct IsrPending ) );
+
+	if( pxPending == NULL )
+	{
+		return NULL;
+	}
+
+	memset( pxPending, 0, sizeof( struct IsrPending ) );
+	pxPending->xWake = xIsrSignalCreateBinary();
+	if( pxPending->xWake == NULL )
+	{
+		vPortFree( pxPending );
+		return NULL;
+	}
+	return pxPending;
+}
+
+/* Returns pdTRUE if the task has to be woken. */
+static inline BaseType_t prvSet( struct IsrPending *pxPending, UBaseType_t uxSource )
+{
+	uint32_t ulBit = 1UL << uxSource;
+
+	__atomic_add_fetch( &pxPending->xStats.ulRaised, 1, __ATOMIC_RELAXED );
+	__atomic_add_fetch( &pxPending->ulCounts[ uxSource ], 1, __ATOMIC_RELAXED );
+	if( __atomic_fetch_or( &pxPending->ulMask, ulBit, __ATOMIC_RELEASE ) != 0 )
+	{
+		return pdFALSE;
+	}
+	__atomic_add_fetch( &pxPending->xStats.ulWakeups, 1, __ATOMIC_RELAXED );
+	return pdTRUE;
+}
+
+void IRAM_ATTR vIsrPendingSetFromISR( IsrPendingHandle_t xPending, UBaseType_t uxSource, BaseType_t *pxHigherPriorityTaskWoken )
+{
+	if( prvSet( xPending, uxSource ) )
+	{
+		xIsrSignalGiveFromISR( xPending->xWake, pxHigherPriorityTaskWoken );
+	}
+}
+
+void vIsrPendingSet( IsrPendingHandle_t xPending, UBaseType_t uxSource )
+{
+	if( prvSet( xPending, uxSource ) )
+	{
+		xIsrSignalGive( xPending->xWake );
+	}
+}
+
+/**************************************************************************/
+
+uint32_t ulIsrPendingWait( IsrPendingHandle_t xPending, uint32_t pulCounts[ ISR_PENDING_MAX_SOURCES ],
+                           TickType_t xTicksToWait )
+{
+	TimeOut_t xTimeOut;
+	uint32_t ulMask, ulTaken, ulCount;
+	UBaseType_t uxSource;
+
+	vTaskSetTimeOutState( &xTimeOut );
+
+	for(;;)
+	{
+		ulMask = __atomic_exchange_n( &xPending->ulMask, 0, __ATOMIC_ACQUIRE );
+		ulTaken = 0;
+
+		while( ulMask != 0 )
+		{
+			uxSource = __builtin_ctz( ulMask );
+			ulMask &= ulMask - 1;
+
+			ulCount = __atomic_exchange_n( &xPending->ulCounts[ uxSource ], 0, __ATOMIC_RELAXED );
+			if( ulCount != 0 )
+			{
+				pulCounts[ uxSource ] = ulCount;
+				ulTaken |= 1UL << uxSource;
+			}
+		}
+
+		if( ulTaken != 0 )
+		{
+			__atomic_add_fetch( &xPending->xStats.ulDrains, 1, __ATOMIC_RELAXED );
+			return ulTaken;
+		}
+
+		/* Nothing pending, or only bits whose counts an earlier drain took
+		   already. */
+		if( xTaskCheckForTimeOut( &xTimeOut, &xTicksToWait ) != pdFALSE ||
+		    xIsrSignalTake( xPending->xWake, xTicksToWait ) != pdTRUE )
+		{
+			return 0;
+		}
+	}
+}
+
+void vIsrPendingGetStats( IsrPendingHandle_t xPending, IsrPendingStats_t *pxStats )
+{
+	pxStats->ulRaised = __atomic_load_n( &xPending->xStats.ulRaised, __ATOMIC_RELAXED );
+	pxStats->ulWakeups = __atomic_load_n( &xPending->xStats.ulWakeups, __ATOMIC_RELAXED );
+	pxStats->ulDrains = __atomic_load_n( &xPending->xStats.ulDrains, __ATOMIC_RELAXED );
+}
@@ -0,0 +1,63 @@
+/* Per-source pending interrupt counts
+
+   When several interrupts share one handler task through a single
+   semaphore and a "last source" variable, two interrupts that arrive before
+   the task runs leave only the second source behind, and the count no
+   longer says which source fired how often. Here each source has its own
+   bit in a pending mask and its own counter, both updated with atomics in
+   the ISR, and the task takes everything pending at once:
+
+   xPending = xIsrPendingCreate();
+
+   (in the ISR)
+   vIsrPendingSetFromISR( xPending, FROM_TIMER_0, &xHigherPriorityTaskWoken );
+
+   (in the task)
+   ulSources = ulIsrPendingWait( xPending, ulCounts, portMAX_DELAY );
+   while( ulSources != 0 )
+   {
+       uxSource = __builtin_ctz( ulSources );
+       ulSources &= ulSources - 1;
+       ... ulCounts[ uxSource ] interrupts from uxSource ...
+   }
+
+   Only the interrupt that finds nothing pending wakes the task; the ones
+   that follow before it drains just count, so a burst costs one wakeup.
+   The wakeup is a binary signal (isr_signal.h), so the task that waits
+   must not use its direct-to-task notification for anything else.
+*/
+#ifndef ISR_PENDING_H
+#define ISR_PENDING_H
+
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+
+/* One bit of the pending mask per source. */
+#define ISR_PENDING_MAX_SOURCES     32
+
+typedef struct
+{
+	uint32_t ulRaised;      /* interrupts counted */
+	uint32_t ulWakeups;     /* interrupts that found nothing pending and woke the task */
+	uint32_t ulDrains;      /* waits that returned sources */
+} IsrPendingStats_t;
+
+typedef struct IsrPending * IsrPendingHandle_t;
+
+/* Returns NULL if there is not enough heap. */
+IsrPendingHandle_t xIsrPendingCreate( void );
+
+/* Counts one interrupt from uxSource, below ISR_PENDING_MAX_SOURCES. */
+void vIsrPendingSetFromISR( IsrPendingHandle_t xPending, UBaseType_t uxSource, BaseType_t *pxHigherPriorityTaskWoken );
+void vIsrPendingSet( IsrPendingHandle_t xPending, UBaseType_t uxSource );
+
+/* Waits up to xTicksToWait for any source to be pending, then takes all of
+   them. Returns the mask of sources taken, with pulCounts[ n ] set to the
+   interrupts counted for source n since it was last taken; entries of
+   sources not in the mask are left alone. Returns 0 on timeout. */
+uint32_t ulIsrPendingWait( IsrPendingHandle_t xPending, uint32_t pulCounts[ ISR_PENDING_MAX_SOURCES ],
+                           TickType_t xTicksToWait );
+
+void vIsrPendingGetStats( IsrPendingHandle_t xPending, IsrPendingStats_t *pxStats );
+
+#endif /* ISR_PENDING_H */
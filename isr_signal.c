@@ -0,0 +1,112 @@
+/* ISR-to-task signals on task notifications - see isr_signal.h
+
+   Until the owner's first take, xTask is NULL and gives are counted in
+   ulEarlyGives under xSignalLock. The first take claims the signal under
+   the same lock and moves those gives into its notification value, after
+   which the lock is never taken again.
+*/
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_attr.h"
+#include "isr_signal.h"
+
+struct IsrSignal
+{
+	TaskHandle_t  xTask;
+	BaseType_t    xClearOnTake;     /* pdTRUE for a binary signal */
+	uint32_t      ulEarlyGives;
+	portMUX_TYPE  xSignalLock;
+};
+
+/**************************************************************************/
+
+static IsrSignalHandle_t prvCreate( BaseType_t xClearOnTake )
+{
+	const portMUX_TYPE xUnlocked = portMUX_INITIALIZER_UNLOCKED;
+	struct IsrSignal *pxSignal = pvPortMalloc( sizeof( struct IsrSignal ) );
+
+	if( pxSignal != NULL )
+	{
+		pxSignal->xTask = NULL;
+		pxSignal->xClearOnTake = xClearOnTake;
+		pxSignal->ulEarlyGives = 0;
+		pxSignal->xSignalLock = xUnlocked;
+	}
+	return pxSignal;
+}
+
+IsrSignalHandle_t xIsrSignalCreateBinary( void )
+{
+	return prvCreate( pdTRUE );
+}
+
+IsrSignalHandle_t xIsrSignalCreateCounting( void )
+{
+	return prvCreate( pdFALSE );
+}
+
+/**************************************************************************/
+
+/* pdTRUE if the give was kept for the first take. */
+static BaseType_t IRAM_ATTR prvGiveEarly( struct IsrSignal *pxSignal )
+{
+	BaseType_t xKept;
+
+	taskENTER_CRITICAL_ISR( &pxSignal->xSignalLock );
+	xKept = ( pxSignal->xTask == NULL );
+	if( xKept )
+	{
+		pxSignal->ulEarlyGives++;
+	}
+	taskEXIT_CRITICAL_ISR( &pxSignal->xSignalLock );
+	return xKept;
+}
+
+BaseType_t IRAM_ATTR xIsrSignalGiveFromISR( IsrSignalHandle_t xSignal, BaseType_t *pxHigherPriorityTaskWoken )
+{
+	TaskHandle_t xTask = __atomic_load_n( &xSignal->xTask, __ATOMIC_ACQUIRE );
+
+	if( xTask == NULL && prvGiveEarly( xSignal ) )
+	{
+		return pdPASS;
+	}
+	vTaskNotifyGiveFromISR( __atomic_load_n( &xSignal->xTask, __ATOMIC_ACQUIRE ), pxHigherPriorityTaskWoken );
+	return pdPASS;
+}
+
+BaseType_t xIsrSignalGive( IsrSignalHandle_t xSignal )
+{
+	TaskHandle_t xTask = __atomic_load_n( &xSignal->xTask, __ATOMIC_ACQUIRE );
+
+	if( xTask == NULL && prvGiveEarly( xSignal ) )
+	{
+		return pdPASS;
+	}
+	return xTaskNotifyGive( __atomic_load_n( &xSignal->xTask, __ATOMIC_ACQUIRE ) );
+}
+
+BaseType_t xIsrSignalTake( IsrSignalHandle_t xSignal, TickType_t xTicksToWait )
+{
+	uint32_t ulEarly;
+
+	if( xSignal->xTask == NULL )
+	{
+		taskENTER_CRITICAL( &xSignal->xSignalLock );
+		__atomic_store_n( &xSignal->xTask, xTaskGetCurrentTaskHandle(), __ATOMIC_RELEASE );
+		ulEarly = xSignal->ulEarlyGives;
+		taskEXIT_CRITICAL( &xSignal->xSignalLock );
+
+		/* This take consumes one; the rest wait in the notification value. */
+		if( ulEarly != 0 )
+		{
+			while( !xSignal->xClearOnTake && --ulEarly != 0 )
+			{
+				xTaskNotifyGive( xSignal->xTask );
+			}
+			return pdTRUE;
+		}
+	}
+
+	return ( ulTaskNotifyTake( xSignal->xClearOnTake, xTicksToWait ) != 0 ) ? pdTRUE : pdFALSE;
+}
@@ -0,0 +1,42 @@
+/* ISR-to-task signals on task notifications
+
+   xSemaphoreGiveFromISR() is a queue send: it takes the queue's lock,
+   copies a zero-length item, walks the queue's waiting lists and only then
+   unblocks the task. When exactly one task ever waits - the task that
+   handles an interrupt - the task's own notification value can do the
+   same job with a fraction of that work. These calls wrap it behind the
+   semaphore calls they replace:
+
+   xCountingSemaphore = xSemaphoreCreateCounting( 10, 0 );   ->  xSignal = xIsrSignalCreateCounting();
+   xSemaphoreGiveFromISR( xCountingSemaphore, &xWoken );     ->  xIsrSignalGiveFromISR( xSignal, &xWoken );
+   xSemaphoreTake( xCountingSemaphore, portMAX_DELAY );      ->  xIsrSignalTake( xSignal, portMAX_DELAY );
+
+   A binary signal latches any number of gives into one take, like a binary
+   semaphore; a counting signal returns one take per give, without a
+   maximum count.
+
+   The signal belongs to the first task that takes it: only that task may
+   take it afterwards, and its notification value is used, so it must not
+   also wait on direct-to-task notifications itself. Gives that arrive
+   before the first take are kept and returned by it.
+*/
+#ifndef ISR_SIGNAL_H
+#define ISR_SIGNAL_H
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+typedef struct IsrSignal * IsrSignalHandle_t;
+
+/* Return NULL if there is not enough heap. */
+IsrSignalHandle_t xIsrSignalCreateBinary( void );
+IsrSignalHandle_t xIsrSignalCreateCounting( void );
+
+/* Always pdPASS: a give can't fail. */
+BaseType_t xIsrSignalGiveFromISR( IsrSignalHandle_t xSignal, BaseType_t *pxHigherPriorityTaskWoken );
+BaseType_t xIsrSignalGive( IsrSignalHandle_t xSignal );
+
+/* pdTRUE if a give was taken, pdFALSE if xTicksToWait passed first. */
+BaseType_t xIsrSignalTake( IsrSignalHandle_t xSignal, TickType_t xTicksToWait );
+
+#endif /* ISR_SIGNAL_H */
@@ -0,0 +1,260 @@
+/* Queue telemetry - see queue_monitor.h */
+
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "queue_monitor.h"
+
+/* Overwrite-oldest discards one item and retries; more attempts than this
+   means other senders are racing for the same slots. */
+#define queueOVERWRITE_ATTEMPTS     3
+
+struct MonitoredQueue
+{
+	QueueHandle_t         xQueue;
+	QueueOverflowPolicy_t ePolicy;
+	void                 *pvDiscard;    /* where overwritten items are received to */
+	QueueMonitor_t        xMonitor;
+};
+
+static QueueMonitor_t *pxMonitorList;
+static portMUX_TYPE xMonitorLock = portMUX_INITIALIZER_UNLOCKED;
+
+/**************************************************************************/
+
+void vQueueMonitorRegister( QueueMonitor_t *pxMonitor, const char *pcName, UBaseType_t uxLength )
+{
+	memset( &pxMonitor->xStats, 0, sizeof( pxMonitor->xStats ) );
+	pxMonitor->pcName = pcName;
+	pxMonitor->uxLength = uxLength;
+
+	taskENTER_CRITICAL( &xMonitorLock );
+	pxMonitor->pxNext = pxMonitorList;
+	__atomic_store_n( &pxMonitorList, pxMonitor, __ATOMIC_RELEASE );
+	taskEXIT_CRITICAL( &xMonitorLock );
+}
+
+/* Don't call this while a monitor task may be walking the list. */
+void vQueueMonitorUnregister( QueueMonitor_t *pxMonitor )
+{
+	QueueMonitor_t **ppxLink;
+
+	taskENTER_CRITICAL( &xMonitorLock );
+	for( ppxLink = &pxMonitorList; *ppxLink != NULL; ppxLink = &( *ppxLink )->pxNext )
+	{
+		if( *ppxLink == pxMonitor )
+		{
+			*ppxLink = pxMonitor->pxNext;
+			break;
+		}
+	}
+	taskEXIT_CRITICAL( &xMonitorLock );
+}
+
+void vQueueMonitorGetStats( const QueueMonitor_t *pxMonitor, QueueStats_t *pxStats )
+{
+	const QueueStats_t *pxSrc = &pxMonitor->xStats;
+
+	pxStats->ulSends = __atomic_load_n( &pxSrc->ulSends, __ATOMIC_RELAXED );
+	pxStats->ulReceives = __atomic_load_n( &pxSrc->ulReceives, __ATOMIC_RELAXED );
+	pxStats->ulFullRejects = __atomic_load_n( &pxSrc->ulFullRejects, __ATOMIC_RELAXED );
+	pxStats->ulEmptyTimeouts = __atomic_load_n( &pxSrc->ulEmptyTimeouts, __ATOMIC_RELAXED );
+	pxStats->ulHighWater = __atomic_load_n( &pxSrc->ulHighWater, __ATOMIC_RELAXED );
+	pxStats->ulSendBlockedTicks = __atomic_load_n( &pxSrc->ulSendBlockedTicks, __ATOMIC_RELAXED );
+	pxStats->ulReceiveBlockedTicks = __atomic_load_n( &pxSrc->ulReceiveBlockedTicks, __ATOMIC_RELAXED );
+	pxStats->ulDroppedNewest = __atomic_load_n( &pxSrc->ulDroppedNewest, __ATOMIC_RELAXED );
+	pxStats->ulOverwrittenOldest = __atomic_load_n( &pxSrc->ulOverwrittenOldest, __ATOMIC_RELAXED );
+}
+
+const QueueMonitor_t *pxQueueMonitorNext( const QueueMonitor_t *pxMonitor )
+{
+	if( pxMonitor == NULL )
+	{
+		return __atomic_load_n( &pxMonitorList, __ATOMIC_ACQUIRE );
+	}
+	return pxMonitor->pxNext;
+}
+
+/**************************************************************************/
+
+void vQueueMonitorPrintAll( void )
+{
+	const QueueMonitor_t *pxMonitor = NULL;
+	QueueStats_t xStats;
+
+	printf("%-12s %10s %10s %8s %8s %9s %10s %10s %8s %8s\r\n", "queue", "sends", "receives", "full",
+	       "empty", "high", "tx_blk_t", "rx_blk_t", "dropped", "overwr");
+
+	while( ( pxMonitor = pxQueueMonitorNext( pxMonitor ) ) != NULL )
+	{
+		vQueueMonitorGetStats( pxMonitor, &xStats );
+		printf("%-12s %10u %10u %8u %8u %5u/%-3u %10u %10u %8u %8u\r\n", pxMonitor->pcName,
+		       xStats.ulSends, xStats.ulReceives, xStats.ulFullRejects, xStats.ulEmptyTimeouts,
+		       xStats.ulHighWater, ( unsigned ) pxMonitor->uxLength,
+		       xStats.ulSendBlockedTicks, xStats.ulReceiveBlockedTicks,
+		       xStats.ulDroppedNewest, xStats.ulOverwrittenOldest);
+	}
+}
+
+static void prvMonitorTask( void *pvParameters )
+{
+	const TickType_t xPeriod = pdMS_TO_TICKS( ( uint32_t ) ( uintptr_t ) pvParameters );
+	TickType_t xLastWakeTime = xTaskGetTickCount();
+
+	for(;;)
+	{
+		vTaskDelayUntil( &xLastWakeTime, xPeriod );
+		vQueueMonitorPrintAll();
+	}
+}
+
+BaseType_t xQueueMonitorStartTask( UBaseType_t uxPriority, uint32_t ulPeriodMs )
+{
+	return xTaskCreate( prvMonitorTask, "QueueMonitor", QUEUE_MONITOR_STACK_SIZE,
+	                    ( void * ) ( uintptr_t ) ulPeriodMs, uxPriority, NULL );
+}
+
+/**************************************************************************/
+
+MonitoredQueueHandle_t xMonitoredQueueCreate( UBaseType_t uxLength, UBaseType_t uxItemSize, const char *pcName )
+{
+	struct MonitoredQueue *pxQueue = pvPortMalloc( sizeof( struct MonitoredQueue ) + uxItemSize );
+
+	if( pxQueue == NULL )
+	{
+		return NULL;
+	}
+
+	pxQueue->xQueue = xQueueCreate( uxLength, uxItemSize );
+	if( pxQueue->xQueue == NULL )
+	{
+		vPortFree( pxQueue );
+		return NULL;
+	}
+
+	/* Senders overwriting at the same time may share it: the contents are
+	   thrown away anyway. */
+	pxQueue->pvDiscard = pxQueue + 1;
+
+	pxQueue->ePolicy = eQueueOverflowBlock;
+	vQueueMonitorRegister( &pxQueue->xMonitor, pcName, uxLength );
+	return pxQueue;
+}
+
+void vMonitoredQueueDelete( MonitoredQueueHandle_t xQueue )
+{
+	vQueueMonitorUnregister( &xQueue->xMonitor );
+	vQueueDelete( xQueue->xQueue );
+	vPortFree( xQueue );
+}
+
+void vMonitoredQueueSetOverflowPolicy( MonitoredQueueHandle_t xQueue, QueueOverflowPolicy_t ePolicy )
+{
+	xQueue->ePolicy = ePolicy;
+}
+
+/**************************************************************************/
+
+/* Counts the outcome of a send made under any policy. */
+static BaseType_t prvSendDone( struct MonitoredQueue *pxQueue, BaseType_t xStatus )
+{
+	if( xStatus == pdPASS )
+	{
+		/* A plain read of the item count; the lock uxQueueMessagesWaiting()
+		   takes would cost more than the send. */
+		vQueueMonitorSent( &pxQueue->xMonitor, 1, uxQueueMessagesWaitingFromISR( pxQueue->xQueue ) );
+	}
+	else if( pxQueue->ePolicy == eQueueOverflowBlock )
+	{
+		vQueueMonitorFull( &pxQueue->xMonitor );
+	}
+	else
+	{
+		vQueueMonitorDropped( &pxQueue->xMonitor );
+	}
+	return xStatus;
+}
+
+BaseType_t xMonitoredQueueSend( MonitoredQueueHandle_t xQueue, const void *pvItem, TickType_t xTicksToWait )
+{
+	TickType_t xStart;
+	BaseType_t xStatus;
+
+	if( xQueue->ePolicy != eQueueOverflowBlock )
+	{
+		xStatus = xQueueSendToBack( xQueue->xQueue, pvItem, 0 );
+
+		/* Discarding the oldest item and queueing the new one are two
+		   constant-time queue operations. */
+		for( int i = 0; xStatus != pdPASS && xQueue->ePolicy == eQueueOverflowOverwriteOldest &&
+		                i < queueOVERWRITE_ATTEMPTS; i++ )
+		{
+			if( xQueueReceive( xQueue->xQueue, xQueue->pvDiscard, 0 ) == pdPASS )
+			{
+				vQueueMonitorOverwritten( &xQueue->xMonitor );
+			}
+			xStatus = xQueueSendToBack( xQueue->xQueue, pvItem, 0 );
+		}
+		return prvSendDone( xQueue, xStatus );
+	}
+
+	xStart = ( xTicksToWait != 0 ) ? xTaskGetTickCount() : 0;
+	xStatus = xQueueSendToBack( xQueue->xQueue, pvItem, xTicksToWait );
+
+	if( xTicksToWait != 0 )
+	{
+		vQueueMonitorBlocked( &xQueue->xMonitor, pdTRUE, xTaskGetTickCount() - xStart );
+	}
+	return prvSendDone( xQueue, xStatus );
+}
+
+BaseType_t xMonitoredQueueSendFromISR( MonitoredQueueHandle_t xQueue, const void *pvItem, BaseType_t *pxHigherPriorityTaskWoken )
+{
+	BaseType_t xStatus = xQueueSendToBackFromISR( xQueue->xQueue, pvItem, pxHigherPriorityTaskWoken );
+
+	for( int i = 0; xStatus != pdPASS && xQueue->ePolicy == eQueueOverflowOverwriteOldest &&
+	                i < queueOVERWRITE_ATTEMPTS; i++ )
+	{
+		if( xQueueReceiveFromISR( xQueue->xQueue, xQueue->pvDiscard, pxHigherPriorityTaskWoken ) == pdPASS )
+		{
+			vQueueMonitorOverwritten( &xQueue->xMonitor );
+		}
+		xStatus = xQueueSendToBackFromISR( xQueue->xQueue, pvItem, pxHigherPriorityTaskWoken );
+	}
+	return prvSendDone( xQueue, xStatus );
+}
+
+BaseType_t xMonitoredQueueReceive( MonitoredQueueHandle_t xQueue, void *pvBuffer, TickType_t xTicksToWait )
+{
+	TickType_t xStart = ( xTicksToWait != 0 ) ? xTaskGetTickCount() : 0;
+	BaseType_t xStatus = xQueueReceive( xQueue->xQueue, pvBuffer, xTicksToWait );
+
+	if( xTicksToWait != 0 )
+	{
+		vQueueMonitorBlocked( &xQueue->xMonitor, pdFALSE, xTaskGetTickCount() - xStart );
+	}
+
+	if( xStatus == pdPASS )
+	{
+		vQueueMonitorReceived( &xQueue->xMonitor, 1 );
+	}
+	else
+	{
+		vQueueMonitorEmpty( &xQueue->xMonitor );
+	}
+	return xStatus;
+}
+
+/**************************************************************************/
+
+QueueHandle_t xMonitoredQueueGetQueue( MonitoredQueueHandle_t xQueue )
+{
+	return xQueue->xQueue;
+}
+
+QueueMonitor_t *pxMonitoredQueueGetMonitor( MonitoredQueueHandle_t xQueue )
+{
+	return &xQueue->xMonitor;
+}
@@ -0,0 +1,165 @@
+/* Queue telemetry
+
+   Counters that tell how a queue is coping, cheap enough to leave on:
+
+   ulSends / ulReceives         items that went in / came out
+   ulFullRejects                sends that gave up because the queue stayed full
+   ulEmptyTimeouts              receives that gave up because it stayed empty
+   ulHighWater                  most items ever waiting at once
+   ulSendBlockedTicks           ticks senders spent blocked waiting for room
+   ulReceiveBlockedTicks        ticks receivers spent blocked waiting for items
+   ulDroppedNewest              items not queued because of eQueueOverflowDropNewest
+   ulOverwrittenOldest          items discarded by eQueueOverflowOverwriteOldest
+
+   Recording costs a few relaxed atomic adds per call, and two tick count reads
+   when the call is allowed to block. Every monitored queue is linked into one
+   list under a name, so a monitor task can read all of them without knowing
+   where they were created; xQueueMonitorStartTask() starts one that prints
+   the table periodically.
+
+   A monitored FreeRTOS queue is used through the xMonitoredQueue calls, which
+   take the same arguments as the xQueue calls they replace:
+
+   xQueue = xMonitoredQueueCreate( 3, sizeof( Voltage_t ), "voltage" );
+   xMonitoredQueueSend( xQueue, &voltage, 0 );
+   xMonitoredQueueReceive( xQueue, &fReceivedVoltage, xTicksToWait );
+
+   A monitored queue also has an overflow policy that decides what a send to
+   a full queue does:
+
+   eQueueOverflowBlock           wait up to xTicksToWait, then fail (the
+                                 xQueueSendToBack() behaviour, and the default)
+   eQueueOverflowDropNewest      fail at once and count the item as dropped
+   eQueueOverflowOverwriteOldest discard the oldest item to make room, so the
+                                 freshest data always gets through and the
+                                 sender never blocks
+
+   The batch queue (batch_queue.h) keeps the same counters itself.
+*/
+#ifndef QUEUE_MONITOR_H
+#define QUEUE_MONITOR_H
+
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+#define QUEUE_MONITOR_STACK_SIZE    2048
+
+typedef struct
+{
+	uint32_t ulSends;
+	uint32_t ulReceives;
+	uint32_t ulFullRejects;
+	uint32_t ulEmptyTimeouts;
+	uint32_t ulHighWater;
+	uint32_t ulSendBlockedTicks;
+	uint32_t ulReceiveBlockedTicks;
+	uint32_t ulDroppedNewest;
+	uint32_t ulOverwrittenOldest;
+} QueueStats_t;
+
+typedef enum
+{
+	eQueueOverflowBlock = 0,
+	eQueueOverflowDropNewest,
+	eQueueOverflowOverwriteOldest
+} QueueOverflowPolicy_t;
+
+/* Telemetry of one queue. Embedded in whatever implements the queue. */
+typedef struct QueueMonitor
+{
+	const char          *pcName;
+	UBaseType_t          uxLength;
+	QueueStats_t         xStats;
+	struct QueueMonitor *pxNext;
+} QueueMonitor_t;
+
+/* Links pxMonitor into the list read by the monitor task. pcName must stay
+   valid for as long as the queue exists. */
+void vQueueMonitorRegister( QueueMonitor_t *pxMonitor, const char *pcName, UBaseType_t uxLength );
+void vQueueMonitorUnregister( QueueMonitor_t *pxMonitor );
+
+/* Snapshot of the counters; each one is read atomically. */
+void vQueueMonitorGetStats( const QueueMonitor_t *pxMonitor, QueueStats_t *pxStats );
+
+/* Walks the registered queues: pass NULL to get the first. */
+const QueueMonitor_t *pxQueueMonitorNext( const QueueMonitor_t *pxMonitor );
+
+/* Prints one line per registered queue. */
+void vQueueMonitorPrintAll( void );
+
+/* Starts a task that calls vQueueMonitorPrintAll() every ulPeriodMs. */
+BaseType_t xQueueMonitorStartTask( UBaseType_t uxPriority, uint32_t ulPeriodMs );
+
+/* Recording, for queue implementations. uxWaiting is the number of items
+   waiting right after the send. */
+static inline void vQueueMonitorSent( QueueMonitor_t *pxMonitor, UBaseType_t uxItems, UBaseType_t uxWaiting )
+{
+	uint32_t ulHigh = __atomic_load_n( &pxMonitor->xStats.ulHighWater, __ATOMIC_RELAXED );
+
+	__atomic_add_fetch( &pxMonitor->xStats.ulSends, uxItems, __ATOMIC_RELAXED );
+	while( uxWaiting > ulHigh &&
+	       !__atomic_compare_exchange_n( &pxMonitor->xStats.ulHighWater, &ulHigh, uxWaiting,
+	                                     pdTRUE, __ATOMIC_RELAXED, __ATOMIC_RELAXED ) )
+	{
+	}
+}
+
+static inline void vQueueMonitorReceived( QueueMonitor_t *pxMonitor, UBaseType_t uxItems )
+{
+	__atomic_add_fetch( &pxMonitor->xStats.ulReceives, uxItems, __ATOMIC_RELAXED );
+}
+
+static inline void vQueueMonitorFull( QueueMonitor_t *pxMonitor )
+{
+	__atomic_add_fetch( &pxMonitor->xStats.ulFullRejects, 1, __ATOMIC_RELAXED );
+}
+
+static inline void vQueueMonitorEmpty( QueueMonitor_t *pxMonitor )
+{
+	__atomic_add_fetch( &pxMonitor->xStats.ulEmptyTimeouts, 1, __ATOMIC_RELAXED );
+}
+
+static inline void vQueueMonitorBlocked( QueueMonitor_t *pxMonitor, BaseType_t xSending, TickType_t xTicks )
+{
+	if( xTicks != 0 )
+	{
+		__atomic_add_fetch( xSending ? &pxMonitor->xStats.ulSendBlockedTicks : &pxMonitor->xStats.ulReceiveBlockedTicks,
+		                    xTicks, __ATOMIC_RELAXED );
+	}
+}
+
+static inline void vQueueMonitorDropped( QueueMonitor_t *pxMonitor )
+{
+	__atomic_add_fetch( &pxMonitor->xStats.ulDroppedNewest, 1, __ATOMIC_RELAXED );
+}
+
+static inline void vQueueMonitorOverwritten( QueueMonitor_t *pxMonitor )
+{
+	__atomic_add_fetch( &pxMonitor->xStats.ulOverwrittenOldest, 1, __ATOMIC_RELAXED );
+}
+
+/**************************************************************************/
+
+typedef struct MonitoredQueue * MonitoredQueueHandle_t;
+
+/* Returns NULL if there is not enough heap for the queue. */
+MonitoredQueueHandle_t xMonitoredQueueCreate( UBaseType_t uxLength, UBaseType_t uxItemSize, const char *pcName );
+void vMonitoredQueueDelete( MonitoredQueueHandle_t xQueue );
+
+/* Set before the queue is first used. */
+void vMonitoredQueueSetOverflowPolicy( MonitoredQueueHandle_t xQueue, QueueOverflowPolicy_t ePolicy );
+
+/* xTicksToWait only matters under eQueueOverflowBlock. Under
+   eQueueOverflowOverwriteOldest the send only fails if other senders keep
+   refilling the queue faster than it can make room. */
+BaseType_t xMonitoredQueueSend( MonitoredQueueHandle_t xQueue, const void *pvItem, TickType_t xTicksToWait );
+BaseType_t xMonitoredQueueSendFromISR( MonitoredQueueHandle_t xQueue, const void *pvItem, BaseType_t *pxHigherPriorityTaskWoken );
+BaseType_t xMonitoredQueueReceive( MonitoredQueueHandle_t xQueue, void *pvBuffer, TickType_t xTicksToWait );
+
+/* The wrapped queue, for the calls that have no monitored form. */
+QueueHandle_t xMonitoredQueueGetQueue( MonitoredQueueHandle_t xQueue );
+QueueMonitor_t *pxMonitoredQueueGetMonitor( MonitoredQueueHandle_t xQueue );
+
+#endif /* QUEUE_MONITOR_H */
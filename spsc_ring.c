@@ -0,0 +1,205 @@
+/* Single-producer/single-consumer ring buffer - see spsc_ring.h
+
+   The ring has one slot more than the requested length so that "full" (head
+   one behind tail) and "empty" (head == tail) can be told apart without a
+   shared count.
+
+   Blocking uses a Dekker-style handshake. A side that is about to block
+   publishes its task handle in xWaitingSender/xWaitingReceiver and then
+   checks the ring once more; the other side moves its index and then takes
+   the handle with an atomic exchange. Both steps are sequentially consistent,
+   so at least one of them sees the other and the wakeup can't be lost. A
+   notification that arrives after the waiter already found what it wanted is
+   harmless: the next wait returns early and the loop checks again.
+*/
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "spsc_ring.h"
+
+struct SpscRing
+{
+	uint8_t          *pucStorage;
+	UBaseType_t       uxItemSize;
+	uint32_t          ulSlots;
+	volatile uint32_t ulHead;               /* next slot to write, producer only */
+	volatile uint32_t ulTail;               /* next slot to read, consumer only */
+	TaskHandle_t      xWaitingReceiver;
+	TaskHandle_t      xWaitingSender;
+};
+
+/**************************************************************************/
+
+static inline uint32_t prvNext( const struct SpscRing *pxRing, uint32_t ulIndex )
+{
+	return ( ulIndex + 1 == pxRing->ulSlots ) ? 0 : ulIndex + 1;
+}
+
+static BaseType_t prvTryPush( struct SpscRing *pxRing, const void *pvItem )
+{
+	uint32_t ulHead = __atomic_load_n( &pxRing->ulHead, __ATOMIC_RELAXED );
+	uint32_t ulNext = prvNext( pxRing, ulHead );
+
+	if( ulNext == __atomic_load_n( &pxRing->ulTail, __ATOMIC_ACQUIRE ) )
+	{
+		return pdFALSE;
+	}
+
+	memcpy( &pxRing->pucStorage[ ulHead * pxRing->uxItemSize ], pvItem, pxRing->uxItemSize );
+	__atomic_store_n( &pxRing->ulHead, ulNext, __ATOMIC_SEQ_CST );
+	return pdTRUE;
+}
+
+static BaseType_t prvTryPop( struct SpscRing *pxRing, void *pvBuffer )
+{
+	uint32_t ulTail = __atomic_load_n( &pxRing->ulTail, __ATOMIC_RELAXED );
+
+	if( ulTail == __atomic_load_n( &pxRing->ulHead, __ATOMIC_ACQUIRE ) )
+	{
+		return pdFALSE;
+	}
+
+	memcpy( pvBuffer, &pxRing->pucStorage[ ulTail * pxRing->uxItemSize ], pxRing->uxItemSize );
+	__atomic_store_n( &pxRing->ulTail, prvNext( pxRing, ulTail ), __ATOMIC_SEQ_CST );
+	return pdTRUE;
+}
+
+/* Returns the task waiting in *pxWaiting, if any, and clears the slot. */
+static inline TaskHandle_t prvClaimWaiter( TaskHandle_t *pxWaiting )
+{
+	if( __atomic_load_n( pxWaiting, __ATOMIC_SEQ_CST ) == NULL )
+	{
+		return NULL;
+	}
+	return __atomic_exchange_n( pxWaiting, NULL, __ATOMIC_SEQ_CST );
+}
+
+/* Shared blocking loop of Send and Receive. */
+static BaseType_t prvTransfer( struct SpscRing *pxRing, void *pvItem, TickType_t xTicksToWait, BaseType_t xSending )
+{
+	TaskHandle_t *pxMyWait = xSending ? &pxRing->xWaitingSender : &pxRing->xWaitingReceiver;
+	TaskHandle_t *pxPeerWait = xSending ? &pxRing->xWaitingReceiver : &pxRing->xWaitingSender;
+	TaskHandle_t xPeer;
+	TimeOut_t xTimeOut;
+	BaseType_t xDone;
+
+	vTaskSetTimeOutState( &xTimeOut );
+
+	for(;;)
+	{
+		xDone = xSending ? prvTryPush( pxRing, pvItem ) : prvTryPop( pxRing, pvItem );
+
+		if( xDone == pdFALSE && xTicksToWait != 0 )
+		{
+			/* Announce, then look again: the peer may have acted between the
+			   failed attempt and the announcement. */
+			__atomic_store_n( pxMyWait, xTaskGetCurrentTaskHandle(), __ATOMIC_SEQ_CST );
+			xDone = xSending ? prvTryPush( pxRing, pvItem ) : prvTryPop( pxRing, pvItem );
+		}
+
+		if( xDone != pdFALSE )
+		{
+			/* Withdraw an announcement nobody has claimed yet. */
+			if( __atomic_load_n( pxMyWait, __ATOMIC_RELAXED ) != NULL )
+			{
+				__atomic_store_n( pxMyWait, NULL, __ATOMIC_SEQ_CST );
+			}
+
+			xPeer = prvClaimWaiter( pxPeerWait );
+			if( xPeer != NULL )
+			{
+				xTaskNotifyGive( xPeer );
+			}
+			return pdPASS;
+		}
+
+		if( xTicksToWait == 0 || xTaskCheckForTimeOut( &xTimeOut, &xTicksToWait ) != pdFALSE )
+		{
+			__atomic_store_n( pxMyWait, NULL, __ATOMIC_SEQ_CST );
+			return xSending ? errQUEUE_FULL : errQUEUE_EMPTY;
+		}
+
+		ulTaskNotifyTake( pdTRUE, xTicksToWait );
+	}
+}
+
+/**************************************************************************/
+
+SpscRingHandle_t xSpscRingCreate( UBaseType_t uxLength, UBaseType_t uxItemSize )
+{
+	struct SpscRing *pxRing;
+
+	if( uxLength == 0 || uxItemSize == 0 )
+	{
+		return NULL;
+	}
+
+	pxRing = pvPortMalloc( sizeof( struct SpscRing ) );
+	if( pxRing == NULL )
+	{
+		return NULL;
+	}
+	memset( pxRing, 0, sizeof( struct SpscRing ) );
+
+	pxRing->pucStorage = pvPortMalloc( ( uxLength + 1 ) * uxItemSize );
+	if( pxRing->pucStorage == NULL )
+	{
+		vPortFree( pxRing );
+		return NULL;
+	}
+
+	pxRing->uxItemSize = uxItemSize;
+	pxRing->ulSlots = ( uint32_t ) uxLength + 1;
+	return pxRing;
+}
+
+void vSpscRingDelete( SpscRingHandle_t xRing )
+{
+	vPortFree( xRing->pucStorage );
+	vPortFree( xRing );
+}
+
+/**************************************************************************/
+
+BaseType_t xSpscRingSend( SpscRingHandle_t xRing, const void *pvItem, TickType_t xTicksToWait )
+{
+	return prvTransfer( xRing, ( void * ) pvItem, xTicksToWait, pdTRUE );
+}
+
+BaseType_t xSpscRingReceive( SpscRingHandle_t xRing, void *pvBuffer, TickType_t xTicksToWait )
+{
+	return prvTransfer( xRing, pvBuffer, xTicksToWait, pdFALSE );
+}
+
+BaseType_t xSpscRingSendFromISR( SpscRingHandle_t xRing, const void *pvItem, BaseType_t *pxHigherPriorityTaskWoken )
+{
+	TaskHandle_t xPeer;
+
+	if( prvTryPush( xRing, pvItem ) == pdFALSE )
+	{
+		return errQUEUE_FULL;
+	}
+
+	xPeer = prvClaimWaiter( &xRing->xWaitingReceiver );
+	if( xPeer != NULL )
+	{
+		vTaskNotifyGiveFromISR( xPeer, pxHigherPriorityTaskWoken );
+	}
+	return pdPASS;
+}
+
+/**************************************************************************/
+
+UBaseType_t uxSpscRingMessagesWaiting( SpscRingHandle_t xRing )
+{
+	uint32_t ulHead = __atomic_load_n( &xRing->ulHead, __ATOMIC_ACQUIRE );
+	uint32_t ulTail = __atomic_load_n( &xRing->ulTail, __ATOMIC_ACQUIRE );
+
+	return ( ulHead >= ulTail ) ? ulHead - ulTail : ulHead + xRing->ulSlots - ulTail;
+}
+
+UBaseType_t uxSpscRingSpacesAvailable( SpscRingHandle_t xRing )
+{
+	return xRing->ulSlots - 1 - uxSpscRingMessagesWaiting( xRing );
+}
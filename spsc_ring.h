@@ -0,0 +1,44 @@
+/* Single-producer/single-consumer ring buffer
+
+   A replacement for a FreeRTOS queue that has exactly one sending task (or
+   ISR) and exactly one receiving task, such as vReadSensor -> vCheckThreshold.
+   The calls mirror xQueueCreate()/xQueueSendToBack()/xQueueReceive() so a
+   pair can be switched over by renaming the calls:
+
+   xRing = xSpscRingCreate( 3, sizeof( Voltage_t ) );
+   xSpscRingSend( xRing, &voltage, 0 );
+   xSpscRingReceive( xRing, &fReceivedVoltage, xTicksToWait );
+
+   Items are still copied, but no critical section is taken: the producer only
+   writes the head index and the consumer only writes the tail index. A side
+   that has to wait blocks on its task notification, and the other side only
+   makes a kernel call when it knows somebody is waiting.
+
+   Because of that, the receiving task (and a sending task that blocks) must
+   not use its direct-to-task notification for anything else.
+*/
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+typedef struct SpscRing * SpscRingHandle_t;
+
+/* Returns NULL if there is not enough heap for the ring. */
+SpscRingHandle_t xSpscRingCreate( UBaseType_t uxLength, UBaseType_t uxItemSize );
+void vSpscRingDelete( SpscRingHandle_t xRing );
+
+/* Same semantics as xQueueSendToBack()/xQueueReceive(): pdPASS, or errQUEUE_FULL
+   / errQUEUE_EMPTY when xTicksToWait expires first. */
+BaseType_t xSpscRingSend( SpscRingHandle_t xRing, const void *pvItem, TickType_t xTicksToWait );
+BaseType_t xSpscRingReceive( SpscRingHandle_t xRing, void *pvBuffer, TickType_t xTicksToWait );
+
+/* For a producer that is an interrupt. Never blocks. */
+BaseType_t xSpscRingSendFromISR( SpscRingHandle_t xRing, const void *pvItem, BaseType_t *pxHigherPriorityTaskWoken );
+
+UBaseType_t uxSpscRingMessagesWaiting( SpscRingHandle_t xRing );
+UBaseType_t uxSpscRingSpacesAvailable( SpscRingHandle_t xRing );
+
+#endif /* SPSC_RING_H */
@@ -14,77 +14,38 @@
 #include "driver/gpio.h"
 #include "sdkconfig.h"
 #include "freertos/semphr.h"
+#include "hrtimer.h"
+#include "edge_capture.h"
 
 #define ESP_INTR_FLAG_DEFAULT 0
 #define STACK_SIZE 2000
 #define LED 2
 #define TOGGLE 18
 #define LED_BLUE 5
+#define DEBOUNCE_US 20000
 
-SemaphoreHandle_t xBinarySemaphore = NULL;
+EdgeCaptureHandle_t xButton = NULL;
 bool ledStatus = false, ledStatusBlue = false;
 
-/*Interrupt service routine called when button is pressed*/
-static void IRAM_ATTR vButtonISRhandler( void )
-{
-	BaseType_t xHigherPriorityTaskWoken;
-
-	/* The xHigherPriorityTaskWoken parameter must be initialized to pdFALSE as
-	   it will get set to pdTRUE inside the interrupt safe API function if a
-       context switch is required. */
-    xHigherPriorityTaskWoken = pdFALSE;
-
-
-	/*BaseType_t xSemaphoreGiveFromISR( SemaphoreHandle_t xBinarySemaphore,
-									  BaseType_t *pxHigherPriorityTaskWoken );
-
-	xBinarySemaphore - the xBinarySemaphore being 'given'.
-				 A xBinarySemaphore is referenced by a variable of BaseType_t
-				 SemaphoreHandle_t, and must be explicity created before
-				 being used.
-
-	pxHigherPriorityTaskWoken - It is possible that a single semaphore will have one or more
-								tasks blocked on it waiting for the semaphore to become
-								available. Calling xSemaphoreGiveFromISR() can make the
-								semaphore available, and so cause a task that was waiting
-								for the semaphore to leave the Blocked state. If calling
-								xSemaphoreGiveFromISR() causes a task to leave the
-								Blocked state, and the unblocked task has a priority higher
-								than the currently executing task (the task that was
-								interrupted), then, internally, xSemaphoreGiveFromISR() will
-								set *pxHigherPriorityTaskWoken to pdTRUE.
-
-								If xSemaphoreGiveFromISR() sets this value to pdTRUE,
-								then normally a context switch should be performed before
-								the interrupt is exited. This will ensure that the interrupt
-								returns directly to the highest priority Ready state task.
-
-	Returned value - There are two possible return values:
-						1. pdPASS
-					 pdPASS will be returned only if the call to
-					 xSemaphoreGiveFromISR() is successful.
-						2. pdFAIL
-					 If a semaphore is already available, it cannot be given,
-					 and xSemaphoreGiveFromISR() will return pdFAIL.*/
-
-	// xSemaphoreGiveFromISR(xBinarySemaphore, NULL);
-	xSemaphoreGiveFromISR(xBinarySemaphore, &xHigherPriorityTaskWoken);
-
-
-	/* Pass the xHigherPriorityTaskWoken value into portYIELD_FROM_ISR(). If
-	   xHigherPriorityTaskWoken was set to pdTRUE inside xSemaphoreGiveFromISR()
-       then calling portYIELD_FROM_ISR() will request a context switch. If
-       xHigherPriorityTaskWoken is still pdFALSE then calling
-       portYIELD_FROM_ISR() will have no effect.*/
-
-	if(xHigherPriorityTaskWoken)	portYIELD_FROM_ISR();
+/*The button used to wake this task through a binary semaphore given by a falling-edge ISR. A
+  bouncing contact gives it several times, and the gives that land while the task is still busy
+  collapse into one: neither the number of edges nor their times survive.
 
-}
+  Now the button is read through edge_capture.h: its ISR records every edge, on both levels, with a
+  microsecond timestamp into a lock-free ring, and the task is only woken once the contacts have
+  been quiet for DEBOUNCE_US. xEdgeCaptureReceive() then returns clean press and release events,
+  each with the time since the previous one.*/
 
 static void vButtonTask( void *pvParameters )
 {
+	EdgeCaptureEvent_t xEvent;
+	EdgeCaptureStats_t xStats;
+
 	for(;;)
 	{
+		/*xEdgeCaptureReceive() blocks the way the xSemaphoreTake() it replaces did; its xTicksToWait
+		  and return value mean the same.*/
+
 		/*BaseType_t xSemaphoreTake( SemaphoreHandle_t xBinarySemaphore, TickType_t xTicksToWait );
 
 		xBinarySemaphore - The semaphore being ‘taken’.
@@ -114,12 +75,20 @@ static void vButtonTask( void *pvParameters )
                          semaphore to become available, but the block time expired before this
                          happened.*/
 
-		if( xSemaphoreTake( xBinarySemaphore, portMAX_DELAY ) == pdTRUE )
+		if( xEdgeCaptureReceive( xButton, &xEvent, portMAX_DELAY ) == pdPASS )
 		{
-			printf("BUTTON PRESSED!!\r\n");
-			ledStatus = !ledStatus;
-			gpio_set_level(LED, ledStatus);
-
+			if( xEvent.eType == eEdgeCapturePressed )
+			{
+				printf("BUTTON PRESSED!! (released for %u ms, %u edges)\r\n", xEvent.ulDurationUs / 1000, xEvent.ulEdges);
+				ledStatus = !ledStatus;
+				gpio_set_level(LED, ledStatus);
+			}
+			else
+			{
+				vEdgeCaptureGetStats( xButton, &xStats );
+				printf("BUTTON RELEASED after %u ms (%u edges; %u edges, %u glitches, %u lost so far)\r\n",
+				       xEvent.ulDurationUs / 1000, xEvent.ulEdges, xStats.ulEdges, xStats.ulGlitches, xStats.ulOverruns);
+			}
 		}
 
 	}
@@ -143,10 +112,6 @@ static void vPeriodicTask( void *pvParameters )
 
 void app_main()
 {
-	/* Before a semaphore is used it must be explicitly created. In this example
-       a semaphore is created. */
-  xBinarySemaphore = xSemaphoreCreateBinary();
-
   gpio_pad_select_gpio(LED);
   gpio_pad_select_gpio(TOGGLE);
   gpio_pad_select_gpio(LED_BLUE);
@@ -155,8 +120,17 @@ void app_main()
   gpio_set_direction(TOGGLE, GPIO_MODE_INPUT);
   gpio_set_direction(LED_BLUE, GPIO_MODE_OUTPUT);
 
-  /*Enable interruption on falling edge*/
-  gpio_set_intr_type(TOGGLE, GPIO_INTR_NEGEDGE);
+  /*Install ISR service that will handle the toggle */
+  gpio_install_isr_service(ESP_INTR_FLAG_DEFAULT);
+
+  /*The debounce timer runs on the high-resolution timer*/
+  xHrTimerInit();
+
+  /*xEdgeCaptureCreate() creates the signal that wakes the button task, in place of the
+    semaphore this example used to create here. It also interrupts on both edges of the
+    active-low button and attaches the capture ISR. The button task receives from it, so
+    it is created first.*/
+  xButton = xEdgeCaptureCreate(TOGGLE, 0, DEBOUNCE_US);
 
   xTaskCreate(vButtonTask,
                 "Task that handles the pressing of the toggle",
@@ -172,10 +146,4 @@ void app_main()
                 1,
                 NULL);
 
-  /*Install ISR service that will handle the toggle */
-  gpio_install_isr_service(ESP_INTR_FLAG_DEFAULT);
-
-  /*Attach the interrupt service routine*/
-  gpio_isr_handler_add(TOGGLE, vButtonISRhandler, NULL);
-
 }
\ No newline at end of file
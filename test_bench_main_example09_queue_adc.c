@@ -7,23 +7,52 @@
 #include "sdkconfig.h"
 #include "driver/adc.h"
 #include "esp_adc_cal.h"
+#include "esp_timer.h"
+#include "queue_monitor.h"
+#include "adc_scan.h"
+#include "adc_voltage.h"
+#include "adc_filter.h"
 
 #define STACK_SIZE 2000
 #define DEFAULT_VREF    3300        //Use adc2_vref_to_gpio() to obtain a better estimate
-#define NO_OF_SAMPLES   64          //Multisampling
+#define SCAN_RATE_HZ    20          //Scans per second, one DMA block each
+#define SCAN_SAMPLES    (1000 / NO_OF_CHANNELS)     //Samples per channel per scan
+#define MEDIAN_WINDOW   5           //Rejects spikes up to 2 samples long
+#define BOXCAR_WINDOW   16
+#define DECIMATION      10
+#define BATCH_READINGS  10          //Readings per queue message, one reading per scan
+#define MAX_BATCH_DELAY_MS 500      //Longest a reading waits to be sent; bounds the alarm latency
 #define LED_BLUE   5
 #define LED_RED   2
-#define THRESHOLD 3260.00
+#define THRESHOLD ADC_MV_Q8(3260)
 
-typedef float Voltage_t;
+//Sensors to scan, all on ADC1: add ADC1_CHANNEL_7 for GPIO35, and so on
+static const adc1_channel_t xChannels[] = { ADC1_CHANNEL_6 };     //GPIO34
+#define NO_OF_CHANNELS  (sizeof(xChannels) / sizeof(xChannels[0]))
+
+typedef MillivoltsQ8_t Voltage_t;
 typedef int8_t AlarmCode_t;
 
-QueueHandle_t xQueue;
+//Every channel at the end of one scan
+typedef struct {
+    int64_t llTimestamp;            //esp_timer_get_time() when the scan completed
+    Voltage_t xVoltages[NO_OF_CHANNELS];
+} Reading_t;
+
+//Readings go to vCheckThreshold a block per message, oldest first
+typedef struct {
+    uint32_t ulReadings;
+    Reading_t xReadings[BATCH_READINGS];
+} ReadingBlock_t;
+
+MonitoredQueueHandle_t xQueue;
 static esp_adc_cal_characteristics_t *adc_chars;
-static const adc_channel_t channel = ADC_CHANNEL_6;     //GPIO34 if ADC1, GPIO14 if ADC2
+static AdcVoltageLut_t xVoltageLut;
+static AdcFilterChain_t xChains[NO_OF_CHANNELS];      //Filter state lives here, not on the task stack
+static AdcFilterStage_t xMedians[NO_OF_CHANNELS], xBoxcars[NO_OF_CHANNELS], xDecimates[NO_OF_CHANNELS];
 static const adc_atten_t atten = ADC_ATTEN_DB_0;
 static const adc_unit_t unit = ADC_UNIT_1;
-Voltage_t voltage;
+static ReadingBlock_t xBlock;
 bool ledRedStatus = 0;
 bool ledBlueStatus = 1;
 AlarmCode_t alarmCode = 0x00;
@@ -32,18 +61,12 @@ AlarmCode_t alarmCode = 0x00;
 
 static void vConfigADC(void)
 {
-	//Configure ADC
-    if (unit == ADC_UNIT_1) {
-        adc1_config_width(ADC_WIDTH_BIT_12);
-        adc1_config_channel_atten(channel, atten);
-    } 
-    else {
-        adc2_config_channel_atten((adc2_channel_t)channel, atten);
-    }
-
-    //Characterize ADC
+	//The scanner configures the channels; characterize ADC1 for all of them
     adc_chars = calloc(1, sizeof(esp_adc_cal_characteristics_t));
     esp_adc_cal_value_t val_type = esp_adc_cal_characterize(unit, atten, ADC_WIDTH_BIT_12, DEFAULT_VREF, adc_chars);
+
+    //Run the calibration once per code, so readings cost a table lookup
+    vAdcVoltageLutInit(&xVoltageLut, adc_chars);
 }
 
 /**************************************************************************/
@@ -59,37 +82,88 @@ static void vConfigIO(void)
 
 /**************************************************************************/
 
+/* Ticks until the oldest reading in the block has waited MAX_BATCH_DELAY_MS,
+   rounded up; portMAX_DELAY while the block is empty. */
+static TickType_t xBatchWait( const ReadingBlock_t *pxBlock )
+{
+    int64_t llLeft;
+
+    if (pxBlock->ulReadings == 0) {
+        return portMAX_DELAY;
+    }
+    llLeft = MAX_BATCH_DELAY_MS * 1000LL - (esp_timer_get_time() - pxBlock->xReadings[0].llTimestamp);
+    if (llLeft <= 0) {
+        return 0;
+    }
+    return (TickType_t) ((llLeft * configTICK_RATE_HZ + 999999) / 1000000);
+}
+
+/**************************************************************************/
+
 static void vReadSensor( void *pvParameters )
 {
-	TickType_t xLastWakeTime;
-    xLastWakeTime = xTaskGetTickCount();
+    AdcScannerHandle_t xScanner;
+    AdcScan_t *pxScan;
+    AdcScanStats_t xScanStats;
     BaseType_t xStatus;
+    uint32_t ulScans = 0;
+
+    /* A single spike no longer moves the average: the median drops it before
+       anything adds it up. Each channel has its own chain. */
+    for (size_t c = 0; c < NO_OF_CHANNELS; c++) {
+        vAdcFilterChainInit(&xChains[c]);
+        xAdcFilterMedianInit(&xMedians[c], MEDIAN_WINDOW);
+        xAdcFilterBoxcarInit(&xBoxcars[c], BOXCAR_WINDOW);
+        xAdcFilterDecimateInit(&xDecimates[c], DECIMATION);
+        vAdcFilterChainAppend(&xChains[c], &xMedians[c]);
+        vAdcFilterChainAppend(&xChains[c], &xBoxcars[c]);
+        vAdcFilterChainAppend(&xChains[c], &xDecimates[c]);
+    }
+
+    /* The DMA scans every channel continuously; the task only wakes once per
+       scan, and gets one row of samples per channel. */
+    xScanner = xAdcScanCreate(eAdcScanDma, xChannels, NO_OF_CHANNELS, atten, SCAN_RATE_HZ, SCAN_SAMPLES);
+    if (xScanner == NULL) {
+        printf("ADC scan could not be started\r\n");
+        vTaskDelete(NULL);
+    }
 
 	for(;;)
 	{
-		uint32_t adc_reading = 0;
-        //Multisampling
-        for (int i = 0; i < NO_OF_SAMPLES; i++)
-         {
-            if (unit == ADC_UNIT_1) {
-                adc_reading += adc1_get_raw((adc1_channel_t)channel);
-            } else {
-                int raw;
-                adc2_get_raw((adc2_channel_t)channel, ADC_WIDTH_BIT_12, &raw);
-                adc_reading += raw;
+        //Wait for the next scan, but not past the oldest reading's deadline
+        if (xAdcScanNext(xScanner, &pxScan, xBatchWait(&xBlock)) == pdTRUE) {
+            Reading_t *pxReading = &xBlock.xReadings[xBlock.ulReadings++];
+            BaseType_t xPrint = (++ulScans % SCAN_RATE_HZ == 0);
+
+            //One reading per scan: the average of each channel's filtered row
+            pxReading->llTimestamp = pxScan->llTimestamp;
+            for (size_t c = 0; c < pxScan->uxChannels; c++) {
+                size_t uxFiltered = uxAdcFilterChainProcess(&xChains[c], pxScan->pusSamples[c], pxScan->uxSamples);
+                uint32_t ulSum = ulAdcFilterSum(pxScan->pusSamples[c], uxFiltered);
+                //Calibrated voltage in mV, from the lookup table
+                pxReading->xVoltages[c] = uxFiltered ? xAdcVoltageFromSumQ8(&xVoltageLut, ulSum, uxFiltered) : 0;
+                if (xPrint) {
+                    printf("Channel %d Raw: %d\tVoltage: %u.%02umV\n", xChannels[c], (int) (uxFiltered ? ulSum / uxFiltered : 0),
+                           ADC_Q8_MV(pxReading->xVoltages[c]), ADC_Q8_HUNDREDTHS(pxReading->xVoltages[c]));
+                }
             }
-        }
-        adc_reading /= NO_OF_SAMPLES;
-        //Convert adc_reading to voltage in mV
-        // uint32_t voltage = esp_adc_cal_raw_to_voltage(adc_reading, adc_chars);
-        // printf("Raw: %d\tVoltage: %dmV\n", adc_reading, voltage);
-
-        voltage = 3.3/4096.0 * adc_reading * 1000;
-        printf("Raw: %d\tVoltage: %.2fmV\n", adc_reading, voltage);
 
-        xStatus = xQueueSendToBack( xQueue, &voltage, 0 );
+            //Filter costs and lost scans every 10 s, with the queue counters
+            if (ulScans % (10 * SCAN_RATE_HZ) == 0) {
+                for (size_t c = 0; c < NO_OF_CHANNELS; c++) {
+                    vAdcFilterChainPrint(&xChains[c], "filter");
+                }
+                vAdcScanGetStats(xScanner, &xScanStats);
+                printf("ADC scans: %u, lost %u, stray samples %u\r\n",
+                       xScanStats.ulScans, xScanStats.ulLostScans, xScanStats.ulStray);
+            }
+        }
 
-        vTaskDelayUntil( &xLastWakeTime, pdMS_TO_TICKS( 1000 ) );
+        //Send when the block is full, or when its oldest reading can't wait any longer
+        if (xBlock.ulReadings == BATCH_READINGS || (xBlock.ulReadings > 0 && xBatchWait(&xBlock) == 0)) {
+            xStatus = xMonitoredQueueSend( xQueue, &xBlock, 0 );
+            xBlock.ulReadings = 0;
+        }
 	}
 }
 
@@ -98,19 +172,31 @@ static void vReadSensor( void *pvParameters )
 static void vCheckThreshold( void *pvParameters )
 {
 	const TickType_t xTicksToWait = pdMS_TO_TICKS( 3100 );
-	Voltage_t fReceivedVoltage;
+	ReadingBlock_t xReceived;
+	const Reading_t *pxAbove;
 	BaseType_t xStatus;
 
 	for(;;)
 	{
 
-		xStatus = xQueueReceive( xQueue, &fReceivedVoltage, xTicksToWait );
+		xStatus = xMonitoredQueueReceive( xQueue, &xReceived, xTicksToWait );
 		
 		if( xStatus == pdPASS)
 		{
-			if(fReceivedVoltage >= THRESHOLD )
+			//One pass over the block: any channel of any reading above the threshold raises the alarm
+			pxAbove = NULL;
+			for (uint32_t r = 0; r < xReceived.ulReadings && pxAbove == NULL; r++) {
+				for (size_t c = 0; c < NO_OF_CHANNELS; c++) {
+					if (xReceived.xReadings[r].xVoltages[c] >= THRESHOLD) {
+						pxAbove = &xReceived.xReadings[r];
+					}
+				}
+			}
+
+			if( pxAbove != NULL )
 			{
-				printf("Abnormal Temperature!!\r\n");
+				printf("Abnormal Temperature!! (%d ms after the reading)\r\n",
+				       (int) ((esp_timer_get_time() - pxAbove->llTimestamp) / 1000));
 				gpio_set_level(LED_RED, ledRedStatus);
 				ledRedStatus = !ledRedStatus;
 				alarmCode = 0x02;
@@ -172,15 +258,22 @@ void app_main(void)
 	vConfigADC();
 	vConfigIO();
 
-	xQueue = xQueueCreate( 3, sizeof( Voltage_t ));
+	xQueue = xMonitoredQueueCreate( 3, sizeof( ReadingBlock_t ), "voltage" );
 
 	if( xQueue != NULL )
 	{
+		/* If vCheckThreshold falls behind, the oldest block is the one to
+		   lose: the alarm must see the latest voltages, and vReadSensor must
+		   keep its period. */
+		vMonitoredQueueSetOverflowPolicy( xQueue, eQueueOverflowOverwriteOldest );
 
 		xTaskCreate( vReadSensor, "Read ADC1", STACK_SIZE, NULL, 2, NULL );
 		xTaskCreate( vCheckThreshold, "Raise alarm if above threshold", STACK_SIZE, NULL, 3, NULL );
 		xTaskCreate( vPeriodicTask, "Blink blue LED", STACK_SIZE, (void*) alarmCode, 1, NULL);
 
+		/* Print the queue counters every 10 s. */
+		xQueueMonitorStartTask( 1, 10000 );
+
 	}
 	else
 	{
@@ -18,6 +18,7 @@
 #include "freertos/task.h"
 #include "driver/gpio.h"
 #include "sdkconfig.h"
+#include "async_log.h"
 
 // static const char *pcTextForTask1 = "blue";//"Task 1 is running\r\n";
 // static const char *pcTextForTask2 = "red";//"Task 2 is running\r\n";
@@ -44,6 +45,10 @@ void app_main(void)
     gpio_set_direction(BLINK_GPIO, GPIO_MODE_OUTPUT);
     gpio_set_direction(BLINK_GPIO_2, GPIO_MODE_OUTPUT);
 
+    /* The tasks log through the deferred logger so the UART doesn't eat into
+       their periods; its drain task runs below both of them. */
+    xAsyncLogInit(tskIDLE_PRIORITY);
+
     xTaskCreate(vTaskFunction1,
                 "Task 1",
                 10000,
@@ -66,7 +71,7 @@ void vTaskFunction1(void *pvParameters)
         gpio_set_level(BLINK_GPIO, 1);
         gpio_set_level(BLINK_GPIO_2, 1);
 
-        printf("**** TASK 1 IS RUNNING ****\n");
+        ASYNC_LOG("**** TASK 1 IS RUNNING ****\n");
         
         vTaskDelayUntil( &xLastWakeTime, pdMS_TO_TICKS( 1000 ) ); 
         
@@ -84,7 +89,7 @@ void vTaskFunction2(void *pvParameters)
         gpio_set_level(BLINK_GPIO, 0);
         gpio_set_level(BLINK_GPIO_2, 0);
 
-        printf("**** TASK 2 IS RUNNING ****\n");        
+        ASYNC_LOG("**** TASK 2 IS RUNNING ****\n");        
                 
         vTaskDelayUntil( &xLastWakeTime, pdMS_TO_TICKS( 4500 ) );
         
@@ -36,9 +36,18 @@
 #include "driver/adc.h"
 #include "esp_adc_cal.h"
 #include "esp_types.h"
+#include "esp_timer.h"
 #include "driver/periph_ctrl.h"
 #include "driver/timer.h"
 #include "freertos/semphr.h"
+#include "async_log.h"
+#include "queue_monitor.h"
+#include "irq_dispatch.h"
+#include "isr_latency.h"
+#include "gpio_storm.h"
+#include "adc_scan.h"
+#include "adc_voltage.h"
+#include "adc_filter.h"
 
 /*DEFINES RELATED TO THE TIMERS*/
 
@@ -48,8 +57,6 @@
 #define TIMER_INTERVAL1_SEC   (1.0)   // sample test interval for the second timer
 #define TEST_WITHOUT_RELOAD   0        // testing will be done without auto reload
 #define TEST_WITH_RELOAD      1        // testing will be done with auto reload
-#define FROM_TIMER_0		  1
-#define FROM_TIMER_1          2
 
 /*DEFINES RELATED TO THE TASKS*/
 
@@ -59,7 +66,11 @@
 /*DEFINES RELATED TO THE ADC*/
 
 #define DEFAULT_VREF          3300        
-#define NO_OF_SAMPLES         64          //Multisampling
+#define SCAN_RATE_HZ          20          //Scans per second, one DMA block each
+#define SCAN_SAMPLES          (1000 / NO_OF_CHANNELS)     //Samples per channel per scan
+#define NO_OF_CHANNELS        (sizeof(xChannels) / sizeof(xChannels[0]))
+#define BATCH_READINGS        10          //Readings per queue message, one reading per scan
+#define MAX_BATCH_DELAY_MS    500         //Longest a reading waits to be sent; bounds the warning latency
 
 /*DEFINES RELATED TO DIGITAL INPUT AND OUTPUT*/
 
@@ -69,22 +80,40 @@
 
 /*DEFINES RELATED TO THE WARNINGS*/
 
-#define WARNING_1             500.0
-#define WARNING_2			  1500.0
-#define WARNING_3			  2000.0
-#define WARNING_4			  2500.0
-#define WARNING_5			  3200.0
+#define WARNING_1             ADC_MV_Q8(500)
+#define WARNING_2			  ADC_MV_Q8(1500)
+#define WARNING_3			  ADC_MV_Q8(2000)
+#define WARNING_4			  ADC_MV_Q8(2500)
+#define WARNING_5			  ADC_MV_Q8(3200)
 
 /*DEFINES RELATED TO THE ISR*/
 
 #define ESP_INTR_FLAG_DEFAULT 0
-#define FROM_GPIO			  3
+
+/* The interrupts and the dispatcher's workers run on this core, so their
+   cycle counters can be compared (see isr_latency.h). */
+#define IRQ_CORE              0
+
+/* The button is handled by the high priority worker, above vReadSensor;
+   the timers, which only print, by the background worker at the priority
+   example_evt_task had. */
+#define IRQ_HIGH_PRIORITY     6
+#define IRQ_BACKGROUND_PRIORITY 4
+
+/* Print the interrupt-to-task latencies every this many TIMER_0 interrupts. */
+#define LATENCY_REPORT_EVERY  20
+
+/* Above this many BUTTON interrupts per second the pin is masked and polled
+   every STORM_POLL_MS, until it has been quiet for STORM_QUIET_MS. A real
+   press, bounce included, stays well below the limit. */
+#define STORM_MAX_RATE_HZ     200
+#define STORM_POLL_MS         10
+#define STORM_QUIET_MS        500
 
 /*TYDEF DECLARATIONS*/
 
-typedef float  Voltage_t;
+typedef MillivoltsQ8_t Voltage_t;
 typedef int8_t WarningCode_t;
-typedef int8_t SourceIntr_t;
 
 typedef struct {
     int type;  // the type of timer's event
@@ -93,25 +122,42 @@ typedef struct {
     uint64_t timer_counter_value;
 } timer_event_t;
 
+/* Every channel at the end of one scan. */
+typedef struct {
+    int64_t llTimestamp;            // esp_timer_get_time() when the scan completed
+    Voltage_t xVoltages[ADC_SCAN_MAX_CHANNELS];
+} Reading_t;
+
+/* Readings go to vCheckThreshold a block per message, oldest first. */
+typedef struct {
+    uint32_t ulReadings;
+    Reading_t xReadings[BATCH_READINGS];
+} ReadingBlock_t;
+
 /*ADC CONFIGURATION VARIABLES*/
 
 static            esp_adc_cal_characteristics_t *adc_chars;
-static const      adc_channel_t channel   =      ADC_CHANNEL_6;     //GPIO34 if ADC1, GPIO14 if ADC2
+static            AdcVoltageLut_t xVoltageLut;
+static const      adc1_channel_t xChannels[] = { ADC1_CHANNEL_6 };     //GPIO34; all sensors are on ADC1
 static const      adc_atten_t atten       =      ADC_ATTEN_DB_0;
 static const      adc_unit_t unit         =      ADC_UNIT_1;
 
 /*ISR VARIABLES*/
 
-SemaphoreHandle_t xCountingSemaphore = NULL;
+/* The BUTTON source is raised by vButtonISRhandler; the timer sources have
+   their ISRs in the dispatcher. */
+static IrqSourceHandle_t xButtonSource;
+
+static GpioStormHandle_t xButtonStorm;
 
 /*QUEUE VARIABLES*/
 
-QueueHandle_t     xQueue;
+MonitoredQueueHandle_t xQueue;
 
 /*GLOBAL VARIABLES*/
 
-Voltage_t         voltage;
-SourceIntr_t      sourceIntr    = 0;
+static            ReadingBlock_t xBlock;
+static            ReadingBlock_t xReceived;      //Off vCheckThreshold's stack
 bool              ledRedStatus  = 0;
 bool              ledBlueStatus = 1;
 WarningCode_t     warningCode;
@@ -120,18 +166,12 @@ WarningCode_t     warningCode;
 
 static void vConfigADC(void)
 {
-	//Configure ADC
-    if (unit == ADC_UNIT_1) {
-        adc1_config_width(ADC_WIDTH_BIT_12);
-        adc1_config_channel_atten(channel, atten);
-    } 
-    else {
-        adc2_config_channel_atten((adc2_channel_t)channel, atten);
-    }
-
-    //Characterize ADC
+	//The scanner configures the channels; characterize ADC1 for all of them
     adc_chars = calloc(1, sizeof(esp_adc_cal_characteristics_t));
     esp_adc_cal_value_t val_type = esp_adc_cal_characterize(unit, atten, ADC_WIDTH_BIT_12, DEFAULT_VREF, adc_chars);
+
+    //Run the calibration once per code, so readings cost a table lookup
+    vAdcVoltageLutInit(&xVoltageLut, adc_chars);
 }
 
 /**************************************************************************/
@@ -151,45 +191,11 @@ static void vConfigIO(void)
 
 /**************************************************************************/
 
-static void IRAM_ATTR vButtonISRhandler( void )
+/* Called from the BUTTON ISR, or from the timer daemon while a storm has
+   the pin masked and polled (see gpio_storm.h); gpio_storm yields. */
+static void IRAM_ATTR vButtonISRhandler( void *pvContext, BaseType_t *pxHigherPriorityTaskWoken )
 {
-	BaseType_t xHigherPriorityTaskWoken;
-	xHigherPriorityTaskWoken = pdFALSE;
-
-	xSemaphoreGiveFromISR(xCountingSemaphore, &xHigherPriorityTaskWoken);
-	sourceIntr = FROM_GPIO;
-
-	if(xHigherPriorityTaskWoken)	portYIELD_FROM_ISR();
-}
-
-/**************************************************************************/
-
-static void IRAM_ATTR timer_group0_isr(void *para)
-{
-    BaseType_t xHigherPriorityTaskWoken;
-    xHigherPriorityTaskWoken = pdFALSE;
-
-    int timer_idx = (int) para;
-    timer_intr_t timer_intr = timer_group_intr_get_in_isr(TIMER_GROUP_0);
-
-    if (timer_intr & TIMER_INTR_T0) {
-        timer_group_intr_clr_in_isr(TIMER_GROUP_0, TIMER_0);
-        sourceIntr = FROM_TIMER_0;
-    }
-
-    else if (timer_intr & TIMER_INTR_T1) {
-        timer_group_intr_clr_in_isr(TIMER_GROUP_0, TIMER_1);
-        sourceIntr = FROM_TIMER_1;
-    } 
-
-    else printf("Event not supported"); // not supported even type
-
-    timer_group_enable_alarm_in_isr(TIMER_GROUP_0, timer_idx);
-
-    xSemaphoreGiveFromISR(xCountingSemaphore, &xHigherPriorityTaskWoken);
-    // xSemaphoreGiveFromISR(xBinarySemaphore, &xHigherPriorityTaskWoken);
-
-    if(xHigherPriorityTaskWoken)	portYIELD_FROM_ISR();
+	vIrqDispatchRaiseFromISR(xButtonSource, pxHigherPriorityTaskWoken);
 }
 
 /**************************************************************************/
@@ -210,45 +216,36 @@ static void example_tg0_timer_init(int timer_idx,
     timer_set_counter_value(TIMER_GROUP_0, timer_idx, 0x00000000ULL);
 
     timer_set_alarm_value(TIMER_GROUP_0, timer_idx, timer_interval_sec * TIMER_SCALE);
-    timer_enable_intr(TIMER_GROUP_0, timer_idx);
-    timer_isr_register(TIMER_GROUP_0, timer_idx, timer_group0_isr,
-                       (void *) timer_idx, ESP_INTR_FLAG_IRAM, NULL);
-
-    timer_start(TIMER_GROUP_0, timer_idx);
 }
 
 /**************************************************************************/
 
-static void example_evt_task(void *pvParameters)
-{
-
-    while (1) {
-
-        if( xSemaphoreTake( xCountingSemaphore, portMAX_DELAY ) == pdTRUE )
-        {
-            switch(sourceIntr)
-            {
+/* Handlers of the interrupt sources, run by the dispatcher's workers with
+   the number of interrupts since their last call. */
 
-            	case FROM_TIMER_0:
-            		printf("INTERRUPTION FROM TIMER 0\r\n");
-            		break;
-
-            	case FROM_TIMER_1:
-            		printf("INTERRUPTION FROM TIMER 1\r\n");
-            		break;
+static void vTimer0Handler(void *pvContext, uint32_t ulCount, BaseType_t *pxHigherPriorityTaskWoken)
+{
+    static uint32_t ulTimer0Count = 0;
 
-            	case FROM_GPIO:
-            		printf("INTERRUPTION FROM GPIO\r\n");
-            		break;
+    printf("INTERRUPTION FROM TIMER 0 (x%u)\r\n", ulCount);
 
-            	default:
-            		break;
-            
-            }
+    ulTimer0Count += ulCount;
+    if (ulTimer0Count >= LATENCY_REPORT_EVERY) {
+        ulTimer0Count = 0;
+        vIsrLatencyPrintAll();
+        vIrqDispatchPrintAll();
+        vGpioStormPrint(xButtonStorm, "BUTTON");
+    }
+}
 
-        }
+static void vTimer1Handler(void *pvContext, uint32_t ulCount, BaseType_t *pxHigherPriorityTaskWoken)
+{
+    printf("INTERRUPTION FROM TIMER 1 (x%u)\r\n", ulCount);
+}
 
-    }
+static void vButtonHandler(void *pvContext, uint32_t ulCount, BaseType_t *pxHigherPriorityTaskWoken)
+{
+    printf("INTERRUPTION FROM GPIO (x%u)\r\n", ulCount);
 }
 
 /**************************************************************************/
@@ -266,49 +263,49 @@ static void vPeriodicTask( void *pvParameters )
 			case 0x00:
 				gpio_set_level(LED_BLUE, !ledBlueStatus);
 				ledBlueStatus = !ledBlueStatus;
-				printf("case 0x00\r\n");
+				ASYNC_LOG("case 0x00\r\n");
 				vTaskDelayUntil( &xLastWakeTime, pdMS_TO_TICKS( 600 ) );
 				break;
 
 			case 0x01:
 				gpio_set_level(LED_BLUE, !ledBlueStatus);
 				ledBlueStatus = !ledBlueStatus;
-				printf("case 0x01\r\n");
+				ASYNC_LOG("case 0x01\r\n");
 				vTaskDelayUntil( &xLastWakeTime, pdMS_TO_TICKS( 500 ) );
 				break;
 
 			case 0x02:
 				gpio_set_level(LED_BLUE, !ledBlueStatus);
 				ledBlueStatus = !ledBlueStatus;
-				printf("case 0x02\r\n");
+				ASYNC_LOG("case 0x02\r\n");
 				vTaskDelayUntil( &xLastWakeTime, pdMS_TO_TICKS( 400 ) );
 				break;
 
 			case 0x03:
 				gpio_set_level(LED_BLUE, !ledBlueStatus);
 				ledBlueStatus = !ledBlueStatus;
-				printf("case 0x03\r\n");
+				ASYNC_LOG("case 0x03\r\n");
 				vTaskDelayUntil( &xLastWakeTime, pdMS_TO_TICKS( 300 ) );
 				break;
 
 			case 0x04:
 				gpio_set_level(LED_BLUE, !ledBlueStatus);
 				ledBlueStatus = !ledBlueStatus;
-				printf("case 0x04\r\n");
+				ASYNC_LOG("case 0x04\r\n");
 				vTaskDelayUntil( &xLastWakeTime, pdMS_TO_TICKS( 200 ) );
 				break;
 
 			case 0x05:
 				gpio_set_level(LED_BLUE, !ledBlueStatus);
 				ledBlueStatus = !ledBlueStatus;
-				printf("case 0x05\r\n");
+				ASYNC_LOG("case 0x05\r\n");
 				vTaskDelayUntil( &xLastWakeTime, pdMS_TO_TICKS( 100 ) );
 				break;
 
 			default:
 				gpio_set_level(LED_BLUE, !ledBlueStatus);
 				ledBlueStatus = !ledBlueStatus;
-				printf("default\r\n");
+				ASYNC_LOG("default\r\n");
 				vTaskDelayUntil( &xLastWakeTime, pdMS_TO_TICKS( 1000 ) );
 				break;
 		}
@@ -318,33 +315,70 @@ static void vPeriodicTask( void *pvParameters )
 
 /**************************************************************************/
 
+/* Ticks until the oldest reading in the block has waited MAX_BATCH_DELAY_MS,
+   rounded up; portMAX_DELAY while the block is empty. */
+static TickType_t xBatchWait( const ReadingBlock_t *pxBlock )
+{
+    int64_t llLeft;
+
+    if (pxBlock->ulReadings == 0) {
+        return portMAX_DELAY;
+    }
+    llLeft = MAX_BATCH_DELAY_MS * 1000LL - (esp_timer_get_time() - pxBlock->xReadings[0].llTimestamp);
+    if (llLeft <= 0) {
+        return 0;
+    }
+    return (TickType_t) ((llLeft * configTICK_RATE_HZ + 999999) / 1000000);
+}
+
+/**************************************************************************/
+
 static void vReadSensor( void *pvParameters )
 {
-	TickType_t xLastWakeTime;
-    xLastWakeTime = xTaskGetTickCount();
+    AdcScannerHandle_t xScanner;
+    AdcScan_t *pxScan;
     BaseType_t xStatus;
+    uint32_t ulScans = 0;
+    uint32_t ulLost = 0;
+
+    /* The DMA scans every channel continuously; the task only wakes once per
+       scan, and gets one row of samples per channel. */
+    xScanner = xAdcScanCreate(eAdcScanDma, xChannels, NO_OF_CHANNELS, atten, SCAN_RATE_HZ, SCAN_SAMPLES);
+    if (xScanner == NULL) {
+        ASYNC_LOG("ADC scan could not be started\r\n");
+        vTaskDelete(NULL);
+    }
 
 	for(;;)
 	{
-		uint32_t adc_reading = 0;
-        for (int i = 0; i < NO_OF_SAMPLES; i++)
-         {
-            if (unit == ADC_UNIT_1) {
-                adc_reading += adc1_get_raw((adc1_channel_t)channel);
-            } else {
-                int raw;
-                adc2_get_raw((adc2_channel_t)channel, ADC_WIDTH_BIT_12, &raw);
-                adc_reading += raw;
+        //Wait for the next scan, but not past the oldest reading's deadline
+        if (xAdcScanNext(xScanner, &pxScan, xBatchWait(&xBlock)) == pdTRUE) {
+            Reading_t *pxReading = &xBlock.xReadings[xBlock.ulReadings++];
+            BaseType_t xLog = (++ulScans % SCAN_RATE_HZ == 0);
+
+            if (pxScan->ulSequence != ulScans - 1 + ulLost) {
+                ASYNC_LOG("ADC scan: %u scans lost\r\n", pxScan->ulSequence - (ulScans - 1) - ulLost);
+                ulLost = pxScan->ulSequence - (ulScans - 1);
             }
-        }
-        adc_reading /= NO_OF_SAMPLES;
-
-        voltage = 3.3/4096.0 * adc_reading * 1000;
-        printf("Raw: %d\tVoltage: %.2fmV\r\n", adc_reading, voltage);
 
-        xStatus = xQueueSendToBack( xQueue, &voltage, 0 );
+            //One reading per scan: the average of each channel's row
+            pxReading->llTimestamp = pxScan->llTimestamp;
+            for (size_t c = 0; c < pxScan->uxChannels; c++) {
+                uint32_t ulSum = ulAdcFilterSum(pxScan->pusSamples[c], pxScan->uxSamples);
+                //Calibrated voltage in mV, from the lookup table
+                pxReading->xVoltages[c] = pxScan->uxSamples ? xAdcVoltageFromSumQ8(&xVoltageLut, ulSum, pxScan->uxSamples) : 0;
+                if (xLog) {
+                    ASYNC_LOG("Channel %d Raw: %d\tVoltage: %u.%02umV\r\n", xChannels[c], (int) (pxScan->uxSamples ? ulSum / pxScan->uxSamples : 0),
+                              ADC_Q8_MV(pxReading->xVoltages[c]), ADC_Q8_HUNDREDTHS(pxReading->xVoltages[c]));
+                }
+            }
+        }
 
-        vTaskDelayUntil( &xLastWakeTime, pdMS_TO_TICKS( 1000 ) );
+        //Send when the block is full, or when its oldest reading can't wait any longer
+        if (xBlock.ulReadings == BATCH_READINGS || (xBlock.ulReadings > 0 && xBatchWait(&xBlock) == 0)) {
+            xStatus = xMonitoredQueueSend( xQueue, &xBlock, 0 );
+            xBlock.ulReadings = 0;
+        }
 	}
 }
 
@@ -353,38 +387,47 @@ static void vReadSensor( void *pvParameters )
 static void vCheckThreshold( void *pvParameters )
 {
 	const TickType_t xTicksToWait = pdMS_TO_TICKS( 3100 );
-	Voltage_t fReceivedVoltage;
+	Voltage_t xReceivedVoltage;
 	BaseType_t xStatus;
 
 	for(;;)
 	{
 
-		xStatus = xQueueReceive( xQueue, &fReceivedVoltage, xTicksToWait );
+		xStatus = xMonitoredQueueReceive( xQueue, &xReceived, xTicksToWait );
 		
 		if( xStatus == pdPASS)
 		{
-			
-			if(fReceivedVoltage >= WARNING_1)
+			//One pass over the block: the warning level follows the highest channel of any reading
+			xReceivedVoltage = 0;
+			for (uint32_t r = 0; r < xReceived.ulReadings; r++) {
+				for (size_t c = 0; c < NO_OF_CHANNELS; c++) {
+					if (xReceived.xReadings[r].xVoltages[c] > xReceivedVoltage) {
+						xReceivedVoltage = xReceived.xReadings[r].xVoltages[c];
+					}
+				}
+			}
+
+			if(xReceivedVoltage >= WARNING_1)
 			{
-				if(fReceivedVoltage < WARNING_2)	    
+				if(xReceivedVoltage < WARNING_2)	    
 				{
 					printf("WARNING 1\r\n");
 					warningCode = 0x01;
 				}
 
-				else if(fReceivedVoltage < WARNING_3)	
+				else if(xReceivedVoltage < WARNING_3)	
 				{
 					printf("WARNING 2\r\n");
 					warningCode = 0x02;
 				}
 
-				else if(fReceivedVoltage < WARNING_4)
+				else if(xReceivedVoltage < WARNING_4)
 				{
 					printf("WARNING 3\r\n");
 					warningCode = 0x03;
 				}
 
-				else if(fReceivedVoltage < WARNING_5)	
+				else if(xReceivedVoltage < WARNING_5)	
 				{
 					printf("WARNING 4\r\n");
 					warningCode = 0x04;
@@ -430,10 +473,15 @@ void app_main()
 	vConfigADC();
 	vConfigIO();
 
-	xCountingSemaphore     =    xSemaphoreCreateCounting( 10, 0 );
+	/* vReadSensor and vPeriodicTask log every period; the deferred logger keeps
+	   the UART out of their timing. */
+	xAsyncLogInit(tskIDLE_PRIORITY);
+
+	/* On the core app_main registers the interrupts from. */
+	xIrqDispatchStart(IRQ_HIGH_PRIORITY, IRQ_BACKGROUND_PRIORITY, IRQ_CORE);
 	// xBinarySemaphore = xSemaphoreCreateBinary();
 
-   	xQueue   =    xQueueCreate( 3, sizeof( Voltage_t ));
+   	xQueue   =    xMonitoredQueueCreate( 3, sizeof( ReadingBlock_t ), "voltage" );
 
 	example_tg0_timer_init(TIMER_0, 
 		                   TEST_WITH_RELOAD, 
@@ -443,11 +491,25 @@ void app_main()
 		                   TEST_WITH_RELOAD, 
 		                   TIMER_INTERVAL1_SEC);
 
+	xIrqDispatchAddTimer(TIMER_GROUP_0, TIMER_0, "TIMER_0",
+	                     eIrqContextBackground, 1, vTimer0Handler, NULL);
+	xIrqDispatchAddTimer(TIMER_GROUP_0, TIMER_1, "TIMER_1",
+	                     eIrqContextBackground, 0, vTimer1Handler, NULL);
+
+	timer_start(TIMER_GROUP_0, TIMER_0);
+	timer_start(TIMER_GROUP_0, TIMER_1);
+
     gpio_install_isr_service(ESP_INTR_FLAG_DEFAULT);
 
-    gpio_isr_handler_add(BUTTON, 
-    	                 vButtonISRhandler, 
-    	                 NULL);
+    xButtonSource = xIrqDispatchAddSource("GPIO", eIrqContextHigh, 0, vButtonHandler, NULL);
+
+    xButtonStorm = xGpioStormCreate(BUTTON,
+    	                            GPIO_INTR_NEGEDGE,
+    	                            STORM_MAX_RATE_HZ,
+    	                            STORM_POLL_MS,
+    	                            STORM_QUIET_MS,
+    	                            vButtonISRhandler,
+    	                            NULL);
 
 
     xTaskCreate(vPeriodicTask,
@@ -457,17 +519,14 @@ void app_main()
                 1,
                 NULL);
 
-    xTaskCreate(example_evt_task, 
-   	           "timer_evt_task", 
-   	           STACK_SIZE_1, 
-   	           NULL, 
-   	           4, 
-   	           NULL);
-
 
 
 	if( xQueue != NULL )
 	{
+		/* If vCheckThreshold falls behind, the oldest block is the one to
+		   lose: the warnings must follow the latest voltages, and vReadSensor
+		   must keep its period. */
+		vMonitoredQueueSetOverflowPolicy( xQueue, eQueueOverflowOverwriteOldest );
 
 		xTaskCreate( vReadSensor, 
 			         "Read ADC1", 
@@ -482,6 +541,9 @@ void app_main()
 			         NULL, 
 			         3, 
 			         NULL );
+
+		/* Print the queue counters every 10 s. */
+		xQueueMonitorStartTask( 1, 10000 );
 		printf("Queue created\r\n");
 
 	}
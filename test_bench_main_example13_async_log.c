@@ -0,0 +1,172 @@
+/* Deferred logging benchmark
+
+   Three periodic tasks (priorities 3, 4 and 5, 10ms period) log one line per
+   period, the way vReadSensor does. The run is made twice: first with plain
+   printf(), then with ASYNC_LOG(). For each run the benchmark reports
+
+   - period jitter: how far each wake-up interval strays from the nominal
+     period (mean of the absolute error and worst case)
+   - log cost: time spent inside the logging call (mean and worst case)
+   - drain cost: time the deferred logger's drain task spent formatting and
+     printing, per line; what ASYNC_LOG() saves the caller is still spent,
+     only later and at low priority. cost_avg is log_avg plus drain_avg
+   - for the deferred logger, how many lines were dropped
+
+   All figures are in microseconds, measured with esp_timer_get_time().
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+#include "async_log.h"
+
+#define STACK_SIZE            3072
+#define BENCH_TASKS           3
+#define BENCH_PERIOD_MS       10
+#define BENCH_ITERATIONS      500
+#define BENCH_SETTLE_MS       2000
+
+typedef struct {
+	int64_t  llJitterSum;
+	int64_t  llJitterMax;
+	int64_t  llLogSum;
+	int64_t  llLogMax;
+	int64_t  llDrainSum;
+	uint32_t ulSamples;
+} BenchResult_t;
+
+static TaskHandle_t       xControllerTask;
+static volatile BaseType_t xUseAsyncLog;
+static BenchResult_t      xResults[ BENCH_TASKS ];
+
+/**************************************************************************/
+
+static void vBenchTask( void *pvParameters )
+{
+	int lTaskNumber = (int) (intptr_t) pvParameters;
+	BenchResult_t *pxResult = &xResults[ lTaskNumber ];
+	const int64_t llPeriodUs = BENCH_PERIOD_MS * 1000;
+	TickType_t xLastWakeTime;
+	int64_t llPrevious, llNow, llError, llBefore, llCost;
+	float fVoltage;
+
+	memset( pxResult, 0, sizeof( *pxResult ) );
+
+	/* The first wake-up only establishes the reference point. */
+	xLastWakeTime = xTaskGetTickCount();
+	vTaskDelayUntil( &xLastWakeTime, pdMS_TO_TICKS( BENCH_PERIOD_MS ) );
+	llPrevious = esp_timer_get_time();
+
+	for( uint32_t i = 0; i < BENCH_ITERATIONS; i++ )
+	{
+		vTaskDelayUntil( &xLastWakeTime, pdMS_TO_TICKS( BENCH_PERIOD_MS ) );
+
+		llNow = esp_timer_get_time();
+		llError = ( llNow - llPrevious ) - llPeriodUs;
+		if( llError < 0 ) llError = -llError;
+		llPrevious = llNow;
+
+		fVoltage = 1000.0f + lTaskNumber * 100.0f + ( i % 100 );
+
+		llBefore = esp_timer_get_time();
+		if( xUseAsyncLog )
+		{
+			ASYNC_LOG( "Task %d iteration %u\tVoltage: %.2fmV\r\n", lTaskNumber, i, fVoltage );
+		}
+		else
+		{
+			printf( "Task %d iteration %u\tVoltage: %.2fmV\r\n", lTaskNumber, i, fVoltage );
+		}
+		llCost = esp_timer_get_time() - llBefore;
+
+		pxResult->llJitterSum += llError;
+		if( llError > pxResult->llJitterMax ) pxResult->llJitterMax = llError;
+		pxResult->llLogSum += llCost;
+		if( llCost > pxResult->llLogMax ) pxResult->llLogMax = llCost;
+		pxResult->ulSamples++;
+	}
+
+	xTaskNotifyGive( xControllerTask );
+	vTaskDelete( NULL );
+}
+
+/**************************************************************************/
+
+static void vRunPhase( BaseType_t xAsync, BenchResult_t *pxSummary )
+{
+	AsyncLogStats_t xBefore, xAfter;
+
+	xUseAsyncLog = xAsync;
+	vAsyncLogGetStats( &xBefore );
+
+	for( int i = 0; i < BENCH_TASKS; i++ )
+	{
+		xTaskCreate( vBenchTask, "Bench", STACK_SIZE, (void *) (intptr_t) i, 3 + i, NULL );
+	}
+
+	for( int i = 0; i < BENCH_TASKS; i++ )
+	{
+		ulTaskNotifyTake( pdFALSE, portMAX_DELAY );
+	}
+
+	/* Let the drain task (or the UART) catch up before the next phase. */
+	vTaskDelay( pdMS_TO_TICKS( BENCH_SETTLE_MS ) );
+	vAsyncLogGetStats( &xAfter );
+
+	memset( pxSummary, 0, sizeof( *pxSummary ) );
+	pxSummary->llDrainSum = xAfter.ullDrainUs - xBefore.ullDrainUs;
+	for( int i = 0; i < BENCH_TASKS; i++ )
+	{
+		pxSummary->llJitterSum += xResults[ i ].llJitterSum;
+		pxSummary->llLogSum += xResults[ i ].llLogSum;
+		pxSummary->ulSamples += xResults[ i ].ulSamples;
+		if( xResults[ i ].llJitterMax > pxSummary->llJitterMax ) pxSummary->llJitterMax = xResults[ i ].llJitterMax;
+		if( xResults[ i ].llLogMax > pxSummary->llLogMax ) pxSummary->llLogMax = xResults[ i ].llLogMax;
+	}
+}
+
+/**************************************************************************/
+
+static void vPrintRow( const char *pcPath, const BenchResult_t *pxResult )
+{
+	printf("%-10s %12" PRId64 " %12" PRId64 " %12" PRId64 " %12" PRId64 " %12" PRId64 " %12" PRId64 "\r\n", pcPath,
+	       pxResult->llJitterSum / pxResult->ulSamples, pxResult->llJitterMax,
+	       pxResult->llLogSum / pxResult->ulSamples, pxResult->llLogMax,
+	       pxResult->llDrainSum / pxResult->ulSamples,
+	       ( pxResult->llLogSum + pxResult->llDrainSum ) / pxResult->ulSamples);
+}
+
+static void vControllerTask( void *pvParameters )
+{
+	BenchResult_t xPrintf, xAsync;
+	AsyncLogStats_t xStats;
+
+	vRunPhase( pdFALSE, &xPrintf );
+	vRunPhase( pdTRUE, &xAsync );
+	vAsyncLogGetStats( &xStats );
+
+	printf("\r\n%-10s %12s %12s %12s %12s %12s %12s\r\n", "path", "jitter_avg", "jitter_max",
+	       "log_avg", "log_max", "drain_avg", "cost_avg");
+	vPrintRow( "printf", &xPrintf );
+	vPrintRow( "async_log", &xAsync );
+	printf("async_log: %u written, %u dropped, high water %u of %u\r\n",
+	       xStats.ulWritten, xStats.ulDropped, xStats.ulHighWater, ASYNC_LOG_QUEUE_LENGTH);
+	printf("async_log: %u bytes out, %u per line (ASYNC_LOG_BINARY=%d)\r\n",
+	       xStats.ulBytesOut, xStats.ulPrinted ? xStats.ulBytesOut / xStats.ulPrinted : 0, ASYNC_LOG_BINARY);
+
+	printf("# done\r\n");
+	vTaskDelete( NULL );
+}
+
+/**************************************************************************/
+
+void app_main(void)
+{
+	xAsyncLogInit( tskIDLE_PRIORITY + 1 );
+
+	xTaskCreate( vControllerTask, "Controller", STACK_SIZE, NULL, 6, &xControllerTask );
+}
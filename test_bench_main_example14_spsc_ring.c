@@ -0,0 +1,191 @@
+/* SPSC ring buffer vs. FreeRTOS queue benchmark
+
+   One sender and one receiver exchange int32_t items, first through a queue
+   created with xQueueCreate(), then through an SPSC ring of the same length.
+   Three measurements are made for each:
+
+   1. Throughput with the receiver above the sender (the example4 topology):
+      every send wakes the receiver, so this is dominated by context switches.
+   2. Throughput with the receiver below the sender (the example5 topology):
+      the sender fills the channel, then the receiver drains it.
+   3. Wake latency: the sender stamps esp_timer_get_time() into each item once
+      per tick, and the blocked receiver measures how long the item took to
+      reach it.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+#include "spsc_ring.h"
+
+#define STACK_SIZE            2048
+#define CHANNEL_LENGTH        5
+#define THROUGHPUT_ITEMS      50000
+#define LATENCY_SAMPLES       500
+
+typedef struct {
+	const char *pcName;
+	BaseType_t ( *pxSend )( void *pvChannel, const void *pvItem, TickType_t xTicksToWait );
+	BaseType_t ( *pxReceive )( void *pvChannel, void *pvBuffer, TickType_t xTicksToWait );
+	void       *pvChannel;
+} Channel_t;
+
+typedef struct {
+	Channel_t *pxChannel;
+	BaseType_t xLatency;        /* pdTRUE: latency run, pdFALSE: throughput run */
+	int64_t    llLatencySum;
+	int64_t    llLatencyMax;
+} Run_t;
+
+static TaskHandle_t xControllerTask;
+
+/**************************************************************************/
+
+static BaseType_t prvQueueSend( void *pvChannel, const void *pvItem, TickType_t xTicksToWait )
+{
+	return xQueueSendToBack( (QueueHandle_t) pvChannel, pvItem, xTicksToWait );
+}
+
+static BaseType_t prvQueueReceive( void *pvChannel, void *pvBuffer, TickType_t xTicksToWait )
+{
+	return xQueueReceive( (QueueHandle_t) pvChannel, pvBuffer, xTicksToWait );
+}
+
+static BaseType_t prvRingSend( void *pvChannel, const void *pvItem, TickType_t xTicksToWait )
+{
+	return xSpscRingSend( (SpscRingHandle_t) pvChannel, pvItem, xTicksToWait );
+}
+
+static BaseType_t prvRingReceive( void *pvChannel, void *pvBuffer, TickType_t xTicksToWait )
+{
+	return xSpscRingReceive( (SpscRingHandle_t) pvChannel, pvBuffer, xTicksToWait );
+}
+
+/**************************************************************************/
+
+static void vSenderTask( void *pvParameters )
+{
+	Run_t *pxRun = (Run_t *) pvParameters;
+	int32_t lValue;
+
+	if( pxRun->xLatency )
+	{
+		for( int i = 0; i < LATENCY_SAMPLES; i++ )
+		{
+			vTaskDelay( 1 );
+			/* Only the low 32 bits are sent; the receiver's delta is
+			   computed modulo 2^32 us, which is plenty. */
+			lValue = (int32_t) esp_timer_get_time();
+			pxRun->pxChannel->pxSend( pxRun->pxChannel->pvChannel, &lValue, portMAX_DELAY );
+		}
+	}
+	else
+	{
+		for( lValue = 0; lValue < THROUGHPUT_ITEMS; lValue++ )
+		{
+			pxRun->pxChannel->pxSend( pxRun->pxChannel->pvChannel, &lValue, portMAX_DELAY );
+		}
+	}
+
+	vTaskDelete( NULL );
+}
+
+static void vReceiverTask( void *pvParameters )
+{
+	Run_t *pxRun = (Run_t *) pvParameters;
+	int32_t lReceivedValue;
+	int32_t lExpected = 0;
+	int64_t llLatency;
+	int lItems = pxRun->xLatency ? LATENCY_SAMPLES : THROUGHPUT_ITEMS;
+
+	for( int i = 0; i < lItems; i++ )
+	{
+		pxRun->pxChannel->pxReceive( pxRun->pxChannel->pvChannel, &lReceivedValue, portMAX_DELAY );
+
+		if( pxRun->xLatency )
+		{
+			llLatency = (uint32_t) ( (int32_t) esp_timer_get_time() - lReceivedValue );
+			pxRun->llLatencySum += llLatency;
+			if( llLatency > pxRun->llLatencyMax ) pxRun->llLatencyMax = llLatency;
+		}
+		else if( lReceivedValue != lExpected++ )
+		{
+			printf("%s: item %d out of order (got %d)\r\n", pxRun->pxChannel->pcName, i, lReceivedValue);
+		}
+	}
+
+	xTaskNotifyGive( xControllerTask );
+	vTaskDelete( NULL );
+}
+
+/**************************************************************************/
+
+/* Runs one sender/receiver pair to completion and returns the elapsed time. */
+static int64_t llRun( Run_t *pxRun, UBaseType_t uxSenderPriority, UBaseType_t uxReceiverPriority )
+{
+	int64_t llStart = esp_timer_get_time();
+
+	xTaskCreate( vReceiverTask, "Receiver", STACK_SIZE, pxRun, uxReceiverPriority, NULL );
+	xTaskCreate( vSenderTask, "Sender", STACK_SIZE, pxRun, uxSenderPriority, NULL );
+
+	ulTaskNotifyTake( pdTRUE, portMAX_DELAY );
+	return esp_timer_get_time() - llStart;
+}
+
+static void vBenchChannel( Channel_t *pxChannel )
+{
+	Run_t xRun;
+	int64_t llAbove, llBelow;
+
+	memset( &xRun, 0, sizeof( xRun ) );
+	xRun.pxChannel = pxChannel;
+
+	llAbove = llRun( &xRun, 2, 3 );
+	llBelow = llRun( &xRun, 3, 2 );
+
+	xRun.xLatency = pdTRUE;
+	llRun( &xRun, 2, 3 );
+
+	printf("%-8s %16" PRId64 " %16" PRId64 " %12" PRId64 " %12" PRId64 "\r\n", pxChannel->pcName,
+	       ( int64_t ) THROUGHPUT_ITEMS * 1000000 / llAbove,
+	       ( int64_t ) THROUGHPUT_ITEMS * 1000000 / llBelow,
+	       xRun.llLatencySum / LATENCY_SAMPLES,
+	       xRun.llLatencyMax);
+}
+
+/**************************************************************************/
+
+static void vControllerTask( void *pvParameters )
+{
+	Channel_t xQueueChannel = { "queue", prvQueueSend, prvQueueReceive, NULL };
+	Channel_t xRingChannel = { "spsc", prvRingSend, prvRingReceive, NULL };
+
+	xQueueChannel.pvChannel = xQueueCreate( CHANNEL_LENGTH, sizeof( int32_t ) );
+	xRingChannel.pvChannel = xSpscRingCreate( CHANNEL_LENGTH, sizeof( int32_t ) );
+
+	if( xQueueChannel.pvChannel == NULL || xRingChannel.pvChannel == NULL )
+	{
+		printf("Channels could not be created\r\n");
+		vTaskDelete( NULL );
+	}
+
+	printf("%-8s %16s %16s %12s %12s\r\n", "channel", "msgs/s rx-above", "msgs/s rx-below",
+	       "wake_avg_us", "wake_max_us");
+	vBenchChannel( &xQueueChannel );
+	vBenchChannel( &xRingChannel );
+
+	printf("# done\r\n");
+	vTaskDelete( NULL );
+}
+
+/**************************************************************************/
+
+void app_main(void)
+{
+	xTaskCreate( vControllerTask, "Controller", STACK_SIZE, NULL, 10, &xControllerTask );
+}
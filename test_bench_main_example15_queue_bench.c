@@ -0,0 +1,340 @@
+/* Queue throughput and latency benchmark suite
+
+   Runs the sender/receiver arrangement of example4 (senders at priority 1,
+   receiver at priority 2, so every item wakes the receiver) and of example5
+   (senders at priority 2, receiver at priority 1, so the queue runs full)
+   over a sweep of queue depth, item size and number of senders, for both the
+   FreeRTOS queue and the batch queue from batch_queue.h.
+
+   Every item starts with the low 32 bits of esp_timer_get_time() taken just
+   before it is sent, so the receiver can histogram end-to-end latency. Each
+   send and receive is first tried without waiting; only when that fails is
+   the blocking call made and timed, which gives the blocked-time ratio of
+   each side: time spent blocked divided by (tasks x run time).
+
+   One CSV line per run is printed, after the header line:
+
+   backend,topology,depth,item_size,senders,items,items_per_s,p50_us,p99_us,p999_us,tx_blocked,rx_blocked
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+#include "batch_queue.h"
+
+#define STACK_SIZE            2048
+#define BENCH_RUN_MS          250
+#define BENCH_MAX_SENDERS     64
+#define BENCH_MAX_ITEM_SIZE   256
+#define CONTROLLER_PRIORITY   10
+
+/* Latency histogram: 1 us buckets below 16 us, then 8 buckets per power of
+   two, so any percentile is within 12.5% of the true value. */
+#define HIST_LINEAR           16
+#define HIST_SUB_BITS         3
+#define HIST_BUCKETS          ( HIST_LINEAR + ( 32 - 4 ) * ( 1 << HIST_SUB_BITS ) )
+
+static const UBaseType_t uxDepths[] = { 1, 5, 32 };
+static const UBaseType_t uxItemSizes[] = { 4, 64, 256 };
+static const UBaseType_t uxSenderCounts[] = { 2, 4, 16, 64 };
+
+typedef struct {
+	const char *pcName;
+	void       *( *pxCreate )( UBaseType_t uxDepth, UBaseType_t uxItemSize );
+	void        ( *pxDelete )( void *pvQueue );
+	BaseType_t  ( *pxSend )( void *pvQueue, const void *pvItem, TickType_t xTicksToWait );
+	UBaseType_t ( *pxReceive )( void *pvQueue, void *pvBuffer, UBaseType_t uxMaxItems, TickType_t xTicksToWait );
+} Backend_t;
+
+typedef struct {
+	const char *pcName;
+	UBaseType_t uxSenderPriority;
+	UBaseType_t uxReceiverPriority;
+} Topology_t;
+
+static const Topology_t xTopologies[] =
+{
+	{ "example4", 1, 2 },
+	{ "example5", 2, 1 },
+};
+
+/* State of the run in progress. */
+static const Backend_t *pxBackend;
+static void *pvQueue;
+static UBaseType_t uxDepth;
+static UBaseType_t uxItemSize;
+static UBaseType_t uxSenders;
+static volatile BaseType_t xStop;
+static volatile UBaseType_t uxSendersDone;
+static int64_t llTxBlocked[ BENCH_MAX_SENDERS ];
+static int64_t llRxBlocked;
+static uint32_t ulItems;
+static uint32_t ulHistogram[ HIST_BUCKETS ];
+static TaskHandle_t xControllerTask;
+
+/**************************************************************************/
+
+static void *pvQueueCreate( UBaseType_t uxLength, UBaseType_t uxSize )
+{
+	return xQueueCreate( uxLength, uxSize );
+}
+
+static void vQueueDeleteBackend( void *pvHandle )
+{
+	vQueueDelete( ( QueueHandle_t ) pvHandle );
+}
+
+static BaseType_t xQueueSendBackend( void *pvHandle, const void *pvItem, TickType_t xTicksToWait )
+{
+	return xQueueSendToBack( ( QueueHandle_t ) pvHandle, pvItem, xTicksToWait );
+}
+
+static UBaseType_t uxQueueReceiveBackend( void *pvHandle, void *pvBuffer, UBaseType_t uxMaxItems, TickType_t xTicksToWait )
+{
+	return ( xQueueReceive( ( QueueHandle_t ) pvHandle, pvBuffer, xTicksToWait ) == pdPASS ) ? 1 : 0;
+}
+
+static void *pvBatchCreate( UBaseType_t uxLength, UBaseType_t uxSize )
+{
+	return xBatchQueueCreate( uxLength, uxSize, NULL );
+}
+
+static void vBatchDelete( void *pvHandle )
+{
+	vBatchQueueDelete( ( BatchQueueHandle_t ) pvHandle );
+}
+
+static BaseType_t xBatchSend( void *pvHandle, const void *pvItem, TickType_t xTicksToWait )
+{
+	return xBatchQueueSend( ( BatchQueueHandle_t ) pvHandle, pvItem, xTicksToWait );
+}
+
+static UBaseType_t uxBatchReceive( void *pvHandle, void *pvBuffer, UBaseType_t uxMaxItems, TickType_t xTicksToWait )
+{
+	return uxBatchQueueReceiveBatch( ( BatchQueueHandle_t ) pvHandle, pvBuffer, uxMaxItems, xTicksToWait );
+}
+
+static const Backend_t xBackends[] =
+{
+	{ "queue", pvQueueCreate, vQueueDeleteBackend, xQueueSendBackend, uxQueueReceiveBackend },
+	{ "batch", pvBatchCreate, vBatchDelete, xBatchSend, uxBatchReceive },
+};
+
+/**************************************************************************/
+
+static UBaseType_t uxBucket( uint32_t ulMicros )
+{
+	int lMsb;
+
+	if( ulMicros < HIST_LINEAR )
+	{
+		return ulMicros;
+	}
+	lMsb = 31 - __builtin_clz( ulMicros );
+	return HIST_LINEAR + ( lMsb - 4 ) * ( 1 << HIST_SUB_BITS ) +
+	       ( ( ulMicros >> ( lMsb - HIST_SUB_BITS ) ) & ( ( 1 << HIST_SUB_BITS ) - 1 ) );
+}
+
+/* Lower edge of a bucket, in microseconds. */
+static uint32_t ulBucketValue( UBaseType_t uxBucketIndex )
+{
+	UBaseType_t uxMsb, uxSub;
+
+	if( uxBucketIndex < HIST_LINEAR )
+	{
+		return uxBucketIndex;
+	}
+	uxMsb = 4 + ( uxBucketIndex - HIST_LINEAR ) / ( 1 << HIST_SUB_BITS );
+	uxSub = ( uxBucketIndex - HIST_LINEAR ) % ( 1 << HIST_SUB_BITS );
+	return ( 1UL << uxMsb ) + ( uxSub << ( uxMsb - HIST_SUB_BITS ) );
+}
+
+/* ulPerMille: 500 for p50, 990 for p99, 999 for p99.9. */
+static uint32_t ulPercentile( uint32_t ulPerMille )
+{
+	uint64_t ullTarget = ( ( uint64_t ) ulItems * ulPerMille + 999 ) / 1000;
+	uint64_t ullSeen = 0;
+
+	for( UBaseType_t i = 0; i < HIST_BUCKETS; i++ )
+	{
+		ullSeen += ulHistogram[ i ];
+		if( ullSeen >= ullTarget && ullSeen != 0 )
+		{
+			return ulBucketValue( i );
+		}
+	}
+	return 0;
+}
+
+/**************************************************************************/
+
+static void vSenderTask( void *pvParameters )
+{
+	int64_t *pllBlocked = ( int64_t * ) pvParameters;
+	uint8_t ucItem[ BENCH_MAX_ITEM_SIZE ];
+	uint32_t ulStamp;
+	int64_t llStart;
+
+	memset( ucItem, 0x55, sizeof( ucItem ) );
+
+	while( !xStop )
+	{
+		ulStamp = ( uint32_t ) esp_timer_get_time();
+		memcpy( ucItem, &ulStamp, sizeof( ulStamp ) );
+
+		if( pxBackend->pxSend( pvQueue, ucItem, 0 ) != pdPASS )
+		{
+			llStart = esp_timer_get_time();
+			pxBackend->pxSend( pvQueue, ucItem, portMAX_DELAY );
+			*pllBlocked += esp_timer_get_time() - llStart;
+		}
+	}
+
+	__atomic_add_fetch( &uxSendersDone, 1, __ATOMIC_SEQ_CST );
+	vTaskDelete( NULL );
+}
+
+static void vReceiverTask( void *pvParameters )
+{
+	uint8_t *pucBuffer = ( uint8_t * ) pvParameters;
+	UBaseType_t uxReceived;
+	uint32_t ulNow, ulStamp;
+	int64_t llStart;
+
+	for(;;)
+	{
+		uxReceived = pxBackend->pxReceive( pvQueue, pucBuffer, uxDepth, 0 );
+
+		if( uxReceived == 0 )
+		{
+			/* Once the senders have stopped, the timeout tells the receiver
+			   the queue is drained. */
+			llStart = esp_timer_get_time();
+			uxReceived = pxBackend->pxReceive( pvQueue, pucBuffer, uxDepth, pdMS_TO_TICKS( 10 ) );
+			if( !xStop )
+			{
+				llRxBlocked += esp_timer_get_time() - llStart;
+			}
+		}
+
+		if( uxReceived == 0 && xStop && uxSendersDone == uxSenders )
+		{
+			break;
+		}
+
+		if( xStop )
+		{
+			continue;
+		}
+
+		ulNow = ( uint32_t ) esp_timer_get_time();
+		for( UBaseType_t i = 0; i < uxReceived; i++ )
+		{
+			memcpy( &ulStamp, &pucBuffer[ i * uxItemSize ], sizeof( ulStamp ) );
+			ulHistogram[ uxBucket( ulNow - ulStamp ) ]++;
+		}
+		ulItems += uxReceived;
+	}
+
+	xTaskNotifyGive( xControllerTask );
+	vTaskDelete( NULL );
+}
+
+/**************************************************************************/
+
+static void vRunOne( const Topology_t *pxTopology )
+{
+	uint8_t *pucBuffer;
+	int64_t llStart, llElapsed, llTxBlockedSum = 0;
+
+	pvQueue = pxBackend->pxCreate( uxDepth, uxItemSize );
+	pucBuffer = pvPortMalloc( uxDepth * uxItemSize );
+	if( pvQueue == NULL || pucBuffer == NULL )
+	{
+		printf("# %s depth %u item %u: out of memory\r\n", pxBackend->pcName,
+		       ( unsigned ) uxDepth, ( unsigned ) uxItemSize);
+		if( pvQueue != NULL ) pxBackend->pxDelete( pvQueue );
+		vPortFree( pucBuffer );
+		return;
+	}
+
+	xStop = pdFALSE;
+	uxSendersDone = 0;
+	llRxBlocked = 0;
+	ulItems = 0;
+	memset( llTxBlocked, 0, sizeof( llTxBlocked ) );
+	memset( ulHistogram, 0, sizeof( ulHistogram ) );
+
+	/* Nothing runs until this task blocks, so all tasks start together. */
+	xTaskCreate( vReceiverTask, "Receiver", STACK_SIZE, pucBuffer, pxTopology->uxReceiverPriority, NULL );
+	for( UBaseType_t i = 0; i < uxSenders; i++ )
+	{
+		xTaskCreate( vSenderTask, "Sender", STACK_SIZE, &llTxBlocked[ i ], pxTopology->uxSenderPriority, NULL );
+	}
+
+	llStart = esp_timer_get_time();
+	vTaskDelay( pdMS_TO_TICKS( BENCH_RUN_MS ) );
+	xStop = pdTRUE;
+	llElapsed = esp_timer_get_time() - llStart;
+
+	ulTaskNotifyTake( pdTRUE, portMAX_DELAY );
+
+	for( UBaseType_t i = 0; i < uxSenders; i++ )
+	{
+		llTxBlockedSum += llTxBlocked[ i ];
+	}
+
+	printf("%s,%s,%u,%u,%u,%u,%lld,%u,%u,%u,%.3f,%.3f\r\n",
+	       pxBackend->pcName, pxTopology->pcName, ( unsigned ) uxDepth, ( unsigned ) uxItemSize,
+	       ( unsigned ) uxSenders, ulItems,
+	       ulItems * 1000000LL / llElapsed,
+	       ulPercentile( 500 ), ulPercentile( 990 ), ulPercentile( 999 ),
+	       (double) llTxBlockedSum / ( (double) uxSenders * llElapsed ),
+	       (double) llRxBlocked / (double) llElapsed);
+
+	pxBackend->pxDelete( pvQueue );
+	vPortFree( pucBuffer );
+
+	/* Let the idle task free the stacks of the deleted tasks. */
+	vTaskDelay( 2 );
+}
+
+static void vControllerTask( void *pvParameters )
+{
+	printf("backend,topology,depth,item_size,senders,items,items_per_s,p50_us,p99_us,p999_us,tx_blocked,rx_blocked\r\n");
+
+	for( UBaseType_t b = 0; b < sizeof( xBackends ) / sizeof( xBackends[ 0 ] ); b++ )
+	{
+		pxBackend = &xBackends[ b ];
+		for( UBaseType_t t = 0; t < sizeof( xTopologies ) / sizeof( xTopologies[ 0 ] ); t++ )
+		{
+			for( UBaseType_t d = 0; d < sizeof( uxDepths ) / sizeof( uxDepths[ 0 ] ); d++ )
+			{
+				for( UBaseType_t s = 0; s < sizeof( uxItemSizes ) / sizeof( uxItemSizes[ 0 ] ); s++ )
+				{
+					for( UBaseType_t n = 0; n < sizeof( uxSenderCounts ) / sizeof( uxSenderCounts[ 0 ] ); n++ )
+					{
+						uxDepth = uxDepths[ d ];
+						uxItemSize = uxItemSizes[ s ];
+						uxSenders = uxSenderCounts[ n ];
+						vRunOne( &xTopologies[ t ] );
+					}
+				}
+			}
+		}
+	}
+
+	printf("# done\r\n");
+	vTaskDelete( NULL );
+}
+
+/**************************************************************************/
+
+void app_main(void)
+{
+	xTaskCreate( vControllerTask, "Controller", STACK_SIZE, NULL, CONTROLLER_PRIORITY, &xControllerTask );
+}
@@ -0,0 +1,308 @@
+/* Timer service benchmark: FreeRTOS timer daemon against the timing wheel
+
+   Creates 10 to 10,000 auto-reload timers with random periods, all started,
+   and measures what servicing them costs per tick, with and without a task
+   resetting a few random timers every tick (the "per-device timeout" case).
+
+   The cost is measured as CPU taken away from a spinner task: it counts
+   loops at the lowest priority on the core the timer service runs on, and
+   the difference against the count of a run without timers is the time the
+   service (callbacks and command processing included) took. Everything
+   else - this controller and the resetting task - runs on the other core.
+   For the wheel, the time its service task measures itself is printed too.
+
+   One CSV line per run is printed, after the header line:
+
+   service,timers,resets_per_tick,ticks,expired,reset_failed,cpu_per_tick_us,busy_per_tick_us
+
+   reset_failed counts resets that found the daemon's command queue full.
+   A size that does not fit in the heap prints an "out of memory" comment
+   line instead.
+*/
+
+#include <stdio.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/timers.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+#include "timer_wheel.h"
+
+#define STACK_SIZE            2048
+#define BENCH_RUN_MS          2000
+#define SERVICE_CORE          0
+#define OTHER_CORE            1
+#define CONTROLLER_PRIORITY   10
+#define CHURN_PRIORITY        2
+#define MIN_PERIOD_TICKS      10
+#define MAX_PERIOD_TICKS      1000
+
+/* At most this many resets are sent per tick: the daemon's command queue
+   only holds configTIMER_QUEUE_LENGTH of them. */
+#define RESETS_PER_TICK       4
+
+static const UBaseType_t uxTimerCounts[] = { 10, 100, 1000, 10000 };
+static const UBaseType_t uxResetCounts[] = { 0, RESETS_PER_TICK };
+
+typedef struct {
+	const char *pcName;
+	void       *( *pxCreate )( TickType_t xPeriod );
+	BaseType_t  ( *pxStart )( void *pvTimer );
+	BaseType_t  ( *pxReset )( void *pvTimer );
+	void        ( *pxDelete )( void *pvTimer );
+} Service_t;
+
+/* State of the run in progress. */
+static const Service_t *pxService;
+static void **ppvTimers;
+static UBaseType_t uxTimers;
+static UBaseType_t uxResetsPerTick;
+static volatile BaseType_t xChurn;
+static volatile uint32_t ulExpired;
+static volatile uint32_t ulResetFailed;
+static volatile uint32_t ulSpins;
+static double dBaselineSpinsPerUs;
+static TaskHandle_t xControllerTask;
+
+/**************************************************************************/
+
+/* xorshift32: the runs only need periods and reset targets spread out, and
+   the same sequence every boot keeps the runs comparable. */
+static uint32_t ulRandom( void )
+{
+	static uint32_t ulState = 0x12345678;
+
+	ulState ^= ulState << 13;
+	ulState ^= ulState >> 17;
+	ulState ^= ulState << 5;
+	return ulState;
+}
+
+/**************************************************************************/
+
+static void vDaemonCallback( TimerHandle_t xTimer )
+{
+	ulExpired++;
+}
+
+static void *pvDaemonCreate( TickType_t xPeriod )
+{
+	return xTimerCreate( "Bench", xPeriod, pdTRUE, 0, vDaemonCallback );
+}
+
+static BaseType_t xDaemonStart( void *pvTimer )
+{
+	return xTimerStart( ( TimerHandle_t ) pvTimer, portMAX_DELAY );
+}
+
+static BaseType_t xDaemonReset( void *pvTimer )
+{
+	return xTimerReset( ( TimerHandle_t ) pvTimer, 0 );
+}
+
+static void vDaemonDelete( void *pvTimer )
+{
+	xTimerDelete( ( TimerHandle_t ) pvTimer, portMAX_DELAY );
+}
+
+static void vWheelCallback( WheelTimerHandle_t xTimer )
+{
+	ulExpired++;
+}
+
+static void *pvWheelCreate( TickType_t xPeriod )
+{
+	return xWheelTimerCreate( "Bench", xPeriod, pdTRUE, 0, vWheelCallback );
+}
+
+static BaseType_t xWheelStart( void *pvTimer )
+{
+	return xWheelTimerStart( ( WheelTimerHandle_t ) pvTimer, 0 );
+}
+
+static BaseType_t xWheelReset( void *pvTimer )
+{
+	return xWheelTimerReset( ( WheelTimerHandle_t ) pvTimer, 0 );
+}
+
+static void vWheelDelete( void *pvTimer )
+{
+	xWheelTimerDelete( ( WheelTimerHandle_t ) pvTimer, 0 );
+}
+
+static const Service_t xServices[] =
+{
+	{ "daemon", pvDaemonCreate, xDaemonStart, xDaemonReset, vDaemonDelete },
+	{ "wheel", pvWheelCreate, xWheelStart, xWheelReset, vWheelDelete },
+};
+
+/**************************************************************************/
+
+static void vSpinnerTask( void *pvParameters )
+{
+	for(;;)
+	{
+		ulSpins++;
+	}
+}
+
+static void vChurnTask( void *pvParameters )
+{
+	TickType_t xLastWakeTime = xTaskGetTickCount();
+
+	while( xChurn )
+	{
+		vTaskDelayUntil( &xLastWakeTime, 1 );
+		for( UBaseType_t i = 0; i < uxResetsPerTick; i++ )
+		{
+			if( pxService->pxReset( ppvTimers[ ulRandom() % uxTimers ] ) != pdPASS )
+			{
+				ulResetFailed++;
+			}
+		}
+	}
+
+	xTaskNotifyGive( xControllerTask );
+	vTaskDelete( NULL );
+}
+
+/* Returns the spinner loops counted over one run, and its length. */
+static uint32_t ulMeasure( int64_t *pllElapsed, TickType_t *pxTicks )
+{
+	uint32_t ulStartSpins = ulSpins;
+	TickType_t xStartTick = xTaskGetTickCount();
+	int64_t llStart = esp_timer_get_time();
+
+	vTaskDelay( pdMS_TO_TICKS( BENCH_RUN_MS ) );
+
+	*pllElapsed = esp_timer_get_time() - llStart;
+	*pxTicks = xTaskGetTickCount() - xStartTick;
+	return ulSpins - ulStartSpins;
+}
+
+/**************************************************************************/
+
+static void vRunOne( void )
+{
+	WheelTimerStats_t xBefore, xAfter;
+	UBaseType_t uxCreated;
+	uint32_t ulLoops;
+	int64_t llElapsed;
+	TickType_t xTicks;
+	double dCpuUs;
+
+	ppvTimers = pvPortMalloc( uxTimers * sizeof( void * ) );
+	for( uxCreated = 0; ppvTimers != NULL && uxCreated < uxTimers; uxCreated++ )
+	{
+		ppvTimers[ uxCreated ] = pxService->pxCreate( MIN_PERIOD_TICKS + ulRandom() % ( MAX_PERIOD_TICKS - MIN_PERIOD_TICKS ) );
+		if( ppvTimers[ uxCreated ] == NULL )
+		{
+			break;
+		}
+	}
+
+	if( uxCreated < uxTimers )
+	{
+		printf("# %s %u timers: out of memory\r\n", pxService->pcName, ( unsigned ) uxTimers);
+		for( UBaseType_t i = 0; i < uxCreated; i++ )
+		{
+			pxService->pxDelete( ppvTimers[ i ] );
+		}
+		vPortFree( ppvTimers );
+		vTaskDelay( 2 );
+		return;
+	}
+
+	for( UBaseType_t i = 0; i < uxTimers; i++ )
+	{
+		pxService->pxStart( ppvTimers[ i ] );
+	}
+
+	/* Let the daemon work through the start commands before measuring. */
+	vTaskDelay( 2 );
+
+	ulExpired = 0;
+	ulResetFailed = 0;
+	xChurn = pdTRUE;
+	if( uxResetsPerTick != 0 )
+	{
+		xTaskCreatePinnedToCore( vChurnTask, "Churn", STACK_SIZE, NULL, CHURN_PRIORITY, NULL, OTHER_CORE );
+	}
+
+	vWheelTimerGetStats( &xBefore );
+	ulLoops = ulMeasure( &llElapsed, &xTicks );
+	vWheelTimerGetStats( &xAfter );
+
+	xChurn = pdFALSE;
+	if( uxResetsPerTick != 0 )
+	{
+		ulTaskNotifyTake( pdTRUE, portMAX_DELAY );
+	}
+
+	dCpuUs = (double) llElapsed - (double) ulLoops / dBaselineSpinsPerUs;
+	if( dCpuUs < 0 )
+	{
+		dCpuUs = 0;
+	}
+
+	printf("%s,%u,%u,%u,%u,%u,%.2f,", pxService->pcName, ( unsigned ) uxTimers, ( unsigned ) uxResetsPerTick,
+	       ( unsigned ) xTicks, ulExpired, ulResetFailed, dCpuUs / xTicks);
+	if( pxService->pxCreate == pvWheelCreate )
+	{
+		printf("%.2f\r\n", (double) ( xAfter.ullBusyUs - xBefore.ullBusyUs ) / ( xAfter.ulTicks - xBefore.ulTicks ));
+	}
+	else
+	{
+		printf("\r\n");
+	}
+
+	for( UBaseType_t i = 0; i < uxTimers; i++ )
+	{
+		pxService->pxDelete( ppvTimers[ i ] );
+	}
+	vPortFree( ppvTimers );
+
+	/* Let the daemon process the deletes and the idle task free the churn
+	   task's stack. */
+	vTaskDelay( 2 );
+}
+
+static void vControllerTask( void *pvParameters )
+{
+	int64_t llElapsed;
+	TickType_t xTicks;
+
+	xTaskCreatePinnedToCore( vSpinnerTask, "Spinner", STACK_SIZE, NULL, tskIDLE_PRIORITY, NULL, SERVICE_CORE );
+	xWheelTimerServiceStart( configTIMER_TASK_PRIORITY );
+
+	/* No timer is active, so neither service wakes up during this run. */
+	dBaselineSpinsPerUs = (double) ulMeasure( &llElapsed, &xTicks ) / (double) llElapsed;
+	printf("# baseline %.2f spins/us over %u ticks\r\n", dBaselineSpinsPerUs, ( unsigned ) xTicks);
+
+	printf("service,timers,resets_per_tick,ticks,expired,reset_failed,cpu_per_tick_us,busy_per_tick_us\r\n");
+
+	for( UBaseType_t s = 0; s < sizeof( xServices ) / sizeof( xServices[ 0 ] ); s++ )
+	{
+		pxService = &xServices[ s ];
+		for( UBaseType_t n = 0; n < sizeof( uxTimerCounts ) / sizeof( uxTimerCounts[ 0 ] ); n++ )
+		{
+			for( UBaseType_t r = 0; r < sizeof( uxResetCounts ) / sizeof( uxResetCounts[ 0 ] ); r++ )
+			{
+				uxTimers = uxTimerCounts[ n ];
+				uxResetsPerTick = uxResetCounts[ r ];
+				vRunOne();
+			}
+		}
+	}
+
+	printf("# done\r\n");
+	vTaskDelete( NULL );
+}
+
+/**************************************************************************/
+
+void app_main(void)
+{
+	xTaskCreatePinnedToCore( vControllerTask, "Controller", STACK_SIZE, NULL, CONTROLLER_PRIORITY,
+	                         &xControllerTask, OTHER_CORE );
+}
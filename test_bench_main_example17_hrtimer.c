@@ -0,0 +1,136 @@
+/* High-resolution timer example
+
+   Runs a 250 us control loop and the 3.333 s one-shot of example6 on the
+   hrtimer.h timers instead of software timers, and shows how closely they
+   keep time: every callback records how late it started after its deadline,
+   and the control task how late it woke, in the lateness histograms of
+   timer_lateness.h, printed every REPORT_PERIOD_MS.
+
+   The one-shot is restarted from its own callback, so it also shows that a
+   deadline of pdMS_TO_TICKS( 3333 ) rounded to 333 ticks is no longer
+   needed: it fires 3333000 us after it was started.
+
+   example6's 500 ms auto-reload timer runs here too. It and the one-shot
+   are given TIMER_SLACK_US of slack, so they fire in a wakeup of the
+   control loop instead of waking the CPU themselves; the report shows how
+   many wakeups that saved.
+*/
+
+#include <stdio.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/gpio.h"
+#include "esp_attr.h"
+#include "sdkconfig.h"
+#include "hrtimer.h"
+#include "timer_lateness.h"
+
+#define CONTROL_PERIOD_US     250
+#define ONE_SHOT_DELAY_US     3333000
+#define AUTO_RELOAD_PERIOD_US 500000
+#define TIMER_SLACK_US        ( 2 * CONTROL_PERIOD_US )
+#define REPORT_PERIOD_MS      2000
+#define CONTROL_PRIORITY      10
+#define REPORT_PRIORITY       1
+#define STACK_SIZE            2048
+
+#define LED_BLUE 5
+
+static TaskHandle_t xControlTask;
+static HrTimerHandle_t xControlTimer, xOneShotTimer, xAutoReloadTimer;
+static volatile uint64_t ullControlDeadline;
+
+static TimerLateness_t xControlIsrLateness, xControlTaskLateness, xOneShotLateness, xAutoReloadLateness;
+
+/**************************************************************************/
+
+static void IRAM_ATTR prvControlCallback( HrTimerHandle_t xTimer, BaseType_t *pxHigherPriorityTaskWoken )
+{
+	uint64_t ullDeadline = ullHrTimerGetDeadline( xTimer );
+
+	vTimerLatenessRecordUs( &xControlIsrLateness, ( uint32_t ) ( ullHrTimerNow() - ullDeadline ) );
+	ullControlDeadline = ullDeadline;
+	vTaskNotifyGiveFromISR( xControlTask, pxHigherPriorityTaskWoken );
+}
+
+static void IRAM_ATTR prvOneShotCallback( HrTimerHandle_t xTimer, BaseType_t *pxHigherPriorityTaskWoken )
+{
+	vTimerLatenessRecordUs( &xOneShotLateness, ( uint32_t ) ( ullHrTimerNow() - ullHrTimerGetDeadline( xTimer ) ) );
+	xHrTimerStartOnce( xTimer, ONE_SHOT_DELAY_US );
+}
+
+static void IRAM_ATTR prvAutoReloadCallback( HrTimerHandle_t xTimer, BaseType_t *pxHigherPriorityTaskWoken )
+{
+	vTimerLatenessRecordUs( &xAutoReloadLateness, ( uint32_t ) ( ullHrTimerNow() - ullHrTimerGetDeadline( xTimer ) ) );
+}
+
+/**************************************************************************/
+
+/* Stands in for a control loop: one step per period, woken by the timer. */
+static void vControlTask( void *pvParameters )
+{
+	uint32_t ulSteps = 0;
+
+	for(;;)
+	{
+		ulTaskNotifyTake( pdTRUE, portMAX_DELAY );
+		vTimerLatenessRecordUs( &xControlTaskLateness, ( uint32_t ) ( ullHrTimerNow() - ullControlDeadline ) );
+
+		ulSteps++;
+		gpio_set_level( LED_BLUE, ( ulSteps >> 11 ) & 1 );
+	}
+}
+
+static void vReportTask( void *pvParameters )
+{
+	TickType_t xLastWakeTime = xTaskGetTickCount();
+	HrTimerStats_t xStats;
+
+	for(;;)
+	{
+		vTaskDelayUntil( &xLastWakeTime, pdMS_TO_TICKS( REPORT_PERIOD_MS ) );
+		vTimerLatenessPrintAll();
+
+		vHrTimerGetStats( &xStats );
+		printf("wakeups %u, callbacks %u, wakeups saved by slack %u\r\n",
+		       xStats.ulWakeups, xStats.ulExpiries, xStats.ulCoalesced);
+	}
+}
+
+/**************************************************************************/
+
+void app_main(void)
+{
+	gpio_pad_select_gpio( LED_BLUE );
+	gpio_set_direction( LED_BLUE, GPIO_MODE_OUTPUT );
+
+	vTimerLatenessRegister( &xControlIsrLateness, "control_isr" );
+	vTimerLatenessRegister( &xControlTaskLateness, "control_task" );
+	vTimerLatenessRegister( &xOneShotLateness, "one_shot" );
+	vTimerLatenessRegister( &xAutoReloadLateness, "auto_reload" );
+
+	xTaskCreate( vControlTask, "Control", STACK_SIZE, NULL, CONTROL_PRIORITY, &xControlTask );
+	xTaskCreate( vReportTask, "Report", STACK_SIZE, NULL, REPORT_PRIORITY, NULL );
+
+	if( xHrTimerInit() != pdPASS )
+	{
+		printf("High-resolution timer could not be set up\r\n");
+		return;
+	}
+
+	xControlTimer = xHrTimerCreate( "control", prvControlCallback, NULL );
+	xOneShotTimer = xHrTimerCreate( "one_shot", prvOneShotCallback, NULL );
+	xAutoReloadTimer = xHrTimerCreate( "auto_reload", prvAutoReloadCallback, NULL );
+	if( xControlTimer == NULL || xOneShotTimer == NULL || xAutoReloadTimer == NULL )
+	{
+		printf("High-resolution timers not created\r\n");
+		return;
+	}
+
+	vHrTimerSetSlack( xOneShotTimer, TIMER_SLACK_US );
+	vHrTimerSetSlack( xAutoReloadTimer, TIMER_SLACK_US );
+
+	xHrTimerStartPeriodic( xControlTimer, CONTROL_PERIOD_US );
+	xHrTimerStartOnce( xOneShotTimer, ONE_SHOT_DELAY_US );
+	xHrTimerStartPeriodic( xAutoReloadTimer, AUTO_RELOAD_PERIOD_US );
+}
@@ -0,0 +1,245 @@
+/* ISR-to-task wake benchmark: semaphores against task notification signals
+
+   A timer group alarm interrupts every BENCH_PERIOD_US and wakes one task,
+   first through a binary and a counting semaphore (as example08 and
+   example12 do), then through the binary and counting signals of
+   isr_signal.h. Two numbers are taken with the CPU cycle counter:
+
+   give   cycles spent in the give call inside the ISR
+   wake   cycles from the ISR's entry to the woken task running again
+
+   Cycle counters are per core, so the ISR and the woken task both run on
+   core 0. One CSV line per mechanism is printed, after the header line:
+
+   mechanism,wakeups,give_p50,give_max,wake_p50,wake_p99,wake_max,wake_p50_us,wake_p99_us
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "driver/timer.h"
+#include "esp_attr.h"
+#include "soc/cpu.h"
+#include "sdkconfig.h"
+#include "isr_signal.h"
+
+#define STACK_SIZE            2048
+#define BENCH_CORE            0
+#define BENCH_PERIOD_US       1000
+#define BENCH_SAMPLES         2000
+#define CONTROLLER_PRIORITY   2
+#define WAITER_PRIORITY       10
+
+/* 80 MHz APB clock / 80: one count per microsecond. */
+#define TIMER_DIVIDER         80
+
+typedef struct {
+	const char *pcName;
+	void       *( *pxCreate )( void );
+	void        ( *pxGiveFromISR )( void *pvHandle, BaseType_t *pxHigherPriorityTaskWoken );
+	BaseType_t  ( *pxTake )( void *pvHandle, TickType_t xTicksToWait );
+} Mechanism_t;
+
+/* State of the run in progress. */
+static const Mechanism_t *pxMechanism;
+static void *pvHandle;
+static volatile uint32_t ulIsrEntry;
+static volatile UBaseType_t uxGiveSamples;
+static UBaseType_t uxWakeSamples;
+static uint32_t ulGiveCycles[ BENCH_SAMPLES ];
+static uint32_t ulWakeCycles[ BENCH_SAMPLES ];
+static TaskHandle_t xControllerTask;
+
+/**************************************************************************/
+
+static void *pvBinarySemaphoreCreate( void )
+{
+	return xSemaphoreCreateBinary();
+}
+
+static void *pvCountingSemaphoreCreate( void )
+{
+	return xSemaphoreCreateCounting( BENCH_SAMPLES, 0 );
+}
+
+static void IRAM_ATTR vSemaphoreGive( void *pvSemaphore, BaseType_t *pxHigherPriorityTaskWoken )
+{
+	xSemaphoreGiveFromISR( ( SemaphoreHandle_t ) pvSemaphore, pxHigherPriorityTaskWoken );
+}
+
+static BaseType_t xSemaphoreTakeBackend( void *pvSemaphore, TickType_t xTicksToWait )
+{
+	return xSemaphoreTake( ( SemaphoreHandle_t ) pvSemaphore, xTicksToWait );
+}
+
+static void *pvBinarySignalCreate( void )
+{
+	return xIsrSignalCreateBinary();
+}
+
+static void *pvCountingSignalCreate( void )
+{
+	return xIsrSignalCreateCounting();
+}
+
+static void IRAM_ATTR vSignalGive( void *pvSignal, BaseType_t *pxHigherPriorityTaskWoken )
+{
+	xIsrSignalGiveFromISR( ( IsrSignalHandle_t ) pvSignal, pxHigherPriorityTaskWoken );
+}
+
+static BaseType_t xSignalTake( void *pvSignal, TickType_t xTicksToWait )
+{
+	return xIsrSignalTake( ( IsrSignalHandle_t ) pvSignal, xTicksToWait );
+}
+
+/* vBenchIsr() calls through this table, so it must be readable with the
+   flash cache disabled. */
+static const DRAM_ATTR Mechanism_t xMechanisms[] =
+{
+	{ "binary_semaphore", pvBinarySemaphoreCreate, vSemaphoreGive, xSemaphoreTakeBackend },
+	{ "counting_semaphore", pvCountingSemaphoreCreate, vSemaphoreGive, xSemaphoreTakeBackend },
+	{ "binary_signal", pvBinarySignalCreate, vSignalGive, xSignalTake },
+	{ "counting_signal", pvCountingSignalCreate, vSignalGive, xSignalTake },
+};
+
+/**************************************************************************/
+
+static void IRAM_ATTR vBenchIsr( void *pvParameters )
+{
+	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+	uint32_t ulEntry = esp_cpu_get_ccount();
+	uint32_t ulGiveStart;
+
+	timer_group_intr_clr_in_isr( TIMER_GROUP_0, TIMER_0 );
+	timer_group_enable_alarm_in_isr( TIMER_GROUP_0, TIMER_0 );
+
+	if( uxGiveSamples < BENCH_SAMPLES )
+	{
+		ulIsrEntry = ulEntry;
+
+		ulGiveStart = esp_cpu_get_ccount();
+		pxMechanism->pxGiveFromISR( pvHandle, &xHigherPriorityTaskWoken );
+		ulGiveCycles[ uxGiveSamples++ ] = esp_cpu_get_ccount() - ulGiveStart;
+	}
+
+	if( xHigherPriorityTaskWoken ) portYIELD_FROM_ISR();
+}
+
+static void vWaiterTask( void *pvParameters )
+{
+	uint32_t ulNow;
+
+	while( uxWakeSamples < BENCH_SAMPLES )
+	{
+		if( pxMechanism->pxTake( pvHandle, pdMS_TO_TICKS( 1000 ) ) != pdTRUE )
+		{
+			break;
+		}
+		ulNow = esp_cpu_get_ccount();
+		ulWakeCycles[ uxWakeSamples++ ] = ulNow - ulIsrEntry;
+	}
+
+	xTaskNotifyGive( xControllerTask );
+	vTaskDelete( NULL );
+}
+
+/**************************************************************************/
+
+static int iCompare( const void *pvA, const void *pvB )
+{
+	uint32_t ulA = *( const uint32_t * ) pvA, ulB = *( const uint32_t * ) pvB;
+
+	return ( ulA > ulB ) - ( ulA < ulB );
+}
+
+/* ulPerMille of the sorted samples: 500 for p50, 990 for p99. */
+static uint32_t ulPercentile( const uint32_t *pulSorted, UBaseType_t uxCount, uint32_t ulPerMille )
+{
+	return ( uxCount == 0 ) ? 0 : pulSorted[ ( uxCount - 1 ) * ulPerMille / 1000 ];
+}
+
+static void vRunOne( void )
+{
+	UBaseType_t uxGives, uxWakes;
+
+	pvHandle = pxMechanism->pxCreate();
+	if( pvHandle == NULL )
+	{
+		printf("# %s: out of memory\r\n", pxMechanism->pcName);
+		return;
+	}
+
+	uxGiveSamples = 0;
+	uxWakeSamples = 0;
+	xTaskCreatePinnedToCore( vWaiterTask, "Waiter", STACK_SIZE, NULL, WAITER_PRIORITY, NULL, BENCH_CORE );
+
+	timer_set_counter_value( TIMER_GROUP_0, TIMER_0, 0x00000000ULL );
+	timer_start( TIMER_GROUP_0, TIMER_0 );
+	ulTaskNotifyTake( pdTRUE, portMAX_DELAY );
+	timer_pause( TIMER_GROUP_0, TIMER_0 );
+
+	/* A binary mechanism latches gives that arrive before the task runs
+	   into one wake, so there can be more gives than wakes. */
+	uxGives = uxGiveSamples;
+	uxWakes = uxWakeSamples;
+	qsort( ulGiveCycles, uxGives, sizeof( uint32_t ), iCompare );
+	qsort( ulWakeCycles, uxWakes, sizeof( uint32_t ), iCompare );
+
+	printf("%s,%u,%u,%u,%u,%u,%u,%.2f,%.2f\r\n", pxMechanism->pcName, ( unsigned ) uxWakes,
+	       ulPercentile( ulGiveCycles, uxGives, 500 ), uxGives ? ulGiveCycles[ uxGives - 1 ] : 0,
+	       ulPercentile( ulWakeCycles, uxWakes, 500 ), ulPercentile( ulWakeCycles, uxWakes, 990 ),
+	       uxWakes ? ulWakeCycles[ uxWakes - 1 ] : 0,
+	       (double) ulPercentile( ulWakeCycles, uxWakes, 500 ) / CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ,
+	       (double) ulPercentile( ulWakeCycles, uxWakes, 990 ) / CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ);
+
+	/* The semaphores and signals are not deleted: a signal can't be, and
+	   the few bytes per run don't matter here. Let the idle task free the
+	   waiter's stack. */
+	vTaskDelay( 2 );
+}
+
+/* Same set-up as example_tg0_timer_init() in example11, at 1 MHz. */
+static void vTimerInit( void )
+{
+	timer_config_t config;
+
+	config.divider = TIMER_DIVIDER;
+	config.counter_dir = TIMER_COUNT_UP;
+	config.counter_en = TIMER_PAUSE;
+	config.alarm_en = TIMER_ALARM_EN;
+	config.intr_type = TIMER_INTR_LEVEL;
+	config.auto_reload = TIMER_AUTORELOAD_EN;
+	timer_init( TIMER_GROUP_0, TIMER_0, &config );
+
+	timer_set_counter_value( TIMER_GROUP_0, TIMER_0, 0x00000000ULL );
+	timer_set_alarm_value( TIMER_GROUP_0, TIMER_0, BENCH_PERIOD_US );
+	timer_enable_intr( TIMER_GROUP_0, TIMER_0 );
+	timer_isr_register( TIMER_GROUP_0, TIMER_0, vBenchIsr, NULL, ESP_INTR_FLAG_IRAM, NULL );
+}
+
+static void vControllerTask( void *pvParameters )
+{
+	/* The interrupt is allocated on the core that registers it. */
+	vTimerInit();
+
+	printf("mechanism,wakeups,give_p50,give_max,wake_p50,wake_p99,wake_max,wake_p50_us,wake_p99_us\r\n");
+
+	for( UBaseType_t m = 0; m < sizeof( xMechanisms ) / sizeof( xMechanisms[ 0 ] ); m++ )
+	{
+		pxMechanism = &xMechanisms[ m ];
+		vRunOne();
+	}
+
+	printf("# done\r\n");
+	vTaskDelete( NULL );
+}
+
+/**************************************************************************/
+
+void app_main(void)
+{
+	xTaskCreatePinnedToCore( vControllerTask, "Controller", STACK_SIZE, NULL, CONTROLLER_PRIORITY,
+	                         &xControllerTask, BENCH_CORE );
+}
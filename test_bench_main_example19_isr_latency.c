@@ -0,0 +1,308 @@
+/* Interrupt-to-task latency under background load
+
+   The three interrupt sources of example12 -- TIMER_0 and TIMER_1 of timer
+   group 0 and a falling edge on the BUTTON pin -- wake one handler task
+   through a counting signal, as they wake example_evt_task. Each ISR stamps
+   the cycle counter into its source's histogram (isr_latency.h) and the
+   handler resumes the stamps as soon as it runs. The GPIO edges are
+   injected: the pin is an input-output and an injector task writes it,
+   which raises the interrupt on the chip and in the host simulation alike.
+
+   The run is repeated under each background load:
+
+   idle          nothing else runs
+   below         a task one priority below the handler spins
+   equal         a task at the handler's priority spins, so a woken handler
+                 waits for the time slice to end
+   above_burst   a task one priority above the handler busy-waits BURST_US
+                 out of every BURST_PERIOD_MS
+
+   One CSV line per load and source is printed, after the header line:
+
+   load,source,samples,coalesced,p50_cyc,p90_cyc,p99_cyc,p999_cyc,max_cyc,p50_us,p99_us,max_us
+
+   Everything runs on core 0, where the controller registers the
+   interrupts, so the cycle counters can be compared. Under the host
+   simulation (host/sim_main.c) timer alarms are delivered on ticks, and the
+   whole run takes about 25 s:
+
+     SIM_RUN_SECONDS=30 ./example19
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/gpio.h"
+#include "driver/timer.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+#include "isr_signal.h"
+#include "isr_latency.h"
+
+#define STACK_SIZE            2048
+#define BENCH_CORE            0
+#define RUN_MS                5000
+
+#define BUTTON                18
+#define ESP_INTR_FLAG_DEFAULT 0
+
+/* 80 MHz APB clock / 80: one count per microsecond. */
+#define TIMER_DIVIDER         80
+#define TIMER0_PERIOD_US      4000
+#define TIMER1_PERIOD_US      6000
+
+#define BURST_US              2000
+#define BURST_PERIOD_MS       10
+
+/* Spinners sleep a tick this often so the idle task still feeds the task
+   watchdog. */
+#define SPIN_SLICE_US         100000
+
+#define HANDLER_PRIORITY      10
+#define INJECTOR_PRIORITY     12
+#define CONTROLLER_PRIORITY   13
+
+typedef struct {
+	const char    *pcName;
+	TaskFunction_t pxTask;
+	UBaseType_t    uxPriority;
+} Load_t;
+
+static IsrSignalHandle_t xSignal;
+static IsrLatency_t xGpioLatency;
+static IsrLatency_t xTimer0Latency;
+static IsrLatency_t xTimer1Latency;
+static volatile BaseType_t xInjecting = pdFALSE;
+
+/**************************************************************************/
+
+static void IRAM_ATTR vButtonISRhandler( void *pvParameters )
+{
+	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+	vIsrLatencyStamp( &xGpioLatency );
+	xIsrSignalGiveFromISR( xSignal, &xHigherPriorityTaskWoken );
+
+	if( xHigherPriorityTaskWoken ) portYIELD_FROM_ISR();
+}
+
+static void IRAM_ATTR timer_group0_isr( void *para )
+{
+	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+	timer_intr_t timer_intr = timer_group_intr_get_in_isr( TIMER_GROUP_0 );
+
+	/* Both alarms may be pending: each is stamped, cleared and re-armed on
+	   its own, whichever timer this handler was registered for. */
+	if( timer_intr & TIMER_INTR_T0 )
+	{
+		vIsrLatencyStamp( &xTimer0Latency );
+		timer_group_intr_clr_in_isr( TIMER_GROUP_0, TIMER_0 );
+		timer_group_enable_alarm_in_isr( TIMER_GROUP_0, TIMER_0 );
+		xIsrSignalGiveFromISR( xSignal, &xHigherPriorityTaskWoken );
+	}
+	if( timer_intr & TIMER_INTR_T1 )
+	{
+		vIsrLatencyStamp( &xTimer1Latency );
+		timer_group_intr_clr_in_isr( TIMER_GROUP_0, TIMER_1 );
+		timer_group_enable_alarm_in_isr( TIMER_GROUP_0, TIMER_1 );
+		xIsrSignalGiveFromISR( xSignal, &xHigherPriorityTaskWoken );
+	}
+
+	if( xHigherPriorityTaskWoken ) portYIELD_FROM_ISR();
+}
+
+/**************************************************************************/
+
+/* example_evt_task, minus the printing. */
+static void vHandlerTask( void *pvParameters )
+{
+	for(;;)
+	{
+		if( xIsrSignalTake( xSignal, portMAX_DELAY ) == pdTRUE )
+		{
+			vIsrLatencyResume( &xGpioLatency );
+			vIsrLatencyResume( &xTimer0Latency );
+			vIsrLatencyResume( &xTimer1Latency );
+		}
+	}
+}
+
+/* One falling edge every two ticks while a run is in progress. */
+static void vInjectorTask( void *pvParameters )
+{
+	uint32_t ulLevel = 1;
+
+	for(;;)
+	{
+		vTaskDelay( 1 );
+		if( xInjecting )
+		{
+			ulLevel = !ulLevel;
+			gpio_set_level( BUTTON, ulLevel );
+		}
+	}
+}
+
+static void vBusyWait( int64_t llMicros )
+{
+	int64_t llEnd = esp_timer_get_time() + llMicros;
+
+	while( esp_timer_get_time() < llEnd )
+	{
+	}
+}
+
+static void vSpinTask( void *pvParameters )
+{
+	for(;;)
+	{
+		vBusyWait( SPIN_SLICE_US );
+		vTaskDelay( 1 );
+	}
+}
+
+static void vBurstTask( void *pvParameters )
+{
+	TickType_t xLastWakeTime = xTaskGetTickCount();
+
+	for(;;)
+	{
+		vBusyWait( BURST_US );
+		vTaskDelayUntil( &xLastWakeTime, pdMS_TO_TICKS( BURST_PERIOD_MS ) );
+	}
+}
+
+static const Load_t xLoads[] =
+{
+	{ "idle", NULL, 0 },
+	{ "below", vSpinTask, HANDLER_PRIORITY - 1 },
+	{ "equal", vSpinTask, HANDLER_PRIORITY },
+	{ "above_burst", vBurstTask, HANDLER_PRIORITY + 1 },
+};
+
+/**************************************************************************/
+
+/* Same set-up as example_tg0_timer_init() in example12, at 1 MHz and left
+   paused. */
+static void vTimerInit( int timer_idx, uint64_t ullPeriodUs )
+{
+	timer_config_t config;
+
+	config.divider = TIMER_DIVIDER;
+	config.counter_dir = TIMER_COUNT_UP;
+	config.counter_en = TIMER_PAUSE;
+	config.alarm_en = TIMER_ALARM_EN;
+	config.intr_type = TIMER_INTR_LEVEL;
+	config.auto_reload = TIMER_AUTORELOAD_EN;
+	timer_init( TIMER_GROUP_0, timer_idx, &config );
+
+	timer_set_counter_value( TIMER_GROUP_0, timer_idx, 0x00000000ULL );
+	timer_set_alarm_value( TIMER_GROUP_0, timer_idx, ullPeriodUs );
+	timer_enable_intr( TIMER_GROUP_0, timer_idx );
+	timer_isr_register( TIMER_GROUP_0, timer_idx, timer_group0_isr,
+	                    ( void * ) ( intptr_t ) timer_idx, ESP_INTR_FLAG_IRAM, NULL );
+}
+
+static void vButtonInit( void )
+{
+	gpio_config_t config = {
+		.pin_bit_mask = 1ULL << BUTTON,
+		.mode = GPIO_MODE_INPUT_OUTPUT,
+		.pull_up_en = GPIO_PULLUP_ENABLE,
+		.pull_down_en = GPIO_PULLDOWN_DISABLE,
+		.intr_type = GPIO_INTR_NEGEDGE,
+	};
+
+	gpio_config( &config );
+	gpio_set_level( BUTTON, 1 );
+	gpio_install_isr_service( ESP_INTR_FLAG_DEFAULT );
+	gpio_isr_handler_add( BUTTON, vButtonISRhandler, NULL );
+}
+
+static void vPrintRow( const char *pcLoad, const IsrLatency_t *pxLatency )
+{
+	IsrLatencySummary_t xSummary;
+
+	vIsrLatencyGetSummary( pxLatency, &xSummary );
+	printf("%s,%s,%u,%u,%u,%u,%u,%u,%u,%.2f,%.2f,%.2f\r\n", pcLoad, pxLatency->pcName,
+	       xSummary.ulSamples, xSummary.ulCoalesced, xSummary.ulP50, xSummary.ulP90,
+	       xSummary.ulP99, xSummary.ulP999, xSummary.ulMax,
+	       fIsrLatencyCyclesToUs( xSummary.ulP50 ), fIsrLatencyCyclesToUs( xSummary.ulP99 ),
+	       fIsrLatencyCyclesToUs( xSummary.ulMax ));
+}
+
+static void vRunOne( const Load_t *pxLoad )
+{
+	TaskHandle_t xLoadTask = NULL;
+
+	vIsrLatencyReset( &xGpioLatency );
+	vIsrLatencyReset( &xTimer0Latency );
+	vIsrLatencyReset( &xTimer1Latency );
+
+	if( pxLoad->pxTask != NULL )
+	{
+		xTaskCreatePinnedToCore( pxLoad->pxTask, pxLoad->pcName, STACK_SIZE, NULL,
+		                         pxLoad->uxPriority, &xLoadTask, BENCH_CORE );
+	}
+
+	timer_set_counter_value( TIMER_GROUP_0, TIMER_0, 0x00000000ULL );
+	timer_set_counter_value( TIMER_GROUP_0, TIMER_1, 0x00000000ULL );
+	timer_start( TIMER_GROUP_0, TIMER_0 );
+	timer_start( TIMER_GROUP_0, TIMER_1 );
+	xInjecting = pdTRUE;
+
+	vTaskDelay( pdMS_TO_TICKS( RUN_MS ) );
+
+	xInjecting = pdFALSE;
+	timer_pause( TIMER_GROUP_0, TIMER_0 );
+	timer_pause( TIMER_GROUP_0, TIMER_1 );
+
+	if( xLoadTask != NULL )
+	{
+		vTaskDelete( xLoadTask );
+	}
+
+	/* Let the handler take what is still pending before reading. */
+	vTaskDelay( 2 );
+
+	vPrintRow( pxLoad->pcName, &xGpioLatency );
+	vPrintRow( pxLoad->pcName, &xTimer0Latency );
+	vPrintRow( pxLoad->pcName, &xTimer1Latency );
+}
+
+static void vControllerTask( void *pvParameters )
+{
+	/* The interrupts are allocated on the core that registers them. */
+	vTimerInit( TIMER_0, TIMER0_PERIOD_US );
+	vTimerInit( TIMER_1, TIMER1_PERIOD_US );
+	vButtonInit();
+
+	xTaskCreatePinnedToCore( vHandlerTask, "Handler", STACK_SIZE, NULL, HANDLER_PRIORITY, NULL, BENCH_CORE );
+	xTaskCreatePinnedToCore( vInjectorTask, "Injector", STACK_SIZE, NULL, INJECTOR_PRIORITY, NULL, BENCH_CORE );
+
+	printf("load,source,samples,coalesced,p50_cyc,p90_cyc,p99_cyc,p999_cyc,max_cyc,p50_us,p99_us,max_us\r\n");
+
+	for( UBaseType_t i = 0; i < sizeof( xLoads ) / sizeof( xLoads[ 0 ] ); i++ )
+	{
+		vRunOne( &xLoads[ i ] );
+	}
+
+	printf("# done\r\n");
+	vTaskDelete( NULL );
+}
+
+/**************************************************************************/
+
+void app_main(void)
+{
+	xSignal = xIsrSignalCreateCounting();
+
+	vIsrLatencyRegister( &xGpioLatency, "GPIO" );
+	vIsrLatencyRegister( &xTimer0Latency, "TIMER_0" );
+	vIsrLatencyRegister( &xTimer1Latency, "TIMER_1" );
+
+	xTaskCreatePinnedToCore( vControllerTask, "Controller", STACK_SIZE, NULL, CONTROLLER_PRIORITY,
+	                         NULL, BENCH_CORE );
+}
@@ -0,0 +1,151 @@
+/* Continuous ADC sampling: DMA blocks against polling
+
+   vReadSensor in example09 and example12 used to poll adc1_get_raw()
+   NO_OF_SAMPLES times in a row; they now take DMA blocks from an ADC stream
+   (adc_stream.h). This bench measures both on ADC1 channel 6:
+
+   poll   bursts of NO_OF_SAMPLES adc1_get_raw() calls, back to back, for
+          RUN_MS: the fastest the polling loop gets, and all of the task's
+          CPU time while it runs
+   dma    a stream at each rate in ulRates[] for RUN_MS, summing every block
+          as vReadSensor does
+
+   One CSV line per run is printed, after the header line:
+
+   mode,rate_hz,block,seconds,blocks,lost_blocks,measured_rate_hz,cpu_us_per_block
+
+   rate_hz is the configured rate (0 when polling), measured_rate_hz the
+   samples taken per second, lost ones included, and cpu_us_per_block the
+   time the task spends per block outside of waiting for it. A sustained
+   rate shows as a measured rate close to the configured one with no lost
+   blocks. Under the host simulation (host/sim_main.c) the simulated I2S
+   DMA completes its buffers from the interrupt dispatcher, and the whole
+   run takes about 15 s:
+
+     SIM_RUN_SECONDS=20 ./example20
+*/
+
+#include <stdio.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/adc.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+#include "adc_stream.h"
+
+#define STACK_SIZE            2048
+#define BENCH_PRIORITY        5
+#define RUN_MS                3000
+
+#define CHANNEL               ADC1_CHANNEL_6
+#define ATTEN                 ADC_ATTEN_DB_0
+#define NO_OF_SAMPLES         64
+#define BLOCK_SAMPLES         1000
+
+static const uint32_t ulRates[] = { 10000, 20000, 40000, 80000 };
+
+/* Keeps the sums from being optimised away. */
+static volatile uint32_t ulSink;
+
+/**************************************************************************/
+
+static void vPrintRow( const char *pcMode, uint32_t ulRateHz, uint32_t ulBlock, int64_t llElapsedUs,
+                       uint32_t ulBlocks, uint32_t ulLost, uint32_t ulMeasuredHz, int64_t llBusyUs )
+{
+	printf("%s,%u,%u,%.2f,%u,%u,%u,%.1f\r\n", pcMode, ulRateHz, ulBlock, llElapsedUs / 1e6,
+	       ulBlocks, ulLost, ulMeasuredHz, ulBlocks ? ( double ) llBusyUs / ulBlocks : 0.0);
+}
+
+static void vRunPoll( void )
+{
+	int64_t llStart, llElapsed;
+	uint32_t ulBursts = 0;
+
+	adc1_config_width( ADC_WIDTH_BIT_12 );
+	adc1_config_channel_atten( CHANNEL, ATTEN );
+
+	llStart = esp_timer_get_time();
+	do
+	{
+		uint32_t adc_reading = 0;
+
+		for( int i = 0; i < NO_OF_SAMPLES; i++ )
+		{
+			adc_reading += adc1_get_raw( CHANNEL );
+		}
+		ulSink = adc_reading / NO_OF_SAMPLES;
+		ulBursts++;
+
+		llElapsed = esp_timer_get_time() - llStart;
+	} while( llElapsed < RUN_MS * 1000LL );
+
+	/* Sleep a tick so the idle task still feeds the task watchdog. */
+	vTaskDelay( 1 );
+
+	vPrintRow( "poll", 0, NO_OF_SAMPLES, llElapsed, ulBursts, 0,
+	           ( uint32_t ) ( ( uint64_t ) ulBursts * NO_OF_SAMPLES * 1000000ULL / llElapsed ), llElapsed );
+}
+
+static void vRunStream( uint32_t ulRateHz )
+{
+	AdcStreamHandle_t xStream;
+	AdcStreamBlock_t xBlock;
+	AdcStreamStats_t xStats;
+	int64_t llStart, llNow, llBusy = 0;
+
+	xStream = xAdcStreamCreate( CHANNEL, ATTEN, ulRateHz, BLOCK_SAMPLES );
+	if( xStream == NULL )
+	{
+		printf("# dma,%u: stream could not be started\r\n", ulRateHz);
+		return;
+	}
+
+	llStart = esp_timer_get_time();
+	llNow = llStart;
+	while( llNow - llStart < RUN_MS * 1000LL )
+	{
+		if( xAdcStreamReceive( xStream, &xBlock, pdMS_TO_TICKS( 1000 ) ) != pdTRUE )
+		{
+			printf("# dma,%u: no block within 1 s\r\n", ulRateHz);
+			break;
+		}
+
+		llNow = esp_timer_get_time();
+
+		uint32_t ulSum = 0;
+		for( size_t i = 0; i < xBlock.uxSamples; i++ )
+		{
+			ulSum += xBlock.pusSamples[ i ];
+		}
+		ulSink = ulSum;
+
+		llBusy += esp_timer_get_time() - llNow;
+	}
+
+	vAdcStreamGetStats( xStream, &xStats );
+	vAdcStreamDelete( xStream );
+
+	vPrintRow( "dma", ulRateHz, BLOCK_SAMPLES, llNow - llStart, xStats.ulBlocks, xStats.ulLostBlocks,
+	           xStats.ulMeasuredRateHz, llBusy );
+}
+
+/**************************************************************************/
+
+static void vBenchTask( void *pvParameters )
+{
+	printf("mode,rate_hz,block,seconds,blocks,lost_blocks,measured_rate_hz,cpu_us_per_block\r\n");
+
+	vRunPoll();
+	for( UBaseType_t i = 0; i < sizeof( ulRates ) / sizeof( ulRates[ 0 ] ); i++ )
+	{
+		vRunStream( ulRates[ i ] );
+	}
+
+	printf("# done\r\n");
+	vTaskDelete( NULL );
+}
+
+void app_main(void)
+{
+	xTaskCreate( vBenchTask, "Bench", STACK_SIZE, NULL, BENCH_PRIORITY, NULL );
+}
@@ -0,0 +1,191 @@
+/* ADC block filter costs and spike rejection
+
+   Runs a synthetic ADC signal through each filter stage of adc_filter.h
+   on its own, at a few settings, then through the chain example09 uses
+   (median 5, boxcar 16, decimate by 10), and measures ulAdcFilterSum().
+   The signal sits at code 2000 with +-8 codes of noise, plus a one-sample
+   spike to 4095 every SPIKE_EVERY samples, like the glitches that could
+   set off a false "Abnormal Temperature!!" in example09. It is fed in
+   blocks of BLOCK_SAMPLES, as the ADC stream delivers them.
+
+   One CSV line per stage or chain is printed, after the header line:
+
+   stage,param,samples_in,samples_out,cycles_per_sample,us_per_block,max_out
+
+   max_out is the highest sample that came out after the first block: the
+   spike itself (4095) for a stage that lets it through, close to 2000 for
+   one that removes it. The stages are sample-by-sample recurrences;
+   ulAdcFilterSum() is the kernel the compiler can vectorise. Under the host
+   simulation (host/sim_main.c) the CMake build compiles adc_filter.c at -O3
+   so that it is, and the cycle counts are host time at the configured CPU
+   frequency:
+
+     SIM_RUN_SECONDS=10 ./example21
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "soc/cpu.h"
+#include "sdkconfig.h"
+#include "adc_filter.h"
+
+#define STACK_SIZE            4096
+#define BENCH_PRIORITY        5
+
+#define BLOCK_SAMPLES         1000
+#define BLOCKS                200
+#define SPIKE_EVERY           487
+
+typedef struct {
+	const char      *pcName;
+	AdcFilterType_t  eType;
+	uint16_t         usParameter;
+} StageRun_t;
+
+static const StageRun_t xRuns[] =
+{
+	{ "boxcar",   eAdcFilterBoxcar,   4 },
+	{ "boxcar",   eAdcFilterBoxcar,   16 },
+	{ "boxcar",   eAdcFilterBoxcar,   64 },
+	{ "iir",      eAdcFilterIir,      2 },
+	{ "iir",      eAdcFilterIir,      6 },
+	{ "median",   eAdcFilterMedian,   3 },
+	{ "median",   eAdcFilterMedian,   5 },
+	{ "median",   eAdcFilterMedian,   15 },
+	{ "decimate", eAdcFilterDecimate, 10 },
+};
+
+static uint16_t usBlock[ BLOCK_SAMPLES ];
+static AdcFilterChain_t xChain;
+static AdcFilterStage_t xStages[ 3 ];
+
+/* Keeps the sums from being optimised away. */
+static volatile uint32_t ulSink;
+
+/**************************************************************************/
+
+static void vFillBlock( uint32_t ulBlock )
+{
+	static uint32_t ulNoise = 0x12345678;
+
+	for( uint32_t i = 0; i < BLOCK_SAMPLES; i++ )
+	{
+		ulNoise = ulNoise * 1664525UL + 1013904223UL;
+		usBlock[ i ] = 2000 - 8 + ( ulNoise >> 24 ) % 17;
+		if( ( ulBlock * BLOCK_SAMPLES + i ) % SPIKE_EVERY == SPIKE_EVERY - 1 )
+		{
+			usBlock[ i ] = 4095;
+		}
+	}
+}
+
+static BaseType_t xInitStage( AdcFilterStage_t *pxStage, AdcFilterType_t eType, uint16_t usParameter )
+{
+	switch( eType )
+	{
+		case eAdcFilterBoxcar:   return xAdcFilterBoxcarInit( pxStage, usParameter );
+		case eAdcFilterIir:      return xAdcFilterIirInit( pxStage, usParameter );
+		case eAdcFilterMedian:   return xAdcFilterMedianInit( pxStage, usParameter );
+		case eAdcFilterDecimate: return xAdcFilterDecimateInit( pxStage, usParameter );
+		default:                 return pdFAIL;
+	}
+}
+
+/* Feeds BLOCKS blocks through the chain and prints its line. */
+static void vRunChain( const char *pcName, uint32_t ulParameter )
+{
+	uint32_t ulOut = 0, ulMax = 0;
+	uint64_t ullCycles = 0;
+
+	vAdcFilterChainResetStats( &xChain );
+
+	for( uint32_t b = 0; b < BLOCKS; b++ )
+	{
+		uint32_t ulStart;
+		size_t uxOut;
+
+		vFillBlock( b );
+		ulStart = esp_cpu_get_ccount();
+		uxOut = uxAdcFilterChainProcess( &xChain, usBlock, BLOCK_SAMPLES );
+		ullCycles += esp_cpu_get_ccount() - ulStart;
+
+		for( size_t i = 0; b > 0 && i < uxOut; i++ )
+		{
+			if( usBlock[ i ] > ulMax ) ulMax = usBlock[ i ];
+		}
+		ulOut += uxOut;
+
+		/* Sleep a tick now and then so the idle task feeds the watchdog. */
+		if( b % 50 == 49 ) vTaskDelay( 1 );
+	}
+
+	printf("%s,%u,%u,%u,%.1f,%.1f,%u\r\n", pcName, ulParameter, BLOCKS * BLOCK_SAMPLES, ulOut,
+	       ( double ) ullCycles / ( BLOCKS * BLOCK_SAMPLES ),
+	       ( double ) ullCycles / BLOCKS / CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ, ulMax);
+}
+
+static void vRunSum( void )
+{
+	uint64_t ullCycles = 0;
+	uint32_t ulMax = 0;
+
+	for( uint32_t b = 0; b < BLOCKS; b++ )
+	{
+		uint32_t ulStart;
+
+		vFillBlock( b );
+		ulStart = esp_cpu_get_ccount();
+		ulSink = ulAdcFilterSum( usBlock, BLOCK_SAMPLES );
+		ullCycles += esp_cpu_get_ccount() - ulStart;
+
+		if( b > 0 && ulSink / BLOCK_SAMPLES > ulMax ) ulMax = ulSink / BLOCK_SAMPLES;
+	}
+
+	/* max_out here is the highest block average. */
+	printf("sum,0,%u,%u,%.1f,%.1f,%u\r\n", BLOCKS * BLOCK_SAMPLES, BLOCKS,
+	       ( double ) ullCycles / ( BLOCKS * BLOCK_SAMPLES ),
+	       ( double ) ullCycles / BLOCKS / CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ, ulMax);
+}
+
+/**************************************************************************/
+
+static void vBenchTask( void *pvParameters )
+{
+	printf("stage,param,samples_in,samples_out,cycles_per_sample,us_per_block,max_out\r\n");
+
+	for( UBaseType_t i = 0; i < sizeof( xRuns ) / sizeof( xRuns[ 0 ] ); i++ )
+	{
+		vAdcFilterChainInit( &xChain );
+		if( xInitStage( &xStages[ 0 ], xRuns[ i ].eType, xRuns[ i ].usParameter ) != pdPASS )
+		{
+			printf("# %s,%u: rejected\r\n", xRuns[ i ].pcName, xRuns[ i ].usParameter);
+			continue;
+		}
+		vAdcFilterChainAppend( &xChain, &xStages[ 0 ] );
+		vRunChain( xRuns[ i ].pcName, xRuns[ i ].usParameter );
+	}
+
+	/* example09's chain. */
+	vAdcFilterChainInit( &xChain );
+	xAdcFilterMedianInit( &xStages[ 0 ], 5 );
+	xAdcFilterBoxcarInit( &xStages[ 1 ], 16 );
+	xAdcFilterDecimateInit( &xStages[ 2 ], 10 );
+	for( UBaseType_t i = 0; i < 3; i++ )
+	{
+		vAdcFilterChainAppend( &xChain, &xStages[ i ] );
+	}
+	vRunChain( "chain", 0 );
+	vAdcFilterChainPrint( &xChain, "# chain" );
+
+	vRunSum();
+
+	printf("# done\r\n");
+	vTaskDelete( NULL );
+}
+
+void app_main(void)
+{
+	xTaskCreate( vBenchTask, "Bench", STACK_SIZE, NULL, BENCH_PRIORITY, NULL );
+}
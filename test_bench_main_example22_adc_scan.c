@@ -0,0 +1,150 @@
+/* ADC scan check: channel tags survive every scan shape
+
+   A DMA scan (adc_scan.h) sorts the samples of its block into rows by the
+   channel tag in their top bits, so a stream that dropped the tags would
+   leave every row empty and count every sample as stray. This checks each
+   configuration in xCases[] for SCANS scans:
+
+   - every scan comes back with SAMPLES samples in every row
+   - no sample is stray
+   - every sample is a 12-bit code
+
+   and that a plain stream (xAdcStreamCreate()) still hands out bare codes.
+   The one-channel case scans a channel other than 0, whose tag can't be
+   mistaken for a stripped one. One CSV line per case is printed, after the
+   header line:
+
+   case,mode,channels,scans,samples,stray,lost,result
+
+   then "# done" if every case passed, or "# failed". Under the host
+   simulation (host/sim_main.c) it runs as a ctest and takes about 3 s:
+
+     SIM_RUN_SECONDS=10 ./example22
+*/
+
+#include <stdio.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/adc.h"
+#include "sdkconfig.h"
+#include "adc_stream.h"
+#include "adc_scan.h"
+
+#define STACK_SIZE            2048
+#define CHECK_PRIORITY        5
+
+#define ATTEN                 ADC_ATTEN_DB_0
+#define SCAN_RATE_HZ          20
+#define SAMPLES               50
+#define SCANS                 10
+#define STREAM_RATE_HZ        20000
+#define STREAM_BLOCK          1000
+
+typedef struct
+{
+	const char           *pcName;
+	AdcScanMode_t         eMode;
+	size_t                uxChannels;
+	const adc1_channel_t *pxChannels;
+} ScanCase_t;
+
+static const adc1_channel_t xOne[] = { ADC1_CHANNEL_6 };
+static const adc1_channel_t xTwo[] = { ADC1_CHANNEL_6, ADC1_CHANNEL_7 };
+
+static const ScanCase_t xCases[] =
+{
+	{ "dma_one",    eAdcScanDma,    1, xOne },
+	{ "dma_two",    eAdcScanDma,    2, xTwo },
+	{ "polled_one", eAdcScanPolled, 1, xOne },
+};
+
+/**************************************************************************/
+
+static BaseType_t xCheckScan( const ScanCase_t *pxCase )
+{
+	AdcScannerHandle_t xScanner;
+	AdcScan_t *pxScan;
+	AdcScanStats_t xStats;
+	uint32_t ulScans = 0, ulShort = 0, ulBadCodes = 0;
+
+	xScanner = xAdcScanCreate( pxCase->eMode, pxCase->pxChannels, pxCase->uxChannels, ATTEN, SCAN_RATE_HZ, SAMPLES );
+	if( xScanner == NULL )
+	{
+		printf("# %s: scan could not be started\r\n", pxCase->pcName);
+		return pdFAIL;
+	}
+
+	while( ulScans < SCANS && xAdcScanNext( xScanner, &pxScan, pdMS_TO_TICKS( 1000 ) ) == pdTRUE )
+	{
+		ulScans++;
+		if( pxScan->uxSamples != SAMPLES )
+		{
+			ulShort++;
+		}
+		for( size_t c = 0; c < pxScan->uxChannels; c++ )
+		{
+			for( size_t i = 0; i < pxScan->uxSamples; i++ )
+			{
+				ulBadCodes += ( pxScan->pusSamples[ c ][ i ] > ADC_STREAM_CODE_MASK );
+			}
+		}
+	}
+
+	vAdcScanGetStats( xScanner, &xStats );
+	vAdcScanDelete( xScanner );
+
+	BaseType_t xPass = ( ulScans == SCANS && ulShort == 0 && ulBadCodes == 0 && xStats.ulStray == 0 );
+	printf("%s,%s,%u,%u,%u,%u,%u,%s\r\n", pxCase->pcName, ( pxCase->eMode == eAdcScanDma ) ? "dma" : "polled",
+	       ( unsigned ) pxCase->uxChannels, ulScans, ulShort ? 0 : SAMPLES, xStats.ulStray, xStats.ulLostScans,
+	       xPass ? "pass" : "FAIL");
+	return xPass;
+}
+
+static BaseType_t xCheckPlainStream( void )
+{
+	AdcStreamHandle_t xStream;
+	AdcStreamBlock_t xBlock;
+	uint32_t ulBadCodes = 0;
+	BaseType_t xReceived;
+
+	xStream = xAdcStreamCreate( ADC1_CHANNEL_6, ATTEN, STREAM_RATE_HZ, STREAM_BLOCK );
+	if( xStream == NULL )
+	{
+		printf("# stream: stream could not be started\r\n");
+		return pdFAIL;
+	}
+
+	xReceived = xAdcStreamReceive( xStream, &xBlock, pdMS_TO_TICKS( 1000 ) );
+	for( size_t i = 0; xReceived && i < xBlock.uxSamples; i++ )
+	{
+		ulBadCodes += ( xBlock.pusSamples[ i ] > ADC_STREAM_CODE_MASK );
+	}
+	vAdcStreamDelete( xStream );
+
+	printf("stream,dma,1,%u,%u,0,0,%s\r\n", xReceived ? 1 : 0, xReceived ? ( unsigned ) xBlock.uxSamples : 0,
+	       ( xReceived && ulBadCodes == 0 ) ? "pass" : "FAIL");
+	return xReceived && ulBadCodes == 0;
+}
+
+/**************************************************************************/
+
+static void vCheckTask( void *pvParameters )
+{
+	BaseType_t xPass = pdTRUE;
+
+	printf("case,mode,channels,scans,samples,stray,lost,result\r\n");
+
+	for( UBaseType_t i = 0; i < sizeof( xCases ) / sizeof( xCases[ 0 ] ); i++ )
+	{
+		xPass &= xCheckScan( &xCases[ i ] );
+	}
+	xPass &= xCheckPlainStream();
+
+	printf(xPass ? "# done\r\n" : "# failed\r\n");
+	vTaskDelete( NULL );
+}
+
+void app_main(void)
+{
+	xTaskCreate( vCheckTask, "Check", STACK_SIZE, NULL, CHECK_PRIORITY, NULL );
+}
@@ -5,21 +5,31 @@
 #include "freertos/queue.h"
 #include "driver/gpio.h"
 #include "sdkconfig.h"
+#include "async_log.h"
+#include "batch_queue.h"
 
 #define STACK_SIZE 2000
+#define QUEUE_LENGTH 5
 
 static void vSenderTask ( void *pvParameters );
 static void vReceiverTask( void *pvParameters );
 
-/*Declare a variable of type QueueHandle_t. This is used to store the handle
+/*Declare a variable of type BatchQueueHandle_t. This is used to store the handle
 to the queue that is accessed by all three tasks.*/
-QueueHandle_t xQueue;
+BatchQueueHandle_t xQueue;
 
 void app_main(void)
 {
 	/*The queue is created to hold a maximum of 5 values, each of which is
 	large enough to hold a variable of type int32_t*/
-	xQueue = xQueueCreate(5, sizeof( int32_t ));
+	xQueue = xBatchQueueCreate( QUEUE_LENGTH, sizeof( int32_t ), "values" );
+
+	/*The senders log on every iteration, so they use the deferred logger. They
+	never block, so a drain task at their priority 1 would only get one time
+	slice in three and the ring would overflow; at priority 2 it preempts them
+	every drain period. It sleeps in between, so the receiver, also at 2,
+	still gets the CPU whenever it has values to print.*/
+	xAsyncLogInit( 2 );
 
 	if( xQueue != NULL ) /*If null is returned when attempting to create the task,
 						   it means there is no space in the heap*/
@@ -36,6 +46,10 @@ void app_main(void)
 		priority 2, so above the priority of the sender tasks. */
 		xTaskCreate( vReceiverTask, "Receiver", STACK_SIZE, NULL, 2, NULL);
 
+		/* Print the queue counters every 5 s, above everything else so the
+		   free running senders can't starve it. */
+		xQueueMonitorStartTask( 3, 5000 );
+
 	}
 
 	else
@@ -80,17 +94,17 @@ static void vSenderTask ( void *pvParameters )
 		should the queue already be full. In this case a block time is not
 		specified because the queue should never contain more than one item, and
 		therefore never be full. */
-		printf( "Space available on the queue...: %d\r\n", uxQueueSpacesAvailable(xQueue) );
-		printf("Sending %d to the queue...\r\n", lValueToSend );
+		ASYNC_LOG( "Space available on the queue...: %d\r\n", uxBatchQueueSpacesAvailable(xQueue) );
+		ASYNC_LOG( "Sending %d to the queue...\r\n", lValueToSend );
 		
-		xStatus = xQueueSendToBack( xQueue, &lValueToSend, 0 );
+		xStatus = xBatchQueueSend( xQueue, &lValueToSend, 0 );
 
 		if( xStatus != pdPASS )
 		{
 			/*The send operation could not complete because the queue was full -
 			this must be an error as the queue should never contain more than
 			one item!*/
-			printf( "Could not send to the queue.\r\n");
+			ASYNC_LOG( "Could not send to the queue.\r\n" );
 		}
 	}
 }
@@ -98,41 +112,43 @@ static void vSenderTask ( void *pvParameters )
 
 static void vReceiverTask( void *pvParameters )
 {
-	/*Declare the variable that will hold the values received from the queue. */
-	int32_t lReceivedValue;
-	BaseType_t xStatus;
+	/*Declare the array that will hold the values received from the queue. */
+	int32_t lReceivedValues[ QUEUE_LENGTH ];
+	UBaseType_t uxReceived;
 	const TickType_t xTicksToWait = pdMS_TO_TICKS( 100 );
 
 	for(;;)
 	{
-		// printf( "Receiving from the queue...: %d\r\n", uxQueueSpacesAvailable(xQueue) );
+		// printf( "Receiving from the queue...: %d\r\n", uxBatchQueueSpacesAvailable(xQueue) );
 
 		/*This call should always find the queue empty because this task will
 		immediately remove any data that is written to que queue. */
-		// if( uxQueueMessagesWaiting( xQueue ) != 0)
+		// if( uxBatchQueueMessagesWaiting( xQueue ) != 0)
 		// {
 		// 	printf( "Queue should have been empty!\r\n");			
 		// }
 
-		/*Receive data from the queue.
+		/*Receive everything that is waiting on the queue in one wakeup.
 		The first parameter is the queue from which data is to be received. The
 		queue is created before the scheduler is started, and therefore before this
 		task runs for the first time.
 
 		The second parameter is the buffer into which the received data will be
-		placed. In this case the buffer is simply the address of a variable that
-		has the required size to hold the received data.
+		placed. It must be large enough for a full queue, QUEUE_LENGTH values.
 
 		The last parameter is the block time – the maximum amount of time that the
 		task will remain in the Blocked state to wait for data to be available
 		should the queue already be empty. */
-		xStatus = xQueueReceive( xQueue, &lReceivedValue, xTicksToWait );
+		uxReceived = uxBatchQueueReceiveAll( xQueue, lReceivedValues, xTicksToWait );
 
-		if( xStatus == pdPASS)
+		if( uxReceived != 0 )
 		{
 			/* Data was successfully received from the queue, print out the received
-			   value. */
-			printf( "Received = %d\r\n", lReceivedValue );
+			   values. */
+			for( UBaseType_t i = 0; i < uxReceived; i++ )
+			{
+				printf( "Received = %d\r\n", lReceivedValues[ i ] );
+			}
 		}
 
 		else
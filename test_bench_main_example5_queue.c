@@ -5,15 +5,23 @@
 #include "freertos/queue.h"
 #include "driver/gpio.h"
 #include "sdkconfig.h"
+#include "buffer_pool.h"
+#include "batch_queue.h"
 
 #define STACK_SIZE 2000
+#define QUEUE_LENGTH 3
+#define STATS_EVERY 100
 
 static void vSenderTask ( void *pvParameters );
 static void vReceiverTask( void *pvParameters );
 
-/*Declare a variable of type QueueHandle_t. This is used to store the handle
+/*Declare a variable of type BatchQueueHandle_t. This is used to store the handle
 to the queue that is accessed by all three tasks.*/
-QueueHandle_t xQueue;
+BatchQueueHandle_t xQueue;
+
+/* The messages themselves live in blocks of this pool; the queue only carries
+pointers to them. */
+BufferPoolHandle_t xPool;
 
 /* Define an enumerated type used to identify the source of the data. */
 typedef enum
@@ -38,10 +46,20 @@ static const Data_t xStructsToSend[ 2 ] =
 
 void app_main(void)
 {
-	/* The queue is created to hold a maximum of 3 structures of type Data_t. */
-	xQueue = xQueueCreate( 3, sizeof( Data_t ));
+	/* Every block is owned by exactly one task or sits in the queue. The receiver
+	   can hold a whole queue's worth while the queue fills up again and each
+	   sender blocks holding one more, so the pool needs two blocks per queue slot
+	   plus one per sender. */
+	const BufferPoolClass_t xClasses[] =
+	{
+		{ sizeof( Data_t ), 2 * QUEUE_LENGTH + 2 }
+	};
+
+	/* The queue is created to hold a maximum of 3 pointers to Data_t blocks. */
+	xQueue = xBatchQueueCreate( QUEUE_LENGTH, sizeof( Data_t * ), "messages" );
+	xPool = xBufferPoolCreate( xClasses, sizeof( xClasses ) / sizeof( xClasses[ 0 ] ) );
 
-	if( xQueue != NULL )
+	if( xQueue != NULL && xPool != NULL )
 	{
 		/* Create two instances of the task that will write to the queue. The
 		   parameter is used to pass the structure that the task will write to the
@@ -55,6 +73,10 @@ void app_main(void)
 		   priority 1, so below the priority of the sender tasks. */
 		xTaskCreate( vReceiverTask, "Receiver", STACK_SIZE, NULL, 1, NULL);
 
+		/* Print the queue counters every 5 s, above the senders so it still
+		   runs while they keep the receiver waiting. */
+		xQueueMonitorStartTask( 3, 5000 );
+
 	}
 	else
 	{
@@ -73,14 +95,22 @@ static void vSenderTask( void *pvParameters )
 {
 	BaseType_t xStatus;
 	const TickType_t xTicksToWait = pdMS_TO_TICKS( 100 );
+	Data_t *pxMessage;
 
 	for(;;)
 	{
-		
+		/* Take a block from the pool and build the message in place. */
+		pxMessage = pvBufferPoolAlloc( xPool, sizeof( Data_t ), xTicksToWait );
+		if( pxMessage == NULL )
+		{
+			printf( "Buffer pool exhausted.\r\n");
+			continue;
+		}
+		*pxMessage = *( const Data_t * ) pvParameters;
+
 		/* Send to the queue.
-		   The second parameter is the address of the structure being sent. The
-		address is passed in as the task parameter so pvParameters is used
-		directly.
+		   The second parameter is the block being sent. Only the pointer is
+		copied into the queue, and from here on the block belongs to the receiver.
 		The third parameter is the Block time - the time the task should be kept
 		in the Blocked state to wait for space to become available on the queue
 		if the queue is already full. A block time is specified because the
@@ -88,10 +118,13 @@ static void vSenderTask( void *pvParameters )
 		is expected to become full. The receiving task will remove items from
 		the queue when both sending tasks are in the Blocked state. */
 
-		xStatus = xQueueSendToBack( xQueue, pvParameters, xTicksToWait );
+		xStatus = xBatchQueueSend( xQueue, &pxMessage, xTicksToWait );
 
 		if( xStatus != pdPASS )
 		{
+			/* Nobody took the block, so it is still ours to give back. */
+			vBufferPoolFree( pxMessage );
+
 			/* The send operation could not complete, even after waiting for 100ms.
 				This must be an error as the receiving task should make space in the
 				queue as soon as both sending tasks are in the Blocked state. */
@@ -102,8 +135,11 @@ static void vSenderTask( void *pvParameters )
 
 static void vReceiverTask( void *pvParameters )
 {
-	Data_t xReceivedStructure;
-	BaseType_t xStatus;
+	Data_t *pxReceivedStructures[ QUEUE_LENGTH ];
+	Data_t *pxReceivedStructure;
+	UBaseType_t uxReceived;
+	BufferPoolStats_t xStats;
+	uint32_t ulReceived = 0;
 
 	for(;;)
 	{
@@ -113,39 +149,50 @@ static void vReceiverTask( void *pvParameters )
 			number of items in the queue to be equal to the queue length, which is 3 in
 		this case. */
 
-		if( uxQueueMessagesWaiting( xQueue ) != 3)
-		{
-			printf("Queue should have been full!\r\n");
-		}
-
-		/* Receive from the queue.
-		The second parameter is the buffer into which the received data will be
-		placed. In this case the buffer is simply the address of a variable that
-		has the required size to hold the received structure.
+		/* Receive everything in the queue in one go.
+		The second parameter is the array that is filled with pointers to the
+		received blocks, which must hold QUEUE_LENGTH of them. The blocks now
+		belong to this task, which gives each back to the pool once it has
+		finished with it.
 		The last parameter is the block time - the maximum amount of time that the
 		task will remain in the Blocked state to wait for data to be available
 		if the queue is already empty. In this case a block time is not necessary
 		because this task will only run when the queue is full. */
-		xStatus = xQueueReceive( xQueue, &xReceivedStructure, 0 );
+		uxReceived = uxBatchQueueReceiveAll( xQueue, pxReceivedStructures, 0 );
+
+		if( uxReceived != 0 && uxReceived != QUEUE_LENGTH )
+		{
+			printf("Queue should have been full!\r\n");
+		}
 
-		if( xStatus == pdPASS )
+		for( UBaseType_t i = 0; i < uxReceived; i++ )
 		{
-			
+			pxReceivedStructure = pxReceivedStructures[ i ];
+
 			/* Data was successfully received from the queue, print out the received
 			value and the source of the value. */
-			if( xReceivedStructure.eDataSource == eSender1 )
+			if( pxReceivedStructure->eDataSource == eSender1 )
 			{
-				printf("From Sender 1 = %d\n", xReceivedStructure.ucValue );
+				printf("From Sender 1 = %d\n", pxReceivedStructure->ucValue );
 			}
 
 			else
 			{
-				printf("From Sender 2 = %d\n", xReceivedStructure.ucValue );
+				printf("From Sender 2 = %d\n", pxReceivedStructure->ucValue );
 			}
 
+			vBufferPoolFree( pxReceivedStructure );
+
+			if( ++ulReceived % STATS_EVERY == 0 )
+			{
+				uxBufferPoolGetStats( xPool, &xStats, 1 );
+				printf("Pool: %u/%u blocks in use, high water %u, exhausted %u, failed %u\r\n",
+				       xStats.ulInUse, xStats.ulBlocks, xStats.ulHighWater,
+				       xStats.ulExhausted, xStats.ulFailed );
+			}
 		}
 
-		else
+		if( uxReceived == 0 )
 		{
 			/* Nothing was received from the queue. This must be an error as this
                task should only run when the queue is full. */
@@ -95,18 +95,26 @@ xTicksToWait - xTimerStart() uses the timer command queue to send the ‘start a
 #include "freertos/queue.h"
 #include "driver/gpio.h"
 #include "sdkconfig.h"
+#include "deferred_timer.h"
+#include "timer_lateness.h"
 
 /* The periods assigned to the one-shot and auto-reload timers are 3.333 second and half a
 second respectively. */
 #define mainONE_SHOT_TIMER_PERIOD pdMS_TO_TICKS( 3333 )
 #define mainAUTO_RELOAD_TIMER_PERIOD pdMS_TO_TICKS( 500 )
 
+/* The lateness histograms are printed every this many auto-reload callbacks. */
+#define mainLATENESS_DUMP_EVERY 20
+
 static void prvOneShotTimerCallback( TimerHandle_t xTimer );
 static void prvAutoReloadTimerCallback( TimerHandle_t xTimer );
 // static void performTest(uint8_t testCode);
 
 uint32_t ulCallCount = 0;
 
+/*How late, in microseconds, each callback started after its timer's scheduled expiry.*/
+static TimerLateness_t xOneShotLateness, xAutoReloadLateness;
+
 void app_main(void)
 {
 
@@ -120,8 +128,17 @@ void app_main(void)
 
 	TickType_t xTimeNow;
 
+	/*Both callbacks call printf, which can take milliseconds on the console. The timers are created
+	  deferred: the daemon only queues their callbacks to worker tasks, so a slow printf does not delay
+	  the expiry of any other timer. The workers run below the daemon, one per core.*/
+	xTimerWorkersStart( tskIDLE_PRIORITY, portNUM_PROCESSORS );
+
+	xTimerLatenessStart();
+	vTimerLatenessRegister( &xOneShotLateness, "OneShot" );
+	vTimerLatenessRegister( &xAutoReloadLateness, "AutoReload" );
+
 	/* Create the one shot timer, storing the handle to the created timer in xOneShotTimer. */
-	xOneShotTimer = xTimerCreate(
+	xOneShotTimer = xDeferredTimerCreate(
 				    /* Text name for the software timer - not used by FreeRTOS. */
 					"OneShot",
 					/*The software timer's period in ticks*/
@@ -135,7 +152,7 @@ void app_main(void)
 
 
 	/*Create the auto-reload timer, storing the handle to the created timer in xAutoReloadTimer*/
-	xAutoReloadTimer = xTimerCreate(
+	xAutoReloadTimer = xDeferredTimerCreate(
 				    /* Text name for the software timer - not used by FreeRTOS. */
 					"AutoReload",
 					/*The software timer's period in ticks*/
@@ -168,6 +185,9 @@ static void prvOneShotTimerCallback( TimerHandle_t xTimer )
 {
 	TickType_t xTimeNow;
 
+	/*Record the lateness before anything else, so the callback's own work is not counted.*/
+	vTimerLatenessRecord( &xOneShotLateness, xDeferredTimerGetScheduledExpiry( xTimer ) );
+
 	/*Obtain the current tick count*/
 	xTimeNow = xTaskGetTickCount();
 	/* Output a string to show the time at which the callback was executed. */
@@ -180,12 +200,20 @@ static void prvOneShotTimerCallback( TimerHandle_t xTimer )
 static void prvAutoReloadTimerCallback( TimerHandle_t xTimerStart )
 {
 	TickType_t xTimeNow;
+
+	vTimerLatenessRecord( &xAutoReloadLateness, xDeferredTimerGetScheduledExpiry( xTimerStart ) );
+
 	/* Obtain the current tick count. */
     xTimeNow = xTaskGetTickCount();
     printf("Auto-reload timer callback executing %d\n", xTimeNow );
 
     ulCallCount++;
 
+    if( xAutoReloadLateness.ulSamples % mainLATENESS_DUMP_EVERY == 0 )
+    {
+    	vTimerLatenessPrintAll();
+    }
+
 }
 
 
@@ -37,6 +37,8 @@ Returned value - the ID of the software timer being queried.
 #include "freertos/queue.h"
 #include "driver/gpio.h"
 #include "sdkconfig.h"
+#include "deferred_timer.h"
+#include "timer_lateness.h"
 
 /* The periods assigned to the one-shot and auto-reload timers are 3.333 second and half a
 second respectively. */
@@ -46,16 +48,28 @@ second respectively. */
 static void prvTimerCallback( TimerHandle_t xTimer );
 TimerHandle_t xAutoReloadTimer, xOneShotTimer; /*These variables will receive the software timer handle upon the creation of the timer.*/
 
+/*How late, in microseconds, each callback started after its timer's scheduled expiry.*/
+static TimerLateness_t xOneShotLateness, xAutoReloadLateness;
+
 void app_main(void)
 {
 
 	BaseType_t xTimer1Started, xTimer2Started; /*These variables receive pdTRUE or pdFALSE depending if the timer could be started or nor*/
 
+	/*The timers are created deferred, so prvTimerCallback() and its printf run in a worker task
+	  instead of the daemon. A deferred timer keeps its deferral record in the timer's ID, so the
+	  callback reads and writes its own ID with pvDeferredTimerGetTimerID() and vDeferredTimerSetTimerID().*/
+	xTimerWorkersStart( tskIDLE_PRIORITY, portNUM_PROCESSORS );
+
+	xTimerLatenessStart();
+	vTimerLatenessRegister( &xOneShotLateness, "OneShot" );
+	vTimerLatenessRegister( &xAutoReloadLateness, "AutoReload" );
+
 	/*Note now that the software timers will be associated with the same callback function prvTimerCallback.
 	  prvTimerCallback() will execute when either timer expires. The implementation of
       prvTimerCallback() uses the function’s parameter to determine if it was called because the
       one-shot timer expired, or because the auto-reload timer expired.*/
-	xOneShotTimer = xTimerCreate(
+	xOneShotTimer = xDeferredTimerCreate(
 				    /* Text name for the software timer - not used by FreeRTOS. */
 					"OneShot",
 					/*The software timer's period in ticks*/
@@ -69,7 +83,7 @@ void app_main(void)
 
 
 
-	xAutoReloadTimer = xTimerCreate(
+	xAutoReloadTimer = xDeferredTimerCreate(
 				    /* Text name for the software timer - not used by FreeRTOS. */
 					"AutoReload",
 					/*The software timer's period in ticks*/
@@ -98,12 +112,16 @@ static void prvTimerCallback( TimerHandle_t xTimer )
 {
 	TickType_t xTimeNow;
 	uint32_t ulExecutionCount;
+
+	/*Record the lateness before anything else, so the callback's own work is not counted.*/
+	vTimerLatenessRecord( ( xTimer == xOneShotTimer ) ? &xOneShotLateness : &xAutoReloadLateness,
+	                      xDeferredTimerGetScheduledExpiry( xTimer ) );
 	/*A count of the number of times this software timer has expired is stored in the timer's
 	ID. Obtain the ID, increment it, then save it as the new ID value. The ID is a void
 	pointer, so is cast to a uint32_t. */
-	ulExecutionCount = (uint32_t) pvTimerGetTimerID( xTimer );
+	ulExecutionCount = (uint32_t) pvDeferredTimerGetTimerID( xTimer );
 	ulExecutionCount++;
-	vTimerSetTimerID( xTimer, ( void *) ulExecutionCount );
+	vDeferredTimerSetTimerID( xTimer, ( void *) ulExecutionCount );
 
 	/* Obtain the current tick count. */
 	xTimeNow = xTaskGetTickCount();
@@ -119,10 +137,13 @@ static void prvTimerCallback( TimerHandle_t xTimer )
 	if( ulExecutionCount == 5)
 	{
 		/*Stop the auto-reload timer after it has executed 5 times. This callback function
-		executes in the context of the RTOS daemon task so must not call any functions that
-		might place the daemon task into the Blocked state. Therefore a block time of 0 is
-		used.*/
+		executes in a timer worker task, not the RTOS daemon task, so it could block; a block
+		time of 0 is still used so a full timer command queue never holds the worker up.*/
 		xTimerStop( xTimer, 0 );
 	}
 
+	/*The one-shot timer expires last, after the auto-reload timer has been stopped: print both
+	  histograms then.*/
+	if( xTimer == xOneShotTimer ) vTimerLatenessPrintAll();
+
 }
\ No newline at end of file
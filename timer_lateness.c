@@ -0,0 +1,129 @@
+/* Software timer lateness histograms - see timer_lateness.h */
+
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "esp_freertos_hooks.h"
+#include "timer_lateness.h"
+
+#define latenessTICK_US     ( 1000000 / configTICK_RATE_HZ )
+
+/* The last tick and when it began. The hook bumps ulTickSeq to odd before
+   writing and back to even after, so a reader on the other core retries
+   instead of pairing a tick with the wrong time. The fences keep the
+   stamp's stores after the first bump and a reader's loads before its
+   re-check; the bumps alone only order what comes before them. */
+static volatile uint32_t ulTickSeq;
+static TickType_t xAnchorTick;
+static int64_t llAnchorUs;
+
+static TimerLateness_t *pxLatenessList;
+static portMUX_TYPE xLatenessLock = portMUX_INITIALIZER_UNLOCKED;
+
+/**************************************************************************/
+
+static void prvTickHook( void )
+{
+	__atomic_add_fetch( &ulTickSeq, 1, __ATOMIC_RELAXED );
+	__atomic_thread_fence( __ATOMIC_RELEASE );
+	xAnchorTick = xTaskGetTickCountFromISR();
+	llAnchorUs = esp_timer_get_time();
+	__atomic_add_fetch( &ulTickSeq, 1, __ATOMIC_RELEASE );
+}
+
+BaseType_t xTimerLatenessStart( void )
+{
+	return ( esp_register_freertos_tick_hook_for_cpu( prvTickHook, 0 ) == ESP_OK ) ? pdPASS : pdFAIL;
+}
+
+void vTimerLatenessRegister( TimerLateness_t *pxLateness, const char *pcName )
+{
+	memset( pxLateness, 0, sizeof( TimerLateness_t ) );
+	pxLateness->pcName = pcName;
+
+	taskENTER_CRITICAL( &xLatenessLock );
+	pxLateness->pxNext = pxLatenessList;
+	__atomic_store_n( &pxLatenessList, pxLateness, __ATOMIC_RELEASE );
+	taskEXIT_CRITICAL( &xLatenessLock );
+}
+
+/**************************************************************************/
+
+void IRAM_ATTR vTimerLatenessRecordUs( TimerLateness_t *pxLateness, uint32_t ulLatenessUs )
+{
+	UBaseType_t uxBucket = ( ulLatenessUs == 0 ) ? 0 : 32 - __builtin_clz( ulLatenessUs );
+	uint32_t ulMax = __atomic_load_n( &pxLateness->ulMaxUs, __ATOMIC_RELAXED );
+
+	if( uxBucket >= TIMER_LATENESS_BUCKETS )
+	{
+		uxBucket = TIMER_LATENESS_BUCKETS - 1;
+	}
+
+	__atomic_add_fetch( &pxLateness->ulBuckets[ uxBucket ], 1, __ATOMIC_RELAXED );
+	__atomic_add_fetch( &pxLateness->ulSamples, 1, __ATOMIC_RELAXED );
+	while( ulLatenessUs > ulMax &&
+	       !__atomic_compare_exchange_n( &pxLateness->ulMaxUs, &ulMax, ulLatenessUs,
+	                                     pdTRUE, __ATOMIC_RELAXED, __ATOMIC_RELAXED ) )
+	{
+	}
+}
+
+void vTimerLatenessRecord( TimerLateness_t *pxLateness, TickType_t xScheduledTick )
+{
+	int64_t llNow = esp_timer_get_time();
+	int64_t llDue;
+	uint32_t ulSeq;
+
+	do
+	{
+		ulSeq = __atomic_load_n( &ulTickSeq, __ATOMIC_ACQUIRE );
+		llDue = llAnchorUs - ( int64_t ) ( int32_t ) ( xAnchorTick - xScheduledTick ) * latenessTICK_US;
+		__atomic_thread_fence( __ATOMIC_ACQUIRE );
+	} while( ( ulSeq & 1 ) != 0 || ulSeq != __atomic_load_n( &ulTickSeq, __ATOMIC_RELAXED ) );
+
+	/* Before the first tick stamp, or a callback run ahead of its tick's
+	   stamp, counts as on time. */
+	vTimerLatenessRecordUs( pxLateness, ( ulSeq != 0 && llNow > llDue ) ? ( uint32_t ) ( llNow - llDue ) : 0 );
+}
+
+/**************************************************************************/
+
+void vTimerLatenessPrintAll( void )
+{
+	const TimerLateness_t *pxLateness = __atomic_load_n( &pxLatenessList, __ATOMIC_ACQUIRE );
+	uint32_t ulCount;
+
+	printf("%-12s %8s %10s  %s\r\n", "timer", "samples", "max_us", "late_us:count");
+
+	for( ; pxLateness != NULL; pxLateness = pxLateness->pxNext )
+	{
+		printf("%-12s %8u %10u ", pxLateness->pcName,
+		       __atomic_load_n( &pxLateness->ulSamples, __ATOMIC_RELAXED ),
+		       __atomic_load_n( &pxLateness->ulMaxUs, __ATOMIC_RELAXED ));
+
+		for( UBaseType_t i = 0; i < TIMER_LATENESS_BUCKETS; i++ )
+		{
+			ulCount = __atomic_load_n( &pxLateness->ulBuckets[ i ], __ATOMIC_RELAXED );
+			if( ulCount == 0 )
+			{
+				continue;
+			}
+			if( i == 0 )
+			{
+				printf(" <1:%u", ulCount);
+			}
+			else if( i == TIMER_LATENESS_BUCKETS - 1 )
+			{
+				printf(" %lu+:%u", 1UL << ( i - 1 ), ulCount);
+			}
+			else
+			{
+				printf(" %lu-%lu:%u", 1UL << ( i - 1 ), ( 1UL << i ) - 1, ulCount);
+			}
+		}
+		printf("\r\n");
+	}
+}
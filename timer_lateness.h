@@ -0,0 +1,74 @@
+/* Software timer lateness histograms
+
+   A timer callback prints xTaskGetTickCount(), which only says which tick
+   it ran in. This records, per timer, how long after its scheduled expiry
+   the callback actually started, in microseconds:
+
+   static TimerLateness_t xAutoReloadLateness;
+
+   xTimerLatenessStart();
+   vTimerLatenessRegister( &xAutoReloadLateness, "AutoReload" );
+
+   static void prvAutoReloadTimerCallback( TimerHandle_t xTimer )
+   {
+       vTimerLatenessRecord( &xAutoReloadLateness, xTimerScheduledExpiry( xTimer, pdTRUE ) );
+       ...
+   }
+
+   vTimerLatenessPrintAll();    (whenever the numbers are wanted)
+
+   The scheduled expiry is a tick; the time that tick began is taken from a
+   tick hook that stamps every tick on core 0 with esp_timer_get_time(), so
+   lateness includes the part of the tick already gone when the callback
+   started. Each sample lands in a power-of-two bucket: bucket 0 counts
+   starts under 1 us late, bucket n starts 2^(n-1) to 2^n - 1 us late, and
+   the last bucket everything later. Recording is one esp_timer_get_time(),
+   a count-leading-zeros and a few relaxed atomic adds, so it can stay on in
+   the field.
+*/
+#ifndef TIMER_LATENESS_H
+#define TIMER_LATENESS_H
+
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/timers.h"
+
+#define TIMER_LATENESS_BUCKETS      24
+
+typedef struct TimerLateness
+{
+	const char            *pcName;
+	uint32_t               ulSamples;
+	uint32_t               ulMaxUs;
+	uint32_t               ulBuckets[ TIMER_LATENESS_BUCKETS ];
+	struct TimerLateness  *pxNext;
+} TimerLateness_t;
+
+/* Installs the tick hook. Call once, before the first sample. */
+BaseType_t xTimerLatenessStart( void );
+
+/* Clears the histogram and links it into the list vTimerLatenessPrintAll()
+   prints. pcName must stay valid for as long as the histogram is linked. */
+void vTimerLatenessRegister( TimerLateness_t *pxLateness, const char *pcName );
+
+/* Call first thing in the callback. */
+void vTimerLatenessRecord( TimerLateness_t *pxLateness, TickType_t xScheduledTick );
+
+/* For callers that measured the lateness themselves. In IRAM, so it can
+   be called from an ESP_INTR_FLAG_IRAM interrupt such as the hrtimer.h
+   callbacks. */
+void vTimerLatenessRecordUs( TimerLateness_t *pxLateness, uint32_t ulLatenessUs );
+
+/* Prints samples, maximum and the non-empty buckets of every histogram. */
+void vTimerLatenessPrintAll( void );
+
+/* The expiry a daemon callback is running for. The daemon re-arms an
+   auto-reload timer one period on before calling its callback, so the
+   expiry time it reports is one period late; a one-shot timer keeps its. */
+static inline TickType_t xTimerScheduledExpiry( TimerHandle_t xTimer, UBaseType_t uxAutoReload )
+{
+	return xTimerGetExpiryTime( xTimer ) - ( uxAutoReload ? xTimerGetPeriod( xTimer ) : 0 );
+}
+
+#endif /* TIMER_LATENESS_H */
@@ -0,0 +1,401 @@
+/* Hierarchical timing wheel timer service - see timer_wheel.h
+
+   A timer due xDelta ticks after the wheel's current time goes into wheel
+   L, the first one whose range (64^(L+1) ticks) is larger than xDelta, in
+   the slot given by bits 6L..6L+5 of its expiry time. When the time reaches
+   the start of that slot's span the slot is cascaded: each timer in it is
+   linked again, and now lands in a lower wheel. Timers further away than
+   the top wheel reaches are parked at its far end and cascade again.
+
+   Slot lists are singly linked with a back pointer to whatever points at the
+   node (the slot head or the previous node's pxNext), so a timer can be
+   unlinked without knowing which slot it is in. ppxPrev is NULL while the
+   timer is dormant.
+
+   All wheel state is guarded by xWheelLock. The service task drops the lock
+   around each callback, so callbacks can start, stop and delete timers,
+   their own included. Meanwhile the timer is pxRunningTimer: deleting it,
+   from the callback or from another core, only marks it, and the service
+   task frees it once the callback has returned.
+*/
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "timer_wheel.h"
+
+#define wheelBITS           6
+#define wheelSLOTS          ( 1 << wheelBITS )
+#define wheelMASK           ( wheelSLOTS - 1 )
+#define wheelLEVELS         4
+#define wheelRANGE          ( ( TickType_t ) 1 << ( wheelBITS * wheelLEVELS ) )
+
+struct WheelTimer
+{
+	struct WheelTimer            *pxNext;
+	struct WheelTimer           **ppxPrev;
+	TickType_t                    xExpiry;
+	TickType_t                    xPeriod;
+	WheelTimerCallbackFunction_t  pxCallback;
+	void                         *pvTimerID;
+	const char                   *pcName;
+	UBaseType_t                   uxAutoReload;
+	BaseType_t                    xDeletePending;
+};
+
+static struct WheelTimer *pxSlots[ wheelLEVELS ][ wheelSLOTS ];
+static TickType_t xWheelTime;
+static portMUX_TYPE xWheelLock = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t xServiceTask;
+static struct WheelTimer *pxRunningTimer;
+static BaseType_t xServiceIdle;
+static WheelTimerStats_t xStats;
+
+/**************************************************************************/
+
+static void prvUnlink( struct WheelTimer *pxTimer )
+{
+	*pxTimer->ppxPrev = pxTimer->pxNext;
+	if( pxTimer->pxNext != NULL )
+	{
+		pxTimer->pxNext->ppxPrev = pxTimer->ppxPrev;
+	}
+	pxTimer->ppxPrev = NULL;
+}
+
+static void prvLink( struct WheelTimer *pxTimer )
+{
+	TickType_t xDelta = pxTimer->xExpiry - xWheelTime;
+	TickType_t xWhen = pxTimer->xExpiry;
+	struct WheelTimer **ppxSlot;
+	UBaseType_t uxLevel = 0;
+
+	if( xDelta >= wheelRANGE )
+	{
+		xDelta = wheelRANGE - 1;
+		xWhen = xWheelTime + xDelta;
+	}
+	while( xDelta >> ( wheelBITS * ( uxLevel + 1 ) ) )
+	{
+		uxLevel++;
+	}
+
+	ppxSlot = &pxSlots[ uxLevel ][ ( xWhen >> ( wheelBITS * uxLevel ) ) & wheelMASK ];
+	pxTimer->pxNext = *ppxSlot;
+	pxTimer->ppxPrev = ppxSlot;
+	if( *ppxSlot != NULL )
+	{
+		( *ppxSlot )->ppxPrev = &pxTimer->pxNext;
+	}
+	*ppxSlot = pxTimer;
+}
+
+/* Arms the timer to expire one period after xNow. Returns pdTRUE if the
+   service task has to be woken. Called with the lock held. */
+static BaseType_t prvArm( struct WheelTimer *pxTimer, TickType_t xNow )
+{
+	BaseType_t xWake = pdFALSE;
+
+	if( pxTimer->xDeletePending != pdFALSE )
+	{
+		/* Its callback restarting a timer that is being deleted. */
+		return pdFALSE;
+	}
+
+	if( pxTimer->ppxPrev != NULL )
+	{
+		prvUnlink( pxTimer );
+	}
+	else
+	{
+		if( xStats.ulActive == 0 )
+		{
+			/* The wheel is empty, so its time can jump straight to now
+			   instead of being caught up tick by tick. */
+			xWheelTime = xNow;
+			xWake = xServiceIdle;
+			xServiceIdle = pdFALSE;
+		}
+		xStats.ulActive++;
+	}
+
+	pxTimer->xExpiry = xNow + pxTimer->xPeriod;
+	prvLink( pxTimer );
+	return xWake;
+}
+
+static void prvDisarm( struct WheelTimer *pxTimer )
+{
+	if( pxTimer->ppxPrev != NULL )
+	{
+		prvUnlink( pxTimer );
+		xStats.ulActive--;
+	}
+}
+
+/**************************************************************************/
+
+/* Moves every timer of one slot down a wheel. */
+static void prvCascade( UBaseType_t uxLevel, UBaseType_t uxSlot )
+{
+	struct WheelTimer *pxTimer;
+
+	while( ( pxTimer = pxSlots[ uxLevel ][ uxSlot ] ) != NULL )
+	{
+		prvUnlink( pxTimer );
+		prvLink( pxTimer );
+		xStats.ulCascaded++;
+	}
+}
+
+/* Advances the wheel by one tick and runs what expires. Called, and returns,
+   with the lock held. */
+static void prvAdvance( void )
+{
+	struct WheelTimer *pxTimer;
+	WheelTimerCallbackFunction_t pxCallback;
+	UBaseType_t uxSlot;
+
+	xWheelTime++;
+	xStats.ulTicks++;
+	uxSlot = xWheelTime & wheelMASK;
+
+	if( uxSlot == 0 )
+	{
+		for( UBaseType_t uxLevel = 1; uxLevel < wheelLEVELS; uxLevel++ )
+		{
+			UBaseType_t uxUpper = ( xWheelTime >> ( wheelBITS * uxLevel ) ) & wheelMASK;
+
+			prvCascade( uxLevel, uxUpper );
+			if( uxUpper != 0 )
+			{
+				break;
+			}
+		}
+	}
+
+	while( ( pxTimer = pxSlots[ 0 ][ uxSlot ] ) != NULL )
+	{
+		prvUnlink( pxTimer );
+
+		if( pxTimer->uxAutoReload != pdFALSE )
+		{
+			/* Measured from the expiry, not from now, so the period doesn't
+			   drift. */
+			pxTimer->xExpiry += pxTimer->xPeriod;
+			prvLink( pxTimer );
+		}
+		else
+		{
+			xStats.ulActive--;
+		}
+
+		pxCallback = pxTimer->pxCallback;
+		xStats.ulExpired++;
+		pxRunningTimer = pxTimer;
+
+		taskEXIT_CRITICAL( &xWheelLock );
+		pxCallback( pxTimer );
+		taskENTER_CRITICAL( &xWheelLock );
+
+		pxRunningTimer = NULL;
+		if( pxTimer->xDeletePending != pdFALSE )
+		{
+			taskEXIT_CRITICAL( &xWheelLock );
+			vPortFree( pxTimer );
+			taskENTER_CRITICAL( &xWheelLock );
+		}
+	}
+}
+
+static void prvServiceTask( void *pvParameters )
+{
+	int64_t llStart;
+
+	for(;;)
+	{
+		taskENTER_CRITICAL( &xWheelLock );
+		xServiceIdle = ( xStats.ulActive == 0 );
+		taskEXIT_CRITICAL( &xWheelLock );
+
+		if( xServiceIdle )
+		{
+			/* Nothing to time: sleep until a timer is started. */
+			ulTaskNotifyTake( pdTRUE, portMAX_DELAY );
+			continue;
+		}
+
+		vTaskDelay( 1 );
+
+		llStart = esp_timer_get_time();
+		taskENTER_CRITICAL( &xWheelLock );
+		while( ( int32_t ) ( xTaskGetTickCount() - xWheelTime ) > 0 )
+		{
+			prvAdvance();
+		}
+		xStats.ullBusyUs += esp_timer_get_time() - llStart;
+		taskEXIT_CRITICAL( &xWheelLock );
+	}
+}
+
+BaseType_t xWheelTimerServiceStart( UBaseType_t uxPriority )
+{
+	return xTaskCreatePinnedToCore( prvServiceTask, "WheelTimers", WHEEL_TIMER_STACK_SIZE, NULL,
+	                                uxPriority, &xServiceTask, WHEEL_TIMER_CORE );
+}
+
+/**************************************************************************/
+
+WheelTimerHandle_t xWheelTimerCreate( const char * const pcTimerName, TickType_t xTimerPeriodInTicks,
+                                      UBaseType_t uxAutoReload, void * const pvTimerID,
+                                      WheelTimerCallbackFunction_t pxCallbackFunction )
+{
+	struct WheelTimer *pxTimer;
+
+	if( xTimerPeriodInTicks == 0 )
+	{
+		return NULL;
+	}
+
+	pxTimer = pvPortMalloc( sizeof( struct WheelTimer ) );
+	if( pxTimer != NULL )
+	{
+		memset( pxTimer, 0, sizeof( struct WheelTimer ) );
+		pxTimer->pcName = pcTimerName;
+		pxTimer->xPeriod = xTimerPeriodInTicks;
+		pxTimer->uxAutoReload = uxAutoReload;
+		pxTimer->pvTimerID = pvTimerID;
+		pxTimer->pxCallback = pxCallbackFunction;
+	}
+	return pxTimer;
+}
+
+BaseType_t xWheelTimerDelete( WheelTimerHandle_t xTimer, TickType_t xTicksToWait )
+{
+	BaseType_t xRunning;
+
+	taskENTER_CRITICAL( &xWheelLock );
+	prvDisarm( xTimer );
+	xRunning = ( xTimer == pxRunningTimer );
+	xTimer->xDeletePending = xRunning;
+	taskEXIT_CRITICAL( &xWheelLock );
+
+	/* Otherwise the service task frees it when the callback returns. */
+	if( xRunning == pdFALSE )
+	{
+		vPortFree( xTimer );
+	}
+	return pdPASS;
+}
+
+/**************************************************************************/
+
+BaseType_t xWheelTimerStart( WheelTimerHandle_t xTimer, TickType_t xTicksToWait )
+{
+	BaseType_t xWake;
+
+	taskENTER_CRITICAL( &xWheelLock );
+	xWake = prvArm( xTimer, xTaskGetTickCount() );
+	taskEXIT_CRITICAL( &xWheelLock );
+
+	if( xWake )
+	{
+		xTaskNotifyGive( xServiceTask );
+	}
+	return pdPASS;
+}
+
+BaseType_t xWheelTimerReset( WheelTimerHandle_t xTimer, TickType_t xTicksToWait )
+{
+	return xWheelTimerStart( xTimer, xTicksToWait );
+}
+
+BaseType_t xWheelTimerStop( WheelTimerHandle_t xTimer, TickType_t xTicksToWait )
+{
+	taskENTER_CRITICAL( &xWheelLock );
+	prvDisarm( xTimer );
+	taskEXIT_CRITICAL( &xWheelLock );
+	return pdPASS;
+}
+
+BaseType_t xWheelTimerChangePeriod( WheelTimerHandle_t xTimer, TickType_t xNewPeriod, TickType_t xTicksToWait )
+{
+	if( xNewPeriod == 0 )
+	{
+		return pdFAIL;
+	}
+
+	taskENTER_CRITICAL( &xWheelLock );
+	xTimer->xPeriod = xNewPeriod;
+	taskEXIT_CRITICAL( &xWheelLock );
+
+	return xWheelTimerStart( xTimer, xTicksToWait );
+}
+
+BaseType_t xWheelTimerStartFromISR( WheelTimerHandle_t xTimer, BaseType_t *pxHigherPriorityTaskWoken )
+{
+	BaseType_t xWake;
+
+	taskENTER_CRITICAL_ISR( &xWheelLock );
+	xWake = prvArm( xTimer, xTaskGetTickCountFromISR() );
+	taskEXIT_CRITICAL_ISR( &xWheelLock );
+
+	if( xWake )
+	{
+		vTaskNotifyGiveFromISR( xServiceTask, pxHigherPriorityTaskWoken );
+	}
+	return pdPASS;
+}
+
+BaseType_t xWheelTimerResetFromISR( WheelTimerHandle_t xTimer, BaseType_t *pxHigherPriorityTaskWoken )
+{
+	return xWheelTimerStartFromISR( xTimer, pxHigherPriorityTaskWoken );
+}
+
+BaseType_t xWheelTimerStopFromISR( WheelTimerHandle_t xTimer, BaseType_t *pxHigherPriorityTaskWoken )
+{
+	taskENTER_CRITICAL_ISR( &xWheelLock );
+	prvDisarm( xTimer );
+	taskEXIT_CRITICAL_ISR( &xWheelLock );
+	return pdPASS;
+}
+
+/**************************************************************************/
+
+BaseType_t xWheelTimerIsTimerActive( WheelTimerHandle_t xTimer )
+{
+	return ( __atomic_load_n( &xTimer->ppxPrev, __ATOMIC_RELAXED ) != NULL ) ? pdTRUE : pdFALSE;
+}
+
+void *pvWheelTimerGetTimerID( const WheelTimerHandle_t xTimer )
+{
+	return xTimer->pvTimerID;
+}
+
+void vWheelTimerSetTimerID( WheelTimerHandle_t xTimer, void *pvNewID )
+{
+	xTimer->pvTimerID = pvNewID;
+}
+
+const char *pcWheelTimerGetName( WheelTimerHandle_t xTimer )
+{
+	return xTimer->pcName;
+}
+
+TickType_t xWheelTimerGetPeriod( WheelTimerHandle_t xTimer )
+{
+	return xTimer->xPeriod;
+}
+
+TickType_t xWheelTimerGetExpiryTime( WheelTimerHandle_t xTimer )
+{
+	return xTimer->xExpiry;
+}
+
+void vWheelTimerGetStats( WheelTimerStats_t *pxStats )
+{
+	taskENTER_CRITICAL( &xWheelLock );
+	*pxStats = xStats;
+	taskEXIT_CRITICAL( &xWheelLock );
+}
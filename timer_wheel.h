@@ -0,0 +1,99 @@
+/* Hierarchical timing wheel timer service
+
+   The FreeRTOS timer daemon keeps active timers in a list sorted by expiry
+   time, so every start, reset and auto-reload walks the list: O(n) in the
+   number of active timers, paid in the daemon task. With hundreds of
+   per-device timeouts that are reset on every message, that walk dominates.
+
+   Here timers hang in the slots of four wheels of 64 slots each. The first
+   wheel has one slot per tick, the second one slot per 64 ticks, and so on,
+   so any expiry up to 2^24 ticks ahead maps straight to one slot. Start, stop
+   and reset unlink and link one list node: O(1). Every tick the service task
+   runs the timers in the current slot of the first wheel; every 64 ticks it
+   moves the timers of the next slot of the second wheel down into the first
+   (and likewise further up), which spreads the cost of far-away expiries
+   over their lifetime.
+
+   The calls mirror the xTimer API, so converting a timer is a matter of
+   renaming:
+
+   xTimer = xWheelTimerCreate( "OneShot", pdMS_TO_TICKS( 3333 ), pdFALSE, 0, prvTimerCallback );
+   xWheelTimerStart( xTimer, 0 );
+
+   static void prvTimerCallback( WheelTimerHandle_t xTimer ) { ... }
+
+   Differences from the daemon:
+
+   - Commands are applied directly under a spinlock instead of being queued
+     for the daemon, so they never block and xTicksToWait is ignored; it is
+     kept only so calls can be renamed one for one.
+   - Callbacks run in the wheel service task, started with
+     xWheelTimerServiceStart(). Like daemon callbacks they must not block.
+   - The service task only wakes every tick while at least one timer is
+     active.
+*/
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+/* Core the service task is pinned to, like CONFIG_FREERTOS_TIMER_TASK_AFFINITY. */
+#ifndef WHEEL_TIMER_CORE
+#define WHEEL_TIMER_CORE            0
+#endif
+
+#define WHEEL_TIMER_STACK_SIZE      3072
+
+typedef struct WheelTimer * WheelTimerHandle_t;
+
+typedef void ( *WheelTimerCallbackFunction_t )( WheelTimerHandle_t xTimer );
+
+typedef struct
+{
+	uint32_t ulTicks;       /* ticks the wheel has advanced */
+	uint32_t ulExpired;     /* callbacks run */
+	uint32_t ulCascaded;    /* timers moved down a wheel */
+	uint32_t ulActive;      /* timers currently running */
+	uint64_t ullBusyUs;     /* time the service task spent advancing the wheel,
+	                           callbacks included */
+} WheelTimerStats_t;
+
+/* Creates the task that advances the wheel and runs the callbacks. */
+BaseType_t xWheelTimerServiceStart( UBaseType_t uxPriority );
+
+/* Returns NULL if there is not enough heap. The timer is created dormant. */
+WheelTimerHandle_t xWheelTimerCreate( const char * const pcTimerName, TickType_t xTimerPeriodInTicks,
+                                      UBaseType_t uxAutoReload, void * const pvTimerID,
+                                      WheelTimerCallbackFunction_t pxCallbackFunction );
+
+/* Stops the timer and frees it. If its callback is running, the service
+   task frees it when the callback returns; the handle is invalid either
+   way. */
+BaseType_t xWheelTimerDelete( WheelTimerHandle_t xTimer, TickType_t xTicksToWait );
+
+/* Start and reset are the same operation: (re)arm the timer to expire one
+   period from now. All return pdPASS. */
+BaseType_t xWheelTimerStart( WheelTimerHandle_t xTimer, TickType_t xTicksToWait );
+BaseType_t xWheelTimerReset( WheelTimerHandle_t xTimer, TickType_t xTicksToWait );
+BaseType_t xWheelTimerStop( WheelTimerHandle_t xTimer, TickType_t xTicksToWait );
+
+/* Sets a new period and (re)arms the timer with it. Returns pdFAIL for a
+   period of 0. */
+BaseType_t xWheelTimerChangePeriod( WheelTimerHandle_t xTimer, TickType_t xNewPeriod, TickType_t xTicksToWait );
+
+BaseType_t xWheelTimerStartFromISR( WheelTimerHandle_t xTimer, BaseType_t *pxHigherPriorityTaskWoken );
+BaseType_t xWheelTimerResetFromISR( WheelTimerHandle_t xTimer, BaseType_t *pxHigherPriorityTaskWoken );
+BaseType_t xWheelTimerStopFromISR( WheelTimerHandle_t xTimer, BaseType_t *pxHigherPriorityTaskWoken );
+
+BaseType_t xWheelTimerIsTimerActive( WheelTimerHandle_t xTimer );
+void *pvWheelTimerGetTimerID( const WheelTimerHandle_t xTimer );
+void vWheelTimerSetTimerID( WheelTimerHandle_t xTimer, void *pvNewID );
+const char *pcWheelTimerGetName( WheelTimerHandle_t xTimer );
+TickType_t xWheelTimerGetPeriod( WheelTimerHandle_t xTimer );
+TickType_t xWheelTimerGetExpiryTime( WheelTimerHandle_t xTimer );
+
+void vWheelTimerGetStats( WheelTimerStats_t *pxStats );
+
+#endif /* TIMER_WHEEL_H */
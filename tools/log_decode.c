@@ -0,0 +1,461 @@
+/* Host-side decoder for the deferred logger's binary mode
+
+   Turns the frames written by async_log.c when built with ASYNC_LOG_BINARY=1
+   back into the text the firmware would have printed. Format strings are not
+   on the wire, so the decoder reads them from the firmware ELF file that
+   produced the stream (build/<project>.elf for an ESP-IDF build, or the host
+   simulation binary). The wire format is described in async_log_format.h.
+
+   Build:   gcc -O2 -I. -o log_decode tools/log_decode.c
+   Usage:   log_decode firmware.elf [capture.bin]      (stdin by default)
+
+   e.g. idf.py monitor is text-only, so capture the raw port instead:
+
+            stty -F /dev/ttyUSB0 115200 raw && cat /dev/ttyUSB0 | log_decode build/app.elf
+
+   The stream must be captured from boot: site ids are bound on first use and
+   the decoder has to see those bindings.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "async_log_format.h"
+
+#define MAX_SITE_IDS        4096
+#define MAX_FRAME           4096
+#define MAX_LINE            1024
+
+#define SHT_SYMTAB          2
+#define SHT_NOBITS          8
+#define SHF_ALLOC           0x2
+
+typedef struct
+{
+	uint64_t ullAddr;
+	uint64_t ullOffset;
+	uint64_t ullSize;
+	uint32_t ulType;
+	uint32_t ulLink;
+	uint64_t ullFlags;
+	uint64_t ullEntSize;
+} Section_t;
+
+static uint8_t   *pucElf;
+static size_t     xElfSize;
+static Section_t *pxSections;
+static uint32_t   ulSectionCount;
+static int        lElf64;
+static uint64_t   ullAnchorLink;        /* link-time address of vAsyncLogWrite */
+static int64_t    llBias;               /* run-time minus link-time address */
+static uint64_t   ullSites[ MAX_SITE_IDS ];
+
+/**************************************************************************/
+
+static uint64_t prvRead( const uint8_t *pucAt, int lBytes )
+{
+	uint64_t ullValue = 0;
+
+	for( int i = lBytes - 1; i >= 0; i-- )
+	{
+		ullValue = ( ullValue << 8 ) | pucAt[ i ];
+	}
+	return ullValue;
+}
+
+static int prvLoadElf( const char *pcPath )
+{
+	FILE *pxFile = fopen( pcPath, "rb" );
+	uint64_t ullShOff;
+	uint32_t ulShEntSize;
+
+	if( pxFile == NULL )
+	{
+		perror( pcPath );
+		return -1;
+	}
+
+	fseek( pxFile, 0, SEEK_END );
+	xElfSize = ( size_t ) ftell( pxFile );
+	fseek( pxFile, 0, SEEK_SET );
+	pucElf = malloc( xElfSize );
+	if( pucElf == NULL || fread( pucElf, 1, xElfSize, pxFile ) != xElfSize )
+	{
+		fprintf( stderr, "%s: read failed\n", pcPath );
+		fclose( pxFile );
+		return -1;
+	}
+	fclose( pxFile );
+
+	if( xElfSize < 64 || memcmp( pucElf, "\x7f" "ELF", 4 ) != 0 || pucElf[ 5 ] != 1 )
+	{
+		fprintf( stderr, "%s: not a little-endian ELF file\n", pcPath );
+		return -1;
+	}
+
+	lElf64 = ( pucElf[ 4 ] == 2 );
+	ullShOff = lElf64 ? prvRead( &pucElf[ 0x28 ], 8 ) : prvRead( &pucElf[ 0x20 ], 4 );
+	ulShEntSize = ( uint32_t ) prvRead( &pucElf[ lElf64 ? 0x3A : 0x2E ], 2 );
+	ulSectionCount = ( uint32_t ) prvRead( &pucElf[ lElf64 ? 0x3C : 0x30 ], 2 );
+
+	if( ullShOff + ( uint64_t ) ulShEntSize * ulSectionCount > xElfSize )
+	{
+		fprintf( stderr, "%s: truncated section table\n", pcPath );
+		return -1;
+	}
+
+	pxSections = calloc( ulSectionCount, sizeof( Section_t ) );
+	for( uint32_t i = 0; i < ulSectionCount; i++ )
+	{
+		const uint8_t *pucSh = &pucElf[ ullShOff + ( uint64_t ) i * ulShEntSize ];
+		Section_t *pxSec = &pxSections[ i ];
+
+		pxSec->ulType = ( uint32_t ) prvRead( &pucSh[ 4 ], 4 );
+		if( lElf64 )
+		{
+			pxSec->ullFlags = prvRead( &pucSh[ 8 ], 8 );
+			pxSec->ullAddr = prvRead( &pucSh[ 16 ], 8 );
+			pxSec->ullOffset = prvRead( &pucSh[ 24 ], 8 );
+			pxSec->ullSize = prvRead( &pucSh[ 32 ], 8 );
+			pxSec->ulLink = ( uint32_t ) prvRead( &pucSh[ 40 ], 4 );
+			pxSec->ullEntSize = prvRead( &pucSh[ 56 ], 8 );
+		}
+		else
+		{
+			pxSec->ullFlags = prvRead( &pucSh[ 8 ], 4 );
+			pxSec->ullAddr = prvRead( &pucSh[ 12 ], 4 );
+			pxSec->ullOffset = prvRead( &pucSh[ 16 ], 4 );
+			pxSec->ullSize = prvRead( &pucSh[ 20 ], 4 );
+			pxSec->ulLink = ( uint32_t ) prvRead( &pucSh[ 24 ], 4 );
+			pxSec->ullEntSize = prvRead( &pucSh[ 36 ], 4 );
+		}
+	}
+
+	return 0;
+}
+
+/* Finds the link-time address of a symbol, 0 if the ELF has no symbol table
+   or doesn't define it. */
+static uint64_t prvFindSymbol( const char *pcName )
+{
+	for( uint32_t i = 0; i < ulSectionCount; i++ )
+	{
+		const Section_t *pxSym = &pxSections[ i ];
+		const Section_t *pxStr;
+
+		if( pxSym->ulType != SHT_SYMTAB || pxSym->ullEntSize == 0 || pxSym->ulLink >= ulSectionCount )
+		{
+			continue;
+		}
+		pxStr = &pxSections[ pxSym->ulLink ];
+
+		for( uint64_t ullOff = 0; ullOff + pxSym->ullEntSize <= pxSym->ullSize; ullOff += pxSym->ullEntSize )
+		{
+			const uint8_t *pucEnt = &pucElf[ pxSym->ullOffset + ullOff ];
+			uint32_t ulName = ( uint32_t ) prvRead( pucEnt, 4 );
+			uint64_t ullValue = lElf64 ? prvRead( &pucEnt[ 8 ], 8 ) : prvRead( &pucEnt[ 4 ], 4 );
+
+			if( ulName < pxStr->ullSize && strcmp( ( const char * ) &pucElf[ pxStr->ullOffset + ulName ], pcName ) == 0 )
+			{
+				return ullValue;
+			}
+		}
+	}
+
+	return 0;
+}
+
+/* Returns the NUL-terminated string at run-time address ullAddr. */
+static const char *prvStringAt( uint64_t ullAddr )
+{
+	uint64_t ullLink = ullAddr - ( uint64_t ) llBias;
+
+	for( uint32_t i = 0; i < ulSectionCount; i++ )
+	{
+		const Section_t *pxSec = &pxSections[ i ];
+
+		if( ( pxSec->ullFlags & SHF_ALLOC ) == 0 || pxSec->ulType == SHT_NOBITS )
+		{
+			continue;
+		}
+
+		if( ullLink >= pxSec->ullAddr && ullLink < pxSec->ullAddr + pxSec->ullSize )
+		{
+			const char *pcStr = ( const char * ) &pucElf[ pxSec->ullOffset + ( ullLink - pxSec->ullAddr ) ];
+			size_t xMax = ( size_t ) ( pxSec->ullAddr + pxSec->ullSize - ullLink );
+
+			if( memchr( pcStr, '\0', xMax ) != NULL )
+			{
+				return pcStr;
+			}
+		}
+	}
+
+	return NULL;
+}
+
+/**************************************************************************/
+
+static int prvGetVarint( const uint8_t **ppucAt, const uint8_t *pucEnd, uint64_t *pullValue )
+{
+	uint64_t ullValue = 0;
+	int lShift = 0;
+
+	while( *ppucAt < pucEnd && lShift < 64 )
+	{
+		uint8_t ucByte = *( *ppucAt )++;
+
+		ullValue |= ( uint64_t ) ( ucByte & 0x7F ) << lShift;
+		if( ( ucByte & 0x80 ) == 0 )
+		{
+			*pullValue = ullValue;
+			return 0;
+		}
+		lShift += 7;
+	}
+
+	return -1;
+}
+
+static void prvPrintRecord( uint64_t ullFormatAddr, const uint8_t *pucAt, const uint8_t *pucEnd )
+{
+	static char cLine[ MAX_LINE ];
+	char cString[ ASYNC_LOG_MAX_STRING + 1 ];
+	const char *pcFmt = prvStringAt( ullFormatAddr );
+	AsyncLogArg_t xArg;
+	LogSpec_t xSpec;
+	size_t xLen = 0;
+	uint64_t ullValue = 0;
+	float fValue;
+
+	if( pcFmt == NULL )
+	{
+		printf( "<unknown log site 0x%llx>\n", ( unsigned long long ) ullFormatAddr );
+		return;
+	}
+
+	for(;;)
+	{
+		int lOk = 0;
+
+		pcFmt = pcAsyncLogScan( pcFmt, cLine, sizeof( cLine ), &xLen, &xSpec );
+		if( xSpec.eConv == eLogConvNone )
+		{
+			break;
+		}
+
+		switch( xSpec.eConv )
+		{
+			case eLogConvSigned:
+				lOk = prvGetVarint( &pucAt, pucEnd, &ullValue ) == 0;
+				xArg.llValue = llAsyncLogUnzigzag( ullValue );
+				break;
+
+			case eLogConvUnsigned:
+			case eLogConvChar:
+				lOk = prvGetVarint( &pucAt, pucEnd, &ullValue ) == 0;
+				xArg.llValue = ( int64_t ) ullValue;
+				break;
+
+			case eLogConvFixed:
+			case eLogConvFloat:
+				if( pucAt < pucEnd && *pucAt == ASYNC_LOG_FLOAT_RAW )
+				{
+					lOk = ( pucEnd - pucAt ) >= 1 + ( long ) sizeof( fValue );
+					if( lOk )
+					{
+						memcpy( &fValue, pucAt + 1, sizeof( fValue ) );
+						pucAt += 1 + sizeof( fValue );
+						xArg.dValue = fValue;
+					}
+				}
+				else if( xSpec.eConv == eLogConvFixed )
+				{
+					lOk = prvGetVarint( &pucAt, pucEnd, &ullValue ) == 0;
+					xArg.dValue = ( double ) llAsyncLogUnzigzag( ullValue >> 1 ) /
+					              ( double ) llAsyncLogPow10( xSpec.lPrecision < 0 ? 6 : xSpec.lPrecision );
+				}
+				break;
+
+			case eLogConvString:
+				lOk = prvGetVarint( &pucAt, pucEnd, &ullValue ) == 0 &&
+				      ullValue <= ASYNC_LOG_MAX_STRING && ( uint64_t ) ( pucEnd - pucAt ) >= ullValue;
+				if( lOk )
+				{
+					memcpy( cString, pucAt, ( size_t ) ullValue );
+					cString[ ullValue ] = '\0';
+					pucAt += ullValue;
+					xArg.pvValue = cString;
+				}
+				break;
+
+			case eLogConvPointer:
+				lOk = prvGetVarint( &pucAt, pucEnd, &ullValue ) == 0;
+				xArg.pvValue = ( const void * ) ( uintptr_t ) ullValue;
+				break;
+
+			default:
+				/* Nothing was sent for it; vAsyncLogEmit() prints a marker. */
+				lOk = 1;
+				break;
+		}
+
+		if( lOk )
+		{
+			vAsyncLogEmit( &xSpec, &xArg, cLine, sizeof( cLine ), &xLen );
+		}
+		else if( xLen + 4 < sizeof( cLine ) )
+		{
+			memcpy( &cLine[ xLen ], "<?>", 4 );
+			xLen += 3;
+		}
+	}
+
+	fputs( cLine, stdout );
+}
+
+static void prvHandleFrame( const uint8_t *pucFrame, size_t xLength )
+{
+	const uint8_t *pucAt = pucFrame, *pucEnd = pucFrame + xLength;
+	uint64_t ullId, ullFirst, ullSecond;
+	uint8_t ucKind;
+
+	if( prvGetVarint( &pucAt, pucEnd, &ullId ) != 0 )
+	{
+		return;
+	}
+
+	if( ullId != 0 )
+	{
+		if( ullId < MAX_SITE_IDS && ullSites[ ullId ] != 0 )
+		{
+			prvPrintRecord( ullSites[ ullId ], pucAt, pucEnd );
+		}
+		else
+		{
+			printf( "<undefined log site id %llu>\n", ( unsigned long long ) ullId );
+		}
+		return;
+	}
+
+	if( pucAt >= pucEnd )
+	{
+		return;
+	}
+	ucKind = *pucAt++;
+
+	switch( ucKind )
+	{
+		case ASYNC_LOG_CTRL_DEFINE:
+			if( prvGetVarint( &pucAt, pucEnd, &ullFirst ) == 0 && prvGetVarint( &pucAt, pucEnd, &ullSecond ) == 0 &&
+			    ullFirst < MAX_SITE_IDS )
+			{
+				ullSites[ ullFirst ] = ullSecond;
+			}
+			break;
+
+		case ASYNC_LOG_CTRL_DROPS:
+			if( prvGetVarint( &pucAt, pucEnd, &ullFirst ) == 0 )
+			{
+				printf( "[async_log] %llu messages dropped\r\n", ( unsigned long long ) ullFirst );
+			}
+			break;
+
+		case ASYNC_LOG_CTRL_ANCHOR:
+			if( prvGetVarint( &pucAt, pucEnd, &ullFirst ) == 0 && ullAnchorLink != 0 )
+			{
+				llBias = ( int64_t ) ( ullFirst - ullAnchorLink );
+			}
+			break;
+
+		case ASYNC_LOG_CTRL_BY_ADDRESS:
+			if( prvGetVarint( &pucAt, pucEnd, &ullFirst ) == 0 )
+			{
+				prvPrintRecord( ullFirst, pucAt, pucEnd );
+			}
+			break;
+
+		default:
+			break;
+	}
+}
+
+/**************************************************************************/
+
+int main( int argc, char **argv )
+{
+	static uint8_t ucRaw[ MAX_FRAME ], ucFrame[ MAX_FRAME ];
+	FILE *pxIn = stdin;
+	size_t xRawLen = 0;
+	int lByte;
+
+	if( argc < 2 || argc > 3 )
+	{
+		fprintf( stderr, "usage: %s firmware.elf [capture.bin]\n", argv[ 0 ] );
+		return EXIT_FAILURE;
+	}
+
+	if( prvLoadElf( argv[ 1 ] ) != 0 )
+	{
+		return EXIT_FAILURE;
+	}
+
+	ullAnchorLink = prvFindSymbol( "vAsyncLogWrite" );
+	if( ullAnchorLink == 0 )
+	{
+		fprintf( stderr, "warning: vAsyncLogWrite not found in %s, assuming it is not relocated\n", argv[ 1 ] );
+	}
+
+	if( argc == 3 && ( pxIn = fopen( argv[ 2 ], "rb" ) ) == NULL )
+	{
+		perror( argv[ 2 ] );
+		return EXIT_FAILURE;
+	}
+
+	while( ( lByte = fgetc( pxIn ) ) != EOF )
+	{
+		if( lByte != 0 )
+		{
+			/* Oversized runs are line noise or text; drop them and wait for
+			   the next delimiter. */
+			if( xRawLen < sizeof( ucRaw ) ) ucRaw[ xRawLen ] = ( uint8_t ) lByte;
+			xRawLen++;
+			continue;
+		}
+
+		if( xRawLen > 0 && xRawLen <= sizeof( ucRaw ) )
+		{
+			/* COBS decode. */
+			size_t xIn = 0, xOut = 0;
+			int lValid = 1;
+
+			while( xIn < xRawLen )
+			{
+				uint8_t ucCode = ucRaw[ xIn++ ];
+
+				if( ucCode == 0 || xIn + ucCode - 1 > xRawLen )
+				{
+					lValid = 0;
+					break;
+				}
+				memcpy( &ucFrame[ xOut ], &ucRaw[ xIn ], ucCode - 1u );
+				xOut += ucCode - 1u;
+				xIn += ucCode - 1u;
+				if( ucCode != 0xFF && xIn < xRawLen )
+				{
+					ucFrame[ xOut++ ] = 0;
+				}
+			}
+
+			if( lValid )
+			{
+				prvHandleFrame( ucFrame, xOut );
+			}
+		}
+
+		xRawLen = 0;
+	}
+
+	return EXIT_SUCCESS;
+}